@@ -6,37 +6,141 @@
 #include <cstdlib>
 #include <cstdint>
 #include <algorithm>
+#include <stdexcept>
 #include "bst.h"
+#include "threadpool.h"
+#include "frozen.h"
 
 struct KeyError { };
 
+/**
+* Policies for the optional per-node bookkeeping an AVLTree keeps on top
+* of the balance. With NoAugment (the default) nothing extra is updated.
+* With OrderStatistics every node tracks the size of its subtree, which
+* makes size(), select(), rank() and count_range() O(log n) at the cost
+* of walking the insert/remove path once more to update the counts.
+* Aggregate<Monoid> additionally keeps a user-defined summary of each
+* subtree, see below.
+*
+* A policy provides value_type (the extra data stored in every node),
+* countsNodes (whether subtree sizes, and with them all other per-node
+* data, are maintained) and update(node), which recomputes a node's data
+* from its children.
+*/
+struct NoAggregate { };
+
+struct NoAugment
+{
+    typedef NoAggregate value_type;
+    static const bool countsNodes = false;
+    static const bool aggregates = false;
+    template<typename NodeType>
+    static void update(NodeType*) {}
+};
+
+struct OrderStatistics
+{
+    typedef NoAggregate value_type;
+    static const bool countsNodes = true;
+    static const bool aggregates = false;
+    template<typename NodeType>
+    static void update(NodeType* node)
+    {
+        node->setSize(1 + (node->getLeft() ? node->getLeft()->getSize() : 0)
+                        + (node->getRight() ? node->getRight()->getSize() : 0));
+    }
+};
+
+/**
+* Keeps Monoid's summary of every subtree, so AVLTree::aggregate(lo, hi)
+* runs in O(log n). Monoid must provide
+*
+*     typedef ... value_type;
+*     static value_type identity();
+*     static value_type lift(const Key& key, const Value& value);
+*     static value_type combine(const value_type& a, const value_type& b);
+*
+* where combine is associative and identity is its neutral element
+* (combine does not have to be commutative: it is always called with the
+* left operand holding the smaller keys). Subtree sizes are kept as well,
+* so the order statistics work too.
+*/
+template <typename Monoid>
+struct Aggregate
+{
+    typedef Monoid monoid;
+    typedef typename Monoid::value_type value_type;
+    static const bool countsNodes = true;
+    static const bool aggregates = true;
+    template<typename NodeType>
+    static void update(NodeType* node)
+    {
+        OrderStatistics::update(node);
+        value_type agg = Monoid::lift(node->getKey(), node->getValue());
+        if(node->getLeft() != nullptr){
+            agg = Monoid::combine(node->getLeft()->getAggregate(), agg);
+        }
+        if(node->getRight() != nullptr){
+            agg = Monoid::combine(agg, node->getRight()->getAggregate());
+        }
+        node->setAggregate(agg);
+    }
+};
+
+/**
+* Holds an AVLNode's aggregate. It is a base class rather than a member so
+* that it takes no space at all for the policies without an aggregate.
+*/
+template <typename T>
+class AVLAggregateSlot
+{
+protected:
+    T aggregate_;
+};
+
+template <>
+class AVLAggregateSlot<NoAggregate>
+{
+};
+
 /**
 * A special kind of node for an AVL tree, which adds the balance as a data member, plus
 * other additional helper functions. You do NOT need to implement any functionality or
 * add additional data members or helper functions.
 */
-template <typename Key, typename Value>
-class AVLNode : public Node<Key, Value>
+template <typename Key, typename Value, typename Augment = NoAugment>
+class AVLNode : public Node<Key, Value>, protected AVLAggregateSlot<typename Augment::value_type>
 {
 public:
     // Constructor/destructor.
-    AVLNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent);
-    virtual ~AVLNode();
+    AVLNode(const Key& key, const Value& value, AVLNode<Key, Value, Augment>* parent);
+    AVLNode(ItemBuilder<Key, Value>& builder, AVLNode<Key, Value, Augment>* parent);
+    ~AVLNode();
 
     // Getter/setter for the node's height.
     int8_t getBalance () const;
     void setBalance (int8_t balance);
     void updateBalance(int8_t diff);
 
+    // Getter/setter for the number of nodes in this subtree. Only kept
+    // up to date by trees using the OrderStatistics policy.
+    uint32_t getSize() const;
+    void setSize(uint32_t size);
+
+    // Getter/setter for the Aggregate policy's summary of this subtree.
+    const typename Augment::value_type& getAggregate() const;
+    void setAggregate(const typename Augment::value_type& aggregate);
+
     // Getters for parent, left, and right. These need to be redefined since they
-    // return pointers to AVLNodes - not plain Nodes. See the Node class in bst.h
-    // for more information.
-    virtual AVLNode<Key, Value>* getParent() const override;
-    virtual AVLNode<Key, Value>* getLeft() const override;
-    virtual AVLNode<Key, Value>* getRight() const override;
+    // return pointers to AVLNodes - not plain Nodes. They hide (not override)
+    // the Node versions, see the Node class in bst.h for more information.
+    AVLNode<Key, Value, Augment>* getParent() const;
+    AVLNode<Key, Value, Augment>* getLeft() const;
+    AVLNode<Key, Value, Augment>* getRight() const;
 
 protected:
     int8_t balance_;    // effectively a signed char
+    uint32_t size_;     // sits in the padding after balance_, so it is free
 };
 
 /*
@@ -48,9 +152,19 @@ protected:
 /**
 * An explicit constructor to initialize the elements by calling the base class constructor
 */
-template<class Key, class Value>
-AVLNode<Key, Value>::AVLNode(const Key& key, const Value& value, AVLNode<Key, Value> *parent) :
-    Node<Key, Value>(key, value, parent), balance_(0)
+template<class Key, class Value, class Augment>
+AVLNode<Key, Value, Augment>::AVLNode(const Key& key, const Value& value, AVLNode<Key, Value, Augment> *parent) :
+    Node<Key, Value>(key, value, parent), balance_(0), size_(1)
+{
+
+}
+
+/**
+* A constructor that builds the item in place, see ItemBuilder in bst.h
+*/
+template<class Key, class Value, class Augment>
+AVLNode<Key, Value, Augment>::AVLNode(ItemBuilder<Key, Value>& builder, AVLNode<Key, Value, Augment> *parent) :
+    Node<Key, Value>(builder, parent), balance_(0), size_(1)
 {
 
 }
@@ -58,8 +172,8 @@ AVLNode<Key, Value>::AVLNode(const Key& key, const Value& value, AVLNode<Key, Va
 /**
 * A destructor which does nothing.
 */
-template<class Key, class Value>
-AVLNode<Key, Value>::~AVLNode()
+template<class Key, class Value, class Augment>
+AVLNode<Key, Value, Augment>::~AVLNode()
 {
 
 }
@@ -67,8 +181,8 @@ AVLNode<Key, Value>::~AVLNode()
 /**
 * A getter for the balance of a AVLNode.
 */
-template<class Key, class Value>
-int8_t AVLNode<Key, Value>::getBalance() const
+template<class Key, class Value, class Augment>
+int8_t AVLNode<Key, Value, Augment>::getBalance() const
 {
     return balance_;
 }
@@ -76,8 +190,8 @@ int8_t AVLNode<Key, Value>::getBalance() const
 /**
 * A setter for the balance of a AVLNode.
 */
-template<class Key, class Value>
-void AVLNode<Key, Value>::setBalance(int8_t balance)
+template<class Key, class Value, class Augment>
+void AVLNode<Key, Value, Augment>::setBalance(int8_t balance)
 {
     balance_ = balance;
 }
@@ -85,38 +199,74 @@ void AVLNode<Key, Value>::setBalance(int8_t balance)
 /**
 * Adds diff to the balance of a AVLNode.
 */
-template<class Key, class Value>
-void AVLNode<Key, Value>::updateBalance(int8_t diff)
+template<class Key, class Value, class Augment>
+void AVLNode<Key, Value, Augment>::updateBalance(int8_t diff)
 {
     balance_ += diff;
 }
 
 /**
-* An overridden function for getting the parent since a static_cast is necessary to make sure
-* that our node is a AVLNode.
+* A getter for the subtree size of a AVLNode.
 */
-template<class Key, class Value>
-AVLNode<Key, Value> *AVLNode<Key, Value>::getParent() const
+template<class Key, class Value, class Augment>
+uint32_t AVLNode<Key, Value, Augment>::getSize() const
 {
-    return static_cast<AVLNode<Key, Value>*>(this->parent_);
+    return size_;
 }
 
 /**
-* Overridden for the same reasons as above.
+* A setter for the subtree size of a AVLNode.
 */
-template<class Key, class Value>
-AVLNode<Key, Value> *AVLNode<Key, Value>::getLeft() const
+template<class Key, class Value, class Augment>
+void AVLNode<Key, Value, Augment>::setSize(uint32_t size)
 {
-    return static_cast<AVLNode<Key, Value>*>(this->left_);
+    size_ = size;
 }
 
 /**
-* Overridden for the same reasons as above.
+* A getter for the aggregate of a AVLNode's subtree.
 */
-template<class Key, class Value>
-AVLNode<Key, Value> *AVLNode<Key, Value>::getRight() const
+template<class Key, class Value, class Augment>
+const typename Augment::value_type& AVLNode<Key, Value, Augment>::getAggregate() const
 {
-    return static_cast<AVLNode<Key, Value>*>(this->right_);
+    return this->aggregate_;
+}
+
+/**
+* A setter for the aggregate of a AVLNode's subtree.
+*/
+template<class Key, class Value, class Augment>
+void AVLNode<Key, Value, Augment>::setAggregate(const typename Augment::value_type& aggregate)
+{
+    this->aggregate_ = aggregate;
+}
+
+/**
+* A function for getting the parent since a static_cast is necessary to make sure
+* that our node is a AVLNode. Resolved at compile time, so this is free.
+*/
+template<class Key, class Value, class Augment>
+AVLNode<Key, Value, Augment> *AVLNode<Key, Value, Augment>::getParent() const
+{
+    return static_cast<AVLNode<Key, Value, Augment>*>(this->parent_);
+}
+
+/**
+* Redefined for the same reasons as above.
+*/
+template<class Key, class Value, class Augment>
+AVLNode<Key, Value, Augment> *AVLNode<Key, Value, Augment>::getLeft() const
+{
+    return static_cast<AVLNode<Key, Value, Augment>*>(this->left_);
+}
+
+/**
+* Redefined for the same reasons as above.
+*/
+template<class Key, class Value, class Augment>
+AVLNode<Key, Value, Augment> *AVLNode<Key, Value, Augment>::getRight() const
+{
+    return static_cast<AVLNode<Key, Value, Augment>*>(this->right_);
 }
 
 
@@ -127,33 +277,186 @@ AVLNode<Key, Value> *AVLNode<Key, Value>::getRight() const
 */
 
 
-template <class Key, class Value>
-class AVLTree : public BinarySearchTree<Key, Value>
+/**
+* A self-balancing AVL tree. Augment selects extra per-node bookkeeping,
+* see NoAugment and OrderStatistics above. Compare orders the keys as in
+* BinarySearchTree; the trees passed to split, join and the set
+* operations must use the same ordering.
+*/
+template <class Key, class Value, class Augment = NoAugment, class Compare = std::less<Key> >
+class AVLTree : public BinarySearchTree<Key, Value, Compare>
 {
 public:
-    virtual void insert (const std::pair<const Key, Value> &new_item); // TODO
-    virtual void remove(const Key& key);  // TODO
+    typedef typename BinarySearchTree<Key, Value, Compare>::iterator iterator;
+
+    AVLTree();
+    explicit AVLTree(const Compare& comp);
+    virtual ~AVLTree();
+    using BinarySearchTree<Key, Value, Compare>::remove;
+
+    // Order statistics, only available with the OrderStatistics policy.
+    // All of them are O(log n); ranks and indices start at 0.
+    std::size_t size() const;
+    iterator select(std::size_t k) const;
+    std::size_t rank(const Key& key) const;
+    std::size_t count_range(const Key& lo, const Key& hi) const;
+
+    // Range aggregates, only available with an Aggregate<Monoid> policy.
+    // After changing a value in place (through an iterator or operator[])
+    // call refresh() on it so the aggregates above it are recomputed.
+    typename Augment::value_type aggregate() const;
+    typename Augment::value_type aggregate(const Key& lo, const Key& hi) const;
+    void refresh(iterator it);
+
+    // Splitting and joining by relinking nodes, O(log n) each. split()
+    // leaves the keys < key here and moves the others into right (whose
+    // old contents are cleared). join(right) appends right, whose keys
+    // must all be larger; join(left, pivot, right) makes this tree hold
+    // left, then pivot, then right (this may be left or right itself).
+    // Only the pivot node is created, everything else is moved over and
+    // the emptied trees stay usable. Trees that hold nodes afterwards
+    // share one node pool, which locks so they can still be modified
+    // from different threads; emptied trees go back to a pool of their
+    // own. See NodePool.
+    void split(const Key& key, AVLTree<Key, Value, Augment, Compare>& right);
+    void join(AVLTree<Key, Value, Augment, Compare>& right);
+    void join(AVLTree<Key, Value, Augment, Compare>& left, std::pair<const Key, Value> pivot,
+        AVLTree<Key, Value, Augment, Compare>& right);
+
+    // Set operations built on split/join, O(m log(n/m + 1)) work for
+    // trees of sizes m <= n. The result replaces this tree and other is
+    // emptied; for keys in both trees this tree's item is kept. Large
+    // subproblems are handed to the thread pool, so Key comparisons and
+    // the Augment policy must be safe to call from several threads.
+    void set_union(AVLTree<Key, Value, Augment, Compare>& other, ThreadPool& threads = ThreadPool::shared());
+    void set_intersection(AVLTree<Key, Value, Augment, Compare>& other, ThreadPool& threads = ThreadPool::shared());
+    void set_difference(AVLTree<Key, Value, Augment, Compare>& other, ThreadPool& threads = ThreadPool::shared());
+
+    // An immutable copy laid out for fast lookups, see FrozenTree.
+    FrozenTree<Key, Value, Compare> freeze() const;
 protected:
-    virtual void nodeSwap( AVLNode<Key,Value>* n1, AVLNode<Key,Value>* n2);
+    virtual void nodeSwap( AVLNode<Key, Value, Augment>* n1, AVLNode<Key, Value, Augment>* n2);
+    virtual void removeNode(Node<Key, Value>* node);  // TODO
 
     // Add helper functions here
-    void rotateRight(AVLNode<Key,Value>* pivot);
-    void rotateLeft(AVLNode<Key, Value>* pivot);
-    void insertFix(AVLNode<Key, Value>* parent, AVLNode<Key, Value>* node);
-    void removeFix(AVLNode<Key, Value>* node, int diff);
-    void insertHelp(const std::pair<const Key, Value> &new_item);
-    
+    void rotateRight(AVLNode<Key, Value, Augment>* pivot);
+    void rotateLeft(AVLNode<Key, Value, Augment>* pivot);
+    void insertFix(AVLNode<Key, Value, Augment>* parent, AVLNode<Key, Value, Augment>* node);
+    void removeFix(AVLNode<Key, Value, Augment>* node, int diff);
+    virtual Node<Key, Value>* createNode(ItemBuilder<Key, Value>& builder, Node<Key, Value>* parent);
+    virtual void destroyNode(Node<Key, Value>* node);
+    virtual void rebalanceAfterInsert(Node<Key, Value>* node);
+    virtual void finishBuiltNode(Node<Key, Value>* node, int leftHeight, int rightHeight);
+    virtual void valueChanged(Node<Key, Value>* node);
+    static std::size_t subtreeSize(AVLNode<Key, Value, Augment>* node);
+    void updateAugment(AVLNode<Key, Value, Augment>* node);
+    void updateAugmentUpward(AVLNode<Key, Value, Augment>* node);
+
+    // Helpers for split/join. They work on detached subtrees (parent and
+    // root_ both null) whose heights are passed along explicitly.
+    static int subtreeHeight(AVLNode<Key, Value, Augment>* node);
+    static AVLNode<Key, Value, Augment>* leftmost(AVLNode<Key, Value, Augment>* node);
+    static AVLNode<Key, Value, Augment>* rightmost(AVLNode<Key, Value, Augment>* node);
+    AVLNode<Key, Value, Augment>* joinNodes(AVLNode<Key, Value, Augment>* left, int leftHeight,
+        AVLNode<Key, Value, Augment>* pivot, AVLNode<Key, Value, Augment>* right, int rightHeight, int& height);
+    AVLNode<Key, Value, Augment>* rebalanceJoined(AVLNode<Key, Value, Augment>* node,
+        int leftHeight, int rightHeight, int& height);
+    void splitNodes(AVLNode<Key, Value, Augment>* node, int height, const Key& key,
+        AVLNode<Key, Value, Augment>*& left, int& leftHeight, AVLNode<Key, Value, Augment>*& found,
+        AVLNode<Key, Value, Augment>*& right, int& rightHeight);
+    AVLNode<Key, Value, Augment>* removeMin(AVLNode<Key, Value, Augment>* node, int height,
+        AVLNode<Key, Value, Augment>*& min, int& newHeight);
+    AVLNode<Key, Value, Augment>* joinTwo(AVLNode<Key, Value, Augment>* left, int leftHeight,
+        AVLNode<Key, Value, Augment>* right, int rightHeight, int& height);
+
+    // Subtrees dropped by the set operations, chained through the parent
+    // pointer of their roots. Freeing them is left until the parallel
+    // part is over, since the node pool is not thread-safe.
+    struct DroppedNodes
+    {
+        AVLNode<Key, Value, Augment>* head;
+        AVLNode<Key, Value, Augment>* tail;
+        DroppedNodes() : head(nullptr), tail(nullptr) {}
+        void add(AVLNode<Key, Value, Augment>* subtree);
+        void append(const DroppedNodes& other);
+    };
+    enum SetOperation { SET_UNION, SET_INTERSECTION, SET_DIFFERENCE };
+    // Below this height (about 2^11 nodes) subproblems are not worth a task.
+    static const int PARALLEL_MIN_HEIGHT = 12;
+    void setOperation(SetOperation op, AVLTree<Key, Value, Augment, Compare>& other, ThreadPool& threads);
+    AVLNode<Key, Value, Augment>* setOperationNodes(SetOperation op,
+        AVLNode<Key, Value, Augment>* a, int aHeight, AVLNode<Key, Value, Augment>* b, int bHeight,
+        int& height, DroppedNodes& dropped, ThreadPool& threads);
 };
 
-template<class Key, class Value>
-void AVLTree<Key, Value>::rotateRight(AVLNode<Key,Value>* pivot) {
+/**
+* Default constructor, which sizes the node pool for AVLNodes.
+*/
+template<class Key, class Value, class Augment, class Compare>
+AVLTree<Key, Value, Augment, Compare>::AVLTree() :
+    BinarySearchTree<Key, Value, Compare>(sizeof(AVLNode<Key, Value, Augment>),
+        std::is_trivially_destructible<std::pair<const Key, Value> >::value &&
+        std::is_trivially_destructible<typename Augment::value_type>::value, Compare())
+{
+
+}
+
+/**
+* An empty tree ordered by the given comparator.
+*/
+template<class Key, class Value, class Augment, class Compare>
+AVLTree<Key, Value, Augment, Compare>::AVLTree(const Compare& comp) :
+    BinarySearchTree<Key, Value, Compare>(sizeof(AVLNode<Key, Value, Augment>),
+        std::is_trivially_destructible<std::pair<const Key, Value> >::value &&
+        std::is_trivially_destructible<typename Augment::value_type>::value, comp)
+{
+
+}
+
+/**
+* Destructor, which clears the tree here (rather than leaving it to the
+* base destructor) so the AVLNode version of destroyNode is used.
+*/
+template<class Key, class Value, class Augment, class Compare>
+AVLTree<Key, Value, Augment, Compare>::~AVLTree()
+{
+    this->clear();
+}
+
+/**
+* Allocates a slot from the tree's pool and constructs an AVLNode in it.
+*/
+template<class Key, class Value, class Augment, class Compare>
+Node<Key, Value>* AVLTree<Key, Value, Augment, Compare>::createNode(ItemBuilder<Key, Value>& builder, Node<Key, Value>* parent)
+{
+    void* slot = this->pool().allocate();
+    try {
+        return new (slot) AVLNode<Key, Value, Augment>(builder, static_cast<AVLNode<Key, Value, Augment>*>(parent));
+    } catch(...) {
+        this->pool().deallocate(slot);
+        throw;
+    }
+}
+
+/**
+* Destroys an AVLNode and gives its slot back to the pool.
+*/
+template<class Key, class Value, class Augment, class Compare>
+void AVLTree<Key, Value, Augment, Compare>::destroyNode(Node<Key, Value>* node)
+{
+    static_cast<AVLNode<Key, Value, Augment>*>(node)->~AVLNode();
+    this->pool().deallocate(node);
+}
+
+template<class Key, class Value, class Augment, class Compare>
+void AVLTree<Key, Value, Augment, Compare>::rotateRight(AVLNode<Key, Value, Augment>* pivot) {
     //pivot is the node that becomes its left child's right child
-    if(pivot == BinarySearchTree<Key, Value>::root_) {
-        BinarySearchTree<Key,Value>::root_ = pivot->getLeft();
+    if(pivot == BinarySearchTree<Key, Value, Compare>::root_) {
+        BinarySearchTree<Key, Value, Compare>::root_ = pivot->getLeft();
     }
-    AVLNode<Key,Value>* parent = pivot->getParent();
-    AVLNode<Key, Value>* lChild = pivot->getLeft();
-    AVLNode<Key, Value>* newLChild = lChild->getRight();
+    AVLNode<Key, Value, Augment>* parent = pivot->getParent();
+    AVLNode<Key, Value, Augment>* lChild = pivot->getLeft();
+    AVLNode<Key, Value, Augment>* newLChild = lChild->getRight();
 
     if(parent != nullptr){
         //actually wait, this may be wrong
@@ -174,18 +477,21 @@ void AVLTree<Key, Value>::rotateRight(AVLNode<Key,Value>* pivot) {
     if(newLChild != nullptr){
         newLChild->setParent(pivot);
     }
+    //pivot is now below lChild, so it has to be recounted first
+    updateAugment(pivot);
+    updateAugment(lChild);
     
 }
 
-template<class Key, class Value>
-void AVLTree<Key, Value>::rotateLeft(AVLNode<Key,Value>* pivot){
+template<class Key, class Value, class Augment, class Compare>
+void AVLTree<Key, Value, Augment, Compare>::rotateLeft(AVLNode<Key, Value, Augment>* pivot){
     //pivot is the node that becomes its right child's left child
-    if(pivot == BinarySearchTree<Key,Value>::root_){
-        BinarySearchTree<Key,Value>::root_ = pivot->getRight();
+    if(pivot == BinarySearchTree<Key, Value, Compare>::root_){
+        BinarySearchTree<Key, Value, Compare>::root_ = pivot->getRight();
     }
-    AVLNode<Key,Value> * parent = pivot->getParent();
-    AVLNode<Key,Value>* rChild = pivot->getRight();
-    AVLNode<Key,Value>* newRChild = rChild->getLeft();
+    AVLNode<Key, Value, Augment> * parent = pivot->getParent();
+    AVLNode<Key, Value, Augment>* rChild = pivot->getRight();
+    AVLNode<Key, Value, Augment>* newRChild = rChild->getLeft();
 
     if(parent != nullptr){
         //this is the issue, since it may become parent's right child
@@ -202,73 +508,26 @@ void AVLTree<Key, Value>::rotateLeft(AVLNode<Key,Value>* pivot){
     if(newRChild != nullptr){
         newRChild->setParent(pivot);
     }
+    updateAugment(pivot);
+    updateAugment(rChild);
 }
 
 
 
-template<class Key, class Value>
-void AVLTree<Key, Value>::insertHelp(const std::pair<const Key, Value> &new_item)
-{
-    if(BinarySearchTree<Key,Value>::root_==nullptr) {
-        //for first insertion we set root to what we're insertin
-        AVLNode<Key,Value>* avlRoot = new AVLNode<Key,Value>(new_item.first, new_item.second, nullptr);
-        BinarySearchTree<Key,Value>::root_ = avlRoot;
-        return;
-    }
-
-    if(BinarySearchTree<Key,Value>::internalFind(new_item.first)!= NULL) {
-        BinarySearchTree<Key,Value>::internalFind(new_item.first)->setValue(new_item.second);
-        return;
-    }
-    
-    AVLNode<Key,Value> *temp = static_cast<AVLNode<Key, Value>*>(BinarySearchTree<Key,Value>::root_);
-    AVLNode<Key,Value> * tempParent = nullptr;
-    //nvm do this later when parent is known, params are key, value, parent;
-    //Node<Key,Value> *temp = new Node();
-
-    //bst searching while within the tree
-    while(temp != nullptr) {
-        //iterate left or right
-        //if key of current node is less than the param, we shoudl go right
-        if(temp->getKey() < new_item.first) {
-            tempParent = temp;
-            temp = temp->getRight();
-        }else{
-            //don't have to worry about same key, bcs of case 1
-            tempParent = temp;
-            temp = temp->getLeft();
-        }
-        //if we reached a null node that means that 
-        //we found were to insert our child
-        //this is why we need to track the parent
-    }
-    AVLNode<Key,Value> * insertion = new AVLNode<Key,Value>(new_item.first, new_item.second, tempParent);
-    //std::cout << insertion->getBalance() << std::endl;
-    //std::cout << static_cast<int>(insertion->getBalance()) << std::endl;
-    if(new_item.first < tempParent->getKey()) {
-        tempParent->setLeft(insertion);
-    } else {
-        tempParent ->setRight(insertion);
-    }
-
-
-}
 /*
- * Recall: If key is already in the tree, you should 
- * overwrite the current value with the updated value.
+ * Called by the BST insert paths once a brand new node has been linked
+ * in (overwriting an existing key never gets here). Updates the parent's
+ * balance and walks up with insertFix if the subtree got taller.
  */
-template<class Key, class Value>
-void AVLTree<Key, Value>::insert (const std::pair<const Key, Value> &new_item)
+template<class Key, class Value, class Augment, class Compare>
+void AVLTree<Key, Value, Augment, Compare>::rebalanceAfterInsert(Node<Key, Value>* node)
 {
-    // TODO
-    //bst insert rewritten to accomodate avl nodes
-    insertHelp(new_item);
-
-    //static_cast may not be needed, but it works so i'm not getting rid of it
-    AVLNode<Key,Value>* temp = static_cast<AVLNode<Key, Value>*>(BinarySearchTree<Key,Value>::internalFind(new_item.first));
+    AVLNode<Key, Value, Augment>* temp = static_cast<AVLNode<Key, Value, Augment>*>(node);
+    //counts have to be right before insertFix starts rotating
+    updateAugmentUpward(temp);
     
-    if(temp != BinarySearchTree<Key,Value>::root_){
-        AVLNode<Key, Value>* tempParent = temp->getParent();
+    if(temp != BinarySearchTree<Key, Value, Compare>::root_){
+        AVLNode<Key, Value, Augment>* tempParent = temp->getParent();
         if(tempParent->getBalance()==-1 ||tempParent->getBalance()==1){
             tempParent->setBalance(0);
         }else{
@@ -282,12 +541,24 @@ void AVLTree<Key, Value>::insert (const std::pair<const Key, Value> &new_item)
     }
 }
 
-template<typename Key, typename Value>
-void AVLTree<Key, Value>::insertFix(AVLNode<Key, Value>* parent, AVLNode<Key, Value>* node){
+/*
+ * Bulk builds (assign_sorted) hand over the subtree heights directly,
+ * so the balance is set without any rotations.
+ */
+template<class Key, class Value, class Augment, class Compare>
+void AVLTree<Key, Value, Augment, Compare>::finishBuiltNode(Node<Key, Value>* node, int leftHeight, int rightHeight)
+{
+    AVLNode<Key, Value, Augment>* avlNode = static_cast<AVLNode<Key, Value, Augment>*>(node);
+    avlNode->setBalance(rightHeight - leftHeight);
+    updateAugment(avlNode);
+}
+
+template<typename Key, typename Value, class Augment, class Compare>
+void AVLTree<Key, Value, Augment, Compare>::insertFix(AVLNode<Key, Value, Augment>* parent, AVLNode<Key, Value, Augment>* node){
     if(parent == nullptr || parent->getParent()== nullptr){
         return;
     }
-    AVLNode<Key, Value>* grandparent = parent->getParent();
+    AVLNode<Key, Value, Augment>* grandparent = parent->getParent();
 
     if(grandparent->getLeft() == parent){
         grandparent->updateBalance(-1);
@@ -371,39 +642,35 @@ void AVLTree<Key, Value>::insertFix(AVLNode<Key, Value>* parent, AVLNode<Key, Va
  * Recall: The writeup specifies that if a node has 2 children you
  * should swap with the predecessor and then remove.
  */
-template<class Key, class Value>
-void AVLTree<Key, Value>::remove(const Key& key)
+template<class Key, class Value, class Augment, class Compare>
+void AVLTree<Key, Value, Augment, Compare>::removeNode(Node<Key, Value>* node)
 {
     // TODO
 
-    //find node to remove by walking tree
-    AVLNode<Key, Value>* temp = static_cast<AVLNode<Key, Value>*>(BinarySearchTree<Key,Value>::internalFind(key));
-    //do nothing if it doesn't exist
-    if(temp == nullptr){
-        return;
-    }
+    //the node was found by remove(), or by a cursor
+    AVLNode<Key, Value, Augment>* temp = static_cast<AVLNode<Key, Value, Augment>*>(node);
 
     //if n has 2 children, swap positions with predecessor 
     bool hasTwoChildren = false;
-    AVLNode<Key, Value>* pred = nullptr;
+    AVLNode<Key, Value, Augment>* pred = nullptr;
     if(temp->getLeft() != nullptr && temp->getRight() != nullptr){
         //if a node has two children, it has a predecessor
 
-        pred = static_cast<AVLNode<Key, Value>*>(BinarySearchTree<Key,Value>::predecessor(temp));
+        pred = static_cast<AVLNode<Key, Value, Augment>*>(BinarySearchTree<Key, Value, Compare>::predecessor(temp));
         //keep track of root, since we won't use the regular remove
         
         //swap nodes with in order predecessor
         nodeSwap(temp, pred);
 
-        if(BinarySearchTree<Key,Value>::root_ == temp){
-            BinarySearchTree<Key,Value>::root_ = pred;
+        if(BinarySearchTree<Key, Value, Compare>::root_ == temp){
+            BinarySearchTree<Key, Value, Compare>::root_ = pred;
         }
         
         hasTwoChildren = true;
     }
     
-    int diff;
-    AVLNode<Key, Value>* tempParent = temp->getParent();
+    int diff = 0;
+    AVLNode<Key, Value, Augment>* tempParent = temp->getParent();
     if(tempParent != nullptr){
         if(tempParent->getLeft()== temp){
             diff = 1;
@@ -424,21 +691,22 @@ void AVLTree<Key, Value>::remove(const Key& key)
         if(temp->getLeft()!= nullptr){
             temp->getLeft()->setParent(tempParent);
         }
-        delete temp;
+        this->destroyNode(temp);
     }else{
-        BinarySearchTree<Key,Value>::remove(key);
+        BinarySearchTree<Key, Value, Compare>::removeNode(temp);
     }
+    updateAugmentUpward(tempParent);
     removeFix(tempParent, diff);
 }
 
-template<typename Key, typename Value>
-void AVLTree<Key, Value>::removeFix(AVLNode<Key, Value>* node, int diff){
+template<typename Key, typename Value, class Augment, class Compare>
+void AVLTree<Key, Value, Augment, Compare>::removeFix(AVLNode<Key, Value, Augment>* node, int diff){
     if(node == nullptr){
         return;
     }
     //idk how to explain this, this is literally just the pseudocode from the slides
     //but written out in c++
-    AVLNode<Key,Value>* parent = node->getParent();
+    AVLNode<Key, Value, Augment>* parent = node->getParent();
     int nDiff = -1;
     if(parent != nullptr){
         if(parent->getLeft()== node){
@@ -447,7 +715,7 @@ void AVLTree<Key, Value>::removeFix(AVLNode<Key, Value>* node, int diff){
     }
     if(diff == -1){
         if(node->getBalance() + diff == -2){
-            AVLNode<Key, Value>* child = node->getLeft();
+            AVLNode<Key, Value, Augment>* child = node->getLeft();
             if(child->getBalance() == -1){
                 rotateRight(node);
                 node->setBalance(0);
@@ -458,7 +726,7 @@ void AVLTree<Key, Value>::removeFix(AVLNode<Key, Value>* node, int diff){
                 node->setBalance(-1);
                 child->setBalance(1);
             }else{
-                AVLNode<Key, Value>* grandchild = child->getRight();
+                AVLNode<Key, Value, Augment>* grandchild = child->getRight();
                 rotateLeft(child);
                 rotateRight(node);
                 if(grandchild->getBalance() == 1){
@@ -486,7 +754,7 @@ void AVLTree<Key, Value>::removeFix(AVLNode<Key, Value>* node, int diff){
 
     }else{
         if(node->getBalance() + diff == 2){
-            AVLNode<Key, Value>* child = node->getRight();
+            AVLNode<Key, Value, Augment>* child = node->getRight();
             if(child->getBalance() == 1){
                 rotateLeft(node);
                 node->setBalance(0);
@@ -497,7 +765,7 @@ void AVLTree<Key, Value>::removeFix(AVLNode<Key, Value>* node, int diff){
                 node->setBalance(1);
                 child->setBalance(-1);
             }else{
-                AVLNode<Key, Value>* grandchild = child->getLeft();
+                AVLNode<Key, Value, Augment>* grandchild = child->getLeft();
                 rotateRight(child);
                 rotateLeft(node);
                 if(grandchild->getBalance() == -1){
@@ -526,13 +794,760 @@ void AVLTree<Key, Value>::removeFix(AVLNode<Key, Value>* node, int diff){
 }
 
 
-template<class Key, class Value>
-void AVLTree<Key, Value>::nodeSwap( AVLNode<Key,Value>* n1, AVLNode<Key,Value>* n2)
+template<class Key, class Value, class Augment, class Compare>
+void AVLTree<Key, Value, Augment, Compare>::nodeSwap( AVLNode<Key, Value, Augment>* n1, AVLNode<Key, Value, Augment>* n2)
 {
-    BinarySearchTree<Key, Value>::nodeSwap(n1, n2);
+    BinarySearchTree<Key, Value, Compare>::nodeSwap(n1, n2);
     int8_t tempB = n1->getBalance();
     n1->setBalance(n2->getBalance());
     n2->setBalance(tempB);
+    //sizes belong to the position in the tree, so they move too
+    //(aggregates get recomputed on the way up after the removal)
+    uint32_t tempS = n1->getSize();
+    n1->setSize(n2->getSize());
+    n2->setSize(tempS);
+}
+
+/**
+* Number of nodes below (and including) node, 0 for an empty subtree.
+*/
+template<class Key, class Value, class Augment, class Compare>
+std::size_t AVLTree<Key, Value, Augment, Compare>::subtreeSize(AVLNode<Key, Value, Augment>* node)
+{
+    return node == nullptr ? 0 : node->getSize();
+}
+
+/**
+* Recomputes the size (and aggregate) of node from its children. No-op
+* unless the policy keeps per-node data.
+*/
+template<class Key, class Value, class Augment, class Compare>
+void AVLTree<Key, Value, Augment, Compare>::updateAugment(AVLNode<Key, Value, Augment>* node)
+{
+    Augment::update(node);
+}
+
+/**
+* Recomputes node and every ancestor of it, used after a node has been
+* linked in or unlinked or its value has changed.
+*/
+template<class Key, class Value, class Augment, class Compare>
+void AVLTree<Key, Value, Augment, Compare>::updateAugmentUpward(AVLNode<Key, Value, Augment>* node)
+{
+    if(Augment::countsNodes){
+        for(; node != nullptr; node = node->getParent()){
+            Augment::update(node);
+        }
+    }
+}
+
+/**
+* Overwriting the value of an existing key changes the aggregates above it.
+*/
+template<class Key, class Value, class Augment, class Compare>
+void AVLTree<Key, Value, Augment, Compare>::valueChanged(Node<Key, Value>* node)
+{
+    updateAugmentUpward(static_cast<AVLNode<Key, Value, Augment>*>(node));
+}
+
+/**
+* Returns the number of items in the tree.
+*/
+template<class Key, class Value, class Augment, class Compare>
+std::size_t AVLTree<Key, Value, Augment, Compare>::size() const
+{
+    static_assert(Augment::countsNodes, "size() needs an AVLTree with the OrderStatistics policy");
+    return subtreeSize(static_cast<AVLNode<Key, Value, Augment>*>(this->root_));
+}
+
+/**
+* Returns an iterator to the k-th smallest item (k = 0 is the smallest),
+* or end() if the tree has k items or fewer.
+*/
+template<class Key, class Value, class Augment, class Compare>
+typename AVLTree<Key, Value, Augment, Compare>::iterator
+AVLTree<Key, Value, Augment, Compare>::select(std::size_t k) const
+{
+    static_assert(Augment::countsNodes, "select() needs an AVLTree with the OrderStatistics policy");
+    AVLNode<Key, Value, Augment>* temp = static_cast<AVLNode<Key, Value, Augment>*>(this->root_);
+    while(temp != nullptr){
+        std::size_t leftSize = subtreeSize(temp->getLeft());
+        if(k < leftSize){
+            temp = temp->getLeft();
+        }else if(k == leftSize){
+            break;
+        }else{
+            k -= leftSize + 1;
+            temp = temp->getRight();
+        }
+    }
+    return this->makeIterator(temp);
+}
+
+/**
+* Returns the number of keys in the tree that are smaller than key
+* (key itself does not have to be in the tree).
+*/
+template<class Key, class Value, class Augment, class Compare>
+std::size_t AVLTree<Key, Value, Augment, Compare>::rank(const Key& key) const
+{
+    static_assert(Augment::countsNodes, "rank() needs an AVLTree with the OrderStatistics policy");
+    std::size_t smaller = 0;
+    AVLNode<Key, Value, Augment>* temp = static_cast<AVLNode<Key, Value, Augment>*>(this->root_);
+    while(temp != nullptr){
+        if(this->comp_(temp->getKey(), key)){
+            smaller += subtreeSize(temp->getLeft()) + 1;
+            temp = temp->getRight();
+        }else{
+            temp = temp->getLeft();
+        }
+    }
+    return smaller;
+}
+
+/**
+* Returns the number of keys k with lo <= k < hi.
+*/
+template<class Key, class Value, class Augment, class Compare>
+std::size_t AVLTree<Key, Value, Augment, Compare>::count_range(const Key& lo, const Key& hi) const
+{
+    if(!this->comp_(lo, hi)){
+        return 0;
+    }
+    return rank(hi) - rank(lo);
+}
+
+
+/**
+* Returns the aggregate over the whole tree (the identity if it is empty).
+*/
+template<class Key, class Value, class Augment, class Compare>
+typename Augment::value_type AVLTree<Key, Value, Augment, Compare>::aggregate() const
+{
+    static_assert(Augment::aggregates, "aggregate() needs an AVLTree with an Aggregate<Monoid> policy");
+    if(this->root_ == nullptr){
+        return Augment::monoid::identity();
+    }
+    return static_cast<AVLNode<Key, Value, Augment>*>(this->root_)->getAggregate();
+}
+
+/**
+* Returns the aggregate over the keys k with lo <= k < hi, combined in key
+* order. Only the two boundary paths are visited, so this is O(log n) no
+* matter how many keys are in the range.
+*/
+template<class Key, class Value, class Augment, class Compare>
+typename Augment::value_type AVLTree<Key, Value, Augment, Compare>::aggregate(const Key& lo, const Key& hi) const
+{
+    static_assert(Augment::aggregates, "aggregate() needs an AVLTree with an Aggregate<Monoid> policy");
+    typedef typename Augment::monoid Monoid;
+    typedef typename Augment::value_type Agg;
+
+    //find the highest node inside the range, the paths to lo and hi split there
+    AVLNode<Key, Value, Augment>* split = static_cast<AVLNode<Key, Value, Augment>*>(this->root_);
+    while(split != nullptr){
+        if(this->comp_(split->getKey(), lo)){
+            split = split->getRight();
+        }else if(!this->comp_(split->getKey(), hi)){
+            split = split->getLeft();
+        }else{
+            break;
+        }
+    }
+    if(split == nullptr){
+        return Monoid::identity();
+    }
+
+    //everything >= lo in the left subtree, collected right to left
+    Agg leftPart = Monoid::identity();
+    for(AVLNode<Key, Value, Augment>* temp = split->getLeft(); temp != nullptr; ){
+        if(this->comp_(temp->getKey(), lo)){
+            temp = temp->getRight();
+        }else{
+            Agg here = Monoid::lift(temp->getKey(), temp->getValue());
+            if(temp->getRight() != nullptr){
+                here = Monoid::combine(here, temp->getRight()->getAggregate());
+            }
+            leftPart = Monoid::combine(here, leftPart);
+            temp = temp->getLeft();
+        }
+    }
+
+    //everything < hi in the right subtree, collected left to right
+    Agg rightPart = Monoid::identity();
+    for(AVLNode<Key, Value, Augment>* temp = split->getRight(); temp != nullptr; ){
+        if(!this->comp_(temp->getKey(), hi)){
+            temp = temp->getLeft();
+        }else{
+            Agg here = Monoid::lift(temp->getKey(), temp->getValue());
+            if(temp->getLeft() != nullptr){
+                here = Monoid::combine(temp->getLeft()->getAggregate(), here);
+            }
+            rightPart = Monoid::combine(rightPart, here);
+            temp = temp->getRight();
+        }
+    }
+
+    Agg middle = Monoid::lift(split->getKey(), split->getValue());
+    return Monoid::combine(Monoid::combine(leftPart, middle), rightPart);
+}
+
+/**
+* Recomputes the aggregates above an item whose value was changed in place.
+*/
+template<class Key, class Value, class Augment, class Compare>
+void AVLTree<Key, Value, Augment, Compare>::refresh(iterator it)
+{
+    if(it != this->end()){
+        updateAugmentUpward(static_cast<AVLNode<Key, Value, Augment>*>(this->iteratorNode(it)));
+    }
+}
+
+/**
+* Splits the tree at key: the keys smaller than key stay in this tree and
+* the rest are moved into right. Runs in O(log n) and creates no nodes.
+*/
+template<class Key, class Value, class Augment, class Compare>
+void AVLTree<Key, Value, Augment, Compare>::split(const Key& key, AVLTree<Key, Value, Augment, Compare>& right)
+{
+    if(&right == this){
+        throw std::invalid_argument("split needs a second tree for the upper half");
+    }
+    right.clear();
+    this->sharePool(right);
+
+    AVLNode<Key, Value, Augment>* root = static_cast<AVLNode<Key, Value, Augment>*>(this->root_);
+    this->root_ = nullptr;
+    AVLNode<Key, Value, Augment>* lower;
+    AVLNode<Key, Value, Augment>* found;
+    AVLNode<Key, Value, Augment>* upper;
+    int lowerHeight, upperHeight;
+    splitNodes(root, subtreeHeight(root), key, lower, lowerHeight, found, upper, upperHeight);
+    if(found != nullptr){
+        upper = joinNodes(nullptr, 0, found, upper, upperHeight, upperHeight);
+    }
+    this->root_ = lower;
+    right.root_ = upper;
+    this->rightmost_ = nullptr;
+    right.rightmost_ = nullptr;
+}
+
+/**
+* Moves every item of right to the end of this tree; all of right's keys
+* must be larger than the keys here. Runs in O(log n) and creates no nodes.
+*/
+template<class Key, class Value, class Augment, class Compare>
+void AVLTree<Key, Value, Augment, Compare>::join(AVLTree<Key, Value, Augment, Compare>& right)
+{
+    if(&right == this){
+        throw std::invalid_argument("cannot join a tree with itself");
+    }
+    AVLNode<Key, Value, Augment>* lower = static_cast<AVLNode<Key, Value, Augment>*>(this->root_);
+    AVLNode<Key, Value, Augment>* upper = static_cast<AVLNode<Key, Value, Augment>*>(right.root_);
+    if(upper == nullptr){
+        return;
+    }
+    if(lower != nullptr && !this->comp_(rightmost(lower)->getKey(), leftmost(upper)->getKey())){
+        throw std::invalid_argument("join needs every key on the right to be larger");
+    }
+    this->sharePool(right);
+    right.root_ = nullptr;
+    right.rightmost_ = nullptr;
+    //empty now, so it lets go of the shared pool
+    right.clear();
+    this->rightmost_ = nullptr;
+    if(lower == nullptr){
+        this->root_ = upper;
+        return;
+    }
+
+    this->root_ = nullptr;
+    int height;
+    this->root_ = joinTwo(lower, subtreeHeight(lower), upper, subtreeHeight(upper), height);
+}
+
+/**
+* Replaces this tree with the items of left, pivot and the items of right,
+* emptying left and right. Needs every key in left to be smaller than the
+* pivot's and every key in right to be larger. O(log n).
+*/
+template<class Key, class Value, class Augment, class Compare>
+void AVLTree<Key, Value, Augment, Compare>::join(AVLTree<Key, Value, Augment, Compare>& left, std::pair<const Key, Value> pivot,
+    AVLTree<Key, Value, Augment, Compare>& right)
+{
+    if(&left == &right){
+        throw std::invalid_argument("join needs two different trees");
+    }
+    AVLNode<Key, Value, Augment>* lower = static_cast<AVLNode<Key, Value, Augment>*>(left.root_);
+    AVLNode<Key, Value, Augment>* upper = static_cast<AVLNode<Key, Value, Augment>*>(right.root_);
+    if((lower != nullptr && !this->comp_(rightmost(lower)->getKey(), pivot.first)) ||
+       (upper != nullptr && !this->comp_(pivot.first, leftmost(upper)->getKey()))){
+        throw std::invalid_argument("join needs left keys < pivot < right keys");
+    }
+    if(this != &left && this != &right){
+        this->clear();
+    }
+    this->sharePool(left);
+    this->sharePool(right);
+
+    auto build = [&]() {
+        return std::move(pivot);
+    };
+    ItemBuilderFn<Key, Value, decltype(build)> builder(build);
+    AVLNode<Key, Value, Augment>* node =
+        static_cast<AVLNode<Key, Value, Augment>*>(this->createNode(builder, nullptr));
+
+    left.root_ = nullptr;
+    right.root_ = nullptr;
+    this->root_ = nullptr;
+    left.rightmost_ = nullptr;
+    right.rightmost_ = nullptr;
+    this->rightmost_ = nullptr;
+    int height;
+    this->root_ = joinNodes(lower, subtreeHeight(lower), node, upper, subtreeHeight(upper), height);
+    //the emptied trees let go of the shared pool
+    if(&left != this){
+        left.clear();
+    }
+    if(&right != this){
+        right.clear();
+    }
+}
+
+/**
+* Height of a subtree (0 for an empty one), found by always stepping to
+* the taller child, so it costs O(log n) rather than a full traversal.
+*/
+template<class Key, class Value, class Augment, class Compare>
+int AVLTree<Key, Value, Augment, Compare>::subtreeHeight(AVLNode<Key, Value, Augment>* node)
+{
+    int height = 0;
+    while(node != nullptr){
+        ++height;
+        node = node->getBalance() < 0 ? node->getLeft() : node->getRight();
+    }
+    return height;
+}
+
+template<class Key, class Value, class Augment, class Compare>
+AVLNode<Key, Value, Augment>* AVLTree<Key, Value, Augment, Compare>::leftmost(AVLNode<Key, Value, Augment>* node)
+{
+    while(node->getLeft() != nullptr){
+        node = node->getLeft();
+    }
+    return node;
+}
+
+template<class Key, class Value, class Augment, class Compare>
+AVLNode<Key, Value, Augment>* AVLTree<Key, Value, Augment, Compare>::rightmost(AVLNode<Key, Value, Augment>* node)
+{
+    while(node->getRight() != nullptr){
+        node = node->getRight();
+    }
+    return node;
+}
+
+/**
+* Joins two detached subtrees around pivot (every key in left < pivot <
+* every key in right) and returns the new root. The shorter subtree is
+* hung off the spine of the taller one where the heights meet, so this
+* takes O(|leftHeight - rightHeight| + 1) time.
+*/
+template<class Key, class Value, class Augment, class Compare>
+AVLNode<Key, Value, Augment>* AVLTree<Key, Value, Augment, Compare>::joinNodes(AVLNode<Key, Value, Augment>* left, int leftHeight,
+    AVLNode<Key, Value, Augment>* pivot, AVLNode<Key, Value, Augment>* right, int rightHeight, int& height)
+{
+    if(leftHeight > rightHeight + 1){
+        //walk down the right spine of the left tree
+        int childLeft = leftHeight - (left->getBalance() > 0 ? 2 : 1);
+        int childRight = leftHeight - (left->getBalance() < 0 ? 2 : 1);
+        AVLNode<Key, Value, Augment>* child = left->getRight();
+        if(child != nullptr){
+            child->setParent(nullptr);
+        }
+        int joinedHeight;
+        AVLNode<Key, Value, Augment>* joined = joinNodes(child, childRight, pivot, right, rightHeight, joinedHeight);
+        left->setRight(joined);
+        joined->setParent(left);
+        return rebalanceJoined(left, childLeft, joinedHeight, height);
+    }
+    if(rightHeight > leftHeight + 1){
+        //mirror image, down the left spine of the right tree
+        int childLeft = rightHeight - (right->getBalance() > 0 ? 2 : 1);
+        int childRight = rightHeight - (right->getBalance() < 0 ? 2 : 1);
+        AVLNode<Key, Value, Augment>* child = right->getLeft();
+        if(child != nullptr){
+            child->setParent(nullptr);
+        }
+        int joinedHeight;
+        AVLNode<Key, Value, Augment>* joined = joinNodes(left, leftHeight, pivot, child, childLeft, joinedHeight);
+        right->setLeft(joined);
+        joined->setParent(right);
+        return rebalanceJoined(right, joinedHeight, childRight, height);
+    }
+
+    //heights are close enough, pivot just becomes the root
+    pivot->setParent(nullptr);
+    pivot->setLeft(left);
+    pivot->setRight(right);
+    if(left != nullptr){
+        left->setParent(pivot);
+    }
+    if(right != nullptr){
+        right->setParent(pivot);
+    }
+    pivot->setBalance(rightHeight - leftHeight);
+    updateAugment(pivot);
+    height = std::max(leftHeight, rightHeight) + 1;
+    return pivot;
+}
+
+/**
+* Fixes up node after joinNodes replaced one of its children, given the
+* children's heights (which differ by at most 2). Rotates if needed and
+* returns the root of the subtree along with its new height.
+*/
+template<class Key, class Value, class Augment, class Compare>
+AVLNode<Key, Value, Augment>* AVLTree<Key, Value, Augment, Compare>::rebalanceJoined(AVLNode<Key, Value, Augment>* node,
+    int leftHeight, int rightHeight, int& height)
+{
+    if(rightHeight > leftHeight + 1){
+        AVLNode<Key, Value, Augment>* child = node->getRight();
+        int innerHeight = rightHeight - (child->getBalance() > 0 ? 2 : 1);
+        int outerHeight = rightHeight - (child->getBalance() < 0 ? 2 : 1);
+        if(innerHeight > outerHeight){
+            //zig-zag, the grandchild ends up on top
+            AVLNode<Key, Value, Augment>* grandchild = child->getLeft();
+            int gLeft = innerHeight - (grandchild->getBalance() > 0 ? 2 : 1);
+            int gRight = innerHeight - (grandchild->getBalance() < 0 ? 2 : 1);
+            rotateRight(child);
+            rotateLeft(node);
+            node->setBalance(gLeft - leftHeight);
+            child->setBalance(outerHeight - gRight);
+            int nodeHeight = std::max(leftHeight, gLeft) + 1;
+            int childHeight = std::max(gRight, outerHeight) + 1;
+            grandchild->setBalance(childHeight - nodeHeight);
+            height = std::max(nodeHeight, childHeight) + 1;
+            return grandchild;
+        }
+        rotateLeft(node);
+        node->setBalance(innerHeight - leftHeight);
+        int nodeHeight = std::max(leftHeight, innerHeight) + 1;
+        child->setBalance(outerHeight - nodeHeight);
+        height = std::max(nodeHeight, outerHeight) + 1;
+        return child;
+    }
+    if(leftHeight > rightHeight + 1){
+        AVLNode<Key, Value, Augment>* child = node->getLeft();
+        int innerHeight = leftHeight - (child->getBalance() < 0 ? 2 : 1);
+        int outerHeight = leftHeight - (child->getBalance() > 0 ? 2 : 1);
+        if(innerHeight > outerHeight){
+            AVLNode<Key, Value, Augment>* grandchild = child->getRight();
+            int gLeft = innerHeight - (grandchild->getBalance() > 0 ? 2 : 1);
+            int gRight = innerHeight - (grandchild->getBalance() < 0 ? 2 : 1);
+            rotateLeft(child);
+            rotateRight(node);
+            child->setBalance(gLeft - outerHeight);
+            node->setBalance(rightHeight - gRight);
+            int childHeight = std::max(outerHeight, gLeft) + 1;
+            int nodeHeight = std::max(gRight, rightHeight) + 1;
+            grandchild->setBalance(nodeHeight - childHeight);
+            height = std::max(nodeHeight, childHeight) + 1;
+            return grandchild;
+        }
+        rotateRight(node);
+        node->setBalance(rightHeight - innerHeight);
+        int nodeHeight = std::max(innerHeight, rightHeight) + 1;
+        child->setBalance(nodeHeight - outerHeight);
+        height = std::max(nodeHeight, outerHeight) + 1;
+        return child;
+    }
+    node->setBalance(rightHeight - leftHeight);
+    updateAugment(node);
+    height = std::max(leftHeight, rightHeight) + 1;
+    return node;
+}
+
+/**
+* Splits the detached subtree under node into the keys < key (left), the
+* node holding key itself (found, null if there is none, unlinked) and
+* the keys > key (right). Each level does one joinNodes call, and the
+* joins telescope, so the whole split is O(log n).
+*/
+template<class Key, class Value, class Augment, class Compare>
+void AVLTree<Key, Value, Augment, Compare>::splitNodes(AVLNode<Key, Value, Augment>* node, int height, const Key& key,
+    AVLNode<Key, Value, Augment>*& left, int& leftHeight, AVLNode<Key, Value, Augment>*& found,
+    AVLNode<Key, Value, Augment>*& right, int& rightHeight)
+{
+    if(node == nullptr){
+        left = right = found = nullptr;
+        leftHeight = rightHeight = 0;
+        return;
+    }
+    int childLeft = height - (node->getBalance() > 0 ? 2 : 1);
+    int childRight = height - (node->getBalance() < 0 ? 2 : 1);
+    AVLNode<Key, Value, Augment>* lChild = node->getLeft();
+    AVLNode<Key, Value, Augment>* rChild = node->getRight();
+    if(lChild != nullptr){
+        lChild->setParent(nullptr);
+    }
+    if(rChild != nullptr){
+        rChild->setParent(nullptr);
+    }
+
+    if(this->comp_(node->getKey(), key)){
+        AVLNode<Key, Value, Augment>* middle;
+        int middleHeight;
+        splitNodes(rChild, childRight, key, middle, middleHeight, found, right, rightHeight);
+        left = joinNodes(lChild, childLeft, node, middle, middleHeight, leftHeight);
+    }else if(this->comp_(key, node->getKey())){
+        AVLNode<Key, Value, Augment>* middle;
+        int middleHeight;
+        splitNodes(lChild, childLeft, key, left, leftHeight, found, middle, middleHeight);
+        right = joinNodes(middle, middleHeight, node, rChild, childRight, rightHeight);
+    }else{
+        left = lChild;
+        leftHeight = childLeft;
+        right = rChild;
+        rightHeight = childRight;
+        found = node;
+        node->setLeft(nullptr);
+        node->setRight(nullptr);
+    }
+}
+
+/**
+* Unlinks the smallest node of a detached subtree (returned through min)
+* and returns what is left of the subtree, rebalanced. O(log n).
+*/
+template<class Key, class Value, class Augment, class Compare>
+AVLNode<Key, Value, Augment>* AVLTree<Key, Value, Augment, Compare>::removeMin(AVLNode<Key, Value, Augment>* node, int height,
+    AVLNode<Key, Value, Augment>*& min, int& newHeight)
+{
+    int childLeft = height - (node->getBalance() > 0 ? 2 : 1);
+    int childRight = height - (node->getBalance() < 0 ? 2 : 1);
+    AVLNode<Key, Value, Augment>* lChild = node->getLeft();
+    AVLNode<Key, Value, Augment>* rChild = node->getRight();
+    if(rChild != nullptr){
+        rChild->setParent(nullptr);
+    }
+    if(lChild == nullptr){
+        min = node;
+        node->setRight(nullptr);
+        newHeight = childRight;
+        return rChild;
+    }
+    lChild->setParent(nullptr);
+    int restHeight;
+    AVLNode<Key, Value, Augment>* rest = removeMin(lChild, childLeft, min, restHeight);
+    return joinNodes(rest, restHeight, node, rChild, childRight, newHeight);
+}
+
+/**
+* Concatenates two detached subtrees (every key in left < every key in
+* right) without a pivot, using the smallest node on the right instead.
+*/
+template<class Key, class Value, class Augment, class Compare>
+AVLNode<Key, Value, Augment>* AVLTree<Key, Value, Augment, Compare>::joinTwo(AVLNode<Key, Value, Augment>* left, int leftHeight,
+    AVLNode<Key, Value, Augment>* right, int rightHeight, int& height)
+{
+    if(left == nullptr){
+        height = rightHeight;
+        return right;
+    }
+    if(right == nullptr){
+        height = leftHeight;
+        return left;
+    }
+    AVLNode<Key, Value, Augment>* pivot;
+    int restHeight;
+    AVLNode<Key, Value, Augment>* rest = removeMin(right, rightHeight, pivot, restHeight);
+    return joinNodes(left, leftHeight, pivot, rest, restHeight, height);
+}
+
+/**
+* Copies the tree into a FrozenTree snapshot in O(n). Later changes to
+* the tree do not show up in the snapshot.
+*/
+template<class Key, class Value, class Augment, class Compare>
+FrozenTree<Key, Value, Compare> AVLTree<Key, Value, Augment, Compare>::freeze() const
+{
+    std::size_t count = 0;
+    for(iterator it = this->begin(); it != this->end(); ++it){
+        ++count;
+    }
+    return FrozenTree<Key, Value, Compare>(this->begin(), count, this->comp_);
+}
+
+/**
+* Adds everything in other to this tree; for keys in both trees this
+* tree's item is kept and other's is destroyed.
+*/
+template<class Key, class Value, class Augment, class Compare>
+void AVLTree<Key, Value, Augment, Compare>::set_union(AVLTree<Key, Value, Augment, Compare>& other, ThreadPool& threads)
+{
+    setOperation(SET_UNION, other, threads);
+}
+
+/**
+* Keeps only the items whose keys are also in other.
+*/
+template<class Key, class Value, class Augment, class Compare>
+void AVLTree<Key, Value, Augment, Compare>::set_intersection(AVLTree<Key, Value, Augment, Compare>& other, ThreadPool& threads)
+{
+    setOperation(SET_INTERSECTION, other, threads);
+}
+
+/**
+* Removes every item whose key is in other.
+*/
+template<class Key, class Value, class Augment, class Compare>
+void AVLTree<Key, Value, Augment, Compare>::set_difference(AVLTree<Key, Value, Augment, Compare>& other, ThreadPool& threads)
+{
+    setOperation(SET_DIFFERENCE, other, threads);
+}
+
+/**
+* Detaches both trees, runs the recursive operation on them and frees
+* whatever it dropped once all the tasks are done.
+*/
+template<class Key, class Value, class Augment, class Compare>
+void AVLTree<Key, Value, Augment, Compare>::setOperation(SetOperation op, AVLTree<Key, Value, Augment, Compare>& other, ThreadPool& threads)
+{
+    if(&other == this){
+        if(op == SET_DIFFERENCE){
+            this->clear();
+        }
+        return;
+    }
+    this->sharePool(other);
+    AVLNode<Key, Value, Augment>* a = static_cast<AVLNode<Key, Value, Augment>*>(this->root_);
+    AVLNode<Key, Value, Augment>* b = static_cast<AVLNode<Key, Value, Augment>*>(other.root_);
+    this->root_ = nullptr;
+    other.root_ = nullptr;
+    this->rightmost_ = nullptr;
+    other.rightmost_ = nullptr;
+    //other is empty from here on, so it lets go of the shared pool
+    other.clear();
+
+    DroppedNodes dropped;
+    int height;
+    this->root_ = setOperationNodes(op, a, subtreeHeight(a), b, subtreeHeight(b), height, dropped, threads);
+    while(dropped.head != nullptr){
+        AVLNode<Key, Value, Augment>* next = dropped.head->getParent();
+        this->clearHelper(dropped.head);
+        dropped.head = next;
+    }
+}
+
+/**
+* The divide and conquer step shared by the set operations: split b at
+* the key of a's root, solve both sides (in parallel if they are big
+* enough) and join the results back around a's root, or without it if
+* the key does not belong in the result.
+*/
+template<class Key, class Value, class Augment, class Compare>
+AVLNode<Key, Value, Augment>* AVLTree<Key, Value, Augment, Compare>::setOperationNodes(SetOperation op,
+    AVLNode<Key, Value, Augment>* a, int aHeight, AVLNode<Key, Value, Augment>* b, int bHeight,
+    int& height, DroppedNodes& dropped, ThreadPool& threads)
+{
+    if(a == nullptr || b == nullptr){
+        AVLNode<Key, Value, Augment>* kept = nullptr;
+        height = 0;
+        if(op == SET_UNION || (op == SET_DIFFERENCE && a != nullptr)){
+            kept = a != nullptr ? a : b;
+            height = a != nullptr ? aHeight : bHeight;
+        }
+        if(kept != a){
+            dropped.add(a);
+        }
+        if(kept != b){
+            dropped.add(b);
+        }
+        return kept;
+    }
+
+    int aLeftHeight = aHeight - (a->getBalance() > 0 ? 2 : 1);
+    int aRightHeight = aHeight - (a->getBalance() < 0 ? 2 : 1);
+    AVLNode<Key, Value, Augment>* aLeft = a->getLeft();
+    AVLNode<Key, Value, Augment>* aRight = a->getRight();
+    if(aLeft != nullptr){
+        aLeft->setParent(nullptr);
+    }
+    if(aRight != nullptr){
+        aRight->setParent(nullptr);
+    }
+    a->setLeft(nullptr);
+    a->setRight(nullptr);
+
+    AVLNode<Key, Value, Augment>* bLeft;
+    AVLNode<Key, Value, Augment>* match;
+    AVLNode<Key, Value, Augment>* bRight;
+    int bLeftHeight, bRightHeight;
+    splitNodes(b, bHeight, a->getKey(), bLeft, bLeftHeight, match, bRight, bRightHeight);
+
+    AVLNode<Key, Value, Augment>* left;
+    AVLNode<Key, Value, Augment>* right;
+    int leftHeight, rightHeight;
+    DroppedNodes rightDropped;
+    auto solveLeft = [&]() {
+        left = setOperationNodes(op, aLeft, aLeftHeight, bLeft, bLeftHeight, leftHeight, dropped, threads);
+    };
+    auto solveRight = [&]() {
+        right = setOperationNodes(op, aRight, aRightHeight, bRight, bRightHeight, rightHeight, rightDropped, threads);
+    };
+    if(aHeight >= PARALLEL_MIN_HEIGHT){
+        threads.invoke(solveLeft, solveRight);
+    }else{
+        solveLeft();
+        solveRight();
+    }
+    dropped.append(rightDropped);
+
+    bool keepRoot = (op == SET_UNION) || ((op == SET_INTERSECTION) == (match != nullptr));
+    if(match != nullptr){
+        dropped.add(match);
+    }
+    if(keepRoot){
+        return joinNodes(left, leftHeight, a, right, rightHeight, height);
+    }
+    dropped.add(a);
+    return joinTwo(left, leftHeight, right, rightHeight, height);
+}
+
+/**
+* Appends a detached subtree (ignores null).
+*/
+template<class Key, class Value, class Augment, class Compare>
+void AVLTree<Key, Value, Augment, Compare>::DroppedNodes::add(AVLNode<Key, Value, Augment>* subtree)
+{
+    if(subtree == nullptr){
+        return;
+    }
+    subtree->setParent(nullptr);
+    if(tail != nullptr){
+        tail->setParent(subtree);
+    }else{
+        head = subtree;
+    }
+    tail = subtree;
+}
+
+/**
+* Moves all of other's subtrees to the end of this list.
+*/
+template<class Key, class Value, class Augment, class Compare>
+void AVLTree<Key, Value, Augment, Compare>::DroppedNodes::append(const DroppedNodes& other)
+{
+    if(other.head == nullptr){
+        return;
+    }
+    if(tail != nullptr){
+        tail->setParent(other.head);
+    }else{
+        head = other.head;
+    }
+    tail = other.tail;
 }
 
 
@@ -0,0 +1,169 @@
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include "avlbst.h"
+#include "concurrentavl.h"
+#include "shardedmap.h"
+
+using namespace std;
+
+// Mixed workload: READ_PERCENT finds, the rest split evenly between
+// inserts and removes, over KEY_RANGE keys with half of them present.
+static const int KEY_RANGE = 1 << 20;
+static const int READ_PERCENT = 90;
+
+// Successful finds, only kept so the lookups cannot be optimized away.
+static atomic<long> hits(0);
+
+/**
+* The baseline: one AVLTree behind one mutex.
+*/
+struct LockedAVLTree
+{
+    bool find(int key, int& value)
+    {
+        lock_guard<mutex> lock(mutex_);
+        AVLTree<int, int>::iterator it = tree_.find(key);
+        if(it == tree_.end()) {
+            return false;
+        }
+        value = it->second;
+        return true;
+    }
+    void insert(int key, int value)
+    {
+        lock_guard<mutex> lock(mutex_);
+        tree_.insert(make_pair(key, value));
+    }
+    void remove(int key)
+    {
+        lock_guard<mutex> lock(mutex_);
+        tree_.remove(key);
+    }
+
+    mutex mutex_;
+    AVLTree<int, int> tree_;
+};
+
+struct ConcurrentTree
+{
+    bool find(int key, int& value)
+    {
+        return tree_.find(key, value);
+    }
+    void insert(int key, int value)
+    {
+        tree_.insert(make_pair(key, value));
+    }
+    void remove(int key)
+    {
+        tree_.remove(key);
+    }
+
+    ConcurrentAVLTree<int, int> tree_;
+};
+
+struct ShardedTree
+{
+    ShardedTree() : map_(64) {}
+    bool find(int key, int& value)
+    {
+        return map_.find(key, value);
+    }
+    void insert(int key, int value)
+    {
+        map_.insert(make_pair(key, value));
+    }
+    void remove(int key)
+    {
+        map_.remove(key);
+    }
+
+    ShardedAVLMap<int, int> map_;
+};
+
+/**
+* Runs the mix on the given number of threads for the given time and
+* returns the total operations per second.
+*/
+template<typename Tree>
+double run(int threads, double seconds)
+{
+    Tree tree;
+    mt19937 fill(12345);
+    for(int i = 0; i < KEY_RANGE / 2; ++i) {
+        int key = fill() % KEY_RANGE;
+        tree.insert(key, key);
+    }
+
+    atomic<bool> start(false);
+    atomic<bool> stop(false);
+    atomic<long> total(0);
+    vector<thread> workers;
+    for(int t = 0; t < threads; ++t) {
+        workers.push_back(thread([&, t]() {
+            mt19937 rng(t + 1);
+            long ops = 0;
+            int value = 0;
+            long found = 0;
+            while(!start.load()) {
+                this_thread::yield();
+            }
+            while(!stop.load(memory_order_relaxed)) {
+                for(int i = 0; i < 256; ++i) {
+                    int key = rng() % KEY_RANGE;
+                    int op = rng() % 100;
+                    if(op < READ_PERCENT) {
+                        found += tree.find(key, value);
+                    } else if(op % 2 == 0) {
+                        tree.insert(key, key);
+                    } else {
+                        tree.remove(key);
+                    }
+                }
+                ops += 256;
+            }
+            total.fetch_add(ops);
+            hits.fetch_add(found);
+        }));
+    }
+
+    chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+    start.store(true);
+    this_thread::sleep_for(chrono::duration<double>(seconds));
+    stop.store(true);
+    for(size_t i = 0; i < workers.size(); ++i) {
+        workers[i].join();
+    }
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+    return total.load() / elapsed;
+}
+
+/**
+* Usage: bst-bench [seconds per run] [max threads]
+*/
+int main(int argc, char *argv[])
+{
+    double seconds = argc > 1 ? atof(argv[1]) : 1.0;
+    int maxThreads = argc > 2 ? atoi(argv[2]) : 2 * max(1u, thread::hardware_concurrency());
+
+    cout << READ_PERCENT << "/" << 100 - READ_PERCENT << " find/update mix, "
+         << KEY_RANGE << " keys, " << thread::hardware_concurrency() << " hardware threads" << endl;
+    cout << setw(8) << "threads" << setw(18) << "mutex+AVLTree" << setw(18) << "ConcurrentAVL" << setw(18) << "ShardedAVLMap"
+         << "   (Mops/s)" << endl;
+    for(int threads = 1; threads <= maxThreads; threads *= 2) {
+        double locked = run<LockedAVLTree>(threads, seconds);
+        double concurrent = run<ConcurrentTree>(threads, seconds);
+        double sharded = run<ShardedTree>(threads, seconds);
+        cout << setw(8) << threads << fixed << setprecision(2)
+             << setw(18) << locked / 1e6 << setw(18) << concurrent / 1e6
+             << setw(18) << sharded / 1e6 << endl;
+    }
+    return 0;
+}
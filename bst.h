@@ -5,20 +5,63 @@
 #include <exception>
 #include <cstdlib>
 #include <utility>
+#include <tuple>
+#include <new>
+#include <type_traits>
+#include <stdexcept>
+#include <algorithm>
+#include <memory>
+#include <functional>
+#include "nodepool.h"
+
+class ThreadPool;
+
+/**
+ * A recipe for building the key/value pair of a new node. Trees create
+ * their nodes through a virtual hook, so the arguments of an insert
+ * are passed along behind this interface and the pair is constructed
+ * straight into the node's item_ member.
+ */
+template <typename Key, typename Value>
+class ItemBuilder
+{
+public:
+    virtual std::pair<const Key, Value> build() = 0;
+
+protected:
+    ~ItemBuilder() {}
+};
+
+/**
+ * An ItemBuilder that forwards to a callable returning the pair.
+ */
+template <typename Key, typename Value, typename Fn>
+class ItemBuilderFn : public ItemBuilder<Key, Value>
+{
+public:
+    explicit ItemBuilderFn(Fn fn) : fn_(fn) {}
+    virtual std::pair<const Key, Value> build() { return fn_(); }
+
+private:
+    Fn fn_;
+};
 
 /**
  * A templated class for a Node in a search tree.
- * The getters for parent/left/right are virtual so
- * that they can be overridden for future kinds of
- * search trees, such as Red Black trees, Splay trees,
- * and AVL trees.
+ * Nothing in a node is virtual: the getters for parent/left/right
+ * compile down to a plain load, and there is no vtable pointer in
+ * every node. Node types for balanced trees (AVL, Red Black, Splay,
+ * ...) derive from this class and hide the getters with versions that
+ * static_cast to their own type, and the tree that owns them is the
+ * only code that creates or destroys them (see createNode/destroyNode).
  */
 template <typename Key, typename Value>
 class Node
 {
 public:
     Node(const Key& key, const Value& value, Node<Key, Value>* parent);
-    virtual ~Node();
+    Node(ItemBuilder<Key, Value>& builder, Node<Key, Value>* parent);
+    ~Node();
 
     const std::pair<const Key, Value>& getItem() const;
     std::pair<const Key, Value>& getItem();
@@ -26,14 +69,15 @@ public:
     const Value& getValue() const;
     Value& getValue();
 
-    virtual Node<Key, Value>* getParent() const;
-    virtual Node<Key, Value>* getLeft() const;
-    virtual Node<Key, Value>* getRight() const;
+    Node<Key, Value>* getParent() const;
+    Node<Key, Value>* getLeft() const;
+    Node<Key, Value>* getRight() const;
 
     void setParent(Node<Key, Value>* parent);
     void setLeft(Node<Key, Value>* left);
     void setRight(Node<Key, Value>* right);
     void setValue(const Value &value);
+    void setValue(Value&& value);
 
 protected:
     std::pair<const Key, Value> item_;
@@ -61,6 +105,19 @@ Node<Key, Value>::Node(const Key& key, const Value& value, Node<Key, Value>* par
 
 }
 
+/**
+* Constructor that builds the item in place from an ItemBuilder.
+*/
+template<typename Key, typename Value>
+Node<Key, Value>::Node(ItemBuilder<Key, Value>& builder, Node<Key, Value>* parent) :
+    item_(builder.build()),
+    parent_(parent),
+    left_(NULL),
+    right_(NULL)
+{
+
+}
+
 /**
 * Destructor, which does not need to do anything since the pointers inside of a node
 * are only used as references to existing nodes. The nodes pointed to by parent/left/right
@@ -118,7 +175,7 @@ Value& Node<Key, Value>::getValue()
 }
 
 /**
-* An implementation of the virtual function for retreiving the parent.
+* A getter for the parent.
 */
 template<typename Key, typename Value>
 Node<Key, Value>* Node<Key, Value>::getParent() const
@@ -127,7 +184,7 @@ Node<Key, Value>* Node<Key, Value>::getParent() const
 }
 
 /**
-* An implementation of the virtual function for retreiving the left child.
+* A getter for the left child.
 */
 template<typename Key, typename Value>
 Node<Key, Value>* Node<Key, Value>::getLeft() const
@@ -136,7 +193,7 @@ Node<Key, Value>* Node<Key, Value>::getLeft() const
 }
 
 /**
-* An implementation of the virtual function for retreiving the right child.
+* A getter for the right child.
 */
 template<typename Key, typename Value>
 Node<Key, Value>* Node<Key, Value>::getRight() const
@@ -180,6 +237,15 @@ void Node<Key, Value>::setValue(const Value& value)
     item_.second = value;
 }
 
+/**
+* A setter that moves the new value into the node.
+*/
+template<typename Key, typename Value>
+void Node<Key, Value>::setValue(Value&& value)
+{
+    item_.second = std::move(value);
+}
+
 /*
   ---------------------------------------
   End implementations for the Node class.
@@ -188,22 +254,42 @@ void Node<Key, Value>::setValue(const Value& value)
 
 /**
 * A templated unbalanced binary search tree.
+*
+* Keys are ordered by Compare, a strict weak ordering like std::less.
+* Every descent calls it once per level and checks for equality only at
+* the end. If Compare has an is_transparent member type, find(),
+* lower_bound() and remove() also take any key type it can compare with
+* Key (such as a const char* or string_view for std::string keys),
+* without building a temporary Key.
 */
-template <typename Key, typename Value>
+template <typename Key, typename Value, typename Compare = std::less<Key> >
 class BinarySearchTree
 {
 public:
     BinarySearchTree(); //TODO
+    explicit BinarySearchTree(const Compare& comp);
     virtual ~BinarySearchTree(); //TODO
-    virtual void insert(const std::pair<const Key, Value>& keyValuePair); //TODO
+    // insert is not virtual: derived trees hook in through createNode and
+    // rebalanceAfterInsert, which also keeps move-only values usable.
+    void insert(const std::pair<const Key, Value>& keyValuePair); //TODO
+    void insert(std::pair<const Key, Value>&& keyValuePair);
     virtual void remove(const Key& key); //TODO
+    template<typename K, typename C = Compare, typename = typename C::is_transparent>
+    void remove(const K& key);
     void clear(); //TODO
     bool isBalanced() const; //TODO
+    void rebalance();
     void print() const;
     bool empty() const;
 
-    template<typename PPKey, typename PPValue>
-    friend void prettyPrintBST(BinarySearchTree<PPKey, PPValue> & tree);
+    template<typename PPKey, typename PPValue, typename PPCompare>
+    friend void prettyPrintBST(BinarySearchTree<PPKey, PPValue, PPCompare> & tree);
+    // Whole-tree scans split across a ThreadPool (include parallel_bst.h to use them).
+    template<typename PKey, typename PValue, typename PCompare, typename Fn>
+    friend void parallel_for_each(BinarySearchTree<PKey, PValue, PCompare>& tree, Fn fn, ThreadPool& threads);
+    template<typename PKey, typename PValue, typename PCompare, typename T, typename Map, typename Combine>
+    friend T parallel_reduce(const BinarySearchTree<PKey, PValue, PCompare>& tree, T identity, Map map,
+                             Combine combine, ThreadPool& threads);
 public:
     /**
     * An internal iterator class for traversing the contents of the BST.
@@ -222,38 +308,152 @@ public:
         iterator& operator++();
 
     protected:
-        friend class BinarySearchTree<Key, Value>;
+        friend class BinarySearchTree<Key, Value, Compare>;
         iterator(Node<Key,Value>* ptr);
         Node<Key, Value> *current_;
     };
 
+    /**
+    * A finger into the tree for lookups that land near the previous one.
+    * Each operation starts from the item the cursor is at and climbs the
+    * parent pointers only as far as needed before descending, so it costs
+    * O(log d) comparisons for a key d items away instead of O(log n), and
+    * then moves the cursor to the item it found (or inserted). Like an
+    * iterator, a cursor is invalidated when its item is removed other than
+    * through the cursor, or leaves the tree (clear, split, join); reset()
+    * makes it usable again.
+    */
+    class cursor
+    {
+    public:
+        explicit cursor(BinarySearchTree<Key, Value, Compare>& tree);
+
+        iterator position() const;
+        void reset();
+
+        iterator find(const Key& key);
+        iterator lower_bound(const Key& key);
+        void insert(const std::pair<const Key, Value>& keyValuePair);
+        template<typename V>
+        std::pair<iterator, bool> insert_or_assign(const Key& key, V&& value);
+        void remove(const Key& key);
+
+    private:
+        BinarySearchTree<Key, Value, Compare>* tree_;
+        Node<Key, Value>* finger_;
+    };
+
 public:
     iterator begin() const;
     iterator end() const;
     iterator find(const Key& key) const;
+    template<typename K, typename C = Compare, typename = typename C::is_transparent>
+    iterator find(const K& key) const;
+    iterator lower_bound(const Key& key) const;
+    template<typename K, typename C = Compare, typename = typename C::is_transparent>
+    iterator lower_bound(const K& key) const;
+    Compare key_comp() const;
     Value& operator[](const Key& key);
+    Value& operator[](Key&& key);
     Value const & operator[](const Key& key) const;
 
+    template<typename V>
+    std::pair<iterator, bool> insert_or_assign(const Key& key, V&& value);
+    template<typename V>
+    std::pair<iterator, bool> insert_or_assign(Key&& key, V&& value);
+    // Hinted insertion, like std::map: O(1) comparisons (and amortized O(1)
+    // time) when the key belongs right before or right after hint, e.g.
+    // insert(end(), kv) or insert(previous, kv) for keys arriving in
+    // increasing order. Otherwise it searches from hint like a cursor.
+    iterator insert(iterator hint, const std::pair<const Key, Value>& keyValuePair);
+    iterator insert(iterator hint, std::pair<const Key, Value>&& keyValuePair);
+    template<typename... Args>
+    std::pair<iterator, bool> try_emplace(const Key& key, Args&&... args);
+    template<typename... Args>
+    std::pair<iterator, bool> try_emplace(Key&& key, Args&&... args);
+    template<typename... Args>
+    std::pair<iterator, bool> emplace(Args&&... args);
+
+    template<typename InputIt>
+    void assign_sorted(InputIt first, InputIt last);
+
 protected:
     // Mandatory helper functions
-    Node<Key, Value>* internalFind(const Key& k) const; // TODO
+    template<typename K>
+    Node<Key, Value>* internalFind(const K& k, Node<Key, Value>* finger = nullptr) const; // TODO
     Node<Key, Value> *getSmallestNode() const;  // TODO
     static Node<Key, Value>* predecessor(Node<Key, Value>* current); // TODO
     // Note:  static means these functions don't have a "this" pointer
     //        and instead just use the input argument.
 
     // Provided helper functions
-    virtual void printRoot (Node<Key, Value> *r) const;
+    // (printRoot is not virtual so trees of values without operator<<
+    // still compile as long as print() is never called)
+    void printRoot (Node<Key, Value> *r) const;
     virtual void nodeSwap( Node<Key,Value>* n1, Node<Key,Value>* n2) ;
 
     // Add helper functions here
+    template<typename K>
+    Node<Key, Value>* lowerBoundNode(const K& key, Node<Key, Value>* finger = nullptr) const;
+    template<typename K>
+    Node<Key, Value>* fingerStart(Node<Key, Value>* finger, const K& key, Node<Key, Value>*& candidate,
+        Node<Key, Value>*& parent) const;
+    virtual void removeNode(Node<Key, Value>* node);
     static Node<Key, Value>* successor(Node<Key, Value>* current);
+    static iterator makeIterator(Node<Key, Value>* node);
+    static Node<Key, Value>* iteratorNode(const iterator& it);
     int isBalancedHelper(Node<Key,Value>* current) const;
     void clearHelper(Node<Key, Value> * curr);
 
+    // Node allocation goes through the pool; derived trees with bigger
+    // nodes pass their node size (and whether their nodes can be dropped
+    // without running destructors) to the protected constructor and
+    // override createNode/destroyNode to build and tear down their own
+    // node type. Since destroyNode is virtual, such trees must call
+    // clear() from their own destructor.
+    BinarySearchTree(std::size_t nodeSize, bool trivialNodes, const Compare& comp);
+    virtual Node<Key, Value>* createNode(ItemBuilder<Key, Value>& builder, Node<Key, Value>* parent);
+    virtual void destroyNode(Node<Key, Value>* node);
+    NodePool& pool();
+    void sharePool(BinarySearchTree<Key, Value, Compare>& other);
+
+    // Single-descent insertion shared by every insert flavour.
+    Node<Key, Value>* findSlot(const Key& key, Node<Key, Value>*& parent,
+        Node<Key, Value>* finger = nullptr) const;
+    Node<Key, Value>* linkNode(Node<Key, Value>* node, Node<Key, Value>* parent);
+    virtual void rebalanceAfterInsert(Node<Key, Value>* node);
+    virtual void valueChanged(Node<Key, Value>* node);
+    template<typename K, typename V>
+    std::pair<iterator, bool> insertOrAssignHelper(K&& key, V&& value, Node<Key, Value>* finger = nullptr);
+    template<typename K, typename V>
+    std::pair<iterator, bool> insertOrAssignAt(Node<Key, Value>* existing, Node<Key, Value>* parent,
+        K&& key, V&& value);
+    Node<Key, Value>* hintSlot(Node<Key, Value>* hint, const Key& key, Node<Key, Value>*& parent);
+    Node<Key, Value>* rightmostNode();
+    template<typename K, typename... Args>
+    std::pair<iterator, bool> tryEmplaceHelper(K&& key, Args&&... args);
+
+    // Linear-time construction of a balanced tree from a sorted vine
+    // (a chain of nodes linked through their right pointers), and the
+    // way back.
+    Node<Key, Value>* buildFromVine(Node<Key, Value>*& vine, std::size_t n, int& height);
+    static Node<Key, Value>* treeToVine(Node<Key, Value>* node, std::size_t& count);
+    void rebuildSubtree(Node<Key, Value>* node);
+    static void compressVine(Node<Key, Value>*& head, std::size_t count);
+    static int leftSpineLength(Node<Key, Value>* node);
+    virtual void finishBuiltNode(Node<Key, Value>* node, int leftHeight, int rightHeight);
+    virtual void finishBuiltTree(Node<Key, Value>* root, int height);
+
 protected:
     Node<Key, Value>* root_;
     // You should not need other data members
+    std::shared_ptr<NodePool> pool_;
+    bool trivialNodes_;
+    Compare comp_;
+    // The node with the largest key, kept up to date by insertion and
+    // removal for O(1) appends; NULL when unknown (it is then looked up
+    // again on demand), which is what bulk restructuring leaves behind.
+    Node<Key, Value>* rightmost_;
 };
 
 /*
@@ -265,8 +465,8 @@ Begin implementations for the BinarySearchTree::iterator class.
 /**
 * Explicit constructor that initializes an iterator with a given node pointer.
 */
-template<class Key, class Value>
-BinarySearchTree<Key, Value>::iterator::iterator(Node<Key,Value> *ptr)
+template<class Key, class Value, class Compare>
+BinarySearchTree<Key, Value, Compare>::iterator::iterator(Node<Key,Value> *ptr)
 {
     // TODO
     current_ = ptr;
@@ -275,8 +475,8 @@ BinarySearchTree<Key, Value>::iterator::iterator(Node<Key,Value> *ptr)
 /**
 * A default constructor that initializes the iterator to NULL.
 */
-template<class Key, class Value>
-BinarySearchTree<Key, Value>::iterator::iterator() 
+template<class Key, class Value, class Compare>
+BinarySearchTree<Key, Value, Compare>::iterator::iterator() 
 {
     // TODO
     current_ = NULL;
@@ -286,9 +486,9 @@ BinarySearchTree<Key, Value>::iterator::iterator()
 /**
 * Provides access to the item.
 */
-template<class Key, class Value>
+template<class Key, class Value, class Compare>
 std::pair<const Key,Value> &
-BinarySearchTree<Key, Value>::iterator::operator*() const
+BinarySearchTree<Key, Value, Compare>::iterator::operator*() const
 {
     return current_->getItem();
 }
@@ -296,9 +496,9 @@ BinarySearchTree<Key, Value>::iterator::operator*() const
 /**
 * Provides access to the address of the item.
 */
-template<class Key, class Value>
+template<class Key, class Value, class Compare>
 std::pair<const Key,Value> *
-BinarySearchTree<Key, Value>::iterator::operator->() const
+BinarySearchTree<Key, Value, Compare>::iterator::operator->() const
 {
     return &(current_->getItem());
 }
@@ -307,10 +507,10 @@ BinarySearchTree<Key, Value>::iterator::operator->() const
 * Checks if 'this' iterator's internals have the same value
 * as 'rhs'
 */
-template<class Key, class Value>
+template<class Key, class Value, class Compare>
 bool
-BinarySearchTree<Key, Value>::iterator::operator==(
-    const BinarySearchTree<Key, Value>::iterator& rhs) const
+BinarySearchTree<Key, Value, Compare>::iterator::operator==(
+    const BinarySearchTree<Key, Value, Compare>::iterator& rhs) const
 {
     // TODO
     //maybe check value/key instead of pointer idk
@@ -321,10 +521,10 @@ BinarySearchTree<Key, Value>::iterator::operator==(
 * Checks if 'this' iterator's internals have a different value
 * as 'rhs'
 */
-template<class Key, class Value>
+template<class Key, class Value, class Compare>
 bool
-BinarySearchTree<Key, Value>::iterator::operator!=(
-    const BinarySearchTree<Key, Value>::iterator& rhs) const
+BinarySearchTree<Key, Value, Compare>::iterator::operator!=(
+    const BinarySearchTree<Key, Value, Compare>::iterator& rhs) const
 {
     // TODO
     return this->current_ != rhs.current_;
@@ -335,9 +535,9 @@ BinarySearchTree<Key, Value>::iterator::operator!=(
 /**
 * Advances the iterator's location using an in-order sequencing
 */
-template<class Key, class Value>
-typename BinarySearchTree<Key, Value>::iterator&
-BinarySearchTree<Key, Value>::iterator::operator++()
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator&
+BinarySearchTree<Key, Value, Compare>::iterator::operator++()
 {
     // TODO
     //wip 
@@ -353,24 +553,194 @@ End implementations for the BinarySearchTree::iterator class.
 -------------------------------------------------------------
 */
 
+/*
+-------------------------------------------------------------
+Begin implementations for the BinarySearchTree::cursor class.
+-------------------------------------------------------------
+*/
+
+/**
+* A cursor on tree that is not at any item yet, so its first operation
+* starts from the root.
+*/
+template<class Key, class Value, class Compare>
+BinarySearchTree<Key, Value, Compare>::cursor::cursor(BinarySearchTree<Key, Value, Compare>& tree) :
+    tree_(&tree),
+    finger_(nullptr)
+{
+
+}
+
+/**
+* The item the cursor is at, or end() before the first operation.
+*/
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::cursor::position() const
+{
+    return iterator(finger_);
+}
+
+/**
+* Forgets the current item, e.g. after it was removed from the tree.
+*/
+template<class Key, class Value, class Compare>
+void BinarySearchTree<Key, Value, Compare>::cursor::reset()
+{
+    finger_ = nullptr;
+}
+
+/**
+* Same as BinarySearchTree::find, searching from the cursor. The cursor
+* moves to the item found, or to the next larger one if key is missing.
+*/
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::cursor::find(const Key& key)
+{
+    Node<Key, Value>* node = tree_->lowerBoundNode(key, finger_);
+    if(node == nullptr) {
+        return iterator(nullptr);
+    }
+    finger_ = node;
+    if(tree_->comp_(key, node->getKey())) {
+        return iterator(nullptr);
+    }
+    return iterator(node);
+}
+
+/**
+* Same as BinarySearchTree::lower_bound, searching from the cursor, which
+* moves to the item found.
+*/
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::cursor::lower_bound(const Key& key)
+{
+    Node<Key, Value>* node = tree_->lowerBoundNode(key, finger_);
+    if(node != nullptr) {
+        finger_ = node;
+    }
+    return iterator(node);
+}
+
+/**
+* Same as BinarySearchTree::insert, searching from the cursor, which moves
+* to the inserted (or overwritten) item.
+*/
+template<class Key, class Value, class Compare>
+void BinarySearchTree<Key, Value, Compare>::cursor::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    insert_or_assign(keyValuePair.first, keyValuePair.second);
+}
+
+template<class Key, class Value, class Compare>
+template<typename V>
+std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool>
+BinarySearchTree<Key, Value, Compare>::cursor::insert_or_assign(const Key& key, V&& value)
+{
+    std::pair<iterator, bool> result = tree_->insertOrAssignHelper(key, std::forward<V>(value), finger_);
+    finger_ = iteratorNode(result.first);
+    return result;
+}
+
+/**
+* Same as BinarySearchTree::remove, searching from the cursor. The cursor
+* moves to the item after the removed one (or before it, if it was the
+* last), since nodes other than the removed one stay put.
+*/
+template<class Key, class Value, class Compare>
+void BinarySearchTree<Key, Value, Compare>::cursor::remove(const Key& key)
+{
+    Node<Key, Value>* node = tree_->internalFind(key, finger_);
+    if(node == nullptr) {
+        return;
+    }
+    Node<Key, Value>* next = successor(node);
+    if(next == nullptr) {
+        next = predecessor(node);
+    }
+    tree_->removeNode(node);
+    finger_ = next;
+}
+
+/*
+-----------------------------------------------------------
+End implementations for the BinarySearchTree::cursor class.
+-----------------------------------------------------------
+*/
+
 /*
 -----------------------------------------------------
 Begin implementations for the BinarySearchTree class.
 -----------------------------------------------------
 */
 
+/**
+* Wraps a node in an iterator, for derived trees (the iterator's
+* constructor is only accessible to BinarySearchTree itself).
+*/
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::makeIterator(Node<Key, Value>* node)
+{
+    return iterator(node);
+}
+
+/**
+* The reverse of makeIterator: the node an iterator points at.
+*/
+template<class Key, class Value, class Compare>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare>::iteratorNode(const iterator& it)
+{
+    return it.current_;
+}
+
 /**
 * Default constructor for a BinarySearchTree, which sets the root to NULL.
 */
-template<class Key, class Value>
-BinarySearchTree<Key, Value>::BinarySearchTree() 
+template<class Key, class Value, class Compare>
+BinarySearchTree<Key, Value, Compare>::BinarySearchTree() :
+    pool_(std::make_shared<NodePool>(sizeof(Node<Key, Value>))),
+    trivialNodes_(std::is_trivially_destructible<std::pair<const Key, Value> >::value),
+    comp_(),
+    rightmost_(nullptr)
 {
     // TODO
     root_ = nullptr;
 }
 
-template<typename Key, typename Value>
-BinarySearchTree<Key, Value>::~BinarySearchTree()
+/**
+* An empty tree ordered by the given comparator.
+*/
+template<class Key, class Value, class Compare>
+BinarySearchTree<Key, Value, Compare>::BinarySearchTree(const Compare& comp) :
+    root_(nullptr),
+    pool_(std::make_shared<NodePool>(sizeof(Node<Key, Value>))),
+    trivialNodes_(std::is_trivially_destructible<std::pair<const Key, Value> >::value),
+    comp_(comp),
+    rightmost_(nullptr)
+{
+
+}
+
+/**
+* Constructor for derived trees whose nodes are larger than a plain Node,
+* so the pool hands out slots big enough for them.
+*/
+template<class Key, class Value, class Compare>
+BinarySearchTree<Key, Value, Compare>::BinarySearchTree(std::size_t nodeSize, bool trivialNodes, const Compare& comp) :
+    root_(nullptr),
+    pool_(std::make_shared<NodePool>(nodeSize)),
+    trivialNodes_(trivialNodes),
+    comp_(comp),
+    rightmost_(nullptr)
+{
+
+}
+
+template<typename Key, typename Value, class Compare>
+BinarySearchTree<Key, Value, Compare>::~BinarySearchTree()
 {
     // TODO
     this->clear();
@@ -379,14 +749,14 @@ BinarySearchTree<Key, Value>::~BinarySearchTree()
 /**
  * Returns true if tree is empty
 */
-template<class Key, class Value>
-bool BinarySearchTree<Key, Value>::empty() const
+template<class Key, class Value, class Compare>
+bool BinarySearchTree<Key, Value, Compare>::empty() const
 {
     return root_ == NULL;
 }
 
-template<typename Key, typename Value>
-void BinarySearchTree<Key, Value>::print() const
+template<typename Key, typename Value, class Compare>
+void BinarySearchTree<Key, Value, Compare>::print() const
 {
     printRoot(root_);
     std::cout << "\n";
@@ -395,22 +765,22 @@ void BinarySearchTree<Key, Value>::print() const
 /**
 * Returns an iterator to the "smallest" item in the tree
 */
-template<class Key, class Value>
-typename BinarySearchTree<Key, Value>::iterator
-BinarySearchTree<Key, Value>::begin() const
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::begin() const
 {
-    BinarySearchTree<Key, Value>::iterator begin(getSmallestNode());
+    BinarySearchTree<Key, Value, Compare>::iterator begin(getSmallestNode());
     return begin;
 }
 
 /**
 * Returns an iterator whose value means INVALID
 */
-template<class Key, class Value>
-typename BinarySearchTree<Key, Value>::iterator
-BinarySearchTree<Key, Value>::end() const
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::end() const
 {
-    BinarySearchTree<Key, Value>::iterator end(NULL);
+    BinarySearchTree<Key, Value, Compare>::iterator end(NULL);
     return end;
 }
 
@@ -418,28 +788,75 @@ BinarySearchTree<Key, Value>::end() const
 * Returns an iterator to the item with the given key, k
 * or the end iterator if k does not exist in the tree
 */
-template<class Key, class Value>
-typename BinarySearchTree<Key, Value>::iterator
-BinarySearchTree<Key, Value>::find(const Key & k) const
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::find(const Key & k) const
 {
     Node<Key, Value> *curr = internalFind(k);
-    BinarySearchTree<Key, Value>::iterator it(curr);
+    BinarySearchTree<Key, Value, Compare>::iterator it(curr);
     return it;
 }
 
 /**
- * @precondition The key exists in the map
- * Returns the value associated with the key
+* find() for any key type a transparent Compare accepts.
+*/
+template<class Key, class Value, class Compare>
+template<typename K, typename C, typename>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::find(const K& k) const
+{
+    return iterator(internalFind(k));
+}
+
+/**
+* Returns an iterator to the first item whose key is not less than key,
+* or end() if there is none.
+*/
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::lower_bound(const Key& key) const
+{
+    return iterator(lowerBoundNode(key));
+}
+
+template<class Key, class Value, class Compare>
+template<typename K, typename C, typename>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::lower_bound(const K& key) const
+{
+    return iterator(lowerBoundNode(key));
+}
+
+/**
+* A getter for the comparator that orders the keys.
+*/
+template<class Key, class Value, class Compare>
+Compare BinarySearchTree<Key, Value, Compare>::key_comp() const
+{
+    return comp_;
+}
+
+/**
+ * Returns the value associated with the key, inserting a
+ * default-constructed value first if the key is not in the map
  */
-template<class Key, class Value>
-Value& BinarySearchTree<Key, Value>::operator[](const Key& key)
+template<class Key, class Value, class Compare>
+Value& BinarySearchTree<Key, Value, Compare>::operator[](const Key& key)
 {
-    Node<Key, Value> *curr = internalFind(key);
-    if(curr == NULL) throw std::out_of_range("Invalid key");
-    return curr->getValue();
+    return try_emplace(key).first->second;
 }
-template<class Key, class Value>
-Value const & BinarySearchTree<Key, Value>::operator[](const Key& key) const
+template<class Key, class Value, class Compare>
+Value& BinarySearchTree<Key, Value, Compare>::operator[](Key&& key)
+{
+    return try_emplace(std::move(key)).first->second;
+}
+
+/**
+ * @precondition The key exists in the map
+ * Returns the value associated with the key
+ */
+template<class Key, class Value, class Compare>
+Value const & BinarySearchTree<Key, Value, Compare>::operator[](const Key& key) const
 {
     Node<Key, Value> *curr = internalFind(key);
     if(curr == NULL) throw std::out_of_range("Invalid key");
@@ -452,52 +869,550 @@ Value const & BinarySearchTree<Key, Value>::operator[](const Key& key) const
 * Recall: If key is already in the tree, you should 
 * overwrite the current value with the updated value.
 */
-template<class Key, class Value>
-void BinarySearchTree<Key, Value>::insert(const std::pair<const Key, Value> &keyValuePair)
+template<class Key, class Value, class Compare>
+void BinarySearchTree<Key, Value, Compare>::insert(const std::pair<const Key, Value> &keyValuePair)
 {
-    // TODO
-    //check if internalFind comes out NULL or not, because if the key is found, we update the value and are done
-    //for now i will write, but remember that i haven't implemented it yet
-    if(root_==nullptr) {
-        //for first insertion we set root to what we're insertin
-        root_ = new Node<Key,Value>(keyValuePair.first, keyValuePair.second, nullptr);
-        return;
+    insert_or_assign(keyValuePair.first, keyValuePair.second);
+}
+
+/**
+* Same as above, but moves the value out of the pair instead of copying it.
+* (The key is const inside the pair, so it still gets copied.)
+*/
+template<class Key, class Value, class Compare>
+void BinarySearchTree<Key, Value, Compare>::insert(std::pair<const Key, Value>&& keyValuePair)
+{
+    insert_or_assign(keyValuePair.first, std::move(keyValuePair.second));
+}
+
+/**
+* Inserts the pair (overwriting the value if the key exists, like insert)
+* using hint as a guess for where it goes, and returns an iterator to it.
+* See hintSlot.
+*/
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::insert(iterator hint, const std::pair<const Key, Value>& keyValuePair)
+{
+    Node<Key, Value>* parent;
+    Node<Key, Value>* existing = hintSlot(hint.current_, keyValuePair.first, parent);
+    return insertOrAssignAt(existing, parent, keyValuePair.first, keyValuePair.second).first;
+}
+
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::insert(iterator hint, std::pair<const Key, Value>&& keyValuePair)
+{
+    Node<Key, Value>* parent;
+    Node<Key, Value>* existing = hintSlot(hint.current_, keyValuePair.first, parent);
+    return insertOrAssignAt(existing, parent, keyValuePair.first, std::move(keyValuePair.second)).first;
+}
+
+/**
+* Inserts the pair if the key is new, otherwise overwrites the value.
+* Walks from the root to a leaf once. Returns an iterator to the item
+* and whether a new node was created.
+*/
+template<class Key, class Value, class Compare>
+template<typename V>
+std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool>
+BinarySearchTree<Key, Value, Compare>::insert_or_assign(const Key& key, V&& value)
+{
+    return insertOrAssignHelper(key, std::forward<V>(value));
+}
+template<class Key, class Value, class Compare>
+template<typename V>
+std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool>
+BinarySearchTree<Key, Value, Compare>::insert_or_assign(Key&& key, V&& value)
+{
+    return insertOrAssignHelper(std::move(key), std::forward<V>(value));
+}
+
+/**
+* Inserts a value constructed from args if the key is new, otherwise
+* leaves the tree (and args) untouched. Walks from the root to a leaf once.
+*/
+template<class Key, class Value, class Compare>
+template<typename... Args>
+std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool>
+BinarySearchTree<Key, Value, Compare>::try_emplace(const Key& key, Args&&... args)
+{
+    return tryEmplaceHelper(key, std::forward<Args>(args)...);
+}
+template<class Key, class Value, class Compare>
+template<typename... Args>
+std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool>
+BinarySearchTree<Key, Value, Compare>::try_emplace(Key&& key, Args&&... args)
+{
+    return tryEmplaceHelper(std::move(key), std::forward<Args>(args)...);
+}
+
+/**
+* Constructs the key/value pair directly inside a new node from args
+* (anything std::pair<const Key, Value> can be built from), then looks
+* for its spot. Like std::map, an existing key is left alone and the
+* new node is thrown away.
+*/
+template<class Key, class Value, class Compare>
+template<typename... Args>
+std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool>
+BinarySearchTree<Key, Value, Compare>::emplace(Args&&... args)
+{
+    auto build = [&]() {
+        return std::pair<const Key, Value>(std::forward<Args>(args)...);
+    };
+    ItemBuilderFn<Key, Value, decltype(build)> builder(build);
+    Node<Key, Value>* node = createNode(builder, nullptr);
+
+    Node<Key, Value>* parent;
+    Node<Key, Value>* existing = findSlot(node->getKey(), parent);
+    if(existing != NULL) {
+        destroyNode(node);
+        return std::make_pair(iterator(existing), false);
     }
+    return std::make_pair(iterator(linkNode(node, parent)), true);
+}
 
-    if(internalFind(keyValuePair.first)!= NULL) {
-        internalFind(keyValuePair.first)->setValue(keyValuePair.second);
-        return;
+template<class Key, class Value, class Compare>
+template<typename K, typename V>
+std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool>
+BinarySearchTree<Key, Value, Compare>::insertOrAssignHelper(K&& key, V&& value, Node<Key, Value>* finger)
+{
+    Node<Key, Value>* parent;
+    Node<Key, Value>* existing = findSlot(key, parent, finger);
+    return insertOrAssignAt(existing, parent, std::forward<K>(key), std::forward<V>(value));
+}
+
+/**
+* The second half of every insert_or_assign flavour: overwrites the value
+* of existing, or creates the node under parent as found by findSlot.
+*/
+template<class Key, class Value, class Compare>
+template<typename K, typename V>
+std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool>
+BinarySearchTree<Key, Value, Compare>::insertOrAssignAt(Node<Key, Value>* existing, Node<Key, Value>* parent,
+    K&& key, V&& value)
+{
+    if(existing != NULL) {
+        existing->setValue(std::forward<V>(value));
+        valueChanged(existing);
+        return std::make_pair(iterator(existing), false);
     }
-    
-    Node<Key,Value> *temp = root_;
-    Node<Key,Value> * tempParent = nullptr;
-    //nvm do this later when parent is known, params are key, value, parent;
-    //Node<Key,Value> *temp = new Node();
+    auto build = [&]() {
+        return std::pair<const Key, Value>(std::piecewise_construct,
+            std::forward_as_tuple(std::forward<K>(key)), std::forward_as_tuple(std::forward<V>(value)));
+    };
+    ItemBuilderFn<Key, Value, decltype(build)> builder(build);
+    return std::make_pair(iterator(linkNode(createNode(builder, parent), parent)), true);
+}
+
+template<class Key, class Value, class Compare>
+template<typename K, typename... Args>
+std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool>
+BinarySearchTree<Key, Value, Compare>::tryEmplaceHelper(K&& key, Args&&... args)
+{
+    Node<Key, Value>* parent;
+    Node<Key, Value>* existing = findSlot(key, parent);
+    if(existing != NULL) {
+        return std::make_pair(iterator(existing), false);
+    }
+    auto build = [&]() {
+        return std::pair<const Key, Value>(std::piecewise_construct,
+            std::forward_as_tuple(std::forward<K>(key)), std::forward_as_tuple(std::forward<Args>(args)...));
+    };
+    ItemBuilderFn<Key, Value, decltype(build)> builder(build);
+    return std::make_pair(iterator(linkNode(createNode(builder, parent), parent)), true);
+}
+
+/**
+* findSlot for hinted insertion. If key goes right next to hint (NULL
+* meaning end(), i.e. after the largest key), the slot is hint's free
+* child link or the free link of its neighbour on that side, which takes
+* one or two comparisons; the neighbour is found in amortized O(1) steps,
+* and right away for the largest node, which the tree keeps track of.
+* Otherwise it falls back to a descent from hint as the finger.
+*/
+template<class Key, class Value, class Compare>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare>::hintSlot(Node<Key, Value>* hint, const Key& key,
+    Node<Key, Value>*& parent)
+{
+    parent = nullptr;
+    if(hint == nullptr) {
+        hint = rightmostNode();
+        if(hint == nullptr) {
+            return nullptr;
+        }
+        if(comp_(hint->getKey(), key)) {
+            parent = hint;
+            return nullptr;
+        }
+    }else if(comp_(hint->getKey(), key)) {
+        Node<Key, Value>* next = hint == rightmost_ ? nullptr : successor(hint);
+        if(next == nullptr || comp_(key, next->getKey())) {
+            parent = hint->getRight() == nullptr ? hint : next;
+            return nullptr;
+        }
+    }else if(comp_(key, hint->getKey())) {
+        Node<Key, Value>* prev = predecessor(hint);
+        if(prev == nullptr || comp_(prev->getKey(), key)) {
+            parent = hint->getLeft() == nullptr ? hint : prev;
+            return nullptr;
+        }
+    }else{
+        return hint;
+    }
+    return findSlot(key, parent, hint);
+}
+
+/**
+* The node with the largest key (NULL for an empty tree), from the cache
+* when it is known.
+*/
+template<class Key, class Value, class Compare>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare>::rightmostNode()
+{
+    if(rightmost_ == nullptr && root_ != nullptr) {
+        rightmost_ = root_;
+        while(rightmost_->getRight() != nullptr) {
+            rightmost_ = rightmost_->getRight();
+        }
+    }
+    return rightmost_;
+}
 
-    //bst searching while within the tree
+/**
+* Walks down from the root (or from near finger, see fingerStart) looking
+* for key. Returns the node holding it, or NULL with parent set to the
+* node whose empty child link is where the key belongs (NULL for an empty
+* tree). Like lowerBoundNode, it compares once per level and checks the
+* last left turn for equality.
+*/
+template<class Key, class Value, class Compare>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare>::findSlot(const Key& key, Node<Key, Value>*& parent,
+    Node<Key, Value>* finger) const
+{
+    Node<Key, Value>* candidate;
+    Node<Key, Value>* temp = fingerStart(finger, key, candidate, parent);
     while(temp != nullptr) {
-        //iterate left or right
-        //if key of current node is less than the param, we shoudl go right
-        if(temp->getKey() < keyValuePair.first) {
-            tempParent = temp;
+        parent = temp;
+        if(comp_(temp->getKey(), key)) {
             temp = temp->getRight();
         }else{
-            //don't have to worry about same key, bcs of case 1
-            tempParent = temp;
+            candidate = temp;
             temp = temp->getLeft();
         }
-        //if we reached a null node that means that 
-        //we found were to insert our child
-        //this is why we need to track the parent
     }
-    Node<Key,Value> * insertion = new Node<Key,Value>(keyValuePair.first, keyValuePair.second, tempParent);
-    if(keyValuePair.first < tempParent->getKey()) {
-        tempParent->setLeft(insertion);
-    } else {
-        tempParent ->setRight(insertion);
+    if(candidate != nullptr && !comp_(key, candidate->getKey())) {
+        return candidate;
+    }
+    return nullptr;
+}
+
+/**
+* Hangs a freshly created node under parent (on the side its key belongs)
+* as found by findSlot, then lets the tree restore its balance.
+*/
+template<class Key, class Value, class Compare>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare>::linkNode(Node<Key, Value>* insertion, Node<Key, Value>* parent)
+{
+    insertion->setParent(parent);
+    if(parent == nullptr) {
+        root_ = insertion;
+        rightmost_ = insertion;
+    }else if(comp_(insertion->getKey(), parent->getKey())) {
+        parent->setLeft(insertion);
+    }else{
+        parent->setRight(insertion);
+        if(parent == rightmost_) {
+            rightmost_ = insertion;
+        }
+    }
+    rebalanceAfterInsert(insertion);
+    return insertion;
+}
+
+/**
+* The plain BST does no rebalancing.
+*/
+template<class Key, class Value, class Compare>
+void BinarySearchTree<Key, Value, Compare>::rebalanceAfterInsert(Node<Key, Value>* node)
+{
+
+}
+
+/**
+* Called after insert/insert_or_assign overwrote the value of an existing
+* node. Nothing in a plain BST depends on the values.
+*/
+template<class Key, class Value, class Compare>
+void BinarySearchTree<Key, Value, Compare>::valueChanged(Node<Key, Value>* node)
+{
+
+}
+
+/**
+* Replaces the contents of the tree with the pairs in [first, last),
+* which must be sorted by key (equal keys keep the last value, like
+* repeated inserts would). Runs in O(n): the nodes are created in order
+* as a vine hanging off root_ and then folded into a perfectly balanced
+* tree, with no per-element descent. Throws std::invalid_argument (and
+* leaves the tree empty) if the range is not sorted.
+*/
+template<class Key, class Value, class Compare>
+template<typename InputIt>
+void BinarySearchTree<Key, Value, Compare>::assign_sorted(InputIt first, InputIt last)
+{
+    clear();
+    Node<Key, Value>* tail = nullptr;
+    std::size_t n = 0;
+    try {
+        for(; first != last; ++first) {
+            auto build = [&]() {
+                return std::pair<const Key, Value>(*first);
+            };
+            ItemBuilderFn<Key, Value, decltype(build)> builder(build);
+            Node<Key, Value>* node = createNode(builder, tail);
+            if(tail != nullptr && !comp_(tail->getKey(), node->getKey())) {
+                bool duplicate = !comp_(node->getKey(), tail->getKey());
+                if(duplicate) {
+                    tail->setValue(std::move(node->getValue()));
+                }
+                destroyNode(node);
+                if(!duplicate) {
+                    throw std::invalid_argument("assign_sorted: keys are not sorted");
+                }
+                continue;
+            }
+            if(tail == nullptr) {
+                root_ = node;
+            }else{
+                tail->setRight(node);
+            }
+            tail = node;
+            ++n;
+        }
+    } catch(...) {
+        //the vine hangs off root_, so clear() can still reach every node
+        clear();
+        throw;
     }
-    //in theory should work, but remember that there is 0 testing and i'm tired/sleepy
-//i write messages to myself to remember im not done, because it just looks like text
+    Node<Key, Value>* vine = root_;
+    int height;
+    root_ = buildFromVine(vine, n, height);
+    rightmost_ = tail;
+    if(root_ != nullptr) {
+        root_->setParent(nullptr);
+    }
+    finishBuiltTree(root_, height);
+}
+
+/**
+* Takes the next n nodes off the vine and arranges them into a balanced
+* subtree (the right side gets the extra node when n is even). Returns the
+* subtree root; its parent pointer is left for the caller to set.
+*/
+template<class Key, class Value, class Compare>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare>::buildFromVine(Node<Key, Value>*& vine, std::size_t n, int& height)
+{
+    if(n == 0) {
+        height = 0;
+        return nullptr;
+    }
+    std::size_t leftCount = (n - 1) / 2;
+    int leftHeight, rightHeight;
+    Node<Key, Value>* left = buildFromVine(vine, leftCount, leftHeight);
+    Node<Key, Value>* node = vine;
+    vine = vine->getRight();
+    Node<Key, Value>* right = buildFromVine(vine, n - 1 - leftCount, rightHeight);
+
+    node->setLeft(left);
+    if(left != nullptr) {
+        left->setParent(node);
+    }
+    node->setRight(right);
+    if(right != nullptr) {
+        right->setParent(node);
+    }
+    finishBuiltNode(node, leftHeight, rightHeight);
+    height = std::max(leftHeight, rightHeight) + 1;
+    return node;
+}
+
+/**
+* Straightens the subtree under node into a vine in key order by rotating
+* right at every node with a left child, without extra memory. Returns
+* the head of the vine and its length in count. Parent pointers are left
+* stale, buildFromVine sets them again.
+*/
+template<class Key, class Value, class Compare>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare>::treeToVine(Node<Key, Value>* node, std::size_t& count)
+{
+    Node<Key, Value>* head = nullptr;
+    Node<Key, Value>* tail = nullptr;
+    count = 0;
+    while(node != nullptr) {
+        Node<Key, Value>* left = node->getLeft();
+        if(left != nullptr) {
+            node->setLeft(left->getRight());
+            left->setRight(node);
+            node = left;
+        }else{
+            if(tail == nullptr) {
+                head = node;
+            }else{
+                tail->setRight(node);
+            }
+            tail = node;
+            node = node->getRight();
+            ++count;
+        }
+    }
+    return head;
+}
+
+/**
+* Rearranges the subtree under node into a perfectly balanced one in
+* O(size) and hangs it back where node was. The nodes stay the same, so
+* iterators (and the cached rightmost node) remain valid.
+*/
+template<class Key, class Value, class Compare>
+void BinarySearchTree<Key, Value, Compare>::rebuildSubtree(Node<Key, Value>* node)
+{
+    Node<Key, Value>* parent = node->getParent();
+    bool isLeft = parent != nullptr && parent->getLeft() == node;
+    std::size_t n;
+    Node<Key, Value>* vine = treeToVine(node, n);
+    int height;
+    Node<Key, Value>* built = buildFromVine(vine, n, height);
+    built->setParent(parent);
+    if(parent == nullptr) {
+        root_ = built;
+        finishBuiltTree(root_, height);
+    }else if(isLeft) {
+        parent->setLeft(built);
+    }else{
+        parent->setRight(built);
+    }
+}
+
+/**
+* Rearranges the whole tree into a complete one (every level full except
+* the last, which is filled from the left) in O(n) time and O(1) extra
+* memory, with Day, Stout and Warren's algorithm: treeToVine straightens
+* it, then compressVine rotates the vine into shape. Nodes are reused as
+* they are, so iterators stay valid. Meant for trees that degenerated,
+* e.g. after a bulk import in sorted order.
+*/
+template<class Key, class Value, class Compare>
+void BinarySearchTree<Key, Value, Compare>::rebalance()
+{
+    std::size_t n;
+    Node<Key, Value>* head = treeToVine(root_, n);
+    if(head == nullptr) {
+        return;
+    }
+    //treeToVine leaves parent pointers stale; compressVine rotates properly
+    Node<Key, Value>* prev = nullptr;
+    for(Node<Key, Value>* temp = head; temp != nullptr; temp = temp->getRight()) {
+        temp->setParent(prev);
+        prev = temp;
+    }
+
+    //full is the size of the largest perfect tree that fits; the nodes
+    //beyond it go to the bottom level first
+    std::size_t full = 1;
+    int height = 1;
+    while(2 * full + 1 <= n) {
+        full = 2 * full + 1;
+        ++height;
+    }
+    if(full < n) {
+        ++height;
+    }
+    compressVine(head, n - full);
+    for(std::size_t count = full / 2; count > 0; count /= 2) {
+        compressVine(head, count);
+    }
+    root_ = head;
+
+    //post-order walk over the parent pointers. In a complete tree the
+    //height of a subtree is the length of its left spine.
+    prev = nullptr;
+    Node<Key, Value>* node = root_;
+    while(node != nullptr) {
+        Node<Key, Value>* next = nullptr;
+        if(prev == node->getParent()) {
+            next = node->getLeft() != nullptr ? node->getLeft() : node->getRight();
+        }else if(prev == node->getLeft()) {
+            next = node->getRight();
+        }
+        if(next == nullptr) {
+            finishBuiltNode(node, leftSpineLength(node->getLeft()), leftSpineLength(node->getRight()));
+            next = node->getParent();
+        }
+        prev = node;
+        node = next;
+    }
+    finishBuiltTree(root_, height);
+}
+
+/**
+* One pass of the DSW compression: left-rotates every other node of the
+* right spine starting at head, count times, so each rotated node drops
+* below its successor.
+*/
+template<class Key, class Value, class Compare>
+void BinarySearchTree<Key, Value, Compare>::compressVine(Node<Key, Value>*& head, std::size_t count)
+{
+    Node<Key, Value>* scanner = nullptr;
+    for(std::size_t i = 0; i < count; ++i) {
+        Node<Key, Value>* child = scanner == nullptr ? head : scanner->getRight();
+        Node<Key, Value>* next = child->getRight();
+        child->setRight(next->getLeft());
+        if(next->getLeft() != nullptr) {
+            next->getLeft()->setParent(child);
+        }
+        next->setLeft(child);
+        child->setParent(next);
+        next->setParent(scanner);
+        if(scanner == nullptr) {
+            head = next;
+        }else{
+            scanner->setRight(next);
+        }
+        scanner = next;
+    }
+}
+
+template<class Key, class Value, class Compare>
+int BinarySearchTree<Key, Value, Compare>::leftSpineLength(Node<Key, Value>* node)
+{
+    int length = 0;
+    for(; node != nullptr; node = node->getLeft()) {
+        ++length;
+    }
+    return length;
+}
+
+/**
+* Called on each node built by buildFromVine once both of its subtrees
+* are in place. The plain BST keeps no per-node balance data.
+*/
+template<class Key, class Value, class Compare>
+void BinarySearchTree<Key, Value, Compare>::finishBuiltNode(Node<Key, Value>* node, int leftHeight, int rightHeight)
+{
+
+}
+
+/**
+* Called once a whole tree has been built by buildFromVine, for balance
+* data that depends on more than a node's own subtree (such as the depth
+* of the node in the tree). Nothing to do for a plain BST.
+*/
+template<class Key, class Value, class Compare>
+void BinarySearchTree<Key, Value, Compare>::finishBuiltTree(Node<Key, Value>* root, int height)
+{
+
 }
 
 
@@ -506,8 +1421,8 @@ void BinarySearchTree<Key, Value>::insert(const std::pair<const Key, Value> &key
 * Recall: The writeup specifies that if a node has 2 children you
 * should swap with the predecessor and then remove.
 */
-template<typename Key, typename Value>
-void BinarySearchTree<Key, Value>::remove(const Key& key)
+template<typename Key, typename Value, class Compare>
+void BinarySearchTree<Key, Value, Compare>::remove(const Key& key)
 {
     // TODO
     Node<Key,Value> *temp = internalFind(key);
@@ -516,7 +1431,19 @@ void BinarySearchTree<Key, Value>::remove(const Key& key)
         //key not found
         return;
     }
+    removeNode(temp);
+}
 
+/**
+* Unlinks and destroys a node of this tree. Derived trees override it to
+* rebalance afterwards; every other node stays where it is in memory.
+*/
+template<typename Key, typename Value, class Compare>
+void BinarySearchTree<Key, Value, Compare>::removeNode(Node<Key, Value>* temp)
+{
+    if(temp == rightmost_) {
+        rightmost_ = predecessor(temp);
+    }
     if(temp->getLeft() == nullptr && temp->getRight() == nullptr){
         if(temp == root_){
             root_ = nullptr;
@@ -528,7 +1455,7 @@ void BinarySearchTree<Key, Value>::remove(const Key& key)
                 temp->getParent()->setRight(nullptr);
             }
         }
-        delete temp;
+        destroyNode(temp);
         
     }else if(temp->getLeft() == nullptr || temp->getRight() == nullptr) {
         //one child
@@ -561,7 +1488,7 @@ void BinarySearchTree<Key, Value>::remove(const Key& key)
 
         }
        
-        delete temp;
+        destroyNode(temp);
 
     }else{
         //we must also account for if predecessor has a left child
@@ -587,7 +1514,7 @@ void BinarySearchTree<Key, Value>::remove(const Key& key)
             
         } 
 
-        delete temp;
+        destroyNode(temp);
         
     }
   
@@ -595,9 +1522,24 @@ void BinarySearchTree<Key, Value>::remove(const Key& key)
 
 
 
-template<class Key, class Value>
+/**
+* remove() for any key type a transparent Compare accepts. The node is
+* unlinked through the virtual removeNode(), so derived trees rebalance
+* as usual.
+*/
+template<typename Key, typename Value, class Compare>
+template<typename K, typename C, typename>
+void BinarySearchTree<Key, Value, Compare>::remove(const K& key)
+{
+    Node<Key, Value>* node = internalFind(key);
+    if(node != NULL) {
+        removeNode(node);
+    }
+}
+
+template<class Key, class Value, class Compare>
 Node<Key, Value>*
-BinarySearchTree<Key, Value>::predecessor(Node<Key, Value>* current)
+BinarySearchTree<Key, Value, Compare>::predecessor(Node<Key, Value>* current)
 {
     // TODO
     if(current == nullptr){
@@ -622,9 +1564,9 @@ BinarySearchTree<Key, Value>::predecessor(Node<Key, Value>* current)
     }
 }
 
-template <class Key, class Value>
+template <class Key, class Value, class Compare>
 Node<Key, Value>* 
-BinarySearchTree<Key,Value>::successor(Node<Key, Value>* current) {
+BinarySearchTree<Key, Value, Compare>::successor(Node<Key, Value>* current) {
     //TODO
     //mapping it all out
     //if right child exists, go as far left as you can in right child subtree(this could be the child itself)
@@ -661,36 +1603,95 @@ BinarySearchTree<Key,Value>::successor(Node<Key, Value>* current) {
 * A method to remove all contents of the tree and
 * reset the values in the tree for use again.
 */
-template<typename Key, typename Value>
-void BinarySearchTree<Key, Value>::clear()
+template<typename Key, typename Value, class Compare>
+void BinarySearchTree<Key, Value, Compare>::clear()
 {
     // TODO
     //pseudocode
     //while loop for node that isn't null
     //remove getSmallest Node, or remove root acutally
     //done?
-    clearHelper(root_);
+    //only walk the tree when the nodes actually need destructors run,
+    //the memory itself goes back a whole slab at a time
+    //(unless other trees still have nodes in the same pool, see sharePool)
+    NodePool& current = pool();
+    if(pool_.use_count() == 1){
+        if(!trivialNodes_){
+            clearHelper(root_);
+        }
+        pool_->release();
+    }else{
+        clearHelper(root_);
+        //start over on a pool of our own, so this tree stops keeping the
+        //other trees' slabs alive
+        pool_ = std::make_shared<NodePool>(current.slotSize());
+    }
     root_ = nullptr;
+    rightmost_ = nullptr;
 }
 
 
-template<typename Key, typename Value>
-void BinarySearchTree<Key, Value>::clearHelper(Node<Key,Value>* curr){
+template<typename Key, typename Value, class Compare>
+void BinarySearchTree<Key, Value, Compare>::clearHelper(Node<Key,Value>* curr){
     if(curr == nullptr){
         return;
     }
 
     clearHelper(curr->getLeft());
     clearHelper(curr->getRight());
-    delete curr;
+    destroyNode(curr);
+}
+
+/**
+* Allocates a slot from the pool and constructs a plain node in it.
+*/
+template<typename Key, typename Value, class Compare>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare>::createNode(ItemBuilder<Key, Value>& builder, Node<Key, Value>* parent)
+{
+    void* slot = pool().allocate();
+    try {
+        return new (slot) Node<Key, Value>(builder, parent);
+    } catch(...) {
+        pool().deallocate(slot);
+        throw;
+    }
+}
+
+/**
+* Destroys a single node and hands its slot back to the pool for reuse.
+*/
+template<typename Key, typename Value, class Compare>
+void BinarySearchTree<Key, Value, Compare>::destroyNode(Node<Key, Value>* node)
+{
+    node->~Node();
+    pool().deallocate(node);
+}
+
+/**
+* The pool this tree allocates from (following any merges, see NodePool).
+*/
+template<typename Key, typename Value, class Compare>
+NodePool& BinarySearchTree<Key, Value, Compare>::pool()
+{
+    return NodePool::root(pool_);
+}
+
+/**
+* Makes this tree and other allocate from one common pool, so that nodes
+* can be relinked from one tree into the other. O(1).
+*/
+template<typename Key, typename Value, class Compare>
+void BinarySearchTree<Key, Value, Compare>::sharePool(BinarySearchTree<Key, Value, Compare>& other)
+{
+    NodePool::merge(pool_, other.pool_);
 }
 
 /**
 * A helper function to find the smallest node in the tree.
 */
-template<typename Key, typename Value>
+template<typename Key, typename Value, class Compare>
 Node<Key, Value>*
-BinarySearchTree<Key, Value>::getSmallestNode() const
+BinarySearchTree<Key, Value, Compare>::getSmallestNode() const
 {
     // TODO
     //pseudocode
@@ -710,33 +1711,106 @@ BinarySearchTree<Key, Value>::getSmallestNode() const
 * return a pointer to it or NULL if no item with that key
 * exists
 */
-template<typename Key, typename Value>
-Node<Key, Value>* BinarySearchTree<Key, Value>::internalFind(const Key& key) const
+template<typename Key, typename Value, class Compare>
+template<typename K>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare>::internalFind(const K& key, Node<Key, Value>* finger) const
 {
     // TODO
-    //pseudocode
-    //basic tree iteration
-    //while somethign
-    //if key < node.key go right, if > go right, if = return
-    //if we reach end without returning sne dnull
-    Node<Key, Value>  *temp = root_;
+    //one comparison per level down to the lower bound, then one more to
+    //see whether it holds key itself
+    Node<Key, Value>* temp = lowerBoundNode(key, finger);
+    if(temp != NULL && !comp_(key, temp->getKey())) {
+        return temp;
+    }
+    return NULL;
+}
+
+/**
+* Returns the node with the smallest key not less than key, or NULL.
+* Starts from the root, or from near finger if one is given.
+*/
+template<typename Key, typename Value, class Compare>
+template<typename K>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare>::lowerBoundNode(const K& key, Node<Key, Value>* finger) const
+{
+    Node<Key, Value>* result;
+    Node<Key, Value>* above;
+    Node<Key, Value>* temp = fingerStart(finger, key, result, above);
     while(temp != nullptr) {
-        if(key < temp->getKey()) {
-            temp = temp->getLeft();
-        }else if(key > temp->getKey()){
+        if(comp_(temp->getKey(), key)) {
             temp = temp->getRight();
         }else{
-            return temp;
+            result = temp;
+            temp = temp->getLeft();
         }
     }
-    return NULL;
+    return result;
+}
+
+/**
+* Where a descent for key has to start so that it ends up exactly as one
+* from the root would. Without a finger that is the root. Otherwise it
+* climbs from the finger until an ancestor bounds key on the far side,
+* comparing only at the ancestors that are on that side of the path,
+* which takes O(log d) steps when key is d items away from the finger.
+* The descent then resumes below the last node passed on the near side
+* (returned in parent, the start being its child towards key), so the
+* path back down is not compared again. candidate is set to the lower
+* bound found so far, or NULL. When the finger holds key itself, it
+* returns NULL with candidate = finger.
+*/
+template<typename Key, typename Value, class Compare>
+template<typename K>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare>::fingerStart(Node<Key, Value>* finger, const K& key,
+    Node<Key, Value>*& candidate, Node<Key, Value>*& parent) const
+{
+    candidate = nullptr;
+    parent = nullptr;
+    if(finger == nullptr) {
+        return root_;
+    }
+    Node<Key, Value>* node = finger;
+    Node<Key, Value>* above = node->getParent();
+    if(comp_(finger->getKey(), key)) {
+        //key lies to the right: climb to the first ancestor we are left of
+        //whose key is not less than key; parent ends up as the highest node
+        //passed on the left of key
+        parent = finger;
+        for(; above != nullptr; node = above, above = node->getParent()) {
+            if(above->getLeft() == node) {
+                if(!comp_(above->getKey(), key)) {
+                    candidate = above;
+                    break;
+                }
+                parent = above;
+            }
+        }
+        return parent->getRight();
+    }
+    candidate = finger;
+    if(!comp_(key, finger->getKey())) {
+        return nullptr;
+    }
+    //key lies to the left: the mirror image, and every node passed on
+    //the way is a closer lower bound
+    parent = finger;
+    for(; above != nullptr; node = above, above = node->getParent()) {
+        if(above->getRight() == node) {
+            if(comp_(above->getKey(), key)) {
+                break;
+            }
+            parent = above;
+        }
+    }
+    candidate = parent;
+    return parent->getLeft();
 }
 
 /**
  * Return true iff the BST is balanced.
  */
-template<typename Key, typename Value>
-bool BinarySearchTree<Key, Value>::isBalanced() const
+template<typename Key, typename Value, class Compare>
+bool BinarySearchTree<Key, Value, Compare>::isBalanced() const
 {
     // TODO
     //i think i implemented a function for this in lab, will just take it
@@ -747,8 +1821,8 @@ bool BinarySearchTree<Key, Value>::isBalanced() const
     return false;
 }
 
-template<typename Key, typename Value>
-int BinarySearchTree<Key,Value>::isBalancedHelper(Node<Key,Value>* current) const{
+template<typename Key, typename Value, class Compare>
+int BinarySearchTree<Key, Value, Compare>::isBalancedHelper(Node<Key,Value>* current) const{
     //idea:
     //calculate height of left and right subtrees
     //work our way down before going up
@@ -771,8 +1845,8 @@ int BinarySearchTree<Key,Value>::isBalancedHelper(Node<Key,Value>* current) cons
 
 
 
-template<typename Key, typename Value>
-void BinarySearchTree<Key, Value>::nodeSwap( Node<Key,Value>* n1, Node<Key,Value>* n2)
+template<typename Key, typename Value, class Compare>
+void BinarySearchTree<Key, Value, Compare>::nodeSwap( Node<Key,Value>* n1, Node<Key,Value>* n2)
 {
     if((n1 == n2) || (n1 == NULL) || (n2 == NULL) ) {
         return;
@@ -0,0 +1,94 @@
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include "avlbst.h"
+#include "btree.h"
+
+using namespace std;
+
+// Successful finds, only kept so the lookups cannot be optimized away.
+static long hits = 0;
+
+struct Timings
+{
+    double insert;
+    double find;
+    double remove;
+};
+
+static double nanosSince(chrono::steady_clock::time_point begin, size_t ops)
+{
+    return chrono::duration<double, nano>(chrono::steady_clock::now() - begin).count() / ops;
+}
+
+/**
+* Average nanoseconds per operation for inserting the keys, finding each
+* of them in a different random order, then removing them.
+*/
+template<typename Tree>
+Timings run(const vector<uint64_t>& keys, const vector<uint64_t>& lookups)
+{
+    Timings timings;
+    Tree tree;
+    chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+    for(size_t i = 0; i < keys.size(); ++i) {
+        tree.insert(make_pair(keys[i], keys[i]));
+    }
+    timings.insert = nanosSince(begin, keys.size());
+
+    begin = chrono::steady_clock::now();
+    for(size_t i = 0; i < lookups.size(); ++i) {
+        hits += tree.find(lookups[i]) != tree.end();
+    }
+    timings.find = nanosSince(begin, lookups.size());
+
+    begin = chrono::steady_clock::now();
+    for(size_t i = 0; i < lookups.size(); ++i) {
+        tree.remove(lookups[i]);
+    }
+    timings.remove = nanosSince(begin, lookups.size());
+    return timings;
+}
+
+static void print(const char* name, const Timings& timings)
+{
+    cout << setw(10) << name << fixed << setprecision(1)
+         << setw(10) << timings.insert << setw(10) << timings.find
+         << setw(10) << timings.remove << endl;
+}
+
+/**
+* Usage: btree-bench [keys]
+* Random uint64 keys (default 4M). Build with -mavx2 added to CXXFLAGS
+* to use the AVX2 key search instead of SSE.
+*/
+int main(int argc, char *argv[])
+{
+    size_t n = argc > 1 ? atol(argv[1]) : 4000000;
+
+    mt19937_64 rng(12345);
+    vector<uint64_t> keys(n);
+    for(size_t i = 0; i < n; ++i) {
+        keys[i] = rng();
+    }
+    vector<uint64_t> lookups(keys);
+    shuffle(lookups.begin(), lookups.end(), rng);
+
+    cout << n << " random uint64 keys" << endl;
+    cout << setw(10) << "(ns/op)" << setw(10) << "insert" << setw(10) << "find"
+         << setw(10) << "remove" << endl;
+    Timings avl = run<AVLTree<uint64_t, uint64_t> >(keys, lookups);
+    print("AVLTree", avl);
+    Timings btree = run<BTree<uint64_t, uint64_t> >(keys, lookups);
+    print("BTree", btree);
+    cout << setw(10) << "speedup" << setprecision(2)
+         << setw(9) << avl.insert / btree.insert << "x"
+         << setw(9) << avl.find / btree.find << "x"
+         << setw(9) << avl.remove / btree.remove << "x" << endl;
+    return hits == 0;
+}
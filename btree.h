@@ -0,0 +1,858 @@
+#ifndef BTREE_H
+#define BTREE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include "nodepool.h"
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+/**
+* How BTree searches the sorted key array of a node: countLess() returns
+* the number of keys smaller than the one searched for, which is where
+* it is (or would be inserted). The general version is a binary search.
+*/
+template<typename Key, typename Enable = void>
+struct BTreeKeySearch
+{
+    static const bool padded = false;
+
+    static Key filler()
+    {
+        return Key();
+    }
+
+    static unsigned countLess(const Key* keys, unsigned count, const Key& key)
+    {
+        return static_cast<unsigned>(std::lower_bound(keys, keys + count, key) - keys);
+    }
+};
+
+/**
+* 32 and 64-bit integer keys are compared a whole vector at a time (AVX2,
+* or SSE when that is all the compiler may use, e.g. without -mavx2) and
+* the matching lanes are counted, with no branches on the key order.
+* Unused key slots are padded with the largest key, which is never less
+* than anything, so whole vectors can be compared past the last key.
+* Unsigned keys get their top bit flipped to use the signed compares.
+*/
+template<typename Key>
+struct BTreeKeySearch<Key, typename std::enable_if<std::is_integral<Key>::value &&
+    (sizeof(Key) == 4 || sizeof(Key) == 8)>::type>
+{
+    static const bool padded = true;
+#if defined(__AVX2__) || defined(__SSE4_2__)
+    static const bool vectorized = true;
+#elif defined(__SSE2__)
+    static const bool vectorized = sizeof(Key) == 4;
+#else
+    static const bool vectorized = false;
+#endif
+
+    static Key filler()
+    {
+        return std::numeric_limits<Key>::max();
+    }
+
+    static unsigned countLess(const Key* keys, unsigned count, const Key& key)
+    {
+        return countLess(keys, count, key, std::integral_constant<bool, vectorized>());
+    }
+
+    static unsigned countLess(const Key* keys, unsigned count, const Key& key, std::false_type)
+    {
+        unsigned less = 0;
+        for(unsigned i = 0; i < count; ++i) {
+            less += keys[i] < key ? 1 : 0;
+        }
+        return less;
+    }
+
+    static Key bias()
+    {
+        return std::is_signed<Key>::value ? Key(0) : static_cast<Key>(Key(1) << (sizeof(Key) * 8 - 1));
+    }
+
+#if defined(__AVX2__)
+    static __m256i splat(Key value)
+    {
+        return sizeof(Key) == 8 ? _mm256_set1_epi64x(static_cast<long long>(value))
+                                : _mm256_set1_epi32(static_cast<int>(value));
+    }
+
+    static unsigned countLess(const Key* keys, unsigned count, const Key& key, std::true_type)
+    {
+        const unsigned lanes = 32 / sizeof(Key);
+        __m256i flip = splat(bias());
+        __m256i target = _mm256_xor_si256(splat(key), flip);
+        unsigned bits = 0;
+        for(unsigned i = 0; i < count; i += lanes) {
+            __m256i block = _mm256_xor_si256(
+                _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i)), flip);
+            __m256i smaller = sizeof(Key) == 8 ? _mm256_cmpgt_epi64(target, block)
+                                               : _mm256_cmpgt_epi32(target, block);
+            bits += __builtin_popcount(static_cast<unsigned>(_mm256_movemask_epi8(smaller)));
+        }
+        return bits / sizeof(Key);
+    }
+#elif defined(__SSE2__)
+    static __m128i splat(Key value)
+    {
+        return sizeof(Key) == 8 ? _mm_set1_epi64x(static_cast<long long>(value))
+                                : _mm_set1_epi32(static_cast<int>(value));
+    }
+
+    static __m128i greater(__m128i a, __m128i b, std::integral_constant<std::size_t, 4>)
+    {
+        return _mm_cmpgt_epi32(a, b);
+    }
+
+#if defined(__SSE4_2__)
+    static __m128i greater(__m128i a, __m128i b, std::integral_constant<std::size_t, 8>)
+    {
+        return _mm_cmpgt_epi64(a, b);
+    }
+#endif
+
+    static unsigned countLess(const Key* keys, unsigned count, const Key& key, std::true_type)
+    {
+        const unsigned lanes = 16 / sizeof(Key);
+        __m128i flip = splat(bias());
+        __m128i target = _mm_xor_si128(splat(key), flip);
+        unsigned bits = 0;
+        for(unsigned i = 0; i < count; i += lanes) {
+            __m128i block = _mm_xor_si128(
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + i)), flip);
+            __m128i smaller = greater(target, block, std::integral_constant<std::size_t, sizeof(Key)>());
+            bits += __builtin_popcount(static_cast<unsigned>(_mm_movemask_epi8(smaller)));
+        }
+        return bits / sizeof(Key);
+    }
+#endif
+};
+
+/**
+* A B+ tree map with the same insert/remove/find/iterator interface as
+* BinarySearchTree. Every node keeps up to MAX_KEYS keys in one array,
+* so a lookup touches a few cache lines per level instead of one node
+* per key compared, and the tree is only about log_16(n) levels deep.
+*
+* Items live in the leaves, which are chained left to right for
+* iteration. Inner nodes hold, for each child but the last, the largest
+* key that may appear under it. Nodes are split on the way down when
+* inserting and topped up (by borrowing from or merging with a sibling)
+* on the way down when removing, so neither ever has to walk back up.
+*
+* Unlike BinarySearchTree, inserting or removing moves items within
+* and between leaves, so it invalidates iterators. Key must be default
+* constructible and assignable (integer keys are searched with SIMD,
+* see BTreeKeySearch).
+*/
+template <typename Key, typename Value>
+class BTree
+{
+public:
+    typedef std::pair<const Key, Value> value_type;
+
+    BTree();
+    ~BTree();
+    void insert(const std::pair<const Key, Value>& keyValuePair);
+    void insert(std::pair<const Key, Value>&& keyValuePair);
+    void remove(const Key& key);
+    void clear();
+    bool empty() const;
+    std::size_t size() const;
+
+protected:
+    struct LeafNode;
+
+public:
+    /**
+    * Walks the leaves in key order.
+    */
+    class iterator
+    {
+    public:
+        iterator();
+
+        std::pair<const Key,Value>& operator*() const;
+        std::pair<const Key,Value>* operator->() const;
+
+        bool operator==(const iterator& rhs) const;
+        bool operator!=(const iterator& rhs) const;
+
+        iterator& operator++();
+
+    protected:
+        friend class BTree<Key, Value>;
+        iterator(LeafNode* leaf, unsigned index);
+        LeafNode* leaf_;
+        unsigned index_;
+    };
+
+    iterator begin() const;
+    iterator end() const;
+    iterator find(const Key& key) const;
+    Value& operator[](const Key& key);
+    Value const & operator[](const Key& key) const;
+
+protected:
+    BTree(const BTree<Key, Value>&) = delete;
+    BTree<Key, Value>& operator=(const BTree<Key, Value>&) = delete;
+
+    static const unsigned MAX_KEYS = 32;        // a multiple of 8, see BTreeKeySearch
+    static const unsigned LEAF_MIN = MAX_KEYS / 2;
+    static const unsigned INNER_MIN = MAX_KEYS / 2 - 1;
+    typedef BTreeKeySearch<Key> Search;
+
+    struct NodeBase
+    {
+        Key keys[MAX_KEYS];
+        unsigned count;
+        bool leaf;
+    };
+
+    struct InnerNode : NodeBase
+    {
+        NodeBase* children[MAX_KEYS + 1];
+    };
+
+    struct LeafNode : NodeBase
+    {
+        LeafNode* next;
+        typename std::aligned_storage<sizeof(value_type), alignof(value_type)>::type items[MAX_KEYS];
+        value_type* item(unsigned index);
+    };
+
+    static unsigned position(const NodeBase* node, const Key& key);
+    static unsigned minCount(const NodeBase* node);
+    LeafNode* newLeaf();
+    InnerNode* newInner();
+    void freeLeaf(LeafNode* leaf);
+    void freeInner(InnerNode* inner);
+
+    static void moveItem(LeafNode* from, unsigned i, LeafNode* to, unsigned j);
+    static void openGap(LeafNode* leaf, unsigned pos);
+    static void closeGap(LeafNode* leaf, unsigned pos);
+    static void insertChild(InnerNode* inner, unsigned pos, const Key& key, NodeBase* child);
+    static void eraseChild(InnerNode* inner, unsigned pos);
+
+    void splitChild(InnerNode* parent, unsigned index);
+    unsigned fixChild(InnerNode* parent, unsigned index);
+    void mergeChildren(InnerNode* parent, unsigned index);
+    template<typename Build>
+    iterator insertSlot(const Key& key, Build build, bool& created);
+    void clearHelper(NodeBase* node);
+
+    NodeBase* root_;
+    LeafNode* head_;        // leftmost leaf, where iteration starts
+    std::size_t size_;
+    NodePool leafPool_;
+    NodePool innerPool_;
+};
+
+/*
+  ----------------------------------------------------
+  Begin implementations for the BTree::iterator class.
+  ----------------------------------------------------
+*/
+
+template<typename Key, typename Value>
+BTree<Key, Value>::iterator::iterator() :
+    leaf_(NULL),
+    index_(0)
+{
+
+}
+
+template<typename Key, typename Value>
+BTree<Key, Value>::iterator::iterator(LeafNode* leaf, unsigned index) :
+    leaf_(leaf),
+    index_(index)
+{
+
+}
+
+template<typename Key, typename Value>
+std::pair<const Key,Value>& BTree<Key, Value>::iterator::operator*() const
+{
+    return *leaf_->item(index_);
+}
+
+template<typename Key, typename Value>
+std::pair<const Key,Value>* BTree<Key, Value>::iterator::operator->() const
+{
+    return leaf_->item(index_);
+}
+
+template<typename Key, typename Value>
+bool BTree<Key, Value>::iterator::operator==(const iterator& rhs) const
+{
+    return leaf_ == rhs.leaf_ && index_ == rhs.index_;
+}
+
+template<typename Key, typename Value>
+bool BTree<Key, Value>::iterator::operator!=(const iterator& rhs) const
+{
+    return !(*this == rhs);
+}
+
+/**
+* Steps to the next item, moving on to the next leaf at the end of one.
+*/
+template<typename Key, typename Value>
+typename BTree<Key, Value>::iterator& BTree<Key, Value>::iterator::operator++()
+{
+    if(++index_ == leaf_->count) {
+        leaf_ = leaf_->next;
+        index_ = 0;
+    }
+    return *this;
+}
+
+/*
+  --------------------------------------------------
+  End implementations for the BTree::iterator class.
+  --------------------------------------------------
+*/
+
+/*
+  -------------------------------------------
+  Begin implementations for the BTree class.
+  -------------------------------------------
+*/
+
+template<typename Key, typename Value>
+BTree<Key, Value>::BTree() :
+    root_(NULL),
+    head_(NULL),
+    size_(0),
+    leafPool_(sizeof(LeafNode)),
+    innerPool_(sizeof(InnerNode))
+{
+
+}
+
+template<typename Key, typename Value>
+BTree<Key, Value>::~BTree()
+{
+    clear();
+}
+
+/**
+* Inserts the pair, overwriting the value if the key is already present.
+*/
+template<typename Key, typename Value>
+void BTree<Key, Value>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    bool created;
+    iterator it = insertSlot(keyValuePair.first, [&]() { return keyValuePair; }, created);
+    if(!created) {
+        it->second = keyValuePair.second;
+    }
+}
+
+template<typename Key, typename Value>
+void BTree<Key, Value>::insert(std::pair<const Key, Value>&& keyValuePair)
+{
+    bool created;
+    iterator it = insertSlot(keyValuePair.first, [&]() { return std::move(keyValuePair); }, created);
+    if(!created) {
+        it->second = std::move(keyValuePair.second);
+    }
+}
+
+/**
+* Removes the item with the given key, if there is one.
+*/
+template<typename Key, typename Value>
+void BTree<Key, Value>::remove(const Key& key)
+{
+    if(root_ == NULL) {
+        return;
+    }
+    NodeBase* node = root_;
+    while(!node->leaf) {
+        InnerNode* inner = static_cast<InnerNode*>(node);
+        unsigned index = position(inner, key);
+        if(inner->children[index]->count <= minCount(inner->children[index])) {
+            index = fixChild(inner, index);
+        }
+        node = inner->children[index];
+        //a merge can leave the root with a single child, which takes its place
+        if(inner == root_ && inner->count == 0) {
+            root_ = node;
+            freeInner(inner);
+        }
+    }
+
+    LeafNode* leaf = static_cast<LeafNode*>(node);
+    unsigned pos = position(leaf, key);
+    if(pos == leaf->count || key < leaf->keys[pos]) {
+        return;
+    }
+    leaf->item(pos)->~value_type();
+    closeGap(leaf, pos);
+    --size_;
+    if(leaf == root_ && leaf->count == 0) {
+        freeLeaf(leaf);
+        root_ = NULL;
+        head_ = NULL;
+    }
+}
+
+/**
+* Removes every item. Node memory goes back to the pools a slab at a time.
+*/
+template<typename Key, typename Value>
+void BTree<Key, Value>::clear()
+{
+    if(!std::is_trivially_destructible<value_type>::value || !std::is_trivially_destructible<Key>::value) {
+        clearHelper(root_);
+    }
+    leafPool_.release();
+    innerPool_.release();
+    root_ = NULL;
+    head_ = NULL;
+    size_ = 0;
+}
+
+template<typename Key, typename Value>
+bool BTree<Key, Value>::empty() const
+{
+    return size_ == 0;
+}
+
+template<typename Key, typename Value>
+std::size_t BTree<Key, Value>::size() const
+{
+    return size_;
+}
+
+template<typename Key, typename Value>
+typename BTree<Key, Value>::iterator BTree<Key, Value>::begin() const
+{
+    return iterator(head_, 0);
+}
+
+template<typename Key, typename Value>
+typename BTree<Key, Value>::iterator BTree<Key, Value>::end() const
+{
+    return iterator(NULL, 0);
+}
+
+/**
+* Returns an iterator to the item with the given key, or end().
+*/
+template<typename Key, typename Value>
+typename BTree<Key, Value>::iterator BTree<Key, Value>::find(const Key& key) const
+{
+    if(root_ == NULL) {
+        return end();
+    }
+    NodeBase* node = root_;
+    while(!node->leaf) {
+        node = static_cast<InnerNode*>(node)->children[position(node, key)];
+    }
+    LeafNode* leaf = static_cast<LeafNode*>(node);
+    unsigned pos = position(leaf, key);
+    if(pos == leaf->count || key < leaf->keys[pos]) {
+        return end();
+    }
+    return iterator(leaf, pos);
+}
+
+/**
+* Returns the value for key, inserting a default constructed one first
+* if the key is missing.
+*/
+template<typename Key, typename Value>
+Value& BTree<Key, Value>::operator[](const Key& key)
+{
+    bool created;
+    return insertSlot(key, [&]() { return value_type(key, Value()); }, created)->second;
+}
+
+/**
+* Returns the value for key, throwing std::out_of_range if it is missing.
+*/
+template<typename Key, typename Value>
+Value const & BTree<Key, Value>::operator[](const Key& key) const
+{
+    iterator it = find(key);
+    if(it == end()) {
+        throw std::out_of_range("Invalid key");
+    }
+    return it->second;
+}
+
+/**
+* Pointer to the item slot at index (constructed or not).
+*/
+template<typename Key, typename Value>
+typename BTree<Key, Value>::value_type* BTree<Key, Value>::LeafNode::item(unsigned index)
+{
+    return reinterpret_cast<value_type*>(&items[index]);
+}
+
+/**
+* Index of the first key in node that is not less than key. In an inner
+* node that is also the child whose range covers key.
+*/
+template<typename Key, typename Value>
+unsigned BTree<Key, Value>::position(const NodeBase* node, const Key& key)
+{
+    return Search::countLess(node->keys, node->count, key);
+}
+
+/**
+* The fewest keys a non-root node may have.
+*/
+template<typename Key, typename Value>
+unsigned BTree<Key, Value>::minCount(const NodeBase* node)
+{
+    return node->leaf ? LEAF_MIN : INNER_MIN;
+}
+
+template<typename Key, typename Value>
+typename BTree<Key, Value>::LeafNode* BTree<Key, Value>::newLeaf()
+{
+    LeafNode* leaf = new (leafPool_.allocate()) LeafNode;
+    std::fill(leaf->keys, leaf->keys + MAX_KEYS, Search::filler());
+    leaf->count = 0;
+    leaf->leaf = true;
+    leaf->next = NULL;
+    return leaf;
+}
+
+template<typename Key, typename Value>
+typename BTree<Key, Value>::InnerNode* BTree<Key, Value>::newInner()
+{
+    InnerNode* inner = new (innerPool_.allocate()) InnerNode;
+    std::fill(inner->keys, inner->keys + MAX_KEYS, Search::filler());
+    inner->count = 0;
+    inner->leaf = false;
+    return inner;
+}
+
+/**
+* Frees an empty leaf (its items must already be destroyed or moved out).
+*/
+template<typename Key, typename Value>
+void BTree<Key, Value>::freeLeaf(LeafNode* leaf)
+{
+    leaf->~LeafNode();
+    leafPool_.deallocate(leaf);
+}
+
+template<typename Key, typename Value>
+void BTree<Key, Value>::freeInner(InnerNode* inner)
+{
+    inner->~InnerNode();
+    innerPool_.deallocate(inner);
+}
+
+/**
+* Moves the item (and key) at index i of one leaf into the empty slot j
+* of another. Counts are left to the caller.
+*/
+template<typename Key, typename Value>
+void BTree<Key, Value>::moveItem(LeafNode* from, unsigned i, LeafNode* to, unsigned j)
+{
+    new (to->item(j)) value_type(std::move(*from->item(i)));
+    from->item(i)->~value_type();
+    to->keys[j] = std::move(from->keys[i]);
+    from->keys[i] = Search::filler();
+}
+
+/**
+* Shifts the items from pos on one slot to the right, leaving slot pos
+* empty. The count is not changed.
+*/
+template<typename Key, typename Value>
+void BTree<Key, Value>::openGap(LeafNode* leaf, unsigned pos)
+{
+    for(unsigned i = leaf->count; i > pos; --i) {
+        moveItem(leaf, i - 1, leaf, i);
+    }
+}
+
+/**
+* Shifts the items after the (already empty) slot pos one to the left and
+* drops the count by one.
+*/
+template<typename Key, typename Value>
+void BTree<Key, Value>::closeGap(LeafNode* leaf, unsigned pos)
+{
+    for(unsigned i = pos + 1; i < leaf->count; ++i) {
+        moveItem(leaf, i, leaf, i - 1);
+    }
+    leaf->keys[leaf->count - 1] = Search::filler();
+    --leaf->count;
+}
+
+/**
+* Puts key at pos and child just right of it, shifting the rest along.
+*/
+template<typename Key, typename Value>
+void BTree<Key, Value>::insertChild(InnerNode* inner, unsigned pos, const Key& key, NodeBase* child)
+{
+    for(unsigned i = inner->count; i > pos; --i) {
+        inner->keys[i] = std::move(inner->keys[i - 1]);
+        inner->children[i + 1] = inner->children[i];
+    }
+    inner->keys[pos] = key;
+    inner->children[pos + 1] = child;
+    ++inner->count;
+}
+
+/**
+* Removes the key at pos together with the child right of it.
+*/
+template<typename Key, typename Value>
+void BTree<Key, Value>::eraseChild(InnerNode* inner, unsigned pos)
+{
+    for(unsigned i = pos + 1; i < inner->count; ++i) {
+        inner->keys[i - 1] = std::move(inner->keys[i]);
+        inner->children[i] = inner->children[i + 1];
+    }
+    --inner->count;
+    inner->keys[inner->count] = Search::filler();
+}
+
+/**
+* Splits the full child at index into two halves, and adds the largest
+* key of the left half to parent (which must not be full) as separator.
+*/
+template<typename Key, typename Value>
+void BTree<Key, Value>::splitChild(InnerNode* parent, unsigned index)
+{
+    const unsigned half = MAX_KEYS / 2;
+    NodeBase* child = parent->children[index];
+    NodeBase* right;
+    Key separator = child->keys[half - 1];
+
+    if(child->leaf) {
+        LeafNode* left = static_cast<LeafNode*>(child);
+        LeafNode* sibling = newLeaf();
+        for(unsigned i = half; i < MAX_KEYS; ++i) {
+            moveItem(left, i, sibling, i - half);
+        }
+        sibling->count = MAX_KEYS - half;
+        left->count = half;
+        sibling->next = left->next;
+        left->next = sibling;
+        right = sibling;
+    } else {
+        InnerNode* left = static_cast<InnerNode*>(child);
+        InnerNode* sibling = newInner();
+        for(unsigned i = half; i < MAX_KEYS; ++i) {
+            sibling->keys[i - half] = std::move(left->keys[i]);
+            left->keys[i] = Search::filler();
+            sibling->children[i - half] = left->children[i];
+        }
+        sibling->children[MAX_KEYS - half] = left->children[MAX_KEYS];
+        sibling->count = MAX_KEYS - half;
+        //the separator moves up instead of staying in the left half
+        left->keys[half - 1] = Search::filler();
+        left->count = half - 1;
+        right = sibling;
+    }
+    insertChild(parent, index, separator, right);
+}
+
+/**
+* Makes sure the child at index has more than the minimum number of keys
+* before removal descends into it, by borrowing one from a sibling or
+* merging with one. Returns the index the child's range is at afterwards.
+*/
+template<typename Key, typename Value>
+unsigned BTree<Key, Value>::fixChild(InnerNode* parent, unsigned index)
+{
+    NodeBase* child = parent->children[index];
+    NodeBase* left = index > 0 ? parent->children[index - 1] : NULL;
+    NodeBase* right = index < parent->count ? parent->children[index + 1] : NULL;
+
+    if(left != NULL && left->count > minCount(left)) {
+        if(child->leaf) {
+            LeafNode* to = static_cast<LeafNode*>(child);
+            LeafNode* from = static_cast<LeafNode*>(left);
+            openGap(to, 0);
+            moveItem(from, from->count - 1, to, 0);
+            ++to->count;
+            --from->count;
+            parent->keys[index - 1] = from->keys[from->count - 1];
+        } else {
+            InnerNode* to = static_cast<InnerNode*>(child);
+            InnerNode* from = static_cast<InnerNode*>(left);
+            to->children[to->count + 1] = to->children[to->count];
+            for(unsigned i = to->count; i > 0; --i) {
+                to->keys[i] = std::move(to->keys[i - 1]);
+                to->children[i] = to->children[i - 1];
+            }
+            to->keys[0] = std::move(parent->keys[index - 1]);
+            to->children[0] = from->children[from->count];
+            ++to->count;
+            parent->keys[index - 1] = std::move(from->keys[from->count - 1]);
+            --from->count;
+            from->keys[from->count] = Search::filler();
+        }
+        return index;
+    }
+
+    if(right != NULL && right->count > minCount(right)) {
+        if(child->leaf) {
+            LeafNode* to = static_cast<LeafNode*>(child);
+            LeafNode* from = static_cast<LeafNode*>(right);
+            moveItem(from, 0, to, to->count);
+            ++to->count;
+            closeGap(from, 0);
+            parent->keys[index] = to->keys[to->count - 1];
+        } else {
+            InnerNode* to = static_cast<InnerNode*>(child);
+            InnerNode* from = static_cast<InnerNode*>(right);
+            to->keys[to->count] = std::move(parent->keys[index]);
+            to->children[to->count + 1] = from->children[0];
+            ++to->count;
+            parent->keys[index] = std::move(from->keys[0]);
+            from->children[0] = from->children[1];
+            eraseChild(from, 0);
+        }
+        return index;
+    }
+
+    if(right != NULL) {
+        mergeChildren(parent, index);
+        return index;
+    }
+    mergeChildren(parent, index - 1);
+    return index - 1;
+}
+
+/**
+* Merges the child right of index into the child at index and drops the
+* separator between them from parent.
+*/
+template<typename Key, typename Value>
+void BTree<Key, Value>::mergeChildren(InnerNode* parent, unsigned index)
+{
+    NodeBase* child = parent->children[index];
+    NodeBase* sibling = parent->children[index + 1];
+    if(child->leaf) {
+        LeafNode* to = static_cast<LeafNode*>(child);
+        LeafNode* from = static_cast<LeafNode*>(sibling);
+        for(unsigned i = 0; i < from->count; ++i) {
+            moveItem(from, i, to, to->count + i);
+        }
+        to->count += from->count;
+        to->next = from->next;
+        freeLeaf(from);
+    } else {
+        InnerNode* to = static_cast<InnerNode*>(child);
+        InnerNode* from = static_cast<InnerNode*>(sibling);
+        to->keys[to->count] = parent->keys[index];
+        for(unsigned i = 0; i < from->count; ++i) {
+            to->keys[to->count + 1 + i] = std::move(from->keys[i]);
+        }
+        for(unsigned i = 0; i <= from->count; ++i) {
+            to->children[to->count + 1 + i] = from->children[i];
+        }
+        to->count += 1 + from->count;
+        freeInner(from);
+    }
+    eraseChild(parent, index);
+}
+
+/**
+* Finds the item for key, or makes room for it and constructs it from
+* build() (created tells which happened). Full nodes are split on the way
+* down, so the leaf always has room.
+*/
+template<typename Key, typename Value>
+template<typename Build>
+typename BTree<Key, Value>::iterator BTree<Key, Value>::insertSlot(const Key& key, Build build, bool& created)
+{
+    if(root_ == NULL) {
+        root_ = head_ = newLeaf();
+    }
+    if(root_->count == MAX_KEYS) {
+        InnerNode* top = newInner();
+        top->children[0] = root_;
+        root_ = top;
+        splitChild(top, 0);
+    }
+
+    NodeBase* node = root_;
+    while(!node->leaf) {
+        InnerNode* inner = static_cast<InnerNode*>(node);
+        unsigned index = position(inner, key);
+        if(inner->children[index]->count == MAX_KEYS) {
+            splitChild(inner, index);
+            if(inner->keys[index] < key) {
+                ++index;
+            }
+        }
+        node = inner->children[index];
+    }
+
+    LeafNode* leaf = static_cast<LeafNode*>(node);
+    unsigned pos = position(leaf, key);
+    if(pos < leaf->count && !(key < leaf->keys[pos])) {
+        created = false;
+        return iterator(leaf, pos);
+    }
+    openGap(leaf, pos);
+    try {
+        new (leaf->item(pos)) value_type(build());
+    } catch(...) {
+        ++leaf->count;
+        closeGap(leaf, pos);
+        throw;
+    }
+    leaf->keys[pos] = key;
+    ++leaf->count;
+    ++size_;
+    created = true;
+    return iterator(leaf, pos);
+}
+
+/**
+* Runs the destructors of every item and node (the memory itself is
+* released by clear()).
+*/
+template<typename Key, typename Value>
+void BTree<Key, Value>::clearHelper(NodeBase* node)
+{
+    if(node == NULL) {
+        return;
+    }
+    if(node->leaf) {
+        LeafNode* leaf = static_cast<LeafNode*>(node);
+        for(unsigned i = 0; i < leaf->count; ++i) {
+            leaf->item(i)->~value_type();
+        }
+        leaf->~LeafNode();
+    } else {
+        InnerNode* inner = static_cast<InnerNode*>(node);
+        for(unsigned i = 0; i <= inner->count; ++i) {
+            clearHelper(inner->children[i]);
+        }
+        inner->~InnerNode();
+    }
+}
+
+/*
+  -----------------------------------------
+  End implementations for the BTree class.
+  -----------------------------------------
+*/
+
+#endif
@@ -0,0 +1,1237 @@
+#ifndef CONCURRENTAVL_H
+#define CONCURRENTAVL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <memory>
+#include <utility>
+#include <algorithm>
+#include <functional>
+#include <type_traits>
+
+/**
+* A test-and-test-and-set lock small enough to put in every tree node.
+* It is only ever held for a handful of pointer updates.
+*/
+class SpinLock
+{
+public:
+    SpinLock() : locked_(false) {}
+
+    void lock()
+    {
+        while(locked_.exchange(true, std::memory_order_acquire)) {
+            for(int spins = 0; locked_.load(std::memory_order_relaxed); ++spins) {
+                if(spins > 64) {
+                    std::this_thread::yield();
+                }
+            }
+        }
+    }
+
+    void unlock()
+    {
+        locked_.store(false, std::memory_order_release);
+    }
+
+private:
+    std::atomic<bool> locked_;
+};
+
+/**
+* Epoch-based reclamation for objects that other threads may still be
+* reading after they were unlinked. Every operation runs inside a Guard,
+* which registers the thread with the current epoch (on one of a few
+* slots picked by thread, so readers do not all write one cache line).
+* retire() queues an object on the thread's slot as well. Once a slot
+* has enough queued, reclaimIfNeeded() collects every slot's queue,
+* moves the epoch on, waits for the guards of the earlier epochs to
+* finish and then frees the batch, since no guard that started after an
+* object was unlinked can reach it.
+*/
+class EpochReclaimer
+{
+public:
+    EpochReclaimer();
+    ~EpochReclaimer();
+
+    class Guard
+    {
+    public:
+        explicit Guard(EpochReclaimer& reclaimer);
+        ~Guard();
+
+    private:
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+        EpochReclaimer& reclaimer_;
+        std::atomic<long>* counter_;
+    };
+
+    void retire(void* object, void (*destroy)(void*));
+    void reclaimIfNeeded();
+
+private:
+    EpochReclaimer(const EpochReclaimer&) = delete;
+    EpochReclaimer& operator=(const EpochReclaimer&) = delete;
+
+    struct Retired
+    {
+        void* object;
+        void (*destroy)(void*);
+    };
+
+    // Two guard counters (one per epoch parity) and the objects retired
+    // by the threads sharing the slot.
+    struct SlotData
+    {
+        std::atomic<long> active[2];
+        SpinLock retireLock;
+        std::atomic<std::size_t> retiredCount;
+        std::vector<Retired> retired;
+    };
+
+    // Padded out to a cache line.
+    struct Slot : SlotData
+    {
+        char padding[64 - sizeof(SlotData) % 64];
+    };
+
+    static const std::size_t SLOTS = 32;
+    static const std::size_t RECLAIM_BATCH = 2048;
+
+    Slot& mySlot();
+    void waitForReaders(unsigned parity);
+    static void destroyAll(std::vector<Retired>& batch);
+
+    Slot slots_[SLOTS];
+    std::atomic<unsigned> epoch_;
+    std::mutex reclaimLock_;
+};
+
+/*
+  ---------------------------------------------------
+  Begin implementations for the EpochReclaimer class.
+  ---------------------------------------------------
+*/
+
+inline EpochReclaimer::EpochReclaimer() :
+    epoch_(0)
+{
+    for(std::size_t i = 0; i < SLOTS; ++i) {
+        slots_[i].active[0].store(0);
+        slots_[i].active[1].store(0);
+        slots_[i].retiredCount.store(0);
+    }
+}
+
+/**
+* Frees everything still queued. No guards may be active any more.
+*/
+inline EpochReclaimer::~EpochReclaimer()
+{
+    for(std::size_t i = 0; i < SLOTS; ++i) {
+        destroyAll(slots_[i].retired);
+    }
+}
+
+/**
+* Enters the current epoch. If the epoch moves on between reading it and
+* registering, the registration might not have been seen, so try again.
+*/
+inline EpochReclaimer::Guard::Guard(EpochReclaimer& reclaimer) :
+    reclaimer_(reclaimer)
+{
+    Slot& slot = reclaimer_.mySlot();
+    for(;;) {
+        unsigned epoch = reclaimer_.epoch_.load();
+        counter_ = &slot.active[epoch & 1];
+        counter_->fetch_add(1);
+        if(reclaimer_.epoch_.load() == epoch) {
+            return;
+        }
+        counter_->fetch_sub(1);
+    }
+}
+
+inline EpochReclaimer::Guard::~Guard()
+{
+    counter_->fetch_sub(1, std::memory_order_release);
+}
+
+/**
+* Queues an object (already unreachable for new guards) to be destroyed.
+* The slot's lock is only contended by threads hashed to the same slot
+* and, once per batch, by the reclaiming thread.
+*/
+inline void EpochReclaimer::retire(void* object, void (*destroy)(void*))
+{
+    Retired retired = { object, destroy };
+    Slot& slot = mySlot();
+    std::lock_guard<SpinLock> lock(slot.retireLock);
+    slot.retired.push_back(retired);
+    slot.retiredCount.store(slot.retired.size(), std::memory_order_relaxed);
+}
+
+/**
+* Frees the retired objects of all slots if enough have piled up on the
+* calling thread's. Must be called outside any Guard (it waits for
+* guards to finish). Only one thread reclaims at a time; the others just
+* carry on.
+*/
+inline void EpochReclaimer::reclaimIfNeeded()
+{
+    if(mySlot().retiredCount.load(std::memory_order_relaxed) < RECLAIM_BATCH) {
+        return;
+    }
+    std::unique_lock<std::mutex> reclaiming(reclaimLock_, std::try_to_lock);
+    if(!reclaiming.owns_lock()) {
+        return;
+    }
+    unsigned epoch = epoch_.load();
+    //guards from the epoch before this one use the counters we are about to reuse
+    waitForReaders((epoch + 1) & 1);
+    std::vector<Retired> batch;
+    for(std::size_t i = 0; i < SLOTS; ++i) {
+        std::lock_guard<SpinLock> lock(slots_[i].retireLock);
+        batch.insert(batch.end(), slots_[i].retired.begin(), slots_[i].retired.end());
+        slots_[i].retired.clear();
+        slots_[i].retiredCount.store(0, std::memory_order_relaxed);
+    }
+    epoch_.store(epoch + 1);
+    waitForReaders(epoch & 1);
+    destroyAll(batch);
+}
+
+inline EpochReclaimer::Slot& EpochReclaimer::mySlot()
+{
+    static thread_local std::size_t index = std::hash<std::thread::id>()(std::this_thread::get_id()) % SLOTS;
+    return slots_[index];
+}
+
+inline void EpochReclaimer::waitForReaders(unsigned parity)
+{
+    for(std::size_t i = 0; i < SLOTS; ++i) {
+        while(slots_[i].active[parity].load(std::memory_order_acquire) != 0) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+inline void EpochReclaimer::destroyAll(std::vector<Retired>& batch)
+{
+    for(std::size_t i = 0; i < batch.size(); ++i) {
+        batch[i].destroy(batch[i].object);
+    }
+    batch.clear();
+}
+
+/*
+  -------------------------------------------------
+  End implementations for the EpochReclaimer class.
+  -------------------------------------------------
+*/
+
+/**
+* A node of a ConcurrentAVLTree. Everything but the key can change while
+* other threads read it, so the links, height, value and version are
+* atomics; changes are made with the node's lock held. The value lives
+* in its own immutable box that is swapped out as a whole; a node with
+* no value is a routing node, left behind by remove() when the node
+* still had two children.
+*
+* The version tells optimistic readers whether the subtree they are
+* searching may have lost nodes under them: a node is marked SHRINKING
+* while it is rotated down, the count goes up when that is finished, and
+* UNLINKED marks a node that has left the tree.
+*/
+template <typename Key, typename Value>
+struct ConcurrentAVLNode
+{
+    struct ValueBox
+    {
+        explicit ValueBox(const Value& v) : value(v) {}
+        Value value;
+    };
+
+    static const uint64_t UNLINKED = 1;
+    static const uint64_t SHRINKING = 2;
+    static const uint64_t CHANGE_COUNT = 4;
+
+    ConcurrentAVLNode();
+    ConcurrentAVLNode(const Key& key, ValueBox* value, ConcurrentAVLNode<Key, Value>* parent);
+    ~ConcurrentAVLNode();
+
+    const Key& key() const;
+    std::atomic<ConcurrentAVLNode<Key, Value>*>& child(int dir);
+    static int height(const ConcurrentAVLNode<Key, Value>* node);
+
+    typename std::aligned_storage<sizeof(Key), alignof(Key)>::type keyStorage;
+    bool hasKey;    // false only for the tree's root holder
+    std::atomic<int> nodeHeight;
+    std::atomic<uint64_t> version;
+    std::atomic<ValueBox*> value;
+    std::atomic<ConcurrentAVLNode<Key, Value>*> parent;
+    std::atomic<ConcurrentAVLNode<Key, Value>*> left;
+    std::atomic<ConcurrentAVLNode<Key, Value>*> right;
+    SpinLock lock;
+};
+
+/*
+  ------------------------------------------------------
+  Begin implementations for the ConcurrentAVLNode class.
+  ------------------------------------------------------
+*/
+
+/**
+* The root holder: no key, and the real root hangs off its right link.
+*/
+template<typename Key, typename Value>
+ConcurrentAVLNode<Key, Value>::ConcurrentAVLNode() :
+    hasKey(false),
+    nodeHeight(0),
+    version(0),
+    value(nullptr),
+    parent(nullptr),
+    left(nullptr),
+    right(nullptr)
+{
+
+}
+
+template<typename Key, typename Value>
+ConcurrentAVLNode<Key, Value>::ConcurrentAVLNode(const Key& key, ValueBox* value, ConcurrentAVLNode<Key, Value>* parent) :
+    hasKey(true),
+    nodeHeight(1),
+    version(0),
+    value(value),
+    parent(parent),
+    left(nullptr),
+    right(nullptr)
+{
+    new (&keyStorage) Key(key);
+}
+
+/**
+* Destroys the key only; the value box is owned by whoever unlinks it.
+*/
+template<typename Key, typename Value>
+ConcurrentAVLNode<Key, Value>::~ConcurrentAVLNode()
+{
+    if(hasKey) {
+        reinterpret_cast<Key*>(&keyStorage)->~Key();
+    }
+}
+
+template<typename Key, typename Value>
+const Key& ConcurrentAVLNode<Key, Value>::key() const
+{
+    return *reinterpret_cast<const Key*>(&keyStorage);
+}
+
+/**
+* The left link for a negative direction, the right link otherwise.
+*/
+template<typename Key, typename Value>
+std::atomic<ConcurrentAVLNode<Key, Value>*>& ConcurrentAVLNode<Key, Value>::child(int dir)
+{
+    return dir < 0 ? left : right;
+}
+
+template<typename Key, typename Value>
+int ConcurrentAVLNode<Key, Value>::height(const ConcurrentAVLNode<Key, Value>* node)
+{
+    return node == nullptr ? 0 : node->nodeHeight.load();
+}
+
+/*
+  ----------------------------------------------------
+  End implementations for the ConcurrentAVLNode class.
+  ----------------------------------------------------
+*/
+
+/**
+* An AVL map that many threads can search and update at once, after
+* Bronson, Casper, Chafi and Olukotun, "A Practical Concurrent Binary
+* Search Tree" (PPoPP 2010).
+*
+* find() takes no locks. It walks down reading each node's version
+* before and after following a link, and retries from the parent if a
+* rotation or unlink changed that part of the tree in between.
+*
+* insert() and remove() search the same way. Then they lock only the node
+* they change, plus its parent if a node is unlinked. Removing a node
+* with two children just clears its value and leaves it as a routing
+* node. Heights are repaired afterwards, one node at a time, walking up.
+* Each rotation locks just the parent, the node and the child (and
+* grandchild) it moves, while it relinks them. The tree is therefore
+* only approximately balanced while updates are in flight, and it
+* settles once they finish.
+*
+* Unlinked nodes and replaced values are freed through an
+* EpochReclaimer, once no reader can still be looking at them.
+*/
+template <typename Key, typename Value>
+class ConcurrentAVLTree
+{
+public:
+    ConcurrentAVLTree();
+    ~ConcurrentAVLTree();
+
+    bool find(const Key& key, Value& value) const;
+    bool contains(const Key& key) const;
+    bool insert(const std::pair<const Key, Value>& keyValuePair);
+    bool remove(const Key& key);
+    std::size_t size() const;
+    bool empty() const;
+
+protected:
+    ConcurrentAVLTree(const ConcurrentAVLTree<Key, Value>&) = delete;
+    ConcurrentAVLTree<Key, Value>& operator=(const ConcurrentAVLTree<Key, Value>&) = delete;
+
+    typedef ConcurrentAVLNode<Key, Value> Node;
+    typedef typename Node::ValueBox ValueBox;
+
+    // Outcomes of the optimistic attempts.
+    enum { RETRY, ABSENT, PRESENT };
+    // nodeCondition() results that are not a new height.
+    enum { UNLINK_REQUIRED = -1, REBALANCE_REQUIRED = -2, NOTHING_REQUIRED = -3 };
+
+    static int compare(const Key& a, const Key& b);
+    static void waitUntilNotChanging(Node* node);
+
+    int attemptGet(const Key& key, Node* node, int dir, uint64_t nodeVersion, Value* value) const;
+    int update(const Key& key, ValueBox* newValue);
+    bool attemptInsertIntoEmpty(const Key& key, ValueBox* newValue);
+    int attemptUpdate(const Key& key, ValueBox* newValue, Node* parent, Node* node, uint64_t nodeVersion);
+    int attemptNodeUpdate(ValueBox* newValue, Node* parent, Node* node);
+    bool attemptUnlink(Node* parent, Node* node);
+
+    static int nodeCondition(Node* node);
+    void fixHeightAndRebalance(Node* node);
+    Node* fixHeight(Node* node);
+    Node* rebalance(Node* parent, Node* node);
+    Node* rebalanceToRight(Node* parent, Node* node, Node* left, int rightHeight);
+    Node* rebalanceToLeft(Node* parent, Node* node, Node* right, int leftHeight);
+    Node* rotateRight(Node* parent, Node* node, Node* left, int hR, int hLL, Node* leftRight, int hLR);
+    Node* rotateLeft(Node* parent, Node* node, int hL, Node* right, Node* rightLeft, int hRL, int hRR);
+    Node* rotateRightOverLeft(Node* parent, Node* node, Node* left, int hR, int hLL, Node* leftRight, int hLRL);
+    Node* rotateLeftOverRight(Node* parent, Node* node, int hL, Node* right, Node* rightLeft, int hRR, int hRLR);
+
+    void retire(Node* node);
+    void retire(ValueBox* value);
+    static void destroySubtree(Node* node);
+
+    Node holder_;
+    std::atomic<long> size_;
+    mutable EpochReclaimer reclaimer_;
+};
+
+/*
+  ------------------------------------------------------
+  Begin implementations for the ConcurrentAVLTree class.
+  ------------------------------------------------------
+*/
+
+template<typename Key, typename Value>
+ConcurrentAVLTree<Key, Value>::ConcurrentAVLTree() :
+    size_(0)
+{
+
+}
+
+/**
+* Frees every node. No other thread may be using the tree any more.
+*/
+template<typename Key, typename Value>
+ConcurrentAVLTree<Key, Value>::~ConcurrentAVLTree()
+{
+    destroySubtree(holder_.right.load());
+}
+
+/**
+* Copies the value for key into value and returns true, or returns
+* false if the key is not in the tree. Never blocks on writers except
+* for briefly waiting out a rotation of a node it is about to pass.
+*/
+template<typename Key, typename Value>
+bool ConcurrentAVLTree<Key, Value>::find(const Key& key, Value& value) const
+{
+    int result;
+    {
+        EpochReclaimer::Guard guard(reclaimer_);
+        result = attemptGet(key, const_cast<Node*>(&holder_), 1, 0, &value);
+    }
+    return result == PRESENT;
+}
+
+template<typename Key, typename Value>
+bool ConcurrentAVLTree<Key, Value>::contains(const Key& key) const
+{
+    int result;
+    {
+        EpochReclaimer::Guard guard(reclaimer_);
+        result = attemptGet(key, const_cast<Node*>(&holder_), 1, 0, nullptr);
+    }
+    return result == PRESENT;
+}
+
+/**
+* Inserts the pair, or replaces the value if the key is already there.
+* Returns true if the key was new.
+*/
+template<typename Key, typename Value>
+bool ConcurrentAVLTree<Key, Value>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    std::unique_ptr<ValueBox> box(new ValueBox(keyValuePair.second));
+    int result;
+    {
+        EpochReclaimer::Guard guard(reclaimer_);
+        result = update(keyValuePair.first, box.get());
+    }
+    box.release();
+    reclaimer_.reclaimIfNeeded();
+    if(result == ABSENT) {
+        size_.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+    return false;
+}
+
+/**
+* Removes the item with the given key. Returns false if it was not there.
+*/
+template<typename Key, typename Value>
+bool ConcurrentAVLTree<Key, Value>::remove(const Key& key)
+{
+    int result;
+    {
+        EpochReclaimer::Guard guard(reclaimer_);
+        result = update(key, nullptr);
+    }
+    reclaimer_.reclaimIfNeeded();
+    if(result == PRESENT) {
+        size_.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+    return false;
+}
+
+/**
+* The number of items; only exact while no updates are running.
+*/
+template<typename Key, typename Value>
+std::size_t ConcurrentAVLTree<Key, Value>::size() const
+{
+    long size = size_.load(std::memory_order_relaxed);
+    return size < 0 ? 0 : static_cast<std::size_t>(size);
+}
+
+template<typename Key, typename Value>
+bool ConcurrentAVLTree<Key, Value>::empty() const
+{
+    return size() == 0;
+}
+
+/**
+* -1, 0 or 1 depending on how a compares to b, using only operator<.
+*/
+template<typename Key, typename Value>
+int ConcurrentAVLTree<Key, Value>::compare(const Key& a, const Key& b)
+{
+    if(a < b) {
+        return -1;
+    }
+    return b < a ? 1 : 0;
+}
+
+/**
+* Waits for a rotation of node to finish: spin for a short while, then
+* wait for the rotating thread's lock.
+*/
+template<typename Key, typename Value>
+void ConcurrentAVLTree<Key, Value>::waitUntilNotChanging(Node* node)
+{
+    uint64_t version = node->version.load();
+    if((version & Node::SHRINKING) == 0) {
+        return;
+    }
+    for(int spins = 0; spins < 100; ++spins) {
+        if(node->version.load() != version) {
+            return;
+        }
+    }
+    node->lock.lock();
+    node->lock.unlock();
+}
+
+/**
+* Searches the subtree in direction dir below node, where node had
+* nodeVersion when we arrived. Returns RETRY if node has changed since,
+* in which case the caller has to check its own node and try again.
+*/
+template<typename Key, typename Value>
+int ConcurrentAVLTree<Key, Value>::attemptGet(const Key& key, Node* node, int dir, uint64_t nodeVersion, Value* value) const
+{
+    for(;;) {
+        Node* child = node->child(dir).load();
+        if(node->version.load() != nodeVersion) {
+            return RETRY;
+        }
+        if(child == nullptr) {
+            return ABSENT;
+        }
+        int next = compare(key, child->key());
+        if(next == 0) {
+            ValueBox* box = child->value.load();
+            if(box == nullptr) {
+                return ABSENT;
+            }
+            if(value != nullptr) {
+                *value = box->value;
+            }
+            return PRESENT;
+        }
+        uint64_t childVersion = child->version.load();
+        if(childVersion & Node::SHRINKING) {
+            waitUntilNotChanging(child);
+        } else if((childVersion & Node::UNLINKED) == 0 && child == node->child(dir).load()) {
+            if(node->version.load() != nodeVersion) {
+                return RETRY;
+            }
+            int result = attemptGet(key, child, next, childVersion, value);
+            if(result != RETRY) {
+                return result;
+            }
+        }
+    }
+}
+
+/**
+* Shared by insert (newValue set) and remove (newValue null). Returns
+* whether the key was PRESENT or ABSENT before.
+*/
+template<typename Key, typename Value>
+int ConcurrentAVLTree<Key, Value>::update(const Key& key, ValueBox* newValue)
+{
+    for(;;) {
+        Node* root = holder_.right.load();
+        if(root == nullptr) {
+            if(newValue == nullptr || attemptInsertIntoEmpty(key, newValue)) {
+                return ABSENT;
+            }
+        } else {
+            uint64_t rootVersion = root->version.load();
+            if(rootVersion & (Node::SHRINKING | Node::UNLINKED)) {
+                waitUntilNotChanging(root);
+            } else if(root == holder_.right.load()) {
+                int result = attemptUpdate(key, newValue, &holder_, root, rootVersion);
+                if(result != RETRY) {
+                    return result;
+                }
+            }
+        }
+    }
+}
+
+template<typename Key, typename Value>
+bool ConcurrentAVLTree<Key, Value>::attemptInsertIntoEmpty(const Key& key, ValueBox* newValue)
+{
+    std::lock_guard<SpinLock> lock(holder_.lock);
+    if(holder_.right.load() != nullptr) {
+        return false;
+    }
+    holder_.right.store(new Node(key, newValue, &holder_));
+    holder_.nodeHeight.store(2);
+    return true;
+}
+
+/**
+* Continues the update below node (reached from parent with nodeVersion).
+* A new key is linked in as a leaf with only node locked.
+*/
+template<typename Key, typename Value>
+int ConcurrentAVLTree<Key, Value>::attemptUpdate(const Key& key, ValueBox* newValue, Node* parent, Node* node, uint64_t nodeVersion)
+{
+    int dir = compare(key, node->key());
+    if(dir == 0) {
+        return attemptNodeUpdate(newValue, parent, node);
+    }
+    for(;;) {
+        Node* child = node->child(dir).load();
+        if(node->version.load() != nodeVersion) {
+            return RETRY;
+        }
+        if(child == nullptr) {
+            if(newValue == nullptr) {
+                return ABSENT;
+            }
+            Node* damaged = nullptr;
+            bool linked = false;
+            {
+                std::lock_guard<SpinLock> lock(node->lock);
+                if(node->version.load() != nodeVersion) {
+                    return RETRY;
+                }
+                //otherwise someone else linked a child here first, look again
+                if(node->child(dir).load() == nullptr) {
+                    node->child(dir).store(new Node(key, newValue, node));
+                    damaged = fixHeight(node);
+                    linked = true;
+                }
+            }
+            if(linked) {
+                fixHeightAndRebalance(damaged);
+                return ABSENT;
+            }
+        } else {
+            uint64_t childVersion = child->version.load();
+            if(childVersion & (Node::SHRINKING | Node::UNLINKED)) {
+                waitUntilNotChanging(child);
+            } else if(child == node->child(dir).load()) {
+                if(node->version.load() != nodeVersion) {
+                    return RETRY;
+                }
+                int result = attemptUpdate(key, newValue, node, child, childVersion);
+                if(result != RETRY) {
+                    return result;
+                }
+            }
+        }
+    }
+}
+
+/**
+* Updates the node holding the key. Removing a node with at most one
+* child unlinks it (locking parent, then node); anything else only swaps
+* the value box under the node's lock.
+*/
+template<typename Key, typename Value>
+int ConcurrentAVLTree<Key, Value>::attemptNodeUpdate(ValueBox* newValue, Node* parent, Node* node)
+{
+    if(newValue == nullptr) {
+        if(node->value.load() == nullptr) {
+            return ABSENT;
+        }
+        if(node->left.load() == nullptr || node->right.load() == nullptr) {
+            Node* damaged;
+            ValueBox* previous;
+            {
+                std::lock_guard<SpinLock> parentLock(parent->lock);
+                if((parent->version.load() & Node::UNLINKED) || node->parent.load() != parent) {
+                    return RETRY;
+                }
+                {
+                    std::lock_guard<SpinLock> nodeLock(node->lock);
+                    previous = node->value.load();
+                    if(previous == nullptr) {
+                        return ABSENT;
+                    }
+                    if(!attemptUnlink(parent, node)) {
+                        return RETRY;
+                    }
+                }
+                damaged = fixHeight(parent);
+            }
+            retire(previous);
+            retire(node);
+            fixHeightAndRebalance(damaged);
+            return PRESENT;
+        }
+    }
+
+    ValueBox* previous;
+    {
+        std::lock_guard<SpinLock> lock(node->lock);
+        if(node->version.load() & Node::UNLINKED) {
+            return RETRY;
+        }
+        //the node may have lost a child since, then it has to be unlinked
+        if(newValue == nullptr && (node->left.load() == nullptr || node->right.load() == nullptr)) {
+            return RETRY;
+        }
+        previous = node->value.load();
+        node->value.store(newValue);
+    }
+    if(previous == nullptr) {
+        return ABSENT;
+    }
+    retire(previous);
+    return PRESENT;
+}
+
+/**
+* Splices node (locked, like parent) out of the tree if it still is a
+* child of parent and has at most one child.
+*/
+template<typename Key, typename Value>
+bool ConcurrentAVLTree<Key, Value>::attemptUnlink(Node* parent, Node* node)
+{
+    Node* parentLeft = parent->left.load();
+    Node* parentRight = parent->right.load();
+    if(parentLeft != node && parentRight != node) {
+        return false;
+    }
+    Node* left = node->left.load();
+    Node* right = node->right.load();
+    if(left != nullptr && right != nullptr) {
+        return false;
+    }
+    Node* splice = left != nullptr ? left : right;
+    if(parentLeft == node) {
+        parent->left.store(splice);
+    } else {
+        parent->right.store(splice);
+    }
+    if(splice != nullptr) {
+        splice->parent.store(parent);
+    }
+    node->version.store(Node::UNLINKED);
+    node->value.store(nullptr);
+    return true;
+}
+
+/**
+* What node needs: to be unlinked (a routing node with at most one
+* child), a rotation, a new height (returned), or nothing. Read without
+* locks, so it may be stale; the fixes recheck under the locks.
+*/
+template<typename Key, typename Value>
+int ConcurrentAVLTree<Key, Value>::nodeCondition(Node* node)
+{
+    Node* left = node->left.load();
+    Node* right = node->right.load();
+    if((left == nullptr || right == nullptr) && node->value.load() == nullptr) {
+        return UNLINK_REQUIRED;
+    }
+    int height = node->nodeHeight.load();
+    int leftHeight = Node::height(left);
+    int rightHeight = Node::height(right);
+    int newHeight = 1 + std::max(leftHeight, rightHeight);
+    int balance = leftHeight - rightHeight;
+    if(balance < -1 || balance > 1) {
+        return REBALANCE_REQUIRED;
+    }
+    return height != newHeight ? newHeight : NOTHING_REQUIRED;
+}
+
+/**
+* Walks up from a damaged node, fixing one node at a time: a height
+* under the node's lock, a rotation or unlink under the parent's and
+* node's locks. Stops as soon as a node needs nothing, unless something
+* was rotated on the way: a rotation below can leave an ancestor out of
+* balance without changing any height in between, so then the walk
+* checks every ancestor up to the root.
+*/
+template<typename Key, typename Value>
+void ConcurrentAVLTree<Key, Value>::fixHeightAndRebalance(Node* node)
+{
+    bool restructured = false;
+    while(node != nullptr && node->parent.load() != nullptr) {
+        if(node->version.load() & Node::UNLINKED) {
+            return;
+        }
+        int condition = nodeCondition(node);
+        Node* next = nullptr;
+        if(condition == UNLINK_REQUIRED || condition == REBALANCE_REQUIRED) {
+            Node* parent = node->parent.load();
+            std::lock_guard<SpinLock> parentLock(parent->lock);
+            if((parent->version.load() & Node::UNLINKED) == 0 && node->parent.load() == parent) {
+                std::lock_guard<SpinLock> nodeLock(node->lock);
+                next = rebalance(parent, node);
+                restructured = true;
+            } else {
+                next = node;
+            }
+        } else if(condition != NOTHING_REQUIRED) {
+            std::lock_guard<SpinLock> lock(node->lock);
+            next = fixHeight(node);
+        }
+        if(next == nullptr) {
+            if(!restructured) {
+                return;
+            }
+            next = node->parent.load();
+        }
+        node = next;
+    }
+}
+
+/**
+* Fixes the height of a locked node if that is all it needs. Returns
+* the next node to look at: the parent if the height changed, node
+* itself if it needs more than a height fix, null if nothing.
+*/
+template<typename Key, typename Value>
+typename ConcurrentAVLTree<Key, Value>::Node* ConcurrentAVLTree<Key, Value>::fixHeight(Node* node)
+{
+    int condition = nodeCondition(node);
+    switch(condition) {
+    case REBALANCE_REQUIRED:
+    case UNLINK_REQUIRED:
+        return node;
+    case NOTHING_REQUIRED:
+        return nullptr;
+    default:
+        node->nodeHeight.store(condition);
+        return node->parent.load();
+    }
+}
+
+/**
+* With parent and node locked: unlinks node if it is a routing node with
+* at most one child, or rotates it if it is out of balance.
+*/
+template<typename Key, typename Value>
+typename ConcurrentAVLTree<Key, Value>::Node* ConcurrentAVLTree<Key, Value>::rebalance(Node* parent, Node* node)
+{
+    Node* left = node->left.load();
+    Node* right = node->right.load();
+    if((left == nullptr || right == nullptr) && node->value.load() == nullptr) {
+        if(attemptUnlink(parent, node)) {
+            retire(node);
+            return fixHeight(parent);
+        }
+        return node;
+    }
+    int height = node->nodeHeight.load();
+    int leftHeight = Node::height(left);
+    int rightHeight = Node::height(right);
+    int newHeight = 1 + std::max(leftHeight, rightHeight);
+    int balance = leftHeight - rightHeight;
+    if(balance > 1) {
+        return rebalanceToRight(parent, node, left, rightHeight);
+    }
+    if(balance < -1) {
+        return rebalanceToLeft(parent, node, right, leftHeight);
+    }
+    if(newHeight != height) {
+        node->nodeHeight.store(newHeight);
+        return fixHeight(parent);
+    }
+    return nullptr;
+}
+
+/**
+* node's left side is too tall: rotate right, or left-right if the
+* left child leans right. Locks the left child (and its right child).
+*/
+template<typename Key, typename Value>
+typename ConcurrentAVLTree<Key, Value>::Node*
+ConcurrentAVLTree<Key, Value>::rebalanceToRight(Node* parent, Node* node, Node* left, int rightHeight)
+{
+    std::lock_guard<SpinLock> leftLock(left->lock);
+    int leftHeight = left->nodeHeight.load();
+    if(leftHeight - rightHeight <= 1) {
+        return node;
+    }
+    Node* leftRight = left->right.load();
+    int hLL = Node::height(left->left.load());
+    int hLR = Node::height(leftRight);
+    if(hLL >= hLR) {
+        return rotateRight(parent, node, left, rightHeight, hLL, leftRight, hLR);
+    }
+    {
+        std::lock_guard<SpinLock> leftRightLock(leftRight->lock);
+        hLR = leftRight->nodeHeight.load();
+        if(hLL >= hLR) {
+            return rotateRight(parent, node, left, rightHeight, hLL, leftRight, hLR);
+        }
+        int hLRL = Node::height(leftRight->left.load());
+        int balance = hLL - hLRL;
+        if(balance >= -1 && balance <= 1) {
+            return rotateRightOverLeft(parent, node, left, rightHeight, hLL, leftRight, hLRL);
+        }
+    }
+    //fix the left child on its own first, node gets another look later
+    return rebalanceToLeft(node, left, leftRight, hLL);
+}
+
+/**
+* Mirror image of rebalanceToRight.
+*/
+template<typename Key, typename Value>
+typename ConcurrentAVLTree<Key, Value>::Node*
+ConcurrentAVLTree<Key, Value>::rebalanceToLeft(Node* parent, Node* node, Node* right, int leftHeight)
+{
+    std::lock_guard<SpinLock> rightLock(right->lock);
+    int rightHeight = right->nodeHeight.load();
+    if(leftHeight - rightHeight >= -1) {
+        return node;
+    }
+    Node* rightLeft = right->left.load();
+    int hRL = Node::height(rightLeft);
+    int hRR = Node::height(right->right.load());
+    if(hRR >= hRL) {
+        return rotateLeft(parent, node, leftHeight, right, rightLeft, hRL, hRR);
+    }
+    {
+        std::lock_guard<SpinLock> rightLeftLock(rightLeft->lock);
+        hRL = rightLeft->nodeHeight.load();
+        if(hRR >= hRL) {
+            return rotateLeft(parent, node, leftHeight, right, rightLeft, hRL, hRR);
+        }
+        int hRLR = Node::height(rightLeft->right.load());
+        int balance = hRR - hRLR;
+        if(balance >= -1 && balance <= 1) {
+            return rotateLeftOverRight(parent, node, leftHeight, right, rightLeft, hRR, hRLR);
+        }
+    }
+    return rebalanceToRight(node, right, rightLeft, hRR);
+}
+
+/**
+* Right rotation of node (parent, node and left locked). node shrinks,
+* so it is marked while the links change. Returns the next node that
+* needs attention, fixing the parent's height if it can.
+*/
+template<typename Key, typename Value>
+typename ConcurrentAVLTree<Key, Value>::Node*
+ConcurrentAVLTree<Key, Value>::rotateRight(Node* parent, Node* node, Node* left, int hR, int hLL, Node* leftRight, int hLR)
+{
+    uint64_t nodeVersion = node->version.load();
+    Node* parentLeft = parent->left.load();
+    node->version.store(nodeVersion | Node::SHRINKING);
+
+    node->left.store(leftRight);
+    if(leftRight != nullptr) {
+        leftRight->parent.store(node);
+    }
+    left->right.store(node);
+    node->parent.store(left);
+    if(parentLeft == node) {
+        parent->left.store(left);
+    } else {
+        parent->right.store(left);
+    }
+    left->parent.store(parent);
+
+    int hNode = 1 + std::max(hLR, hR);
+    node->nodeHeight.store(hNode);
+    left->nodeHeight.store(1 + std::max(hLL, hNode));
+    node->version.store(nodeVersion + Node::CHANGE_COUNT);
+
+    int balanceNode = hLR - hR;
+    if(balanceNode < -1 || balanceNode > 1) {
+        return node;
+    }
+    if((leftRight == nullptr || hR == 0) && node->value.load() == nullptr) {
+        return node;
+    }
+    int balanceLeft = hLL - hNode;
+    if(balanceLeft < -1 || balanceLeft > 1) {
+        return left;
+    }
+    if(hLL == 0 && left->value.load() == nullptr) {
+        return left;
+    }
+    return fixHeight(parent);
+}
+
+/**
+* Mirror image of rotateRight.
+*/
+template<typename Key, typename Value>
+typename ConcurrentAVLTree<Key, Value>::Node*
+ConcurrentAVLTree<Key, Value>::rotateLeft(Node* parent, Node* node, int hL, Node* right, Node* rightLeft, int hRL, int hRR)
+{
+    uint64_t nodeVersion = node->version.load();
+    Node* parentLeft = parent->left.load();
+    node->version.store(nodeVersion | Node::SHRINKING);
+
+    node->right.store(rightLeft);
+    if(rightLeft != nullptr) {
+        rightLeft->parent.store(node);
+    }
+    right->left.store(node);
+    node->parent.store(right);
+    if(parentLeft == node) {
+        parent->left.store(right);
+    } else {
+        parent->right.store(right);
+    }
+    right->parent.store(parent);
+
+    int hNode = 1 + std::max(hL, hRL);
+    node->nodeHeight.store(hNode);
+    right->nodeHeight.store(1 + std::max(hNode, hRR));
+    node->version.store(nodeVersion + Node::CHANGE_COUNT);
+
+    int balanceNode = hRL - hL;
+    if(balanceNode < -1 || balanceNode > 1) {
+        return node;
+    }
+    if((rightLeft == nullptr || hL == 0) && node->value.load() == nullptr) {
+        return node;
+    }
+    int balanceRight = hRR - hNode;
+    if(balanceRight < -1 || balanceRight > 1) {
+        return right;
+    }
+    if(hRR == 0 && right->value.load() == nullptr) {
+        return right;
+    }
+    return fixHeight(parent);
+}
+
+/**
+* Left-right double rotation (parent, node, left and leftRight locked).
+* Both node and left lose part of their subtree, so both are marked.
+* If left is a routing node and ends up with a single child, it is
+* unlinked here too.
+*/
+template<typename Key, typename Value>
+typename ConcurrentAVLTree<Key, Value>::Node*
+ConcurrentAVLTree<Key, Value>::rotateRightOverLeft(Node* parent, Node* node, Node* left, int hR, int hLL, Node* leftRight, int hLRL)
+{
+    uint64_t nodeVersion = node->version.load();
+    uint64_t leftVersion = left->version.load();
+    Node* parentLeft = parent->left.load();
+    Node* leftRightLeft = leftRight->left.load();
+    Node* leftRightRight = leftRight->right.load();
+    int hLRR = Node::height(leftRightRight);
+    node->version.store(nodeVersion | Node::SHRINKING);
+    left->version.store(leftVersion | Node::SHRINKING);
+
+    node->left.store(leftRightRight);
+    if(leftRightRight != nullptr) {
+        leftRightRight->parent.store(node);
+    }
+    left->right.store(leftRightLeft);
+    if(leftRightLeft != nullptr) {
+        leftRightLeft->parent.store(left);
+    }
+    leftRight->left.store(left);
+    left->parent.store(leftRight);
+    leftRight->right.store(node);
+    node->parent.store(leftRight);
+    if(parentLeft == node) {
+        parent->left.store(leftRight);
+    } else {
+        parent->right.store(leftRight);
+    }
+    leftRight->parent.store(parent);
+
+    int hNode = 1 + std::max(hLRR, hR);
+    node->nodeHeight.store(hNode);
+    int hLeft = 1 + std::max(hLL, hLRL);
+    left->nodeHeight.store(hLeft);
+    node->version.store(nodeVersion + Node::CHANGE_COUNT);
+    left->version.store(leftVersion + Node::CHANGE_COUNT);
+    //a routing node left with one child goes now, while everything is locked
+    if((hLL == 0 || hLRL == 0) && left->value.load() == nullptr && attemptUnlink(leftRight, left)) {
+        retire(left);
+        hLeft = std::max(hLL, hLRL);
+    }
+    leftRight->nodeHeight.store(1 + std::max(hLeft, hNode));
+
+    int balanceNode = hLRR - hR;
+    if(balanceNode < -1 || balanceNode > 1) {
+        return node;
+    }
+    if((leftRightRight == nullptr || hR == 0) && node->value.load() == nullptr) {
+        return node;
+    }
+    int balanceTop = hLeft - hNode;
+    if(balanceTop < -1 || balanceTop > 1) {
+        return leftRight;
+    }
+    return fixHeight(parent);
+}
+
+/**
+* Mirror image of rotateRightOverLeft.
+*/
+template<typename Key, typename Value>
+typename ConcurrentAVLTree<Key, Value>::Node*
+ConcurrentAVLTree<Key, Value>::rotateLeftOverRight(Node* parent, Node* node, int hL, Node* right, Node* rightLeft, int hRR, int hRLR)
+{
+    uint64_t nodeVersion = node->version.load();
+    uint64_t rightVersion = right->version.load();
+    Node* parentLeft = parent->left.load();
+    Node* rightLeftLeft = rightLeft->left.load();
+    Node* rightLeftRight = rightLeft->right.load();
+    int hRLL = Node::height(rightLeftLeft);
+    node->version.store(nodeVersion | Node::SHRINKING);
+    right->version.store(rightVersion | Node::SHRINKING);
+
+    node->right.store(rightLeftLeft);
+    if(rightLeftLeft != nullptr) {
+        rightLeftLeft->parent.store(node);
+    }
+    right->left.store(rightLeftRight);
+    if(rightLeftRight != nullptr) {
+        rightLeftRight->parent.store(right);
+    }
+    rightLeft->right.store(right);
+    right->parent.store(rightLeft);
+    rightLeft->left.store(node);
+    node->parent.store(rightLeft);
+    if(parentLeft == node) {
+        parent->left.store(rightLeft);
+    } else {
+        parent->right.store(rightLeft);
+    }
+    rightLeft->parent.store(parent);
+
+    int hNode = 1 + std::max(hL, hRLL);
+    node->nodeHeight.store(hNode);
+    int hRight = 1 + std::max(hRLR, hRR);
+    right->nodeHeight.store(hRight);
+    node->version.store(nodeVersion + Node::CHANGE_COUNT);
+    right->version.store(rightVersion + Node::CHANGE_COUNT);
+    if((hRR == 0 || hRLR == 0) && right->value.load() == nullptr && attemptUnlink(rightLeft, right)) {
+        retire(right);
+        hRight = std::max(hRLR, hRR);
+    }
+    rightLeft->nodeHeight.store(1 + std::max(hNode, hRight));
+
+    int balanceNode = hRLL - hL;
+    if(balanceNode < -1 || balanceNode > 1) {
+        return node;
+    }
+    if((rightLeftLeft == nullptr || hL == 0) && node->value.load() == nullptr) {
+        return node;
+    }
+    int balanceTop = hRight - hNode;
+    if(balanceTop < -1 || balanceTop > 1) {
+        return rightLeft;
+    }
+    return fixHeight(parent);
+}
+
+template<typename Key, typename Value>
+void ConcurrentAVLTree<Key, Value>::retire(Node* node)
+{
+    reclaimer_.retire(node, [](void* object) { delete static_cast<Node*>(object); });
+}
+
+template<typename Key, typename Value>
+void ConcurrentAVLTree<Key, Value>::retire(ValueBox* value)
+{
+    reclaimer_.retire(value, [](void* object) { delete static_cast<ValueBox*>(object); });
+}
+
+template<typename Key, typename Value>
+void ConcurrentAVLTree<Key, Value>::destroySubtree(Node* node)
+{
+    if(node == nullptr) {
+        return;
+    }
+    destroySubtree(node->left.load());
+    destroySubtree(node->right.load());
+    delete node->value.load();
+    delete node;
+}
+
+/*
+  ----------------------------------------------------
+  End implementations for the ConcurrentAVLTree class.
+  ----------------------------------------------------
+*/
+
+#endif
@@ -0,0 +1,589 @@
+#ifndef DURABLEAVL_H
+#define DURABLEAVL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <string>
+#include <vector>
+#include <utility>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <stdexcept>
+#include <system_error>
+#include <type_traits>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "avlbst.h"
+#include "mapped.h"
+
+/**
+* How often a DurableAVLTree forces its log to disk.
+*
+* syncEvery is the number of mutations that may be logged but not yet
+* synced. 1 (the default) makes every insert/remove durable before it
+* returns. Larger values amortize one fdatasync over that many mutations,
+* and a crash can lose at most the last syncEvery - 1 of them. 0 leaves
+* syncing to sync(), checkpoint() and the destructor.
+*
+* bufferBytes caps the batch held in memory between writes. A full batch
+* is written to the log without a sync.
+*/
+struct DurabilityOptions
+{
+    DurabilityOptions() : syncEvery(1), bufferBytes(1 << 16) {}
+
+    std::size_t syncEvery;
+    std::size_t bufferBytes;
+};
+
+/**
+* An AVLTree that survives crashes. It keeps two files next to path:
+* path.ckpt, a MappedTree image of the whole tree, and path.log, a
+* write-ahead log of every insert/remove since that image was taken.
+* The constructor recovers the tree from both. It loads the image with
+* assign_sorted, in linear time, then replays the log on top of it. A
+* record torn by a crash at the end of the log is cut off.
+*
+* Mutations update the tree and append a record to an in-memory batch,
+* under one mutex. Batches are group-committed. The first thread that
+* needs its record on disk writes and syncs everything buffered so far,
+* while threads arriving in the meantime wait. The next of them then
+* commits their whole batch with a single fdatasync. checkpoint() writes
+* a new image and empties the log, which keeps both the log and recovery
+* time short.
+*
+* Keys and values must be trivially copyable (they are logged as raw
+* bytes, as in MappedTree). Every method locks the tree, so it can be
+* shared between threads. If the log cannot be written, the call throws
+* std::system_error. The mutation stays applied in memory but may not be
+* durable. A failed write is cut off the log and its batch is kept for
+* the next commit, so a later sync() can still make it durable. A failed
+* fdatasync cannot be retried (the kernel may have dropped the pages it
+* could not write), so it leaves the tree failed: reads keep working,
+* but every later mutation, sync() and checkpoint() throws without
+* touching the log. Reopening the store recovers what reached the disk.
+*/
+template <typename Key, typename Value, typename Compare = std::less<Key> >
+class DurableAVLTree
+{
+public:
+    static_assert(std::is_trivially_copyable<Key>::value, "DurableAVLTree keys must be trivially copyable");
+    static_assert(std::is_trivially_copyable<Value>::value, "DurableAVLTree values must be trivially copyable");
+
+    explicit DurableAVLTree(const std::string& path, const DurabilityOptions& options = DurabilityOptions(),
+        const Compare& comp = Compare());
+    ~DurableAVLTree();
+
+    void insert(const std::pair<const Key, Value>& keyValuePair);
+    bool remove(const Key& key);
+    bool find(const Key& key, Value& value) const;
+    bool contains(const Key& key) const;
+    template<typename Fn>
+    void forEach(Fn fn) const;
+
+    void sync();
+    void checkpoint();
+
+protected:
+    DurableAVLTree(const DurableAVLTree<Key, Value, Compare>&) = delete;
+    DurableAVLTree<Key, Value, Compare>& operator=(const DurableAVLTree<Key, Value, Compare>&) = delete;
+
+    typedef AVLTree<Key, Value, NoAugment, Compare> Tree;
+    typedef MappedTree<Key, Value, Compare> Image;
+
+    // Reads a checkpoint image as std::pairs, for assign_sorted.
+    class ImageReader
+    {
+    public:
+        explicit ImageReader(typename Image::iterator it) : it_(it) {}
+        std::pair<const Key, Value> operator*() const { return std::pair<const Key, Value>(it_->first, it_->second); }
+        ImageReader& operator++() { ++it_; return *this; }
+        bool operator!=(const ImageReader& rhs) const { return it_ != rhs.it_; }
+
+    private:
+        typename Image::iterator it_;
+    };
+
+    // The log starts with a LogHeader. Each record after it is a 4-byte
+    // checksum of the rest of the record, an op byte, the key, and for
+    // inserts the value.
+    struct LogHeader
+    {
+        char magic[8];
+        std::uint32_t byteOrder;
+        std::uint32_t reserved;
+        std::uint64_t keySize;
+        std::uint64_t valueSize;
+    };
+    static const char OP_INSERT = 'I';
+    static const char OP_REMOVE = 'R';
+    static const std::uint32_t BYTE_ORDER_MARK = 0x01020304;
+    static const std::size_t CHECKSUM_SIZE = 4;
+
+    static std::uint32_t checksum(const char* data, std::size_t length);
+    static void fail(const std::string& what);
+    void recover();
+    void replay(const std::vector<char>& log, std::size_t& end);
+    void appendRecord(char op, const Key& key, const Value* value);
+    void commit(std::unique_lock<std::mutex>& lock, std::uint64_t lsn, bool sync);
+    void writeAll(const char* data, std::size_t length);
+    void writeLogHeader();
+    void syncDirectory();
+    void throwIfFailed() const;
+
+    Tree tree_;
+    DurabilityOptions options_;
+    std::string checkpointPath_;
+    std::string logPath_;
+    int fd_;
+
+    // Records are numbered (log sequence numbers) as they are appended.
+    // Everything up to writtenLsn_ is in the file, which is logEnd_ bytes
+    // long, and up to syncedLsn_ on disk. writing_ is set while a thread
+    // commits a batch. failed_ holds the error that made the log unusable.
+    mutable std::mutex mutex_;
+    std::condition_variable committed_;
+    std::vector<char> buffer_;
+    std::uint64_t appendedLsn_;
+    std::uint64_t writtenLsn_;
+    std::uint64_t syncedLsn_;
+    std::size_t logEnd_;
+    bool writing_;
+    std::error_code failed_;
+};
+
+/*
+  ----------------------------------------------------
+  Begin implementations for the DurableAVLTree class.
+  ----------------------------------------------------
+*/
+
+/**
+* Opens (creating if needed) the store at path and recovers its contents.
+* Throws std::system_error if the files cannot be read or written, and
+* std::runtime_error if they belong to a different Key/Value layout.
+*/
+template<typename Key, typename Value, typename Compare>
+DurableAVLTree<Key, Value, Compare>::DurableAVLTree(const std::string& path, const DurabilityOptions& options,
+    const Compare& comp) :
+    tree_(comp),
+    options_(options),
+    checkpointPath_(path + ".ckpt"),
+    logPath_(path + ".log"),
+    fd_(-1),
+    appendedLsn_(0),
+    writtenLsn_(0),
+    syncedLsn_(0),
+    logEnd_(0),
+    writing_(false)
+{
+    fd_ = ::open(logPath_.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if(fd_ < 0) {
+        fail("open " + logPath_);
+    }
+    try {
+        recover();
+    } catch(...) {
+        ::close(fd_);
+        throw;
+    }
+}
+
+/**
+* Syncs whatever is still buffered. Errors are swallowed here; call sync()
+* first to see them.
+*/
+template<typename Key, typename Value, typename Compare>
+DurableAVLTree<Key, Value, Compare>::~DurableAVLTree()
+{
+    try {
+        sync();
+    } catch(...) {
+    }
+    ::close(fd_);
+}
+
+/**
+* Inserts or overwrites the item and logs it. With syncEvery 1 the item
+* is on disk when this returns.
+*/
+template<typename Key, typename Value, typename Compare>
+void DurableAVLTree<Key, Value, Compare>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    throwIfFailed();
+    tree_.insert(keyValuePair);
+    appendRecord(OP_INSERT, keyValuePair.first, &keyValuePair.second);
+    commit(lock, appendedLsn_, false);
+}
+
+/**
+* Removes key and logs it. Returns false, logging nothing, if key was
+* not there.
+*/
+template<typename Key, typename Value, typename Compare>
+bool DurableAVLTree<Key, Value, Compare>::remove(const Key& key)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    throwIfFailed();
+    if(tree_.find(key) == tree_.end()) {
+        return false;
+    }
+    tree_.remove(key);
+    appendRecord(OP_REMOVE, key, NULL);
+    commit(lock, appendedLsn_, false);
+    return true;
+}
+
+/**
+* Copies the value for key into value. Returns false if key is missing.
+*/
+template<typename Key, typename Value, typename Compare>
+bool DurableAVLTree<Key, Value, Compare>::find(const Key& key, Value& value) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    typename Tree::iterator it = tree_.find(key);
+    if(it == tree_.end()) {
+        return false;
+    }
+    value = it->second;
+    return true;
+}
+
+template<typename Key, typename Value, typename Compare>
+bool DurableAVLTree<Key, Value, Compare>::contains(const Key& key) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return tree_.find(key) != tree_.end();
+}
+
+/**
+* Calls fn(key, value) for every item in key order, with the tree locked;
+* fn must not call back into this tree.
+*/
+template<typename Key, typename Value, typename Compare>
+template<typename Fn>
+void DurableAVLTree<Key, Value, Compare>::forEach(Fn fn) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    for(typename Tree::iterator it = tree_.begin(); it != tree_.end(); ++it) {
+        fn(it->first, it->second);
+    }
+}
+
+/**
+* Makes every mutation so far durable.
+*/
+template<typename Key, typename Value, typename Compare>
+void DurableAVLTree<Key, Value, Compare>::sync()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    throwIfFailed();
+    commit(lock, appendedLsn_, true);
+}
+
+/**
+* Writes the whole tree as the new checkpoint image and empties the log.
+* Mutations wait until it is done. The image replaces the old one
+* atomically, and a crash before the log is emptied only makes recovery
+* replay records the image already contains, which leaves the same
+* result.
+*/
+template<typename Key, typename Value, typename Compare>
+void DurableAVLTree<Key, Value, Compare>::checkpoint()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    throwIfFailed();
+    //let a commit in flight finish; the lock is then held to the end
+    commit(lock, appendedLsn_, true);
+    Image::save(checkpointPath_, tree_);
+    syncDirectory();
+    if(::ftruncate(fd_, 0) != 0) {
+        fail("truncate " + logPath_);
+    }
+    //the image holds anything still buffered
+    buffer_.clear();
+    writtenLsn_ = syncedLsn_ = appendedLsn_;
+    logEnd_ = 0;
+    try {
+        writeLogHeader();
+        if(::fdatasync(fd_) != 0) {
+            fail("sync " + logPath_);
+        }
+    } catch(const std::system_error& error) {
+        //records appended after a torn header would be lost on recovery
+        failed_ = error.code();
+        throw;
+    }
+    logEnd_ = sizeof(LogHeader);
+}
+
+/**
+* FNV-1a, enough to tell a record torn by a crash from a whole one.
+*/
+template<typename Key, typename Value, typename Compare>
+std::uint32_t DurableAVLTree<Key, Value, Compare>::checksum(const char* data, std::size_t length)
+{
+    std::uint32_t hash = 2166136261u;
+    for(std::size_t i = 0; i < length; ++i) {
+        hash = (hash ^ static_cast<unsigned char>(data[i])) * 16777619u;
+    }
+    return hash;
+}
+
+/**
+* Throws std::system_error for a failed file operation on errno.
+*/
+template<typename Key, typename Value, typename Compare>
+void DurableAVLTree<Key, Value, Compare>::fail(const std::string& what)
+{
+    throw std::system_error(errno, std::system_category(), "DurableAVLTree: " + what);
+}
+
+/**
+* Loads the checkpoint (if any) with assign_sorted, then replays the log
+* and cuts off a torn record at its end.
+*/
+template<typename Key, typename Value, typename Compare>
+void DurableAVLTree<Key, Value, Compare>::recover()
+{
+    if(::access(checkpointPath_.c_str(), F_OK) == 0) {
+        Image image = Image::open(checkpointPath_);
+        tree_.assign_sorted(ImageReader(image.begin()), ImageReader(image.end()));
+    }
+
+    std::vector<char> log;
+    char chunk[1 << 16];
+    for(;;) {
+        ssize_t got = ::pread(fd_, chunk, sizeof(chunk), static_cast<off_t>(log.size()));
+        if(got < 0 && errno == EINTR) {
+            continue;
+        }
+        if(got < 0) {
+            fail("read " + logPath_);
+        }
+        if(got == 0) {
+            break;
+        }
+        log.insert(log.end(), chunk, chunk + got);
+    }
+
+    if(log.size() < sizeof(LogHeader)) {
+        //new, or torn while checkpoint() rewrote the header
+        if(::ftruncate(fd_, 0) != 0) {
+            fail("truncate " + logPath_);
+        }
+        writeLogHeader();
+        if(::fdatasync(fd_) != 0) {
+            fail("sync " + logPath_);
+        }
+        logEnd_ = sizeof(LogHeader);
+        return;
+    }
+    LogHeader header;
+    std::memcpy(&header, log.data(), sizeof(header));
+    if(std::memcmp(header.magic, "BSTLOG01", sizeof(header.magic)) != 0) {
+        throw std::runtime_error("DurableAVLTree: " + logPath_ + " is not a tree log");
+    }
+    if(header.byteOrder != BYTE_ORDER_MARK || header.keySize != sizeof(Key) || header.valueSize != sizeof(Value)) {
+        throw std::runtime_error("DurableAVLTree: " + logPath_ + " was written with a different key/value layout");
+    }
+    std::size_t end;
+    replay(log, end);
+    if(end != log.size()) {
+        if(::ftruncate(fd_, static_cast<off_t>(end)) != 0 || ::fdatasync(fd_) != 0) {
+            fail("truncate " + logPath_);
+        }
+    }
+    logEnd_ = end;
+}
+
+/**
+* Applies the log records to the tree. Stops at the first incomplete or
+* damaged record and returns its offset in end.
+*/
+template<typename Key, typename Value, typename Compare>
+void DurableAVLTree<Key, Value, Compare>::replay(const std::vector<char>& log, std::size_t& end)
+{
+    end = sizeof(LogHeader);
+    while(end + CHECKSUM_SIZE + 1 + sizeof(Key) <= log.size()) {
+        const char* record = log.data() + end;
+        char op = record[CHECKSUM_SIZE];
+        std::size_t length = 1 + sizeof(Key) + (op == OP_INSERT ? sizeof(Value) : 0);
+        if((op != OP_INSERT && op != OP_REMOVE) || end + CHECKSUM_SIZE + length > log.size()) {
+            return;
+        }
+        std::uint32_t sum;
+        std::memcpy(&sum, record, CHECKSUM_SIZE);
+        if(sum != checksum(record + CHECKSUM_SIZE, length)) {
+            return;
+        }
+        Key key;
+        std::memcpy(&key, record + CHECKSUM_SIZE + 1, sizeof(Key));
+        if(op == OP_INSERT) {
+            Value value;
+            std::memcpy(&value, record + CHECKSUM_SIZE + 1 + sizeof(Key), sizeof(Value));
+            tree_.insert(std::pair<const Key, Value>(key, value));
+        }else{
+            tree_.remove(key);
+        }
+        end += CHECKSUM_SIZE + length;
+    }
+}
+
+/**
+* Adds a record to the batch; the caller holds mutex_.
+*/
+template<typename Key, typename Value, typename Compare>
+void DurableAVLTree<Key, Value, Compare>::appendRecord(char op, const Key& key, const Value* value)
+{
+    std::size_t start = buffer_.size();
+    std::size_t length = 1 + sizeof(Key) + (value != NULL ? sizeof(Value) : 0);
+    buffer_.resize(start + CHECKSUM_SIZE + length);
+    char* record = &buffer_[start];
+    record[CHECKSUM_SIZE] = op;
+    std::memcpy(record + CHECKSUM_SIZE + 1, &key, sizeof(Key));
+    if(value != NULL) {
+        std::memcpy(record + CHECKSUM_SIZE + 1 + sizeof(Key), value, sizeof(Value));
+    }
+    std::uint32_t sum = checksum(record + CHECKSUM_SIZE, length);
+    std::memcpy(record, &sum, CHECKSUM_SIZE);
+    ++appendedLsn_;
+}
+
+/**
+* Brings the log up to lsn as the options (or sync) require. One thread
+* at a time takes the whole batch and writes (and syncs) it with mutex_
+* released; threads that need a later record wait for it and then commit
+* whatever was buffered meanwhile as the next batch.
+*
+* If the write fails, the log is truncated back to logEnd_ so no torn
+* record sits in front of later ones, and the batch goes back to the
+* front of the buffer. If that truncate or the fdatasync fails, the
+* tree is marked failed.
+*/
+template<typename Key, typename Value, typename Compare>
+void DurableAVLTree<Key, Value, Compare>::commit(std::unique_lock<std::mutex>& lock, std::uint64_t lsn, bool sync)
+{
+    sync = sync || (options_.syncEvery != 0 && lsn - syncedLsn_ >= options_.syncEvery);
+    if(!sync && buffer_.size() < options_.bufferBytes) {
+        return;
+    }
+    while(sync ? syncedLsn_ < lsn : writtenLsn_ < lsn) {
+        throwIfFailed();
+        if(writing_) {
+            committed_.wait(lock);
+            continue;
+        }
+        writing_ = true;
+        std::vector<char> batch;
+        batch.swap(buffer_);
+        std::uint64_t target = appendedLsn_;
+        lock.unlock();
+        bool written = false;
+        try {
+            writeAll(batch.data(), batch.size());
+            written = true;
+            if(sync && ::fdatasync(fd_) != 0) {
+                fail("sync " + logPath_);
+            }
+        } catch(const std::system_error& error) {
+            lock.lock();
+            writing_ = false;
+            if(!written && ::ftruncate(fd_, static_cast<off_t>(logEnd_)) == 0) {
+                buffer_.insert(buffer_.begin(), batch.begin(), batch.end());
+            } else {
+                failed_ = error.code();
+            }
+            committed_.notify_all();
+            throw;
+        }
+        lock.lock();
+        writing_ = false;
+        writtenLsn_ = target;
+        logEnd_ += batch.size();
+        if(sync) {
+            syncedLsn_ = target;
+        }
+        if(buffer_.empty()) {
+            //keep the capacity for the next batch
+            batch.clear();
+            buffer_.swap(batch);
+        }
+        committed_.notify_all();
+    }
+}
+
+template<typename Key, typename Value, typename Compare>
+void DurableAVLTree<Key, Value, Compare>::writeAll(const char* data, std::size_t length)
+{
+    while(length > 0) {
+        ssize_t written = ::write(fd_, data, length);
+        if(written < 0 && errno == EINTR) {
+            continue;
+        }
+        if(written < 0) {
+            fail("write " + logPath_);
+        }
+        data += written;
+        length -= static_cast<std::size_t>(written);
+    }
+}
+
+template<typename Key, typename Value, typename Compare>
+void DurableAVLTree<Key, Value, Compare>::writeLogHeader()
+{
+    LogHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, "BSTLOG01", sizeof(header.magic));
+    header.byteOrder = BYTE_ORDER_MARK;
+    header.keySize = sizeof(Key);
+    header.valueSize = sizeof(Value);
+    writeAll(reinterpret_cast<const char*>(&header), sizeof(header));
+}
+
+/**
+* Syncs the directory holding the checkpoint, so that the rename that
+* put the new image in place survives a crash as well.
+*/
+template<typename Key, typename Value, typename Compare>
+void DurableAVLTree<Key, Value, Compare>::syncDirectory()
+{
+    std::string::size_type slash = checkpointPath_.rfind('/');
+    std::string directory = slash == std::string::npos ? "." :
+        slash == 0 ? "/" : checkpointPath_.substr(0, slash);
+    int fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if(fd < 0) {
+        fail("open " + directory);
+    }
+    int result = ::fsync(fd);
+    int error = errno;
+    ::close(fd);
+    if(result != 0) {
+        errno = error;
+        fail("sync " + directory);
+    }
+}
+
+/**
+* Throws std::system_error with the earlier error if the tree is failed.
+*/
+template<typename Key, typename Value, typename Compare>
+void DurableAVLTree<Key, Value, Compare>::throwIfFailed() const
+{
+    if(failed_) {
+        throw std::system_error(failed_, "DurableAVLTree: " + logPath_ + " failed earlier");
+    }
+}
+
+/*
+  --------------------------------------------------
+  End implementations for the DurableAVLTree class.
+  --------------------------------------------------
+*/
+
+#endif
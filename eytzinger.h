@@ -0,0 +1,125 @@
+#ifndef EYTZINGER_H
+#define EYTZINGER_H
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+* Index arithmetic for a sorted array in Eytzinger (BFS) order, shared by
+* FrozenTree and MappedTree. The root is at index 1 and the children of
+* index i are at 2i and 2i + 1, so items[1..size] form a complete binary
+* search tree with no pointers in it; index 0 is unused and doubles as
+* the end position.
+*
+* Since the children of every node are adjacent, the descendants a few
+* levels down share a cache line, so lowerBound() prefetches that line
+* while the current level is being compared.
+*/
+class Eytzinger
+{
+public:
+    static std::size_t first(std::size_t size);
+    static std::size_t next(std::size_t index, std::size_t size);
+    template<typename Item, typename Key, typename Compare>
+    static std::size_t lowerBound(const Item* items, std::size_t size, const Key& key, const Compare& comp);
+    template<typename Place>
+    static void fill(std::size_t index, std::size_t size, Place& place);
+
+    static const std::size_t CACHE_LINE = 64;
+
+protected:
+    // Step this many levels ahead when prefetching: as many items as fit
+    // in a cache line (a power of two, at least the two children).
+    template<typename Item>
+    static constexpr std::size_t prefetchSpan()
+    {
+        return sizeof(Item) * 8 <= CACHE_LINE ? 8 :
+               sizeof(Item) * 4 <= CACHE_LINE ? 4 : 2;
+    }
+};
+
+/*
+  ----------------------------------------------
+  Begin implementations for the Eytzinger class.
+  ----------------------------------------------
+*/
+
+/**
+* Index of the smallest item: the leftmost one, 0 for an empty array.
+*/
+inline std::size_t Eytzinger::first(std::size_t size)
+{
+    std::size_t index = size == 0 ? 0 : 1;
+    while(index != 0 && 2 * index <= size) {
+        index *= 2;
+    }
+    return index;
+}
+
+/**
+* Index of the in-order successor of index, 0 after the largest item:
+* the leftmost item of the right subtree if there is one, otherwise up
+* past all the right turns.
+*/
+inline std::size_t Eytzinger::next(std::size_t index, std::size_t size)
+{
+    if(2 * index + 1 <= size) {
+        index = 2 * index + 1;
+        while(2 * index <= size) {
+            index *= 2;
+        }
+    } else {
+        while(index & 1) {
+            index >>= 1;
+        }
+        index >>= 1;
+    }
+    return index;
+}
+
+/**
+* Index of the first item whose key (items[i].first) is not less than
+* key, 0 if none. The loop is one comparison per level; the index it
+* stops at encodes the path taken, and the last left turn is the answer.
+*/
+template<typename Item, typename Key, typename Compare>
+std::size_t Eytzinger::lowerBound(const Item* items, std::size_t size, const Key& key, const Compare& comp)
+{
+    std::size_t index = 1;
+    while(index <= size) {
+#if defined(__GNUC__)
+        __builtin_prefetch(reinterpret_cast<const void*>(
+            reinterpret_cast<std::uintptr_t>(items) + index * prefetchSpan<Item>() * sizeof(Item)));
+#endif
+        index = 2 * index + (comp(items[index].first, key) ? 1 : 0);
+    }
+    //undo the trailing right turns, then the left turn before them
+    while(index & 1) {
+        index >>= 1;
+    }
+    return index >> 1;
+}
+
+/**
+* Calls place(i) for every index of the subtree rooted at index, in key
+* order (left subtree, root, right subtree), so place can store the next
+* item of a sorted range at i.
+*/
+template<typename Place>
+void Eytzinger::fill(std::size_t index, std::size_t size, Place& place)
+{
+    if(index > size) {
+        return;
+    }
+    fill(2 * index, size, place);
+    place(index);
+    fill(2 * index + 1, size, place);
+}
+
+/*
+  --------------------------------------------
+  End implementations for the Eytzinger class.
+  --------------------------------------------
+*/
+
+#endif
@@ -0,0 +1,315 @@
+#ifndef FROZEN_H
+#define FROZEN_H
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+#include <stdexcept>
+#include <type_traits>
+#include <functional>
+#include "eytzinger.h"
+
+/**
+* An immutable snapshot of a sorted map, made by AVLTree::freeze(). The
+* items are copied into one contiguous array in Eytzinger (BFS) order
+* (see eytzinger.h): the root is at index 1 and the children of index i
+* are at 2i and 2i + 1. A lookup walks down that array with no pointers
+* to chase, prefetching the cache line a few levels below.
+*
+* find(), begin()/end(), operator[] and the iterator behave like their
+* BinarySearchTree counterparts, except that items cannot be modified.
+* Iteration visits the keys in sorted order (the tree's Compare order).
+*/
+template <typename Key, typename Value, typename Compare = std::less<Key> >
+class FrozenTree
+{
+public:
+    typedef std::pair<const Key, Value> value_type;
+
+    FrozenTree();
+    template<typename InputIt>
+    FrozenTree(InputIt first, std::size_t count, const Compare& comp = Compare());
+    FrozenTree(FrozenTree<Key, Value, Compare>&& other);
+    FrozenTree<Key, Value, Compare>& operator=(FrozenTree<Key, Value, Compare>&& other);
+    ~FrozenTree();
+
+    std::size_t size() const;
+    bool empty() const;
+
+    /**
+    * Walks the array in key order. Holds a snapshot pointer and an index.
+    */
+    class iterator
+    {
+    public:
+        iterator();
+
+        const value_type& operator*() const;
+        const value_type* operator->() const;
+
+        bool operator==(const iterator& rhs) const;
+        bool operator!=(const iterator& rhs) const;
+
+        iterator& operator++();
+
+    protected:
+        friend class FrozenTree<Key, Value, Compare>;
+        iterator(const FrozenTree<Key, Value, Compare>* tree, std::size_t index);
+        const FrozenTree<Key, Value, Compare>* tree_;
+        std::size_t index_;
+    };
+
+    iterator begin() const;
+    iterator end() const;
+    iterator find(const Key& key) const;
+    Value const & operator[](const Key& key) const;
+
+protected:
+    FrozenTree(const FrozenTree<Key, Value, Compare>&) = delete;
+    FrozenTree<Key, Value, Compare>& operator=(const FrozenTree<Key, Value, Compare>&) = delete;
+
+    void destroy(std::size_t built);
+
+    static const std::size_t CACHE_LINE = Eytzinger::CACHE_LINE;
+
+    void* raw_;             // the allocation, items_ is aligned within it
+    value_type* items_;     // items_[1..size_], items_[0] is never used
+    std::size_t size_;
+    Compare comp_;
+};
+
+/*
+  ------------------------------------------------
+  Begin implementations for the FrozenTree class.
+  ------------------------------------------------
+*/
+
+/**
+* An empty snapshot.
+*/
+template<typename Key, typename Value, typename Compare>
+FrozenTree<Key, Value, Compare>::FrozenTree() :
+    raw_(NULL),
+    items_(NULL),
+    size_(0),
+    comp_()
+{
+
+}
+
+/**
+* Copies the count items of a sorted range starting at first into
+* Eytzinger order. The array is cache-line aligned so the blocks that
+* find() prefetches line up.
+*/
+template<typename Key, typename Value, typename Compare>
+template<typename InputIt>
+FrozenTree<Key, Value, Compare>::FrozenTree(InputIt first, std::size_t count, const Compare& comp) :
+    raw_(NULL),
+    items_(NULL),
+    size_(0),
+    comp_(comp)
+{
+    if(count == 0) {
+        return;
+    }
+    raw_ = ::operator new((count + 1) * sizeof(value_type) + CACHE_LINE);
+    std::uintptr_t base = reinterpret_cast<std::uintptr_t>(raw_);
+    base = (base + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE;
+    items_ = reinterpret_cast<value_type*>(base);
+    size_ = count;
+    std::size_t built = 0;
+    //constructs the items in key order
+    auto place = [&](std::size_t index) {
+        new (items_ + index) value_type(*first);
+        ++built;
+        ++first;
+    };
+    try {
+        Eytzinger::fill(1, size_, place);
+    } catch(...) {
+        destroy(built);
+        throw;
+    }
+}
+
+template<typename Key, typename Value, typename Compare>
+FrozenTree<Key, Value, Compare>::FrozenTree(FrozenTree<Key, Value, Compare>&& other) :
+    raw_(other.raw_),
+    items_(other.items_),
+    size_(other.size_),
+    comp_(other.comp_)
+{
+    other.raw_ = NULL;
+    other.items_ = NULL;
+    other.size_ = 0;
+}
+
+template<typename Key, typename Value, typename Compare>
+FrozenTree<Key, Value, Compare>& FrozenTree<Key, Value, Compare>::operator=(FrozenTree<Key, Value, Compare>&& other)
+{
+    if(this != &other) {
+        destroy(size_);
+        std::swap(raw_, other.raw_);
+        std::swap(items_, other.items_);
+        std::swap(size_, other.size_);
+        std::swap(comp_, other.comp_);
+    }
+    return *this;
+}
+
+template<typename Key, typename Value, typename Compare>
+FrozenTree<Key, Value, Compare>::~FrozenTree()
+{
+    destroy(size_);
+}
+
+/**
+* Returns the number of items in the snapshot.
+*/
+template<typename Key, typename Value, typename Compare>
+std::size_t FrozenTree<Key, Value, Compare>::size() const
+{
+    return size_;
+}
+
+template<typename Key, typename Value, typename Compare>
+bool FrozenTree<Key, Value, Compare>::empty() const
+{
+    return size_ == 0;
+}
+
+/**
+* Returns an iterator to the smallest item.
+*/
+template<typename Key, typename Value, typename Compare>
+typename FrozenTree<Key, Value, Compare>::iterator FrozenTree<Key, Value, Compare>::begin() const
+{
+    return iterator(this, Eytzinger::first(size_));
+}
+
+template<typename Key, typename Value, typename Compare>
+typename FrozenTree<Key, Value, Compare>::iterator FrozenTree<Key, Value, Compare>::end() const
+{
+    return iterator(this, 0);
+}
+
+/**
+* Returns an iterator to the item with the given key, or end().
+*/
+template<typename Key, typename Value, typename Compare>
+typename FrozenTree<Key, Value, Compare>::iterator FrozenTree<Key, Value, Compare>::find(const Key& key) const
+{
+    std::size_t index = Eytzinger::lowerBound(items_, size_, key, comp_);
+    if(index == 0 || comp_(key, items_[index].first)) {
+        return end();
+    }
+    return iterator(this, index);
+}
+
+/**
+* Returns the value for key, throwing std::out_of_range if it is missing.
+*/
+template<typename Key, typename Value, typename Compare>
+Value const & FrozenTree<Key, Value, Compare>::operator[](const Key& key) const
+{
+    iterator it = find(key);
+    if(it == end()) {
+        throw std::out_of_range("Invalid key");
+    }
+    return it->second;
+}
+
+/**
+* Destroys the first built items (in key order, which is the order they
+* are constructed in, so a half-built array works too) and frees the array.
+*/
+template<typename Key, typename Value, typename Compare>
+void FrozenTree<Key, Value, Compare>::destroy(std::size_t built)
+{
+    if(raw_ == NULL) {
+        return;
+    }
+    if(!std::is_trivially_destructible<value_type>::value) {
+        for(iterator it = begin(); built > 0; ++it, --built) {
+            it->~value_type();
+        }
+    }
+    ::operator delete(raw_);
+    raw_ = NULL;
+    items_ = NULL;
+    size_ = 0;
+}
+
+/*
+  ----------------------------------------------
+  End implementations for the FrozenTree class.
+  ----------------------------------------------
+*/
+
+/*
+  ----------------------------------------------------------
+  Begin implementations for the FrozenTree::iterator class.
+  ----------------------------------------------------------
+*/
+
+template<typename Key, typename Value, typename Compare>
+FrozenTree<Key, Value, Compare>::iterator::iterator() :
+    tree_(NULL),
+    index_(0)
+{
+
+}
+
+template<typename Key, typename Value, typename Compare>
+FrozenTree<Key, Value, Compare>::iterator::iterator(const FrozenTree<Key, Value, Compare>* tree, std::size_t index) :
+    tree_(tree),
+    index_(index)
+{
+
+}
+
+template<typename Key, typename Value, typename Compare>
+const typename FrozenTree<Key, Value, Compare>::value_type&
+FrozenTree<Key, Value, Compare>::iterator::operator*() const
+{
+    return tree_->items_[index_];
+}
+
+template<typename Key, typename Value, typename Compare>
+const typename FrozenTree<Key, Value, Compare>::value_type*
+FrozenTree<Key, Value, Compare>::iterator::operator->() const
+{
+    return &(tree_->items_[index_]);
+}
+
+template<typename Key, typename Value, typename Compare>
+bool FrozenTree<Key, Value, Compare>::iterator::operator==(const iterator& rhs) const
+{
+    return index_ == rhs.index_;
+}
+
+template<typename Key, typename Value, typename Compare>
+bool FrozenTree<Key, Value, Compare>::iterator::operator!=(const iterator& rhs) const
+{
+    return index_ != rhs.index_;
+}
+
+/**
+* Moves to the in-order successor.
+*/
+template<typename Key, typename Value, typename Compare>
+typename FrozenTree<Key, Value, Compare>::iterator& FrozenTree<Key, Value, Compare>::iterator::operator++()
+{
+    index_ = Eytzinger::next(index_, tree_->size_);
+    return *this;
+}
+
+/*
+  --------------------------------------------------------
+  End implementations for the FrozenTree::iterator class.
+  --------------------------------------------------------
+*/
+
+#endif
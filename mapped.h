@@ -0,0 +1,463 @@
+#ifndef MAPPED_H
+#define MAPPED_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <string>
+#include <stdexcept>
+#include <type_traits>
+#include <functional>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "eytzinger.h"
+
+/**
+* A read-only sorted map served straight from a memory-mapped file, made
+* by MappedTree::save() from a tree or any sorted range. The file holds a
+* 64-byte header and then the items in Eytzinger order, like FrozenTree
+* (see eytzinger.h): the root is item 1 and the children of item i are
+* items 2i and 2i + 1, so the tree shape is implied by the offsets and
+* the file has no pointers in it. open() only maps the file and checks the
+* header; pages are read in on first touch and the page cache is shared
+* by every process that maps the same image.
+*
+* Keys and values must be trivially copyable and are stored as their raw
+* bytes, so an image can only be read on a machine with the same byte
+* order and type layout (the header records both and open() checks
+* them). Items are exposed as { first, second } structs, read-only.
+*/
+template <typename Key, typename Value, typename Compare = std::less<Key> >
+class MappedTree
+{
+public:
+    static_assert(std::is_trivially_copyable<Key>::value, "MappedTree keys must be trivially copyable");
+    static_assert(std::is_trivially_copyable<Value>::value, "MappedTree values must be trivially copyable");
+
+    struct value_type
+    {
+        Key first;
+        Value second;
+    };
+
+    MappedTree();
+    MappedTree(MappedTree<Key, Value, Compare>&& other);
+    MappedTree<Key, Value, Compare>& operator=(MappedTree<Key, Value, Compare>&& other);
+    ~MappedTree();
+
+    static MappedTree<Key, Value, Compare> open(const std::string& path, const Compare& comp = Compare());
+    template<typename InputIt>
+    static void save(const std::string& path, InputIt first, std::size_t count);
+    template<typename Tree>
+    static void save(const std::string& path, const Tree& tree);
+
+    std::size_t size() const;
+    bool empty() const;
+
+    /**
+    * Walks the mapping in key order. Holds a tree pointer and an index.
+    */
+    class iterator
+    {
+    public:
+        iterator();
+
+        const value_type& operator*() const;
+        const value_type* operator->() const;
+
+        bool operator==(const iterator& rhs) const;
+        bool operator!=(const iterator& rhs) const;
+
+        iterator& operator++();
+
+    protected:
+        friend class MappedTree<Key, Value, Compare>;
+        iterator(const MappedTree<Key, Value, Compare>* tree, std::size_t index);
+        const MappedTree<Key, Value, Compare>* tree_;
+        std::size_t index_;
+    };
+
+    iterator begin() const;
+    iterator end() const;
+    iterator find(const Key& key) const;
+    Value const & operator[](const Key& key) const;
+
+protected:
+    MappedTree(const MappedTree<Key, Value, Compare>&) = delete;
+    MappedTree<Key, Value, Compare>& operator=(const MappedTree<Key, Value, Compare>&) = delete;
+
+    // The first HEADER_SIZE bytes of an image. Items follow it, item 0
+    // is never used (zero bytes) so item i sits at offset
+    // HEADER_SIZE + i * itemSize.
+    struct Header
+    {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t byteOrder;    // BYTE_ORDER_MARK as written
+        std::uint64_t keySize;
+        std::uint64_t valueSize;
+        std::uint64_t itemSize;
+        std::uint64_t count;
+    };
+    static const std::size_t HEADER_SIZE = 64;
+    static const std::uint32_t VERSION = 1;
+    static const std::uint32_t BYTE_ORDER_MARK = 0x01020304;
+    static_assert(sizeof(Header) <= HEADER_SIZE, "MappedTree header too large");
+    static_assert(alignof(value_type) <= HEADER_SIZE, "MappedTree items would be misaligned");
+
+    static void fail(const std::string& what, const std::string& path);
+    void unmap();
+
+    void* map_;                 // the whole mapping, header included
+    std::size_t mapSize_;
+    const value_type* items_;   // items_[1..size_]
+    std::size_t size_;
+    Compare comp_;
+};
+
+/*
+  ------------------------------------------------
+  Begin implementations for the MappedTree class.
+  ------------------------------------------------
+*/
+
+/**
+* An empty tree that maps nothing.
+*/
+template<typename Key, typename Value, typename Compare>
+MappedTree<Key, Value, Compare>::MappedTree() :
+    map_(NULL),
+    mapSize_(0),
+    items_(NULL),
+    size_(0),
+    comp_()
+{
+
+}
+
+template<typename Key, typename Value, typename Compare>
+MappedTree<Key, Value, Compare>::MappedTree(MappedTree<Key, Value, Compare>&& other) :
+    map_(other.map_),
+    mapSize_(other.mapSize_),
+    items_(other.items_),
+    size_(other.size_),
+    comp_(other.comp_)
+{
+    other.map_ = NULL;
+    other.mapSize_ = 0;
+    other.items_ = NULL;
+    other.size_ = 0;
+}
+
+template<typename Key, typename Value, typename Compare>
+MappedTree<Key, Value, Compare>& MappedTree<Key, Value, Compare>::operator=(MappedTree<Key, Value, Compare>&& other)
+{
+    if(this != &other) {
+        unmap();
+        std::swap(map_, other.map_);
+        std::swap(mapSize_, other.mapSize_);
+        std::swap(items_, other.items_);
+        std::swap(size_, other.size_);
+        std::swap(comp_, other.comp_);
+    }
+    return *this;
+}
+
+template<typename Key, typename Value, typename Compare>
+MappedTree<Key, Value, Compare>::~MappedTree()
+{
+    unmap();
+}
+
+/**
+* Maps the image at path read-only. Throws std::runtime_error if the
+* file cannot be mapped or was not written by save() for this Key and
+* Value layout. The items are not read, so this takes the same time for
+* any size.
+*/
+template<typename Key, typename Value, typename Compare>
+MappedTree<Key, Value, Compare> MappedTree<Key, Value, Compare>::open(const std::string& path, const Compare& comp)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0) {
+        fail("cannot open", path);
+    }
+    struct stat info;
+    if(::fstat(fd, &info) != 0) {
+        int error = errno;
+        ::close(fd);
+        errno = error;
+        fail("cannot stat", path);
+    }
+    std::size_t fileSize = static_cast<std::size_t>(info.st_size);
+    if(fileSize < HEADER_SIZE) {
+        ::close(fd);
+        throw std::runtime_error("MappedTree: " + path + " is not a tree image");
+    }
+    void* map = ::mmap(NULL, fileSize, PROT_READ, MAP_SHARED, fd, 0);
+    int error = errno;
+    //the mapping keeps the file alive on its own
+    ::close(fd);
+    if(map == MAP_FAILED) {
+        errno = error;
+        fail("cannot map", path);
+    }
+
+    MappedTree<Key, Value, Compare> tree;
+    tree.map_ = map;
+    tree.mapSize_ = fileSize;
+    tree.comp_ = comp;
+    Header header;
+    std::memcpy(&header, map, sizeof(header));
+    if(std::memcmp(header.magic, "BSTIMAGE", sizeof(header.magic)) != 0 || header.version != VERSION) {
+        throw std::runtime_error("MappedTree: " + path + " is not a tree image");
+    }
+    if(header.byteOrder != BYTE_ORDER_MARK || header.keySize != sizeof(Key)
+        || header.valueSize != sizeof(Value) || header.itemSize != sizeof(value_type)) {
+        throw std::runtime_error("MappedTree: " + path + " was saved with a different key/value layout");
+    }
+    //item 0 comes first, so count items need count + 1 slots
+    if(header.count >= (fileSize - HEADER_SIZE) / sizeof(value_type)) {
+        throw std::runtime_error("MappedTree: " + path + " is truncated");
+    }
+    tree.items_ = reinterpret_cast<const value_type*>(static_cast<const char*>(map) + HEADER_SIZE);
+    tree.size_ = static_cast<std::size_t>(header.count);
+    return tree;
+}
+
+/**
+* Writes the count items of a sorted range starting at first (anything
+* whose elements have first and second, e.g. tree iterators) as an image
+* at path. The image is written to path + ".tmp", synced and renamed over
+* path, so readers and crashes only ever see a complete image. The file's
+* blocks are allocated before it is mapped, so a full disk makes this
+* throw instead of faulting on a store to the mapping. Throws
+* std::runtime_error if a file operation fails.
+*/
+template<typename Key, typename Value, typename Compare>
+template<typename InputIt>
+void MappedTree<Key, Value, Compare>::save(const std::string& path, InputIt first, std::size_t count)
+{
+    std::string temp = path + ".tmp";
+    int fd = ::open(temp.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if(fd < 0) {
+        fail("cannot create", temp);
+    }
+    std::size_t fileSize = HEADER_SIZE + (count + 1) * sizeof(value_type);
+    void* map = MAP_FAILED;
+    //returns the error instead of setting errno
+    int allocated = ::posix_fallocate(fd, 0, static_cast<off_t>(fileSize));
+    if(allocated == 0) {
+        map = ::mmap(NULL, fileSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    } else {
+        errno = allocated;
+    }
+    if(map == MAP_FAILED) {
+        int error = errno;
+        ::close(fd);
+        ::unlink(temp.c_str());
+        errno = error;
+        fail("cannot write", temp);
+    }
+
+    //the allocated blocks read as zeros, which covers the padding and item 0
+    Header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, "BSTIMAGE", sizeof(header.magic));
+    header.version = VERSION;
+    header.byteOrder = BYTE_ORDER_MARK;
+    header.keySize = sizeof(Key);
+    header.valueSize = sizeof(Value);
+    header.itemSize = sizeof(value_type);
+    header.count = count;
+    std::memcpy(map, &header, sizeof(header));
+    value_type* items = reinterpret_cast<value_type*>(static_cast<char*>(map) + HEADER_SIZE);
+    //writes the items in key order
+    auto place = [&](std::size_t index) {
+        items[index].first = first->first;
+        items[index].second = first->second;
+        ++first;
+    };
+    Eytzinger::fill(1, count, place);
+
+    bool synced = ::msync(map, fileSize, MS_SYNC) == 0;
+    ::munmap(map, fileSize);
+    synced = synced && ::fsync(fd) == 0;
+    int error = errno;
+    ::close(fd);
+    if(!synced || ::rename(temp.c_str(), path.c_str()) != 0) {
+        error = synced ? errno : error;
+        ::unlink(temp.c_str());
+        errno = error;
+        fail("cannot write", path);
+    }
+}
+
+/**
+* Saves all the items of tree (a BinarySearchTree, AVLTree or anything
+* else iterated in key order with begin()/end()) as an image at path.
+* Startup code can then open() the file instead of rebuilding the tree.
+*/
+template<typename Key, typename Value, typename Compare>
+template<typename Tree>
+void MappedTree<Key, Value, Compare>::save(const std::string& path, const Tree& tree)
+{
+    std::size_t count = 0;
+    for(typename Tree::iterator it = tree.begin(); it != tree.end(); ++it) {
+        ++count;
+    }
+    save(path, tree.begin(), count);
+}
+
+/**
+* Returns the number of items in the image.
+*/
+template<typename Key, typename Value, typename Compare>
+std::size_t MappedTree<Key, Value, Compare>::size() const
+{
+    return size_;
+}
+
+template<typename Key, typename Value, typename Compare>
+bool MappedTree<Key, Value, Compare>::empty() const
+{
+    return size_ == 0;
+}
+
+/**
+* Returns an iterator to the smallest item.
+*/
+template<typename Key, typename Value, typename Compare>
+typename MappedTree<Key, Value, Compare>::iterator MappedTree<Key, Value, Compare>::begin() const
+{
+    return iterator(this, Eytzinger::first(size_));
+}
+
+template<typename Key, typename Value, typename Compare>
+typename MappedTree<Key, Value, Compare>::iterator MappedTree<Key, Value, Compare>::end() const
+{
+    return iterator(this, 0);
+}
+
+/**
+* Returns an iterator to the item with the given key, or end().
+*/
+template<typename Key, typename Value, typename Compare>
+typename MappedTree<Key, Value, Compare>::iterator MappedTree<Key, Value, Compare>::find(const Key& key) const
+{
+    std::size_t index = Eytzinger::lowerBound(items_, size_, key, comp_);
+    if(index == 0 || comp_(key, items_[index].first)) {
+        return end();
+    }
+    return iterator(this, index);
+}
+
+/**
+* Returns the value for key, throwing std::out_of_range if it is missing.
+*/
+template<typename Key, typename Value, typename Compare>
+Value const & MappedTree<Key, Value, Compare>::operator[](const Key& key) const
+{
+    iterator it = find(key);
+    if(it == end()) {
+        throw std::out_of_range("Invalid key");
+    }
+    return it->second;
+}
+
+/**
+* Throws std::runtime_error for a failed file operation, with errno's
+* description.
+*/
+template<typename Key, typename Value, typename Compare>
+void MappedTree<Key, Value, Compare>::fail(const std::string& what, const std::string& path)
+{
+    throw std::runtime_error("MappedTree: " + what + " " + path + ": " + std::strerror(errno));
+}
+
+template<typename Key, typename Value, typename Compare>
+void MappedTree<Key, Value, Compare>::unmap()
+{
+    if(map_ != NULL) {
+        ::munmap(map_, mapSize_);
+    }
+    map_ = NULL;
+    mapSize_ = 0;
+    items_ = NULL;
+    size_ = 0;
+}
+
+/*
+  ----------------------------------------------
+  End implementations for the MappedTree class.
+  ----------------------------------------------
+*/
+
+/*
+  ----------------------------------------------------------
+  Begin implementations for the MappedTree::iterator class.
+  ----------------------------------------------------------
+*/
+
+template<typename Key, typename Value, typename Compare>
+MappedTree<Key, Value, Compare>::iterator::iterator() :
+    tree_(NULL),
+    index_(0)
+{
+
+}
+
+template<typename Key, typename Value, typename Compare>
+MappedTree<Key, Value, Compare>::iterator::iterator(const MappedTree<Key, Value, Compare>* tree, std::size_t index) :
+    tree_(tree),
+    index_(index)
+{
+
+}
+
+template<typename Key, typename Value, typename Compare>
+const typename MappedTree<Key, Value, Compare>::value_type&
+MappedTree<Key, Value, Compare>::iterator::operator*() const
+{
+    return tree_->items_[index_];
+}
+
+template<typename Key, typename Value, typename Compare>
+const typename MappedTree<Key, Value, Compare>::value_type*
+MappedTree<Key, Value, Compare>::iterator::operator->() const
+{
+    return &(tree_->items_[index_]);
+}
+
+template<typename Key, typename Value, typename Compare>
+bool MappedTree<Key, Value, Compare>::iterator::operator==(const iterator& rhs) const
+{
+    return index_ == rhs.index_;
+}
+
+template<typename Key, typename Value, typename Compare>
+bool MappedTree<Key, Value, Compare>::iterator::operator!=(const iterator& rhs) const
+{
+    return index_ != rhs.index_;
+}
+
+/**
+* Moves to the in-order successor.
+*/
+template<typename Key, typename Value, typename Compare>
+typename MappedTree<Key, Value, Compare>::iterator& MappedTree<Key, Value, Compare>::iterator::operator++()
+{
+    index_ = Eytzinger::next(index_, tree_->size_);
+    return *this;
+}
+
+/*
+  --------------------------------------------------------
+  End implementations for the MappedTree::iterator class.
+  --------------------------------------------------------
+*/
+
+#endif
@@ -0,0 +1,346 @@
+#ifndef NODEPOOL_H
+#define NODEPOOL_H
+
+#include <cstddef>
+#include <new>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <utility>
+
+/**
+* A slab allocator that hands out fixed-size slots for tree nodes.
+* Slots are carved out of large slabs, so inserting does not pay for
+* a malloc per node and neighbouring nodes end up close together in
+* memory. Slots given back with deallocate() are kept on a free list
+* and reused before the pool grows again. release() frees every slab
+* at once; it does not run any destructors, so the owner has to destroy
+* the objects living in the slots first (or know that they are trivial).
+*
+* Trees that exchange nodes (AVLTree::split/join) have to share a pool.
+* merge() combines two pools: one of them adopts the other's slabs and
+* the emptied one just forwards to it from then on, so every tree
+* holding either pointer ends up at the same pool. A merged pool takes a
+* lock in allocate() and deallocate(), and merge() holds the locks of
+* both pools while it moves slabs and sets up the forwarding, so trees
+* that share one still look independent and can be modified from
+* different threads, even while another tree on the same pool is being
+* split or joined. Pools that were never merged stay lock-free.
+*/
+class NodePool
+{
+public:
+    explicit NodePool(std::size_t slotSize);
+    ~NodePool();
+
+    void* allocate();
+    void deallocate(void* slot);
+    void release();
+    std::size_t slotSize() const;
+
+    static NodePool& root(std::shared_ptr<NodePool>& pool);
+    static void merge(std::shared_ptr<NodePool>& a, std::shared_ptr<NodePool>& b);
+
+private:
+    NodePool(const NodePool&) = delete;
+    NodePool& operator=(const NodePool&) = delete;
+
+    // A recycled slot stores the link to the next free slot in itself.
+    struct FreeSlot
+    {
+        FreeSlot* next;
+    };
+
+    // Every slab starts with this header, followed by the slots.
+    struct Slab
+    {
+        Slab* next;
+    };
+
+    void* allocateSlot();
+    void deallocateSlot(void* slot);
+    void grow();
+    void adopt(NodePool& other);
+    static std::size_t roundUp(std::size_t bytes);
+
+    static const std::size_t FIRST_SLAB_SLOTS = 32;
+    static const std::size_t MAX_SLAB_SLOTS = 4096;
+
+    std::size_t slotSize_;
+    std::size_t nextSlabSlots_;
+    Slab* slabs_;
+    Slab* slabsTail_;
+    FreeSlot* freeList_;
+    FreeSlot* freeTail_;
+    char* cursor_;  // first never-used slot in the newest slab
+    char* limit_;   // one past the end of the newest slab
+    std::shared_ptr<NodePool> forward_;  // set once merged into another pool
+    std::atomic<bool> shared_;  // set once merged with another pool
+    std::mutex lock_;   // guards the slots and forward_ once shared_ is set
+};
+
+/*
+  ---------------------------------------------
+  Begin implementations for the NodePool class.
+  ---------------------------------------------
+*/
+
+/**
+* Creates an empty pool for slots of (at least) slotSize bytes.
+* No memory is allocated until the first call to allocate().
+*/
+inline NodePool::NodePool(std::size_t slotSize) :
+    slotSize_(roundUp(slotSize < sizeof(FreeSlot) ? sizeof(FreeSlot) : slotSize)),
+    nextSlabSlots_(FIRST_SLAB_SLOTS),
+    slabs_(NULL),
+    slabsTail_(NULL),
+    freeList_(NULL),
+    freeTail_(NULL),
+    cursor_(NULL),
+    limit_(NULL),
+    shared_(false)
+{
+
+}
+
+/**
+* Frees all slabs. Objects still living in the slots are not destroyed.
+*/
+inline NodePool::~NodePool()
+{
+    release();
+}
+
+/**
+* Returns an uninitialized slot, reusing a recycled one when possible.
+* If another thread merged this pool away in the meantime, the slot
+* comes from the pool it forwards to.
+*/
+inline void* NodePool::allocate()
+{
+    if(!shared_.load(std::memory_order_acquire)) {
+        return allocateSlot();
+    }
+    std::unique_lock<std::mutex> guard(lock_);
+    if(forward_) {
+        std::shared_ptr<NodePool> next = forward_;
+        guard.unlock();
+        return next->allocate();
+    }
+    return allocateSlot();
+}
+
+/**
+* Gives a slot back to the pool. The object in it must already be destroyed.
+*/
+inline void NodePool::deallocate(void* slot)
+{
+    if(!shared_.load(std::memory_order_acquire)) {
+        deallocateSlot(slot);
+        return;
+    }
+    std::unique_lock<std::mutex> guard(lock_);
+    if(forward_) {
+        std::shared_ptr<NodePool> next = forward_;
+        guard.unlock();
+        next->deallocate(slot);
+        return;
+    }
+    deallocateSlot(slot);
+}
+
+inline void* NodePool::allocateSlot()
+{
+    if(freeList_ != NULL) {
+        FreeSlot* slot = freeList_;
+        freeList_ = slot->next;
+        if(freeList_ == NULL) {
+            freeTail_ = NULL;
+        }
+        return slot;
+    }
+    if(cursor_ == limit_) {
+        grow();
+    }
+    void* slot = cursor_;
+    cursor_ += slotSize_;
+    return slot;
+}
+
+inline void NodePool::deallocateSlot(void* slot)
+{
+    if(slot == NULL) {
+        return;
+    }
+    FreeSlot* freed = static_cast<FreeSlot*>(slot);
+    freed->next = freeList_;
+    if(freeList_ == NULL) {
+        freeTail_ = freed;
+    }
+    freeList_ = freed;
+}
+
+/**
+* Frees every slab in one go and resets the pool to its empty state.
+*/
+inline void NodePool::release()
+{
+    while(slabs_ != NULL) {
+        Slab* next = slabs_->next;
+        ::operator delete(slabs_);
+        slabs_ = next;
+    }
+    slabsTail_ = NULL;
+    nextSlabSlots_ = FIRST_SLAB_SLOTS;
+    freeList_ = NULL;
+    freeTail_ = NULL;
+    cursor_ = NULL;
+    limit_ = NULL;
+}
+
+/**
+* A getter for the size of a single slot (after rounding for alignment).
+*/
+inline std::size_t NodePool::slotSize() const
+{
+    return slotSize_;
+}
+
+/**
+* Allocates a new slab. Slabs double in size up to MAX_SLAB_SLOTS slots,
+* so small trees stay small and large trees need few slabs.
+*/
+inline void NodePool::grow()
+{
+    std::size_t header = roundUp(sizeof(Slab));
+    char* raw = static_cast<char*>(::operator new(header + nextSlabSlots_ * slotSize_));
+    Slab* slab = reinterpret_cast<Slab*>(raw);
+    slab->next = slabs_;
+    if(slabs_ == NULL) {
+        slabsTail_ = slab;
+    }
+    slabs_ = slab;
+    cursor_ = raw + header;
+    limit_ = cursor_ + nextSlabSlots_ * slotSize_;
+    if(nextSlabSlots_ < MAX_SLAB_SLOTS) {
+        nextSlabSlots_ *= 2;
+    }
+}
+
+/**
+* Follows the forwarding chain from a merged pool to the pool that
+* actually owns the slabs, and points the given handle straight at it.
+* Only merged pools can forward, and their forward_ is read under their
+* lock. The chain may grow while the returned pool is in use; allocate()
+* and deallocate() follow it from there.
+*/
+inline NodePool& NodePool::root(std::shared_ptr<NodePool>& pool)
+{
+    while(pool->shared_.load(std::memory_order_acquire)) {
+        std::shared_ptr<NodePool> next;
+        {
+            std::lock_guard<std::mutex> guard(pool->lock_);
+            next = pool->forward_;
+        }
+        if(!next) {
+            break;
+        }
+        pool = next;
+    }
+    return *pool;
+}
+
+/**
+* Combines the pools behind a and b (which must have the same slot size)
+* so that both handles end up at one pool owning all of their slabs.
+* Takes O(1) time apart from recycling the unused tail of one slab.
+* The trees holding a and b must not be in use elsewhere, but other
+* trees on either pool may keep allocating meanwhile.
+*/
+inline void NodePool::merge(std::shared_ptr<NodePool>& a, std::shared_ptr<NodePool>& b)
+{
+    for(;;) {
+        NodePool& keep = root(a);
+        NodePool& gone = root(b);
+        if(&keep == &gone) {
+            return;
+        }
+        std::unique_lock<std::mutex> keepGuard(keep.lock_, std::defer_lock);
+        std::unique_lock<std::mutex> goneGuard(gone.lock_, std::defer_lock);
+        std::lock(keepGuard, goneGuard);
+        if(keep.forward_ || gone.forward_) {
+            //a merge of another tree on one of the pools got there first
+            continue;
+        }
+        keep.adopt(gone);
+        //set before unlocking, so later callers take the locks
+        keep.shared_.store(true, std::memory_order_release);
+        gone.shared_.store(true, std::memory_order_release);
+        gone.forward_ = a;
+        //b may be the last handle on gone, keep it alive until unlocked
+        std::shared_ptr<NodePool> goneHandle;
+        goneHandle.swap(b);
+        b = a;
+        goneGuard.unlock();
+        return;
+    }
+}
+
+/**
+* Moves every slab and free slot of other into this pool, leaving other
+* empty. Whichever pool has more never-used slots left keeps them as its
+* bump region; the smaller leftover goes onto the free list.
+*/
+inline void NodePool::adopt(NodePool& other)
+{
+    if(other.slabs_ == NULL) {
+        return;
+    }
+    if(other.limit_ - other.cursor_ > limit_ - cursor_) {
+        std::swap(cursor_, other.cursor_);
+        std::swap(limit_, other.limit_);
+    }
+    for(char* slot = other.cursor_; slot != other.limit_; slot += slotSize_) {
+        deallocateSlot(slot);
+    }
+
+    if(other.freeList_ != NULL) {
+        other.freeTail_->next = freeList_;
+        if(freeList_ == NULL) {
+            freeTail_ = other.freeTail_;
+        }
+        freeList_ = other.freeList_;
+    }
+    other.slabsTail_->next = slabs_;
+    if(slabs_ == NULL) {
+        slabsTail_ = other.slabsTail_;
+    }
+    slabs_ = other.slabs_;
+    if(other.nextSlabSlots_ > nextSlabSlots_) {
+        nextSlabSlots_ = other.nextSlabSlots_;
+    }
+
+    other.slabs_ = NULL;
+    other.slabsTail_ = NULL;
+    other.freeList_ = NULL;
+    other.freeTail_ = NULL;
+    other.cursor_ = NULL;
+    other.limit_ = NULL;
+}
+
+/**
+* Rounds a size up so every slot stays suitably aligned for any node type.
+*/
+inline std::size_t NodePool::roundUp(std::size_t bytes)
+{
+    const std::size_t align = alignof(std::max_align_t);
+    return (bytes + align - 1) / align * align;
+}
+
+/*
+  -------------------------------------------
+  End implementations for the NodePool class.
+  -------------------------------------------
+*/
+
+#endif
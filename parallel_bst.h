@@ -0,0 +1,136 @@
+#ifndef PARALLEL_BST_H
+#define PARALLEL_BST_H
+
+#include <cstddef>
+#include <vector>
+#include "bst.h"
+#include "threadpool.h"
+
+// Parallel whole-tree scans. The tree is cut into subtrees a few levels
+// below the root; each cut forks on the pool (whose workers steal the
+// larger pending halves), and the subtrees below the cut are walked
+// sequentially with an explicit stack instead of iterator::operator++,
+// which would climb parent pointers at every step.
+
+// How many levels to fork: enough for several subtrees per thread so
+// stealing can even out subtrees of different sizes.
+inline std::size_t parallelForkDepth(const ThreadPool& threads)
+{
+    if(threads.size() == 0) {
+        return 0;
+    }
+    std::size_t depth = 3;
+    for(std::size_t n = threads.size() + 1; n > 1; n = (n + 1) / 2) {
+        ++depth;
+    }
+    return depth;
+}
+
+// Calls fn on every item of the subtree, in key order.
+template<typename Key, typename Value, typename Fn>
+void forEachInSubtree(Node<Key, Value>* node, Fn& fn)
+{
+    std::vector<Node<Key, Value>*> stack;
+    while(node != nullptr || !stack.empty()) {
+        while(node != nullptr) {
+            stack.push_back(node);
+            node = node->getLeft();
+        }
+        node = stack.back();
+        stack.pop_back();
+        fn(node->getItem());
+        node = node->getRight();
+    }
+}
+
+template<typename Key, typename Value, typename Fn>
+void parallelForEachNode(Node<Key, Value>* node, std::size_t depth, Fn& fn, ThreadPool& threads)
+{
+    if(node == nullptr) {
+        return;
+    }
+    if(depth == 0) {
+        forEachInSubtree(node, fn);
+        return;
+    }
+    fn(node->getItem());
+    threads.invoke(
+        [&]() { parallelForEachNode(node->getLeft(), depth - 1, fn, threads); },
+        [&]() { parallelForEachNode(node->getRight(), depth - 1, fn, threads); });
+}
+
+// Folds map(item) over the subtree in key order: combine(acc, map(item)).
+template<typename Key, typename Value, typename T, typename Map, typename Combine>
+T reduceSubtree(Node<Key, Value>* node, T acc, Map& map, Combine& combine)
+{
+    std::vector<Node<Key, Value>*> stack;
+    while(node != nullptr || !stack.empty()) {
+        while(node != nullptr) {
+            stack.push_back(node);
+            node = node->getLeft();
+        }
+        node = stack.back();
+        stack.pop_back();
+        acc = combine(acc, map(const_cast<const Node<Key, Value>*>(node)->getItem()));
+        node = node->getRight();
+    }
+    return acc;
+}
+
+template<typename Key, typename Value, typename T, typename Map, typename Combine>
+T parallelReduceNode(Node<Key, Value>* node, std::size_t depth, const T& identity,
+                     Map& map, Combine& combine, ThreadPool& threads)
+{
+    if(node == nullptr) {
+        return identity;
+    }
+    if(depth == 0) {
+        return reduceSubtree(node, identity, map, combine);
+    }
+    T left = identity;
+    T right = identity;
+    threads.invoke(
+        [&]() { left = parallelReduceNode(node->getLeft(), depth - 1, identity, map, combine, threads); },
+        [&]() { right = parallelReduceNode(node->getRight(), depth - 1, identity, map, combine, threads); });
+    return combine(combine(left, map(const_cast<const Node<Key, Value>*>(node)->getItem())), right);
+}
+
+/**
+* Calls fn(item) on every item of the tree, in parallel on the given pool.
+* The order of the calls is unspecified and fn runs on several threads
+* at once. fn may change values, but on an AVLTree with aggregates it
+* then has to call refresh() afterwards, as with iterators. The tree
+* must not be modified otherwise until this returns.
+*/
+template<typename Key, typename Value, typename Compare, typename Fn>
+void parallel_for_each(BinarySearchTree<Key, Value, Compare>& tree, Fn fn, ThreadPool& threads)
+{
+    parallelForEachNode(tree.root_, parallelForkDepth(threads), fn, threads);
+}
+
+template<typename Key, typename Value, typename Compare, typename Fn>
+void parallel_for_each(BinarySearchTree<Key, Value, Compare>& tree, Fn fn)
+{
+    parallel_for_each(tree, fn, ThreadPool::shared());
+}
+
+/**
+* Returns identity combined with map(item) for every item, in parallel on
+* the given pool. combine must be associative and identity its neutral
+* element. The items are combined in key order, so combine does not
+* have to be commutative. map and combine run on several threads at once.
+*/
+template<typename Key, typename Value, typename Compare, typename T, typename Map, typename Combine>
+T parallel_reduce(const BinarySearchTree<Key, Value, Compare>& tree, T identity, Map map,
+                  Combine combine, ThreadPool& threads)
+{
+    return parallelReduceNode(tree.root_, parallelForkDepth(threads), identity, map, combine, threads);
+}
+
+template<typename Key, typename Value, typename Compare, typename T, typename Map, typename Combine>
+T parallel_reduce(const BinarySearchTree<Key, Value, Compare>& tree, T identity, Map map, Combine combine)
+{
+    return parallel_reduce(tree, identity, map, combine, ThreadPool::shared());
+}
+
+#endif
@@ -0,0 +1,771 @@
+#ifndef PERSISTENTAVL_H
+#define PERSISTENTAVL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <mutex>
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
+
+template <typename Key, typename Value>
+class PersistentAVLTree;
+
+/**
+* A node of a PersistentAVLTree. Once linked into a published version a
+* node never changes again; versions share the nodes they have in common
+* and the reference count says how many parents and handles point at it.
+* Nodes are allocated with new rather than from a NodePool, since the
+* last reference may be dropped on any thread.
+*/
+template <typename Key, typename Value>
+class PersistentAVLNode
+{
+public:
+    PersistentAVLNode(const std::pair<const Key, Value>& item, PersistentAVLNode<Key, Value>* left,
+        PersistentAVLNode<Key, Value>* right);
+    PersistentAVLNode(std::pair<const Key, Value>&& item, PersistentAVLNode<Key, Value>* left,
+        PersistentAVLNode<Key, Value>* right);
+
+    const std::pair<const Key, Value>& getItem() const;
+    const Key& getKey() const;
+    PersistentAVLNode<Key, Value>* getLeft() const;
+    PersistentAVLNode<Key, Value>* getRight() const;
+    static int height(const PersistentAVLNode<Key, Value>* node);
+
+    static void acquire(PersistentAVLNode<Key, Value>* node);
+    static void release(PersistentAVLNode<Key, Value>* node);
+
+protected:
+    std::pair<const Key, Value> item_;
+    PersistentAVLNode<Key, Value>* left_;
+    PersistentAVLNode<Key, Value>* right_;
+    std::atomic<int> refs_;
+    uint8_t height_;
+};
+
+/*
+  ------------------------------------------------------
+  Begin implementations for the PersistentAVLNode class.
+  ------------------------------------------------------
+*/
+
+/**
+* Builds a node over left and right, taking over one reference to each.
+* The new node starts with a single reference, owned by the caller.
+*/
+template<typename Key, typename Value>
+PersistentAVLNode<Key, Value>::PersistentAVLNode(const std::pair<const Key, Value>& item,
+    PersistentAVLNode<Key, Value>* left, PersistentAVLNode<Key, Value>* right) :
+    item_(item),
+    left_(left),
+    right_(right),
+    refs_(1),
+    height_(static_cast<uint8_t>(std::max(height(left), height(right)) + 1))
+{
+
+}
+
+template<typename Key, typename Value>
+PersistentAVLNode<Key, Value>::PersistentAVLNode(std::pair<const Key, Value>&& item,
+    PersistentAVLNode<Key, Value>* left, PersistentAVLNode<Key, Value>* right) :
+    item_(std::move(item)),
+    left_(left),
+    right_(right),
+    refs_(1),
+    height_(static_cast<uint8_t>(std::max(height(left), height(right)) + 1))
+{
+
+}
+
+template<typename Key, typename Value>
+const std::pair<const Key, Value>& PersistentAVLNode<Key, Value>::getItem() const
+{
+    return item_;
+}
+
+template<typename Key, typename Value>
+const Key& PersistentAVLNode<Key, Value>::getKey() const
+{
+    return item_.first;
+}
+
+template<typename Key, typename Value>
+PersistentAVLNode<Key, Value>* PersistentAVLNode<Key, Value>::getLeft() const
+{
+    return left_;
+}
+
+template<typename Key, typename Value>
+PersistentAVLNode<Key, Value>* PersistentAVLNode<Key, Value>::getRight() const
+{
+    return right_;
+}
+
+/**
+* Height of a subtree, 0 for an empty one.
+*/
+template<typename Key, typename Value>
+int PersistentAVLNode<Key, Value>::height(const PersistentAVLNode<Key, Value>* node)
+{
+    return node == nullptr ? 0 : node->height_;
+}
+
+/**
+* Adds a reference to node (null is ignored).
+*/
+template<typename Key, typename Value>
+void PersistentAVLNode<Key, Value>::acquire(PersistentAVLNode<Key, Value>* node)
+{
+    if(node != nullptr) {
+        node->refs_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+/**
+* Drops a reference to node, freeing it (and then dropping its references
+* to its children) when it was the last one. Children shared with other
+* versions stay alive.
+*/
+template<typename Key, typename Value>
+void PersistentAVLNode<Key, Value>::release(PersistentAVLNode<Key, Value>* node)
+{
+    if(node != nullptr && node->refs_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        release(node->left_);
+        release(node->right_);
+        delete node;
+    }
+}
+
+/*
+  ----------------------------------------------------
+  End implementations for the PersistentAVLNode class.
+  ----------------------------------------------------
+*/
+
+/**
+* An immutable version of a PersistentAVLTree. Copying a snapshot only
+* bumps a reference count. As long as it exists, the version it refers
+* to stays intact, whatever the tree it came from does. A snapshot can
+* be searched and iterated on any thread without locking.
+*/
+template <typename Key, typename Value>
+class PersistentAVLSnapshot
+{
+public:
+    PersistentAVLSnapshot();
+    PersistentAVLSnapshot(const PersistentAVLSnapshot<Key, Value>& other);
+    PersistentAVLSnapshot(PersistentAVLSnapshot<Key, Value>&& other);
+    PersistentAVLSnapshot<Key, Value>& operator=(PersistentAVLSnapshot<Key, Value> other);
+    ~PersistentAVLSnapshot();
+
+    std::size_t size() const;
+    bool empty() const;
+
+    /**
+    * An in-order iterator. Without parent pointers (a node can have a
+    * different parent in every version) it keeps the path it came down.
+    */
+    class iterator
+    {
+    public:
+        iterator();
+
+        const std::pair<const Key,Value>& operator*() const;
+        const std::pair<const Key,Value>* operator->() const;
+
+        bool operator==(const iterator& rhs) const;
+        bool operator!=(const iterator& rhs) const;
+
+        iterator& operator++();
+
+    protected:
+        friend class PersistentAVLSnapshot<Key, Value>;
+        void pushLeftSpine(PersistentAVLNode<Key, Value>* node);
+
+        // AVL height is below 1.45 log2(n + 2), so this covers any tree that fits in memory
+        static const int MAX_DEPTH = 64;
+        // Nodes still to be visited, the current one on top.
+        PersistentAVLNode<Key, Value>* path_[MAX_DEPTH];
+        int depth_;
+    };
+
+    iterator begin() const;
+    iterator end() const;
+    iterator find(const Key& key) const;
+    Value const & operator[](const Key& key) const;
+
+protected:
+    friend class PersistentAVLTree<Key, Value>;
+    PersistentAVLSnapshot(PersistentAVLNode<Key, Value>* root, std::size_t size);
+
+    PersistentAVLNode<Key, Value>* root_;
+    std::size_t size_;
+};
+
+/*
+  ----------------------------------------------------------
+  Begin implementations for the PersistentAVLSnapshot class.
+  ----------------------------------------------------------
+*/
+
+template<typename Key, typename Value>
+PersistentAVLSnapshot<Key, Value>::PersistentAVLSnapshot() :
+    root_(nullptr),
+    size_(0)
+{
+
+}
+
+/**
+* Wraps a root the caller holds a reference to; the snapshot takes it over.
+*/
+template<typename Key, typename Value>
+PersistentAVLSnapshot<Key, Value>::PersistentAVLSnapshot(PersistentAVLNode<Key, Value>* root, std::size_t size) :
+    root_(root),
+    size_(size)
+{
+
+}
+
+template<typename Key, typename Value>
+PersistentAVLSnapshot<Key, Value>::PersistentAVLSnapshot(const PersistentAVLSnapshot<Key, Value>& other) :
+    root_(other.root_),
+    size_(other.size_)
+{
+    PersistentAVLNode<Key, Value>::acquire(root_);
+}
+
+template<typename Key, typename Value>
+PersistentAVLSnapshot<Key, Value>::PersistentAVLSnapshot(PersistentAVLSnapshot<Key, Value>&& other) :
+    root_(other.root_),
+    size_(other.size_)
+{
+    other.root_ = nullptr;
+    other.size_ = 0;
+}
+
+template<typename Key, typename Value>
+PersistentAVLSnapshot<Key, Value>& PersistentAVLSnapshot<Key, Value>::operator=(PersistentAVLSnapshot<Key, Value> other)
+{
+    std::swap(root_, other.root_);
+    std::swap(size_, other.size_);
+    return *this;
+}
+
+template<typename Key, typename Value>
+PersistentAVLSnapshot<Key, Value>::~PersistentAVLSnapshot()
+{
+    PersistentAVLNode<Key, Value>::release(root_);
+}
+
+template<typename Key, typename Value>
+std::size_t PersistentAVLSnapshot<Key, Value>::size() const
+{
+    return size_;
+}
+
+template<typename Key, typename Value>
+bool PersistentAVLSnapshot<Key, Value>::empty() const
+{
+    return root_ == nullptr;
+}
+
+template<typename Key, typename Value>
+typename PersistentAVLSnapshot<Key, Value>::iterator PersistentAVLSnapshot<Key, Value>::begin() const
+{
+    iterator it;
+    it.pushLeftSpine(root_);
+    return it;
+}
+
+template<typename Key, typename Value>
+typename PersistentAVLSnapshot<Key, Value>::iterator PersistentAVLSnapshot<Key, Value>::end() const
+{
+    return iterator();
+}
+
+/**
+* Returns an iterator to the item with the given key, or end(). The
+* ancestors whose left subtree the search went into are remembered, so
+* iteration can continue from the result.
+*/
+template<typename Key, typename Value>
+typename PersistentAVLSnapshot<Key, Value>::iterator PersistentAVLSnapshot<Key, Value>::find(const Key& key) const
+{
+    iterator it;
+    PersistentAVLNode<Key, Value>* node = root_;
+    while(node != nullptr) {
+        if(key < node->getKey()) {
+            it.path_[it.depth_++] = node;
+            node = node->getLeft();
+        } else if(node->getKey() < key) {
+            node = node->getRight();
+        } else {
+            it.path_[it.depth_++] = node;
+            return it;
+        }
+    }
+    return end();
+}
+
+/**
+* Returns the value for key, throwing std::out_of_range if it is missing.
+*/
+template<typename Key, typename Value>
+Value const & PersistentAVLSnapshot<Key, Value>::operator[](const Key& key) const
+{
+    iterator it = find(key);
+    if(it == end()) {
+        throw std::out_of_range("Invalid key");
+    }
+    return it->second;
+}
+
+template<typename Key, typename Value>
+PersistentAVLSnapshot<Key, Value>::iterator::iterator() :
+    depth_(0)
+{
+
+}
+
+template<typename Key, typename Value>
+const std::pair<const Key,Value>& PersistentAVLSnapshot<Key, Value>::iterator::operator*() const
+{
+    return path_[depth_ - 1]->getItem();
+}
+
+template<typename Key, typename Value>
+const std::pair<const Key,Value>* PersistentAVLSnapshot<Key, Value>::iterator::operator->() const
+{
+    return &(path_[depth_ - 1]->getItem());
+}
+
+template<typename Key, typename Value>
+bool PersistentAVLSnapshot<Key, Value>::iterator::operator==(const iterator& rhs) const
+{
+    if(depth_ == 0 || rhs.depth_ == 0) {
+        return depth_ == rhs.depth_;
+    }
+    return path_[depth_ - 1] == rhs.path_[rhs.depth_ - 1];
+}
+
+template<typename Key, typename Value>
+bool PersistentAVLSnapshot<Key, Value>::iterator::operator!=(const iterator& rhs) const
+{
+    return !(*this == rhs);
+}
+
+/**
+* Moves to the smallest item in the right subtree, or back up to the
+* closest ancestor that is still pending.
+*/
+template<typename Key, typename Value>
+typename PersistentAVLSnapshot<Key, Value>::iterator& PersistentAVLSnapshot<Key, Value>::iterator::operator++()
+{
+    PersistentAVLNode<Key, Value>* node = path_[--depth_];
+    pushLeftSpine(node->getRight());
+    return *this;
+}
+
+template<typename Key, typename Value>
+void PersistentAVLSnapshot<Key, Value>::iterator::pushLeftSpine(PersistentAVLNode<Key, Value>* node)
+{
+    for(; node != nullptr; node = node->getLeft()) {
+        path_[depth_++] = node;
+    }
+}
+
+/*
+  --------------------------------------------------------
+  End implementations for the PersistentAVLSnapshot class.
+  --------------------------------------------------------
+*/
+
+/**
+* An AVL tree whose updates never modify a node that is already in use.
+* insert() and remove() copy the nodes on the path from the root to the
+* change (plus the few touched by rotations) and share every other node
+* with the previous version, so they cost O(log n) time and memory.
+*
+* snapshot() hands out the current version in O(1). Readers can keep
+* using it on other threads while the tree moves on, and nodes are freed
+* by reference counting once no version needs them any more. The tree
+* itself has a single writer: insert/remove/clear must not run
+* concurrently with each other, but snapshot() may be called from any
+* thread at any time (it takes a short lock to pick up the root).
+*
+* Since nodes get copied, Value must be copyable.
+*/
+template <typename Key, typename Value>
+class PersistentAVLTree
+{
+public:
+    typedef typename PersistentAVLSnapshot<Key, Value>::iterator iterator;
+
+    PersistentAVLTree();
+    ~PersistentAVLTree();
+    void insert(const std::pair<const Key, Value>& keyValuePair);
+    void insert(std::pair<const Key, Value>&& keyValuePair);
+    void remove(const Key& key);
+    void clear();
+    bool empty() const;
+    std::size_t size() const;
+
+    // Reads of the current version, for the writer's own use. Iterators
+    // are invalidated by the next insert/remove/clear.
+    iterator begin() const;
+    iterator end() const;
+    iterator find(const Key& key) const;
+    Value const & operator[](const Key& key) const;
+
+    PersistentAVLSnapshot<Key, Value> snapshot() const;
+
+protected:
+    PersistentAVLTree(const PersistentAVLTree<Key, Value>&) = delete;
+    PersistentAVLTree<Key, Value>& operator=(const PersistentAVLTree<Key, Value>&) = delete;
+
+    typedef PersistentAVLNode<Key, Value> Node;
+
+    static Node* make(const Node* from, Node* left, Node* right);
+    static Node* join(const Node* from, Node* left, Node* right);
+    template<typename Item>
+    static Node* insertAt(Node* node, Item&& item, bool& added);
+    static Node* removeAt(Node* node, const Key& key);
+    static Node* removeMin(Node* node, const Node*& min);
+    void publish(Node* root, std::size_t size);
+
+    PersistentAVLSnapshot<Key, Value> current_;
+    mutable std::mutex publishLock_;
+};
+
+/*
+  ------------------------------------------------------
+  Begin implementations for the PersistentAVLTree class.
+  ------------------------------------------------------
+*/
+
+template<typename Key, typename Value>
+PersistentAVLTree<Key, Value>::PersistentAVLTree()
+{
+
+}
+
+/**
+* Drops the current version; snapshots taken earlier stay valid.
+*/
+template<typename Key, typename Value>
+PersistentAVLTree<Key, Value>::~PersistentAVLTree()
+{
+
+}
+
+/**
+* Inserts the pair, overwriting the value if the key is already present.
+*/
+template<typename Key, typename Value>
+void PersistentAVLTree<Key, Value>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    bool added = false;
+    Node* root = insertAt(current_.root_, keyValuePair, added);
+    publish(root, current_.size_ + (added ? 1 : 0));
+}
+
+template<typename Key, typename Value>
+void PersistentAVLTree<Key, Value>::insert(std::pair<const Key, Value>&& keyValuePair)
+{
+    bool added = false;
+    Node* root = insertAt(current_.root_, std::move(keyValuePair), added);
+    publish(root, current_.size_ + (added ? 1 : 0));
+}
+
+/**
+* Removes the item with the given key, if there is one.
+*/
+template<typename Key, typename Value>
+void PersistentAVLTree<Key, Value>::remove(const Key& key)
+{
+    //nothing gets copied unless the key is actually there
+    if(current_.find(key) == current_.end()) {
+        return;
+    }
+    publish(removeAt(current_.root_, key), current_.size_ - 1);
+}
+
+template<typename Key, typename Value>
+void PersistentAVLTree<Key, Value>::clear()
+{
+    publish(nullptr, 0);
+}
+
+template<typename Key, typename Value>
+bool PersistentAVLTree<Key, Value>::empty() const
+{
+    return current_.empty();
+}
+
+template<typename Key, typename Value>
+std::size_t PersistentAVLTree<Key, Value>::size() const
+{
+    return current_.size();
+}
+
+template<typename Key, typename Value>
+typename PersistentAVLTree<Key, Value>::iterator PersistentAVLTree<Key, Value>::begin() const
+{
+    return current_.begin();
+}
+
+template<typename Key, typename Value>
+typename PersistentAVLTree<Key, Value>::iterator PersistentAVLTree<Key, Value>::end() const
+{
+    return current_.end();
+}
+
+template<typename Key, typename Value>
+typename PersistentAVLTree<Key, Value>::iterator PersistentAVLTree<Key, Value>::find(const Key& key) const
+{
+    return current_.find(key);
+}
+
+template<typename Key, typename Value>
+Value const & PersistentAVLTree<Key, Value>::operator[](const Key& key) const
+{
+    return current_[key];
+}
+
+/**
+* Returns a handle on the current version in O(1).
+*/
+template<typename Key, typename Value>
+PersistentAVLSnapshot<Key, Value> PersistentAVLTree<Key, Value>::snapshot() const
+{
+    std::lock_guard<std::mutex> lock(publishLock_);
+    return current_;
+}
+
+/**
+* Makes root (which the caller holds a reference to) the current version.
+* The old root is released after the lock, so any nodes that only it
+* used are freed without holding up snapshot().
+*/
+template<typename Key, typename Value>
+void PersistentAVLTree<Key, Value>::publish(Node* root, std::size_t size)
+{
+    PersistentAVLSnapshot<Key, Value> old(root, size);
+    {
+        std::lock_guard<std::mutex> lock(publishLock_);
+        std::swap(current_.root_, old.root_);
+        std::swap(current_.size_, old.size_);
+    }
+}
+
+/**
+* A new node with a copy of from's item over left and right, taking over
+* the caller's references to them (also if the copy throws).
+*/
+template<typename Key, typename Value>
+typename PersistentAVLTree<Key, Value>::Node*
+PersistentAVLTree<Key, Value>::make(const Node* from, Node* left, Node* right)
+{
+    try {
+        return new Node(from->getItem(), left, right);
+    } catch(...) {
+        Node::release(left);
+        Node::release(right);
+        throw;
+    }
+}
+
+/**
+* Like make(), but if left and right differ in height by 2 (the most an
+* insert or remove below can cause) the result is rotated back into AVL
+* shape. Rotated nodes are copied too, since they may be shared.
+*/
+template<typename Key, typename Value>
+typename PersistentAVLTree<Key, Value>::Node*
+PersistentAVLTree<Key, Value>::join(const Node* from, Node* left, Node* right)
+{
+    int leftHeight = Node::height(left);
+    int rightHeight = Node::height(right);
+    if(leftHeight > rightHeight + 1) {
+        Node* outer = left->getLeft();
+        Node* inner = left->getRight();
+        Node* result;
+        if(Node::height(outer) >= Node::height(inner)) {
+            //single right rotation, left comes up
+            Node::acquire(outer);
+            Node::acquire(inner);
+            Node* lowered = nullptr;
+            try {
+                lowered = make(from, inner, right);
+                result = make(left, outer, lowered);
+            } catch(...) {
+                if(lowered == nullptr) {
+                    Node::release(outer);
+                }
+                Node::release(left);
+                throw;
+            }
+        } else {
+            //double rotation, inner comes up
+            Node::acquire(outer);
+            Node::acquire(inner->getLeft());
+            Node::acquire(inner->getRight());
+            Node* newLeft = nullptr;
+            Node* newRight = nullptr;
+            try {
+                newLeft = make(left, outer, inner->getLeft());
+                newRight = make(from, inner->getRight(), right);
+                result = make(inner, newLeft, newRight);
+            } catch(...) {
+                //each make() already released what it was given
+                if(newLeft == nullptr) {
+                    Node::release(inner->getRight());
+                    Node::release(right);
+                } else if(newRight == nullptr) {
+                    Node::release(newLeft);
+                }
+                Node::release(left);
+                throw;
+            }
+        }
+        Node::release(left);
+        return result;
+    }
+    if(rightHeight > leftHeight + 1) {
+        Node* outer = right->getRight();
+        Node* inner = right->getLeft();
+        Node* result;
+        if(Node::height(outer) >= Node::height(inner)) {
+            Node::acquire(outer);
+            Node::acquire(inner);
+            Node* lowered = nullptr;
+            try {
+                lowered = make(from, left, inner);
+                result = make(right, lowered, outer);
+            } catch(...) {
+                if(lowered == nullptr) {
+                    Node::release(outer);
+                }
+                Node::release(right);
+                throw;
+            }
+        } else {
+            Node::acquire(outer);
+            Node::acquire(inner->getLeft());
+            Node::acquire(inner->getRight());
+            Node* newLeft = nullptr;
+            Node* newRight = nullptr;
+            try {
+                newRight = make(right, inner->getRight(), outer);
+                newLeft = make(from, left, inner->getLeft());
+                result = make(inner, newLeft, newRight);
+            } catch(...) {
+                if(newRight == nullptr) {
+                    Node::release(inner->getLeft());
+                    Node::release(left);
+                } else if(newLeft == nullptr) {
+                    Node::release(newRight);
+                }
+                Node::release(right);
+                throw;
+            }
+        }
+        Node::release(right);
+        return result;
+    }
+    return make(from, left, right);
+}
+
+/**
+* Returns a new version of the subtree under node with item inserted (or
+* its value replaced), sharing everything off the search path.
+*/
+template<typename Key, typename Value>
+template<typename Item>
+typename PersistentAVLTree<Key, Value>::Node*
+PersistentAVLTree<Key, Value>::insertAt(Node* node, Item&& item, bool& added)
+{
+    if(node == nullptr) {
+        added = true;
+        return new Node(std::forward<Item>(item), nullptr, nullptr);
+    }
+    if(item.first < node->getKey()) {
+        Node* left = insertAt(node->getLeft(), std::forward<Item>(item), added);
+        Node::acquire(node->getRight());
+        return join(node, left, node->getRight());
+    }
+    if(node->getKey() < item.first) {
+        Node* right = insertAt(node->getRight(), std::forward<Item>(item), added);
+        Node::acquire(node->getLeft());
+        return join(node, node->getLeft(), right);
+    }
+    Node::acquire(node->getLeft());
+    Node::acquire(node->getRight());
+    try {
+        return new Node(std::forward<Item>(item), node->getLeft(), node->getRight());
+    } catch(...) {
+        Node::release(node->getLeft());
+        Node::release(node->getRight());
+        throw;
+    }
+}
+
+/**
+* Returns a new version of the subtree under node without key, which
+* must be in it. A node with two children is replaced by a copy of its
+* successor.
+*/
+template<typename Key, typename Value>
+typename PersistentAVLTree<Key, Value>::Node*
+PersistentAVLTree<Key, Value>::removeAt(Node* node, const Key& key)
+{
+    if(key < node->getKey()) {
+        Node* left = removeAt(node->getLeft(), key);
+        Node::acquire(node->getRight());
+        return join(node, left, node->getRight());
+    }
+    if(node->getKey() < key) {
+        Node* right = removeAt(node->getRight(), key);
+        Node::acquire(node->getLeft());
+        return join(node, node->getLeft(), right);
+    }
+    if(node->getLeft() == nullptr || node->getRight() == nullptr) {
+        Node* child = node->getLeft() != nullptr ? node->getLeft() : node->getRight();
+        Node::acquire(child);
+        return child;
+    }
+    //the successor stays alive through the old version until we are done
+    const Node* successor;
+    Node* right = removeMin(node->getRight(), successor);
+    Node::acquire(node->getLeft());
+    return join(successor, node->getLeft(), right);
+}
+
+/**
+* Returns a new version of the subtree under node without its smallest
+* item, which is passed back through min.
+*/
+template<typename Key, typename Value>
+typename PersistentAVLTree<Key, Value>::Node*
+PersistentAVLTree<Key, Value>::removeMin(Node* node, const Node*& min)
+{
+    if(node->getLeft() == nullptr) {
+        min = node;
+        Node::acquire(node->getRight());
+        return node->getRight();
+    }
+    Node* left = removeMin(node->getLeft(), min);
+    Node::acquire(node->getRight());
+    return join(node, left, node->getRight());
+}
+
+/*
+  ----------------------------------------------------
+  End implementations for the PersistentAVLTree class.
+  ----------------------------------------------------
+*/
+
+#endif
@@ -0,0 +1,87 @@
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include "avlbst.h"
+#include "prefixkey.h"
+
+using namespace std;
+
+// Successful finds, only kept so the lookups cannot be optimized away.
+static long hits = 0;
+
+typedef AVLTree<string, int> StringTree;
+typedef AVLTree<PrefixedString, int, NoAugment, PrefixLess> PrefixTree;
+
+static double secondsSince(chrono::steady_clock::time_point begin)
+{
+    return chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+}
+
+/**
+* A random path like "/qzk/fmwpa/.../xq", length bytes long, so keys
+* usually differ within their first 8 bytes.
+*/
+static string randomPath(mt19937& rng, size_t length)
+{
+    string path;
+    while(path.size() < length) {
+        path += rng() % 6 == 0 ? '/' : char('a' + rng() % 26);
+    }
+    path[0] = '/';
+    return path;
+}
+
+/**
+* Seconds for rounds passes of lookups of every probe, in shuffled order.
+*/
+template<typename Tree, typename Probe>
+double lookups(const Tree& tree, const vector<Probe>& probes, int rounds)
+{
+    chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+    for(int round = 0; round < rounds; ++round) {
+        for(size_t i = 0; i < probes.size(); ++i) {
+            hits += tree.find(probes[i]) != tree.end();
+        }
+    }
+    return secondsSince(begin);
+}
+
+/**
+* Usage: prefix-bench [keys] [rounds]
+* Builds an AVLTree with std::string keys and one with PrefixedString
+* keys from the same random 31-byte paths (default 1M), then times
+* shuffled lookups of all of them.
+*/
+int main(int argc, char *argv[])
+{
+    size_t n = argc > 1 ? atol(argv[1]) : 1000000;
+    int rounds = argc > 2 ? atoi(argv[2]) : 3;
+
+    mt19937 rng(12345);
+    vector<string> keys;
+    for(size_t i = 0; i < n; ++i) {
+        keys.push_back(randomPath(rng, 31));
+    }
+
+    StringTree strings;
+    PrefixTree prefixed;
+    for(size_t i = 0; i < n; ++i) {
+        strings.insert(make_pair(keys[i], int(i)));
+        prefixed.insert(make_pair(PrefixedString(keys[i]), int(i)));
+    }
+
+    shuffle(keys.begin(), keys.end(), rng);
+    vector<PrefixedString> prefixedKeys(keys.begin(), keys.end());
+
+    cout << n << " keys, " << rounds << " rounds of shuffled lookups (s)" << endl;
+    cout << fixed << setprecision(2);
+    cout << setw(44) << left << "std::string keys" << lookups(strings, keys, rounds) << endl;
+    cout << setw(44) << left << "PrefixedString keys, std::string probes" << lookups(prefixed, keys, rounds) << endl;
+    cout << setw(44) << left << "PrefixedString keys, PrefixedString probes" << lookups(prefixed, prefixedKeys, rounds) << endl;
+    return hits == 0;
+}
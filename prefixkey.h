@@ -0,0 +1,219 @@
+#ifndef PREFIXKEY_H
+#define PREFIXKEY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <ostream>
+#include <functional>
+#include <utility>
+
+/**
+* A string key that keeps its first 8 bytes inline as a big-endian
+* integer next to the std::string. When a tree compares such keys, the
+* prefixes (which sit in the node itself) decide most comparisons with a
+* single integer compare. Only keys that share their first 8 bytes fall
+* back to comparing the strings, which reads their heap buffers. The
+* order is the same as std::string's.
+*
+* Use it as the Key of a BinarySearchTree/AVLTree instead of std::string.
+* With PrefixLess as the Compare, find/lower_bound/remove also take plain
+* std::string or const char* keys. The prefix helps most when keys differ
+* early: URLs that all start with "https://" have the same prefix, so a
+* map of them gains little unless the common scheme is stripped.
+*/
+class PrefixedString
+{
+public:
+    static const std::size_t PREFIX_BYTES = 8;
+
+    PrefixedString();
+    PrefixedString(const std::string& str);
+    PrefixedString(std::string&& str);
+    PrefixedString(const char* str);
+
+    const std::string& str() const;
+    uint64_t prefix() const;
+    std::size_t size() const;
+
+    static uint64_t makePrefix(const char* data, std::size_t size);
+
+private:
+    uint64_t prefix_;
+    std::string str_;
+};
+
+/*
+  ---------------------------------------------------
+  Begin implementations for the PrefixedString class.
+  ---------------------------------------------------
+*/
+
+inline PrefixedString::PrefixedString() :
+    prefix_(0)
+{
+
+}
+
+inline PrefixedString::PrefixedString(const std::string& str) :
+    prefix_(makePrefix(str.data(), str.size())),
+    str_(str)
+{
+
+}
+
+inline PrefixedString::PrefixedString(std::string&& str) :
+    prefix_(makePrefix(str.data(), str.size())),
+    str_(std::move(str))
+{
+
+}
+
+inline PrefixedString::PrefixedString(const char* str) :
+    prefix_(makePrefix(str, std::strlen(str))),
+    str_(str)
+{
+
+}
+
+/**
+* A getter for the whole string.
+*/
+inline const std::string& PrefixedString::str() const
+{
+    return str_;
+}
+
+/**
+* A getter for the first bytes of the string as a big-endian integer.
+*/
+inline uint64_t PrefixedString::prefix() const
+{
+    return prefix_;
+}
+
+inline std::size_t PrefixedString::size() const
+{
+    return str_.size();
+}
+
+/**
+* Packs the first PREFIX_BYTES bytes (as unsigned chars, zero padded)
+* most significant first, so comparing prefixes as integers orders them
+* the way std::string orders the strings. Two strings with equal
+* prefixes can still differ (later, or by trailing '\0's).
+*/
+inline uint64_t PrefixedString::makePrefix(const char* data, std::size_t size)
+{
+    unsigned char bytes[PREFIX_BYTES] = { 0 };
+    std::memcpy(bytes, data, size < PREFIX_BYTES ? size : PREFIX_BYTES);
+    uint64_t prefix = 0;
+    for(std::size_t i = 0; i < PREFIX_BYTES; ++i) {
+        prefix = (prefix << 8) | bytes[i];
+    }
+    return prefix;
+}
+
+/*
+  -------------------------------------------------
+  End implementations for the PrefixedString class.
+  -------------------------------------------------
+*/
+
+inline bool operator<(const PrefixedString& a, const PrefixedString& b)
+{
+    if(a.prefix() != b.prefix()) {
+        return a.prefix() < b.prefix();
+    }
+    return a.str() < b.str();
+}
+
+inline bool operator>(const PrefixedString& a, const PrefixedString& b)
+{
+    return b < a;
+}
+
+inline bool operator<=(const PrefixedString& a, const PrefixedString& b)
+{
+    return !(b < a);
+}
+
+inline bool operator>=(const PrefixedString& a, const PrefixedString& b)
+{
+    return !(a < b);
+}
+
+inline bool operator==(const PrefixedString& a, const PrefixedString& b)
+{
+    return a.prefix() == b.prefix() && a.str() == b.str();
+}
+
+inline bool operator!=(const PrefixedString& a, const PrefixedString& b)
+{
+    return !(a == b);
+}
+
+inline std::ostream& operator<<(std::ostream& out, const PrefixedString& key)
+{
+    return out << key.str();
+}
+
+/**
+* A transparent comparator for PrefixedString keys that also compares
+* them with std::string and const char* lookup keys. The lookup key's
+* prefix is recomputed at every comparison, but that reads only the
+* lookup key's own bytes, which stay in cache during a descent.
+*/
+struct PrefixLess
+{
+    typedef void is_transparent;
+
+    bool operator()(const PrefixedString& a, const PrefixedString& b) const
+    {
+        return a < b;
+    }
+    bool operator()(const PrefixedString& a, const std::string& b) const
+    {
+        return compare(a, b.data(), b.size()) < 0;
+    }
+    bool operator()(const std::string& a, const PrefixedString& b) const
+    {
+        return compare(b, a.data(), a.size()) > 0;
+    }
+    bool operator()(const PrefixedString& a, const char* b) const
+    {
+        return compare(a, b, std::strlen(b)) < 0;
+    }
+    bool operator()(const char* a, const PrefixedString& b) const
+    {
+        return compare(b, a, std::strlen(a)) > 0;
+    }
+
+    // <0, 0 or >0 as key is less than, equal to or greater than the string.
+    static int compare(const PrefixedString& key, const char* data, std::size_t size)
+    {
+        uint64_t prefix = PrefixedString::makePrefix(data, size);
+        if(key.prefix() != prefix) {
+            return key.prefix() < prefix ? -1 : 1;
+        }
+        return key.str().compare(0, std::string::npos, data, size);
+    }
+};
+
+namespace std
+{
+    /**
+    * Hashes like the underlying string, e.g. for ShardedAVLMap.
+    */
+    template <>
+    struct hash<PrefixedString>
+    {
+        std::size_t operator()(const PrefixedString& key) const
+        {
+            return std::hash<std::string>()(key.str());
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,104 @@
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include "avlbst.h"
+#include "rbbst.h"
+
+using namespace std;
+
+// Successful finds, only kept so the lookups cannot be optimized away.
+static long hits = 0;
+
+struct Timings
+{
+    double insert;
+    double find;
+    double remove;
+    double queue;
+};
+
+static double nanosSince(chrono::steady_clock::time_point begin, size_t ops)
+{
+    return chrono::duration<double, nano>(chrono::steady_clock::now() - begin).count() / ops;
+}
+
+/**
+* Average nanoseconds per operation for n inserts, finds and removes of
+* the keys in random order, then for n rounds of a queue table (remove
+* the smallest key, insert a new largest one) holding n keys.
+*/
+template<typename Tree>
+Timings run(const vector<int>& keys)
+{
+    size_t n = keys.size();
+    Timings timings;
+    {
+        Tree tree;
+        chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+        for(size_t i = 0; i < n; ++i) {
+            tree.insert(make_pair(keys[i], keys[i]));
+        }
+        timings.insert = nanosSince(begin, n);
+
+        begin = chrono::steady_clock::now();
+        for(size_t i = n; i > 0; --i) {
+            hits += tree.find(keys[i - 1]) != tree.end();
+        }
+        timings.find = nanosSince(begin, n);
+
+        begin = chrono::steady_clock::now();
+        for(size_t i = 0; i < n; ++i) {
+            tree.remove(keys[(i * 7919) % n]);
+        }
+        timings.remove = nanosSince(begin, n);
+    }
+    {
+        Tree tree;
+        for(size_t i = 0; i < n; ++i) {
+            tree.insert(make_pair(int(i), int(i)));
+        }
+        chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+        for(size_t i = 0; i < n; ++i) {
+            tree.remove(tree.begin()->first);
+            tree.insert(make_pair(int(n + i), int(i)));
+        }
+        timings.queue = nanosSince(begin, n);
+    }
+    return timings;
+}
+
+static void print(const char* name, const Timings& timings)
+{
+    cout << setw(14) << name << fixed << setprecision(1)
+         << setw(10) << timings.insert << setw(10) << timings.find
+         << setw(10) << timings.remove << setw(10) << timings.queue << endl;
+}
+
+/**
+* Usage: rbbst-bench [max keys]
+* Runs 1M, 10M, 100M, ... keys up to max keys (default 10M; 100M needs
+* about 10 GB of memory).
+*/
+int main(int argc, char *argv[])
+{
+    size_t maxKeys = argc > 1 ? atol(argv[1]) : 10000000;
+
+    mt19937 rng(12345);
+    cout << setw(14) << "(ns/op)" << setw(10) << "insert" << setw(10) << "find"
+         << setw(10) << "remove" << setw(10) << "queue" << endl;
+    for(size_t n = 1000000; n <= maxKeys; n *= 10) {
+        vector<int> keys(n);
+        for(size_t i = 0; i < n; ++i) {
+            keys[i] = int(i);
+        }
+        shuffle(keys.begin(), keys.end(), rng);
+        cout << n << " keys" << endl;
+        print("AVLTree", run<AVLTree<int, int> >(keys));
+        print("RedBlackTree", run<RedBlackTree<int, int> >(keys));
+    }
+    return hits == 0;
+}
@@ -0,0 +1,468 @@
+#ifndef RBBST_H
+#define RBBST_H
+
+#include <functional>
+#include <type_traits>
+#include <utility>
+#include "bst.h"
+
+/**
+* A node of a red-black tree, which adds the color to a plain Node.
+*/
+template <typename Key, typename Value>
+class RBNode : public Node<Key, Value>
+{
+public:
+    // Constructor/destructor. New nodes are red.
+    RBNode(ItemBuilder<Key, Value>& builder, RBNode<Key, Value>* parent);
+    ~RBNode();
+
+    // Getter/setter for the node's color.
+    bool isRed() const;
+    void setRed(bool red);
+
+    // Getters for parent, left, and right, which hide the Node versions
+    // just like AVLNode's do.
+    RBNode<Key, Value>* getParent() const;
+    RBNode<Key, Value>* getLeft() const;
+    RBNode<Key, Value>* getRight() const;
+
+protected:
+    bool red_;
+};
+
+/*
+  -----------------------------------------
+  Begin implementations for the RBNode class.
+  -----------------------------------------
+*/
+
+/**
+* A constructor that builds the item in place, see ItemBuilder in bst.h
+*/
+template<class Key, class Value>
+RBNode<Key, Value>::RBNode(ItemBuilder<Key, Value>& builder, RBNode<Key, Value>* parent) :
+    Node<Key, Value>(builder, parent), red_(true)
+{
+
+}
+
+/**
+* A destructor which does nothing.
+*/
+template<class Key, class Value>
+RBNode<Key, Value>::~RBNode()
+{
+
+}
+
+/**
+* A getter for the color of a RBNode.
+*/
+template<class Key, class Value>
+bool RBNode<Key, Value>::isRed() const
+{
+    return red_;
+}
+
+/**
+* A setter for the color of a RBNode.
+*/
+template<class Key, class Value>
+void RBNode<Key, Value>::setRed(bool red)
+{
+    red_ = red;
+}
+
+template<class Key, class Value>
+RBNode<Key, Value>* RBNode<Key, Value>::getParent() const
+{
+    return static_cast<RBNode<Key, Value>*>(this->parent_);
+}
+
+template<class Key, class Value>
+RBNode<Key, Value>* RBNode<Key, Value>::getLeft() const
+{
+    return static_cast<RBNode<Key, Value>*>(this->left_);
+}
+
+template<class Key, class Value>
+RBNode<Key, Value>* RBNode<Key, Value>::getRight() const
+{
+    return static_cast<RBNode<Key, Value>*>(this->right_);
+}
+
+/*
+  ---------------------------------------
+  End implementations for the RBNode class.
+  ---------------------------------------
+*/
+
+/**
+* A red-black tree, with the same interface as BinarySearchTree and
+* AVLTree<Key, Value>. Its height can be up to twice the minimum (AVL
+* keeps it within about 1.44 times), so lookups go a little deeper. In
+* exchange, an insert does at most two rotations and a remove at most
+* three, where AVLTree may rotate at every level on the way up. Most
+* fixups only recolor a few nodes.
+*
+* isBalanced() checks the AVL height condition, which a valid red-black
+* tree does not always meet.
+*/
+template <class Key, class Value, class Compare = std::less<Key> >
+class RedBlackTree : public BinarySearchTree<Key, Value, Compare>
+{
+public:
+    typedef typename BinarySearchTree<Key, Value, Compare>::iterator iterator;
+
+    RedBlackTree();
+    explicit RedBlackTree(const Compare& comp);
+    virtual ~RedBlackTree();
+
+protected:
+    static bool isRed(RBNode<Key, Value>* node);
+    void rotateRight(RBNode<Key, Value>* pivot);
+    void rotateLeft(RBNode<Key, Value>* pivot);
+    void insertFix(RBNode<Key, Value>* node);
+    void removeFix(RBNode<Key, Value>* node, RBNode<Key, Value>* parent);
+    virtual Node<Key, Value>* createNode(ItemBuilder<Key, Value>& builder, Node<Key, Value>* parent);
+    virtual void destroyNode(Node<Key, Value>* node);
+    virtual void rebalanceAfterInsert(Node<Key, Value>* node);
+    virtual void removeNode(Node<Key, Value>* node);
+    virtual void finishBuiltTree(Node<Key, Value>* root, int height);
+};
+
+/*
+  -------------------------------------------------
+  Begin implementations for the RedBlackTree class.
+  -------------------------------------------------
+*/
+
+/**
+* Default constructor, which sizes the node pool for RBNodes.
+*/
+template<class Key, class Value, class Compare>
+RedBlackTree<Key, Value, Compare>::RedBlackTree() :
+    BinarySearchTree<Key, Value, Compare>(sizeof(RBNode<Key, Value>),
+        std::is_trivially_destructible<std::pair<const Key, Value> >::value, Compare())
+{
+
+}
+
+/**
+* An empty tree ordered by the given comparator.
+*/
+template<class Key, class Value, class Compare>
+RedBlackTree<Key, Value, Compare>::RedBlackTree(const Compare& comp) :
+    BinarySearchTree<Key, Value, Compare>(sizeof(RBNode<Key, Value>),
+        std::is_trivially_destructible<std::pair<const Key, Value> >::value, comp)
+{
+
+}
+
+/**
+* Destructor, which clears the tree here so the RBNode version of
+* destroyNode is used.
+*/
+template<class Key, class Value, class Compare>
+RedBlackTree<Key, Value, Compare>::~RedBlackTree()
+{
+    this->clear();
+}
+
+/**
+* Allocates a slot from the tree's pool and constructs a (red) RBNode in it.
+*/
+template<class Key, class Value, class Compare>
+Node<Key, Value>* RedBlackTree<Key, Value, Compare>::createNode(ItemBuilder<Key, Value>& builder, Node<Key, Value>* parent)
+{
+    void* slot = this->pool().allocate();
+    try {
+        return new (slot) RBNode<Key, Value>(builder, static_cast<RBNode<Key, Value>*>(parent));
+    } catch(...) {
+        this->pool().deallocate(slot);
+        throw;
+    }
+}
+
+/**
+* Destroys a RBNode and gives its slot back to the pool.
+*/
+template<class Key, class Value, class Compare>
+void RedBlackTree<Key, Value, Compare>::destroyNode(Node<Key, Value>* node)
+{
+    static_cast<RBNode<Key, Value>*>(node)->~RBNode();
+    this->pool().deallocate(node);
+}
+
+/**
+* Empty subtrees count as black.
+*/
+template<class Key, class Value, class Compare>
+bool RedBlackTree<Key, Value, Compare>::isRed(RBNode<Key, Value>* node)
+{
+    return node != nullptr && node->isRed();
+}
+
+template<class Key, class Value, class Compare>
+void RedBlackTree<Key, Value, Compare>::rotateRight(RBNode<Key, Value>* pivot)
+{
+    //pivot is the node that becomes its left child's right child
+    if(pivot == this->root_) {
+        this->root_ = pivot->getLeft();
+    }
+    RBNode<Key, Value>* parent = pivot->getParent();
+    RBNode<Key, Value>* lChild = pivot->getLeft();
+    RBNode<Key, Value>* newLChild = lChild->getRight();
+
+    if(parent != nullptr) {
+        if(parent->getLeft() == pivot) {
+            parent->setLeft(lChild);
+        }else{
+            parent->setRight(lChild);
+        }
+    }
+    lChild->setParent(parent);
+    pivot->setParent(lChild);
+    lChild->setRight(pivot);
+    pivot->setLeft(newLChild);
+    if(newLChild != nullptr) {
+        newLChild->setParent(pivot);
+    }
+}
+
+template<class Key, class Value, class Compare>
+void RedBlackTree<Key, Value, Compare>::rotateLeft(RBNode<Key, Value>* pivot)
+{
+    //pivot is the node that becomes its right child's left child
+    if(pivot == this->root_) {
+        this->root_ = pivot->getRight();
+    }
+    RBNode<Key, Value>* parent = pivot->getParent();
+    RBNode<Key, Value>* rChild = pivot->getRight();
+    RBNode<Key, Value>* newRChild = rChild->getLeft();
+
+    if(parent != nullptr) {
+        if(parent->getLeft() == pivot) {
+            parent->setLeft(rChild);
+        }else{
+            parent->setRight(rChild);
+        }
+    }
+    rChild->setParent(parent);
+    pivot->setParent(rChild);
+    rChild->setLeft(pivot);
+    pivot->setRight(newRChild);
+    if(newRChild != nullptr) {
+        newRChild->setParent(pivot);
+    }
+}
+
+/**
+* Called by the BST insert paths once a new (red) node has been linked in.
+*/
+template<class Key, class Value, class Compare>
+void RedBlackTree<Key, Value, Compare>::rebalanceAfterInsert(Node<Key, Value>* node)
+{
+    insertFix(static_cast<RBNode<Key, Value>*>(node));
+}
+
+/**
+* Fixes a red node with a red parent: while the uncle is red too, the
+* grandparent takes the red up the tree by recoloring only; otherwise one
+* or two rotations finish the job.
+*/
+template<class Key, class Value, class Compare>
+void RedBlackTree<Key, Value, Compare>::insertFix(RBNode<Key, Value>* node)
+{
+    RBNode<Key, Value>* parent = node->getParent();
+    while(isRed(parent)) {
+        //a red parent is never the root, so the grandparent exists
+        RBNode<Key, Value>* grandparent = parent->getParent();
+        if(parent == grandparent->getLeft()) {
+            RBNode<Key, Value>* uncle = grandparent->getRight();
+            if(isRed(uncle)) {
+                parent->setRed(false);
+                uncle->setRed(false);
+                grandparent->setRed(true);
+                node = grandparent;
+                parent = node->getParent();
+                continue;
+            }
+            if(node == parent->getRight()) {
+                rotateLeft(parent);
+                node = parent;
+                parent = node->getParent();
+            }
+            parent->setRed(false);
+            grandparent->setRed(true);
+            rotateRight(grandparent);
+        }else{
+            RBNode<Key, Value>* uncle = grandparent->getLeft();
+            if(isRed(uncle)) {
+                parent->setRed(false);
+                uncle->setRed(false);
+                grandparent->setRed(true);
+                node = grandparent;
+                parent = node->getParent();
+                continue;
+            }
+            if(node == parent->getLeft()) {
+                rotateRight(parent);
+                node = parent;
+                parent = node->getParent();
+            }
+            parent->setRed(false);
+            grandparent->setRed(true);
+            rotateLeft(grandparent);
+        }
+        break;
+    }
+    static_cast<RBNode<Key, Value>*>(this->root_)->setRed(false);
+}
+
+/**
+* Swaps a node with two children with its predecessor (colors stay with
+* the positions), then unlinks it through the plain BST removal. Taking
+* out a black node leaves its side one black short, which removeFix
+* repairs.
+*/
+template<class Key, class Value, class Compare>
+void RedBlackTree<Key, Value, Compare>::removeNode(Node<Key, Value>* node)
+{
+    RBNode<Key, Value>* temp = static_cast<RBNode<Key, Value>*>(node);
+    if(temp->getLeft() != nullptr && temp->getRight() != nullptr) {
+        RBNode<Key, Value>* pred = static_cast<RBNode<Key, Value>*>(
+            BinarySearchTree<Key, Value, Compare>::predecessor(temp));
+        this->nodeSwap(temp, pred);
+        if(this->root_ == temp) {
+            this->root_ = pred;
+        }
+        bool red = temp->isRed();
+        temp->setRed(pred->isRed());
+        pred->setRed(red);
+    }
+
+    bool wasRed = temp->isRed();
+    RBNode<Key, Value>* parent = temp->getParent();
+    RBNode<Key, Value>* child = temp->getLeft() != nullptr ? temp->getLeft() : temp->getRight();
+    //temp has at most one child now, so this only relinks it
+    BinarySearchTree<Key, Value, Compare>::removeNode(temp);
+    if(wasRed) {
+        return;
+    }
+    if(isRed(child)) {
+        child->setRed(false);
+        return;
+    }
+    removeFix(child, parent);
+}
+
+/**
+* node (possibly empty, below parent) is one black short of its sibling.
+* A red sibling is rotated up first; then either the sibling can turn red
+* and the shortage moves up to parent, or one or two more rotations end
+* it. At most three rotations in all.
+*/
+template<class Key, class Value, class Compare>
+void RedBlackTree<Key, Value, Compare>::removeFix(RBNode<Key, Value>* node, RBNode<Key, Value>* parent)
+{
+    while(parent != nullptr && !isRed(node)) {
+        if(node == parent->getLeft()) {
+            RBNode<Key, Value>* sibling = parent->getRight();
+            if(sibling->isRed()) {
+                sibling->setRed(false);
+                parent->setRed(true);
+                rotateLeft(parent);
+                sibling = parent->getRight();
+            }
+            if(!isRed(sibling->getLeft()) && !isRed(sibling->getRight())) {
+                sibling->setRed(true);
+                node = parent;
+                parent = node->getParent();
+                continue;
+            }
+            if(!isRed(sibling->getRight())) {
+                sibling->getLeft()->setRed(false);
+                sibling->setRed(true);
+                rotateRight(sibling);
+                sibling = parent->getRight();
+            }
+            sibling->setRed(parent->isRed());
+            parent->setRed(false);
+            sibling->getRight()->setRed(false);
+            rotateLeft(parent);
+        }else{
+            RBNode<Key, Value>* sibling = parent->getLeft();
+            if(sibling->isRed()) {
+                sibling->setRed(false);
+                parent->setRed(true);
+                rotateRight(parent);
+                sibling = parent->getLeft();
+            }
+            if(!isRed(sibling->getLeft()) && !isRed(sibling->getRight())) {
+                sibling->setRed(true);
+                node = parent;
+                parent = node->getParent();
+                continue;
+            }
+            if(!isRed(sibling->getLeft())) {
+                sibling->getRight()->setRed(false);
+                sibling->setRed(true);
+                rotateLeft(sibling);
+                sibling = parent->getLeft();
+            }
+            sibling->setRed(parent->isRed());
+            parent->setRed(false);
+            sibling->getLeft()->setRed(false);
+            rotateRight(parent);
+        }
+        return;
+    }
+    if(node != nullptr) {
+        node->setRed(false);
+    }
+}
+
+/**
+* assign_sorted and rebalance() build a tree whose leaves are all on the
+* last two levels. Every node is colored black except those on the last
+* level, which makes every path count the same number of black nodes.
+* The walk follows the parent pointers and tracks the depth as it goes,
+* so it needs no extra memory.
+*/
+template<class Key, class Value, class Compare>
+void RedBlackTree<Key, Value, Compare>::finishBuiltTree(Node<Key, Value>* root, int height)
+{
+    Node<Key, Value>* prev = nullptr;
+    Node<Key, Value>* node = root;
+    int depth = 1;
+    while(node != nullptr) {
+        Node<Key, Value>* next = nullptr;
+        if(prev == node->getParent()) {
+            static_cast<RBNode<Key, Value>*>(node)->setRed(depth == height && depth > 1);
+            next = node->getLeft() != nullptr ? node->getLeft() : node->getRight();
+        }else if(prev == node->getLeft()) {
+            next = node->getRight();
+        }
+        if(next == nullptr) {
+            if(node == root) {
+                return;
+            }
+            next = node->getParent();
+            --depth;
+        }else{
+            ++depth;
+        }
+        prev = node;
+        node = next;
+    }
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the RedBlackTree class.
+  -----------------------------------------------
+*/
+
+#endif
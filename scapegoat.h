@@ -0,0 +1,197 @@
+#ifndef SCAPEGOAT_H
+#define SCAPEGOAT_H
+
+#include <cmath>
+#include <cstddef>
+#include <functional>
+#include <stdexcept>
+#include <algorithm>
+#include "bst.h"
+
+/**
+* A BinarySearchTree that rebuilds itself where it gets too deep
+* (Galperin and Rivest's scapegoat trees). It keeps plain Nodes, with no
+* balance data per node, and only tracks the number of items n and the
+* largest n since the last full rebuild. When an insert ends deeper than
+* log(n) / log(1 / alpha), it walks back up to the lowest ancestor whose
+* larger child holds more than alpha of its items. That ancestor's
+* subtree is rebuilt into a perfectly balanced one (treeToVine, then
+* buildFromVine). When removals shrink n below alpha times the largest
+* n, the whole tree is rebuilt. Sorted input then costs amortized
+* O(log n) per operation instead of degrading into a list.
+*
+* alpha, between 0.5 and 1 (default 2/3), trades rebuild work for lower
+* depth: lookups never go deeper than log(n) / log(1 / alpha) + 1 levels.
+*/
+template <class Key, class Value, class Compare = std::less<Key> >
+class ScapegoatTree : public BinarySearchTree<Key, Value, Compare>
+{
+public:
+    typedef typename BinarySearchTree<Key, Value, Compare>::iterator iterator;
+
+    ScapegoatTree();
+    explicit ScapegoatTree(const Compare& comp);
+    explicit ScapegoatTree(double alpha, const Compare& comp = Compare());
+
+    std::size_t size() const;
+    double alpha() const;
+
+protected:
+    static std::size_t subtreeSize(Node<Key, Value>* node);
+    virtual void rebalanceAfterInsert(Node<Key, Value>* node);
+    virtual void removeNode(Node<Key, Value>* node);
+    virtual void finishBuiltTree(Node<Key, Value>* root, int height);
+
+    double alpha_;
+    double logInverseAlpha_;
+    std::size_t size_;
+    std::size_t maxSize_;
+};
+
+/*
+  --------------------------------------------------
+  Begin implementations for the ScapegoatTree class.
+  --------------------------------------------------
+*/
+
+template<class Key, class Value, class Compare>
+ScapegoatTree<Key, Value, Compare>::ScapegoatTree() :
+    BinarySearchTree<Key, Value, Compare>(),
+    alpha_(2.0 / 3),
+    logInverseAlpha_(std::log(1.5)),
+    size_(0),
+    maxSize_(0)
+{
+
+}
+
+/**
+* An empty tree ordered by the given comparator.
+*/
+template<class Key, class Value, class Compare>
+ScapegoatTree<Key, Value, Compare>::ScapegoatTree(const Compare& comp) :
+    BinarySearchTree<Key, Value, Compare>(comp),
+    alpha_(2.0 / 3),
+    logInverseAlpha_(std::log(1.5)),
+    size_(0),
+    maxSize_(0)
+{
+
+}
+
+/**
+* An empty tree with the given balance factor; throws
+* std::invalid_argument unless 0.5 < alpha < 1.
+*/
+template<class Key, class Value, class Compare>
+ScapegoatTree<Key, Value, Compare>::ScapegoatTree(double alpha, const Compare& comp) :
+    BinarySearchTree<Key, Value, Compare>(comp),
+    alpha_(alpha),
+    logInverseAlpha_(0),
+    size_(0),
+    maxSize_(0)
+{
+    if(!(alpha > 0.5 && alpha < 1)) {
+        throw std::invalid_argument("ScapegoatTree: alpha must be between 0.5 and 1");
+    }
+    logInverseAlpha_ = std::log(1 / alpha);
+}
+
+/**
+* The number of items, in O(1).
+*/
+template<class Key, class Value, class Compare>
+std::size_t ScapegoatTree<Key, Value, Compare>::size() const
+{
+    return this->root_ == nullptr ? 0 : size_;
+}
+
+template<class Key, class Value, class Compare>
+double ScapegoatTree<Key, Value, Compare>::alpha() const
+{
+    return alpha_;
+}
+
+/**
+* Counts the nodes of a subtree. Its depth is bounded by the tree's, so
+* the recursion stays shallow.
+*/
+template<class Key, class Value, class Compare>
+std::size_t ScapegoatTree<Key, Value, Compare>::subtreeSize(Node<Key, Value>* node)
+{
+    if(node == nullptr) {
+        return 0;
+    }
+    return 1 + subtreeSize(node->getLeft()) + subtreeSize(node->getRight());
+}
+
+/**
+* Counts the new node and, if it landed too deep, rebuilds the subtree of
+* its scapegoat. Sizes are only counted on the way up from a deep node,
+* which the amortized analysis pays for.
+*/
+template<class Key, class Value, class Compare>
+void ScapegoatTree<Key, Value, Compare>::rebalanceAfterInsert(Node<Key, Value>* node)
+{
+    if(node == this->root_) {
+        //also covers a tree emptied by clear(), which this tree cannot see
+        size_ = 0;
+        maxSize_ = 0;
+    }
+    ++size_;
+    maxSize_ = std::max(maxSize_, size_);
+
+    int depth = 0;
+    for(Node<Key, Value>* temp = node->getParent(); temp != nullptr; temp = temp->getParent()) {
+        ++depth;
+    }
+    if(depth <= std::log(double(size_)) / logInverseAlpha_) {
+        return;
+    }
+
+    std::size_t childSize = 1;
+    Node<Key, Value>* child = node;
+    for(Node<Key, Value>* parent = node->getParent(); parent != nullptr; parent = parent->getParent()) {
+        Node<Key, Value>* sibling = parent->getLeft() == child ? parent->getRight() : parent->getLeft();
+        std::size_t parentSize = childSize + 1 + subtreeSize(sibling);
+        if(childSize > alpha_ * parentSize) {
+            this->rebuildSubtree(parent);
+            return;
+        }
+        child = parent;
+        childSize = parentSize;
+    }
+}
+
+/**
+* Removes the node as in a plain BST, rebuilding the whole tree once
+* enough items are gone that its depth bound has loosened.
+*/
+template<class Key, class Value, class Compare>
+void ScapegoatTree<Key, Value, Compare>::removeNode(Node<Key, Value>* node)
+{
+    BinarySearchTree<Key, Value, Compare>::removeNode(node);
+    --size_;
+    if(this->root_ != nullptr && size_ < alpha_ * maxSize_) {
+        this->rebuildSubtree(this->root_);
+    }
+}
+
+/**
+* Whole-tree builds (assign_sorted, or the rebuild after removals) leave
+* the tree perfectly balanced, so counting starts over from its size.
+*/
+template<class Key, class Value, class Compare>
+void ScapegoatTree<Key, Value, Compare>::finishBuiltTree(Node<Key, Value>* root, int height)
+{
+    size_ = subtreeSize(root);
+    maxSize_ = size_;
+}
+
+/*
+  ------------------------------------------------
+  End implementations for the ScapegoatTree class.
+  ------------------------------------------------
+*/
+
+#endif
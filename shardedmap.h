@@ -0,0 +1,449 @@
+#ifndef SHARDEDMAP_H
+#define SHARDEDMAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <pthread.h>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+#include <vector>
+#include "avlbst.h"
+
+/**
+* A reader-writer lock. C++11 has no std::shared_mutex, so this wraps
+* pthread_rwlock_t. lock()/unlock() work with std::lock_guard; the
+* shared side goes through SharedLockGuard.
+*/
+class RWLock
+{
+public:
+    RWLock();
+    ~RWLock();
+
+    void lock();
+    void unlock();
+    void lock_shared();
+    void unlock_shared();
+
+private:
+    RWLock(const RWLock&) = delete;
+    RWLock& operator=(const RWLock&) = delete;
+
+    pthread_rwlock_t lock_;
+};
+
+/**
+* Holds an RWLock in shared mode for its lifetime.
+*/
+class SharedLockGuard
+{
+public:
+    explicit SharedLockGuard(RWLock& lock) : lock_(lock) { lock_.lock_shared(); }
+    ~SharedLockGuard() { lock_.unlock_shared(); }
+
+private:
+    SharedLockGuard(const SharedLockGuard&) = delete;
+    SharedLockGuard& operator=(const SharedLockGuard&) = delete;
+
+    RWLock& lock_;
+};
+
+/*
+  -------------------------------------------
+  Begin implementations for the RWLock class.
+  -------------------------------------------
+*/
+
+inline RWLock::RWLock()
+{
+    int error = pthread_rwlock_init(&lock_, NULL);
+    if(error != 0) {
+        throw std::system_error(error, std::system_category(), "pthread_rwlock_init");
+    }
+}
+
+inline RWLock::~RWLock()
+{
+    pthread_rwlock_destroy(&lock_);
+}
+
+inline void RWLock::lock()
+{
+    int error = pthread_rwlock_wrlock(&lock_);
+    if(error != 0) {
+        throw std::system_error(error, std::system_category(), "pthread_rwlock_wrlock");
+    }
+}
+
+inline void RWLock::unlock()
+{
+    pthread_rwlock_unlock(&lock_);
+}
+
+inline void RWLock::lock_shared()
+{
+    int error = pthread_rwlock_rdlock(&lock_);
+    if(error != 0) {
+        throw std::system_error(error, std::system_category(), "pthread_rwlock_rdlock");
+    }
+}
+
+inline void RWLock::unlock_shared()
+{
+    pthread_rwlock_unlock(&lock_);
+}
+
+/*
+  -----------------------------------------
+  End implementations for the RWLock class.
+  -----------------------------------------
+*/
+
+/**
+* A map for many threads, made of independent AVLTree shards. A key's
+* hash picks its shard, and each shard has its own reader-writer lock.
+* Threads working on different shards never wait for each other, and
+* lookups within one shard share its lock.
+*
+* The batched insert/remove/find sort their keys by shard first and take
+* each shard's lock once for all of its keys. forEach() visits every
+* item in key order by merging the shards (a k-way merge over their
+* iterators) while holding all of their read locks.
+*
+* size() and forEach() lock the shards one after another or all at once
+* respectively; callbacks must not call back into the same map.
+*/
+template <typename Key, typename Value, typename Hash = std::hash<Key> >
+class ShardedAVLMap
+{
+public:
+    typedef std::pair<const Key, Value> value_type;
+
+    explicit ShardedAVLMap(std::size_t shards = 16);
+
+    bool insert(const value_type& keyValuePair);
+    bool remove(const Key& key);
+    bool find(const Key& key, Value& value) const;
+    bool contains(const Key& key) const;
+    void clear();
+    std::size_t size() const;
+    bool empty() const;
+    std::size_t shardCount() const;
+
+    template<typename ForwardIt>
+    std::size_t insert(ForwardIt first, ForwardIt last);
+    template<typename ForwardIt>
+    std::size_t remove(ForwardIt first, ForwardIt last);
+    template<typename ForwardIt, typename Fn>
+    std::size_t find(ForwardIt first, ForwardIt last, Fn fn) const;
+
+    template<typename Fn>
+    void forEach(Fn fn) const;
+
+protected:
+    ShardedAVLMap(const ShardedAVLMap&) = delete;
+    ShardedAVLMap& operator=(const ShardedAVLMap&) = delete;
+
+    struct Shard
+    {
+        Shard() : count(0) {}
+        mutable RWLock lock;
+        AVLTree<Key, Value> tree;
+        std::size_t count;      // AVLTree only counts its nodes with OrderStatistics
+    };
+
+    std::size_t shardIndex(const Key& key) const;
+    bool insertLocked(Shard& shard, const value_type& keyValuePair);
+    bool removeLocked(Shard& shard, const Key& key);
+    template<typename ForwardIt, typename GetKey>
+    std::vector<std::vector<ForwardIt> > bucket(ForwardIt first, ForwardIt last, GetKey getKey) const;
+
+    std::vector<std::unique_ptr<Shard> > shards_;
+    Hash hash_;
+};
+
+/*
+  --------------------------------------------------
+  Begin implementations for the ShardedAVLMap class.
+  --------------------------------------------------
+*/
+
+/**
+* Creates an empty map with the given number of shards (at least one).
+*/
+template<typename Key, typename Value, typename Hash>
+ShardedAVLMap<Key, Value, Hash>::ShardedAVLMap(std::size_t shards)
+{
+    if(shards == 0) {
+        throw std::invalid_argument("ShardedAVLMap needs at least one shard");
+    }
+    for(std::size_t i = 0; i < shards; ++i) {
+        shards_.push_back(std::unique_ptr<Shard>(new Shard()));
+    }
+}
+
+/**
+* Inserts the pair or overwrites the value of an existing key. Returns
+* true if the key was new.
+*/
+template<typename Key, typename Value, typename Hash>
+bool ShardedAVLMap<Key, Value, Hash>::insert(const value_type& keyValuePair)
+{
+    Shard& shard = *shards_[shardIndex(keyValuePair.first)];
+    std::lock_guard<RWLock> lock(shard.lock);
+    return insertLocked(shard, keyValuePair);
+}
+
+/**
+* Removes the key. Returns false if it was not there.
+*/
+template<typename Key, typename Value, typename Hash>
+bool ShardedAVLMap<Key, Value, Hash>::remove(const Key& key)
+{
+    Shard& shard = *shards_[shardIndex(key)];
+    std::lock_guard<RWLock> lock(shard.lock);
+    return removeLocked(shard, key);
+}
+
+/**
+* Copies the value for key into value and returns true, or returns false
+* if the key is missing.
+*/
+template<typename Key, typename Value, typename Hash>
+bool ShardedAVLMap<Key, Value, Hash>::find(const Key& key, Value& value) const
+{
+    const Shard& shard = *shards_[shardIndex(key)];
+    SharedLockGuard lock(shard.lock);
+    typename AVLTree<Key, Value>::iterator it = shard.tree.find(key);
+    if(it == shard.tree.end()) {
+        return false;
+    }
+    value = it->second;
+    return true;
+}
+
+template<typename Key, typename Value, typename Hash>
+bool ShardedAVLMap<Key, Value, Hash>::contains(const Key& key) const
+{
+    const Shard& shard = *shards_[shardIndex(key)];
+    SharedLockGuard lock(shard.lock);
+    return shard.tree.find(key) != shard.tree.end();
+}
+
+template<typename Key, typename Value, typename Hash>
+void ShardedAVLMap<Key, Value, Hash>::clear()
+{
+    for(std::size_t i = 0; i < shards_.size(); ++i) {
+        std::lock_guard<RWLock> lock(shards_[i]->lock);
+        shards_[i]->tree.clear();
+        shards_[i]->count = 0;
+    }
+}
+
+/**
+* The number of items, summed shard by shard (so only a snapshot of each
+* shard, not of the whole map, while other threads are updating it).
+*/
+template<typename Key, typename Value, typename Hash>
+std::size_t ShardedAVLMap<Key, Value, Hash>::size() const
+{
+    std::size_t total = 0;
+    for(std::size_t i = 0; i < shards_.size(); ++i) {
+        SharedLockGuard lock(shards_[i]->lock);
+        total += shards_[i]->count;
+    }
+    return total;
+}
+
+template<typename Key, typename Value, typename Hash>
+bool ShardedAVLMap<Key, Value, Hash>::empty() const
+{
+    return size() == 0;
+}
+
+template<typename Key, typename Value, typename Hash>
+std::size_t ShardedAVLMap<Key, Value, Hash>::shardCount() const
+{
+    return shards_.size();
+}
+
+/**
+* Inserts (or overwrites) every pair in the range, locking each shard
+* once. Returns how many keys were new.
+*/
+template<typename Key, typename Value, typename Hash>
+template<typename ForwardIt>
+std::size_t ShardedAVLMap<Key, Value, Hash>::insert(ForwardIt first, ForwardIt last)
+{
+    std::vector<std::vector<ForwardIt> > buckets =
+        bucket(first, last, [](const value_type& item) -> const Key& { return item.first; });
+    std::size_t added = 0;
+    for(std::size_t i = 0; i < buckets.size(); ++i) {
+        if(buckets[i].empty()) {
+            continue;
+        }
+        std::lock_guard<RWLock> lock(shards_[i]->lock);
+        for(std::size_t j = 0; j < buckets[i].size(); ++j) {
+            added += insertLocked(*shards_[i], *buckets[i][j]);
+        }
+    }
+    return added;
+}
+
+/**
+* Removes every key in the range, locking each shard once. Returns how
+* many were found.
+*/
+template<typename Key, typename Value, typename Hash>
+template<typename ForwardIt>
+std::size_t ShardedAVLMap<Key, Value, Hash>::remove(ForwardIt first, ForwardIt last)
+{
+    std::vector<std::vector<ForwardIt> > buckets =
+        bucket(first, last, [](const Key& key) -> const Key& { return key; });
+    std::size_t removed = 0;
+    for(std::size_t i = 0; i < buckets.size(); ++i) {
+        if(buckets[i].empty()) {
+            continue;
+        }
+        std::lock_guard<RWLock> lock(shards_[i]->lock);
+        for(std::size_t j = 0; j < buckets[i].size(); ++j) {
+            removed += removeLocked(*shards_[i], *buckets[i][j]);
+        }
+    }
+    return removed;
+}
+
+/**
+* Looks up every key in the range, taking each shard's read lock once,
+* and calls fn(item) for each one found (with that lock held). Items are
+* visited shard by shard, not in the order of the range. Returns how
+* many were found.
+*/
+template<typename Key, typename Value, typename Hash>
+template<typename ForwardIt, typename Fn>
+std::size_t ShardedAVLMap<Key, Value, Hash>::find(ForwardIt first, ForwardIt last, Fn fn) const
+{
+    std::vector<std::vector<ForwardIt> > buckets =
+        bucket(first, last, [](const Key& key) -> const Key& { return key; });
+    std::size_t found = 0;
+    for(std::size_t i = 0; i < buckets.size(); ++i) {
+        if(buckets[i].empty()) {
+            continue;
+        }
+        const Shard& shard = *shards_[i];
+        SharedLockGuard lock(shard.lock);
+        for(std::size_t j = 0; j < buckets[i].size(); ++j) {
+            typename AVLTree<Key, Value>::iterator it = shard.tree.find(*buckets[i][j]);
+            if(it != shard.tree.end()) {
+                const value_type& item = *it;
+                fn(item);
+                ++found;
+            }
+        }
+    }
+    return found;
+}
+
+/**
+* Calls fn(item) for every item in key order. All shards are read-locked
+* for the duration, so this sees one consistent state of the map.
+*/
+template<typename Key, typename Value, typename Hash>
+template<typename Fn>
+void ShardedAVLMap<Key, Value, Hash>::forEach(Fn fn) const
+{
+    typedef typename AVLTree<Key, Value>::iterator TreeIterator;
+    typedef std::pair<TreeIterator, std::size_t> Cursor;   // position and shard
+
+    std::vector<std::unique_ptr<SharedLockGuard> > locks;
+    for(std::size_t i = 0; i < shards_.size(); ++i) {
+        locks.push_back(std::unique_ptr<SharedLockGuard>(new SharedLockGuard(shards_[i]->lock)));
+    }
+
+    //min-heap on the key each shard's cursor is at
+    auto later = [](const Cursor& a, const Cursor& b) { return b.first->first < a.first->first; };
+    std::priority_queue<Cursor, std::vector<Cursor>, decltype(later)> heads(later);
+    for(std::size_t i = 0; i < shards_.size(); ++i) {
+        if(!shards_[i]->tree.empty()) {
+            heads.push(Cursor(shards_[i]->tree.begin(), i));
+        }
+    }
+    while(!heads.empty()) {
+        Cursor cursor = heads.top();
+        heads.pop();
+        const value_type& item = *cursor.first;
+        fn(item);
+        if(++cursor.first != shards_[cursor.second]->tree.end()) {
+            heads.push(cursor);
+        }
+    }
+}
+
+/**
+* Picks the shard for a key. The hash is mixed first since std::hash is
+* the identity for integers, which would put runs of keys on one shard.
+*/
+template<typename Key, typename Value, typename Hash>
+std::size_t ShardedAVLMap<Key, Value, Hash>::shardIndex(const Key& key) const
+{
+    uint64_t h = static_cast<uint64_t>(hash_(key));
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return static_cast<std::size_t>(h % shards_.size());
+}
+
+/**
+* Inserts into a shard whose write lock is held.
+*/
+template<typename Key, typename Value, typename Hash>
+bool ShardedAVLMap<Key, Value, Hash>::insertLocked(Shard& shard, const value_type& keyValuePair)
+{
+    bool added = shard.tree.insert_or_assign(keyValuePair.first, keyValuePair.second).second;
+    if(added) {
+        ++shard.count;
+    }
+    return added;
+}
+
+/**
+* Removes from a shard whose write lock is held.
+*/
+template<typename Key, typename Value, typename Hash>
+bool ShardedAVLMap<Key, Value, Hash>::removeLocked(Shard& shard, const Key& key)
+{
+    if(shard.tree.find(key) == shard.tree.end()) {
+        return false;
+    }
+    shard.tree.remove(key);
+    --shard.count;
+    return true;
+}
+
+/**
+* Groups the positions in [first, last) by the shard of their key.
+*/
+template<typename Key, typename Value, typename Hash>
+template<typename ForwardIt, typename GetKey>
+std::vector<std::vector<ForwardIt> >
+ShardedAVLMap<Key, Value, Hash>::bucket(ForwardIt first, ForwardIt last, GetKey getKey) const
+{
+    std::vector<std::vector<ForwardIt> > buckets(shards_.size());
+    for(; first != last; ++first) {
+        buckets[shardIndex(getKey(*first))].push_back(first);
+    }
+    return buckets;
+}
+
+/*
+  ------------------------------------------------
+  End implementations for the ShardedAVLMap class.
+  ------------------------------------------------
+*/
+
+#endif
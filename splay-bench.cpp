@@ -0,0 +1,101 @@
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+#include "avlbst.h"
+#include "splay.h"
+
+using namespace std;
+
+// Successful finds, only kept so the lookups cannot be optimized away.
+static long hits = 0;
+
+/**
+* Draws n lookups from keys, where the key of popularity rank r (the
+* keys are in random rank order) is picked with probability proportional
+* to 1 / (r + 1)^skew. skew 0 is uniform; around 1 the top 5% of the keys
+* get most of the lookups.
+*/
+vector<int> zipfLookups(const vector<int>& keys, double skew, size_t n, mt19937& rng)
+{
+    vector<double> cdf(keys.size());
+    double sum = 0;
+    for(size_t r = 0; r < keys.size(); ++r) {
+        sum += 1.0 / pow(double(r + 1), skew);
+        cdf[r] = sum;
+    }
+    uniform_real_distribution<double> uniform(0, sum);
+    vector<int> lookups(n);
+    for(size_t i = 0; i < n; ++i) {
+        size_t r = upper_bound(cdf.begin(), cdf.end(), uniform(rng)) - cdf.begin();
+        lookups[i] = keys[min(r, keys.size() - 1)];
+    }
+    return lookups;
+}
+
+/**
+* The share of the lookups that go to the most popular 5% of the keys.
+*/
+double hotShare(const vector<int>& keys, const vector<int>& lookups)
+{
+    vector<int> hot(keys.begin(), keys.begin() + max<size_t>(1, keys.size() / 20));
+    sort(hot.begin(), hot.end());
+    size_t count = 0;
+    for(size_t i = 0; i < lookups.size(); ++i) {
+        count += binary_search(hot.begin(), hot.end(), lookups[i]);
+    }
+    return double(count) / lookups.size();
+}
+
+/**
+* Average nanoseconds per find over the lookups.
+*/
+template<typename Tree>
+double run(const vector<int>& keys, const vector<int>& lookups)
+{
+    Tree tree;
+    for(size_t i = 0; i < keys.size(); ++i) {
+        tree.insert(make_pair(keys[i], keys[i]));
+    }
+    chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+    for(size_t i = 0; i < lookups.size(); ++i) {
+        hits += tree.find(lookups[i]) != tree.end();
+    }
+    double elapsed = chrono::duration<double, nano>(chrono::steady_clock::now() - begin).count();
+    return elapsed / lookups.size();
+}
+
+/**
+* Usage: splay-bench [keys] [lookups]
+*/
+int main(int argc, char *argv[])
+{
+    size_t n = argc > 1 ? atol(argv[1]) : 1000000;
+    size_t lookupCount = argc > 2 ? atol(argv[2]) : 4000000;
+
+    mt19937 rng(12345);
+    vector<int> keys(n);
+    for(size_t i = 0; i < n; ++i) {
+        keys[i] = int(i);
+    }
+    shuffle(keys.begin(), keys.end(), rng);
+
+    cout << n << " keys, " << lookupCount << " finds per run, Zipfian popularity" << endl;
+    cout << setw(8) << "skew" << setw(12) << "top 5%" << setw(14) << "AVLTree" << setw(14) << "SplayTree"
+         << "   (ns/find)" << endl;
+    const double skews[] = { 0.0, 0.8, 0.99, 1.2, 1.5 };
+    for(size_t i = 0; i < sizeof(skews) / sizeof(skews[0]); ++i) {
+        vector<int> lookups = zipfLookups(keys, skews[i], lookupCount, rng);
+        double avl = run<AVLTree<int, int> >(keys, lookups);
+        double splay = run<SplayTree<int, int> >(keys, lookups);
+        cout << fixed << setprecision(2) << setw(8) << skews[i] << setprecision(1)
+             << setw(11) << 100 * hotShare(keys, lookups) << "%"
+             << setw(14) << avl << setw(14) << splay << endl;
+    }
+    return hits == 0;
+}
@@ -0,0 +1,235 @@
+#ifndef SPLAY_H
+#define SPLAY_H
+
+#include <functional>
+#include "bst.h"
+
+/**
+* A self-adjusting search tree (Sleator and Tarjan). Every node that is
+* found with find(), inserted or overwritten is rotated up to the root,
+* so keys that are used often stay near the top, and on a skewed access
+* mix most lookups end after a few levels. Operations are amortized
+* O(log n), but a single one can take O(n). The nodes are plain Nodes
+* without balance data.
+*
+* Since find() changes the shape, a SplayTree must not be searched from
+* several threads at once. Through a const reference, find() and the
+* other lookups (lower_bound, try_emplace/operator[] on an existing key)
+* search without splaying.
+*/
+template <class Key, class Value, class Compare = std::less<Key> >
+class SplayTree : public BinarySearchTree<Key, Value, Compare>
+{
+public:
+    typedef typename BinarySearchTree<Key, Value, Compare>::iterator iterator;
+
+    SplayTree();
+    explicit SplayTree(const Compare& comp);
+
+    iterator find(const Key& key);
+    using BinarySearchTree<Key, Value, Compare>::find;
+
+protected:
+    void splay(Node<Key, Value>* node);
+    void rotateRight(Node<Key, Value>* pivot);
+    void rotateLeft(Node<Key, Value>* pivot);
+    virtual void rebalanceAfterInsert(Node<Key, Value>* node);
+    virtual void valueChanged(Node<Key, Value>* node);
+    virtual void removeNode(Node<Key, Value>* node);
+};
+
+/*
+  ----------------------------------------------
+  Begin implementations for the SplayTree class.
+  ----------------------------------------------
+*/
+
+template<class Key, class Value, class Compare>
+SplayTree<Key, Value, Compare>::SplayTree() :
+    BinarySearchTree<Key, Value, Compare>()
+{
+
+}
+
+/**
+* An empty tree ordered by the given comparator.
+*/
+template<class Key, class Value, class Compare>
+SplayTree<Key, Value, Compare>::SplayTree(const Compare& comp) :
+    BinarySearchTree<Key, Value, Compare>(comp)
+{
+
+}
+
+/**
+* Looks up key like BinarySearchTree::find, then splays the node found
+* (or, if key is missing, the last node on the search path, so repeated
+* misses in one area get cheaper as well).
+*/
+template<class Key, class Value, class Compare>
+typename SplayTree<Key, Value, Compare>::iterator
+SplayTree<Key, Value, Compare>::find(const Key& key)
+{
+    Node<Key, Value>* last = nullptr;
+    Node<Key, Value>* candidate = nullptr;
+    Node<Key, Value>* temp = this->root_;
+    while(temp != nullptr) {
+        last = temp;
+        if(this->comp_(temp->getKey(), key)) {
+            temp = temp->getRight();
+        }else{
+            candidate = temp;
+            temp = temp->getLeft();
+        }
+    }
+    if(candidate != nullptr && !this->comp_(key, candidate->getKey())) {
+        splay(candidate);
+        return this->makeIterator(candidate);
+    }
+    if(last != nullptr) {
+        splay(last);
+    }
+    return this->end();
+}
+
+/**
+* Rotates node up to the root: zig-zig steps rotate the grandparent
+* first, zig-zag steps the parent, which is what halves the depth of the
+* nodes along the way.
+*/
+template<class Key, class Value, class Compare>
+void SplayTree<Key, Value, Compare>::splay(Node<Key, Value>* node)
+{
+    while(node->getParent() != nullptr) {
+        Node<Key, Value>* parent = node->getParent();
+        Node<Key, Value>* grandparent = parent->getParent();
+        bool isLeft = parent->getLeft() == node;
+        if(grandparent == nullptr) {
+            //zig
+            if(isLeft) {
+                rotateRight(parent);
+            }else{
+                rotateLeft(parent);
+            }
+        }else if((grandparent->getLeft() == parent) == isLeft) {
+            //zig-zig
+            if(isLeft) {
+                rotateRight(grandparent);
+                rotateRight(parent);
+            }else{
+                rotateLeft(grandparent);
+                rotateLeft(parent);
+            }
+        }else{
+            //zig-zag
+            if(isLeft) {
+                rotateRight(parent);
+                rotateLeft(grandparent);
+            }else{
+                rotateLeft(parent);
+                rotateRight(grandparent);
+            }
+        }
+    }
+}
+
+template<class Key, class Value, class Compare>
+void SplayTree<Key, Value, Compare>::rotateRight(Node<Key, Value>* pivot)
+{
+    //pivot is the node that becomes its left child's right child
+    if(pivot == this->root_) {
+        this->root_ = pivot->getLeft();
+    }
+    Node<Key, Value>* parent = pivot->getParent();
+    Node<Key, Value>* lChild = pivot->getLeft();
+    Node<Key, Value>* newLChild = lChild->getRight();
+
+    if(parent != nullptr) {
+        if(parent->getLeft() == pivot) {
+            parent->setLeft(lChild);
+        }else{
+            parent->setRight(lChild);
+        }
+    }
+    lChild->setParent(parent);
+    pivot->setParent(lChild);
+    lChild->setRight(pivot);
+    pivot->setLeft(newLChild);
+    if(newLChild != nullptr) {
+        newLChild->setParent(pivot);
+    }
+}
+
+template<class Key, class Value, class Compare>
+void SplayTree<Key, Value, Compare>::rotateLeft(Node<Key, Value>* pivot)
+{
+    //pivot is the node that becomes its right child's left child
+    if(pivot == this->root_) {
+        this->root_ = pivot->getRight();
+    }
+    Node<Key, Value>* parent = pivot->getParent();
+    Node<Key, Value>* rChild = pivot->getRight();
+    Node<Key, Value>* newRChild = rChild->getLeft();
+
+    if(parent != nullptr) {
+        if(parent->getLeft() == pivot) {
+            parent->setLeft(rChild);
+        }else{
+            parent->setRight(rChild);
+        }
+    }
+    rChild->setParent(parent);
+    pivot->setParent(rChild);
+    rChild->setLeft(pivot);
+    pivot->setRight(newRChild);
+    if(newRChild != nullptr) {
+        newRChild->setParent(pivot);
+    }
+}
+
+/**
+* New nodes are splayed to the root.
+*/
+template<class Key, class Value, class Compare>
+void SplayTree<Key, Value, Compare>::rebalanceAfterInsert(Node<Key, Value>* node)
+{
+    splay(node);
+}
+
+/**
+* So are nodes whose value insert/insert_or_assign overwrote.
+*/
+template<class Key, class Value, class Compare>
+void SplayTree<Key, Value, Compare>::valueChanged(Node<Key, Value>* node)
+{
+    splay(node);
+}
+
+/**
+* Removes the node as in a plain BST (swapping with the predecessor if it
+* has two children, see nodeSwap), then splays the parent of the spot
+* that was actually unlinked.
+*/
+template<class Key, class Value, class Compare>
+void SplayTree<Key, Value, Compare>::removeNode(Node<Key, Value>* node)
+{
+    Node<Key, Value>* above = node->getParent();
+    if(node->getLeft() != nullptr && node->getRight() != nullptr) {
+        Node<Key, Value>* pred = BinarySearchTree<Key, Value, Compare>::predecessor(node);
+        //after the swap the predecessor takes node's place, and node is
+        //unlinked from where the predecessor used to be
+        above = pred->getParent() == node ? pred : pred->getParent();
+    }
+    BinarySearchTree<Key, Value, Compare>::removeNode(node);
+    if(above != nullptr) {
+        splay(above);
+    }
+}
+
+/*
+  --------------------------------------------
+  End implementations for the SplayTree class.
+  --------------------------------------------
+*/
+
+#endif
@@ -0,0 +1,274 @@
+//
+// Shared checkers for the tree tests. Like the hw4 suites, the tree
+// headers are included with everything public so the checks can walk
+// the nodes; the standard headers they use are included first so the
+// redefinition only reaches the tree code.
+//
+
+#ifndef TREE_TESTS_CHECK_TREES_H
+#define TREE_TESTS_CHECK_TREES_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#define private public
+#define protected public
+#include <avlbst.h>
+#include <rbbst.h>
+#undef private
+#undef protected
+
+// Checks parent links and key order below node, and returns the number
+// of nodes in the subtree (or -1 after recording a failure).
+template<typename Key, typename Value, typename NodeType>
+int checkLinks(NodeType* node, NodeType* parent, const Key* lo, const Key* hi, testing::AssertionResult& result)
+{
+	if(node == nullptr)
+	{
+		return 0;
+	}
+	if(node->getParent() != parent)
+	{
+		result = testing::AssertionFailure() << "Node " << node->getKey() << " has the wrong parent";
+		return -1;
+	}
+	if((lo != nullptr && !(*lo < node->getKey())) || (hi != nullptr && !(node->getKey() < *hi)))
+	{
+		result = testing::AssertionFailure() << "Node " << node->getKey() << " is out of order";
+		return -1;
+	}
+	int left = checkLinks<Key, Value>(node->getLeft(), node, lo, &node->getKey(), result);
+	int right = checkLinks<Key, Value>(node->getRight(), node, &node->getKey(), hi, result);
+	if(left < 0 || right < 0)
+	{
+		return -1;
+	}
+	return left + right + 1;
+}
+
+// Checks the stored balance of every AVL node against the real subtree
+// heights, and returns the height (or -1 after recording a failure).
+template<typename Key, typename Value, typename Augment>
+int checkBalances(AVLNode<Key, Value, Augment>* node, testing::AssertionResult& result)
+{
+	if(node == nullptr)
+	{
+		return 0;
+	}
+	int left = checkBalances(node->getLeft(), result);
+	int right = checkBalances(node->getRight(), result);
+	if(left < 0 || right < 0)
+	{
+		return -1;
+	}
+	if(right - left != node->getBalance() || std::abs(right - left) > 1)
+	{
+		result = testing::AssertionFailure() << "Node " << node->getKey() << " has balance "
+			<< int(node->getBalance()) << " but its subtrees differ by " << right - left;
+		return -1;
+	}
+	return std::max(left, right) + 1;
+}
+
+// Recomputes the subtree size of every node for the policies that keep
+// one, and returns it (or -1 after recording a failure).
+template<typename NodeType>
+long checkSizes(NodeType*, testing::AssertionResult&, std::false_type)
+{
+	return 0;
+}
+
+template<typename NodeType>
+long checkSizes(NodeType* node, testing::AssertionResult& result, std::true_type counts)
+{
+	if(node == nullptr)
+	{
+		return 0;
+	}
+	long left = checkSizes(node->getLeft(), result, counts);
+	long right = checkSizes(node->getRight(), result, counts);
+	if(left < 0 || right < 0)
+	{
+		return -1;
+	}
+	if(long(node->getSize()) != left + right + 1)
+	{
+		result = testing::AssertionFailure() << "Node " << node->getKey() << " has size "
+			<< node->getSize() << " but " << left + right + 1 << " nodes below it";
+		return -1;
+	}
+	return left + right + 1;
+}
+
+// Recomputes the aggregate of every node for the Aggregate<Monoid>
+// policies into agg, and returns false after recording a failure.
+template<typename Augment, typename NodeType, typename Agg>
+bool checkAggregates(NodeType*, Agg&, testing::AssertionResult&, std::false_type)
+{
+	return true;
+}
+
+template<typename Augment, typename NodeType>
+bool checkAggregates(NodeType* node, typename Augment::value_type& agg, testing::AssertionResult& result,
+	std::true_type aggregates)
+{
+	typedef typename Augment::monoid Monoid;
+	agg = Monoid::identity();
+	if(node == nullptr)
+	{
+		return true;
+	}
+	typename Augment::value_type left, right;
+	if(!checkAggregates<Augment>(node->getLeft(), left, result, aggregates) ||
+		!checkAggregates<Augment>(node->getRight(), right, result, aggregates))
+	{
+		return false;
+	}
+	agg = Monoid::combine(Monoid::combine(left, Monoid::lift(node->getKey(), node->getValue())), right);
+	if(!(node->getAggregate() == agg))
+	{
+		result = testing::AssertionFailure() << "Node " << node->getKey() << " has a stale aggregate";
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Verifies that tree is a valid AVL tree (links, order, balances, and the
+ * subtree sizes and aggregates its policy keeps) holding exactly size
+ * nodes.
+ */
+template<typename Key, typename Value, typename Augment, typename Compare>
+testing::AssertionResult verifyAVL(AVLTree<Key, Value, Augment, Compare>& tree, std::size_t size)
+{
+	typedef AVLNode<Key, Value, Augment> NodeType;
+	testing::AssertionResult result = testing::AssertionSuccess();
+	NodeType* root = static_cast<NodeType*>(tree.root_);
+	int count = checkLinks<Key, Value>(root, static_cast<NodeType*>(nullptr), nullptr, nullptr, result);
+	if(count < 0)
+	{
+		return result;
+	}
+	if(std::size_t(count) != size)
+	{
+		return testing::AssertionFailure() << "Tree has " << count << " nodes, expected " << size;
+	}
+	if(checkBalances(root, result) < 0)
+	{
+		return result;
+	}
+	if(checkSizes(root, result, std::integral_constant<bool, Augment::countsNodes>()) < 0)
+	{
+		return result;
+	}
+	typename Augment::value_type agg;
+	if(!checkAggregates<Augment>(root, agg, result, std::integral_constant<bool, Augment::aggregates>()))
+	{
+		return result;
+	}
+	return testing::AssertionSuccess();
+}
+
+// Checks the red-black rules below node: no red node has a red child and
+// every path down to a null link passes the same number of black nodes.
+// Returns that black height (or -1 after recording a failure).
+template<typename Key, typename Value>
+int checkColors(RBNode<Key, Value>* node, testing::AssertionResult& result)
+{
+	if(node == nullptr)
+	{
+		return 1;
+	}
+	if(node->isRed() && ((node->getLeft() != nullptr && node->getLeft()->isRed()) ||
+		(node->getRight() != nullptr && node->getRight()->isRed())))
+	{
+		result = testing::AssertionFailure() << "Red node " << node->getKey() << " has a red child";
+		return -1;
+	}
+	int left = checkColors(node->getLeft(), result);
+	int right = checkColors(node->getRight(), result);
+	if(left < 0 || right < 0)
+	{
+		return -1;
+	}
+	if(left != right)
+	{
+		result = testing::AssertionFailure() << "Node " << node->getKey() << " has black heights "
+			<< left << " and " << right << " below it";
+		return -1;
+	}
+	return left + (node->isRed() ? 0 : 1);
+}
+
+/**
+ * Verifies that tree is a valid red-black tree (links, order, colors and
+ * a black root) holding exactly size nodes.
+ */
+template<typename Key, typename Value, typename Compare>
+testing::AssertionResult verifyRB(RedBlackTree<Key, Value, Compare>& tree, std::size_t size)
+{
+	typedef RBNode<Key, Value> NodeType;
+	testing::AssertionResult result = testing::AssertionSuccess();
+	NodeType* root = static_cast<NodeType*>(tree.root_);
+	int count = checkLinks<Key, Value>(root, static_cast<NodeType*>(nullptr), nullptr, nullptr, result);
+	if(count < 0)
+	{
+		return result;
+	}
+	if(std::size_t(count) != size)
+	{
+		return testing::AssertionFailure() << "Tree has " << count << " nodes, expected " << size;
+	}
+	if(root != nullptr && root->isRed())
+	{
+		return testing::AssertionFailure() << "Root " << root->getKey() << " is red";
+	}
+	if(checkColors(root, result) < 0)
+	{
+		return result;
+	}
+	return testing::AssertionSuccess();
+}
+
+/**
+ * Verifies that iterating tree gives exactly the items of expected.
+ */
+template<typename Tree, typename Map>
+testing::AssertionResult sameItems(const Tree& tree, const Map& expected)
+{
+	typename Map::const_iterator want = expected.begin();
+	for(typename Tree::iterator it = tree.begin(); it != tree.end(); ++it, ++want)
+	{
+		if(want == expected.end())
+		{
+			return testing::AssertionFailure() << "Extra key " << it->first;
+		}
+		if(!(it->first == want->first) || !(it->second == want->second))
+		{
+			return testing::AssertionFailure() << "Found key " << it->first << ", expected " << want->first;
+		}
+	}
+	if(want != expected.end())
+	{
+		return testing::AssertionFailure() << "Missing key " << want->first;
+	}
+	return testing::AssertionSuccess();
+}
+
+#endif //TREE_TESTS_CHECK_TREES_H
@@ -0,0 +1,151 @@
+#include "check_trees.h"
+
+#include <random>
+
+struct ValueSum
+{
+	typedef long value_type;
+	static long identity() { return 0; }
+	static long lift(const int&, const int& value) { return value; }
+	static long combine(long a, long b) { return a + b; }
+};
+
+// Not commutative, so the aggregates also check the key order.
+struct KeyList
+{
+	typedef std::string value_type;
+	static std::string identity() { return std::string(); }
+	static std::string lift(const int& key, const int&) { return std::to_string(key) + ","; }
+	static std::string combine(const std::string& a, const std::string& b) { return a + b; }
+};
+
+typedef AVLTree<int, int, Aggregate<ValueSum> > SumTree;
+typedef AVLTree<int, int, Aggregate<KeyList> > ListTree;
+
+static long bruteSum(const std::map<int, int>& items, int lo, int hi)
+{
+	long sum = 0;
+	for(std::map<int, int>::const_iterator it = items.lower_bound(lo); it != items.end() && it->first < hi; ++it)
+	{
+		sum += it->second;
+	}
+	return sum;
+}
+
+static std::string bruteList(const std::map<int, int>& items, int lo, int hi)
+{
+	std::string list;
+	for(std::map<int, int>::const_iterator it = items.lower_bound(lo); it != items.end() && it->first < hi; ++it)
+	{
+		list += std::to_string(it->first) + ",";
+	}
+	return list;
+}
+
+TEST(Aggregate, RangesAgainstBruteForce)
+{
+	std::mt19937 rng(7);
+	SumTree sums;
+	ListTree lists;
+	std::map<int, int> items;
+	for(int round = 0; round < 20; ++round)
+	{
+		for(int i = 0; i < 100; ++i)
+		{
+			int key = int(rng() % 1000);
+			if(rng() % 3 != 0)
+			{
+				int value = int(rng() % 100) - 50;
+				sums.insert(std::make_pair(key, value));
+				lists.insert(std::make_pair(key, value));
+				items[key] = value;
+			}
+			else
+			{
+				sums.remove(key);
+				lists.remove(key);
+				items.erase(key);
+			}
+		}
+		ASSERT_TRUE(verifyAVL(sums, items.size())) << "round " << round;
+		ASSERT_TRUE(verifyAVL(lists, items.size())) << "round " << round;
+		EXPECT_EQ(bruteSum(items, -1, 1000), sums.aggregate());
+		EXPECT_EQ(bruteList(items, -1, 1000), lists.aggregate());
+		for(int q = 0; q < 50; ++q)
+		{
+			int lo = int(rng() % 1100) - 50;
+			int hi = lo + int(rng() % 500) - 50;
+			ASSERT_EQ(bruteSum(items, lo, hi), sums.aggregate(lo, hi)) << "[" << lo << ", " << hi << ")";
+			ASSERT_EQ(bruteList(items, lo, hi), lists.aggregate(lo, hi)) << "[" << lo << ", " << hi << ")";
+		}
+	}
+	SumTree empty;
+	EXPECT_EQ(0, empty.aggregate());
+	EXPECT_EQ(0, empty.aggregate(0, 10));
+}
+
+TEST(Aggregate, RefreshAfterChangingValues)
+{
+	std::mt19937 rng(70);
+	SumTree tree;
+	std::map<int, int> items;
+	for(int i = 0; i < 500; ++i)
+	{
+		tree.insert(std::make_pair(i, 1));
+		items[i] = 1;
+	}
+	for(int i = 0; i < 300; ++i)
+	{
+		int key = int(rng() % 500);
+		int value = int(rng() % 1000);
+		if(i % 2 == 0)
+		{
+			SumTree::iterator it = tree.find(key);
+			it->second = value;
+			tree.refresh(it);
+		}
+		else
+		{
+			tree[key] = value;
+			tree.refresh(tree.find(key));
+		}
+		items[key] = value;
+		ASSERT_EQ(bruteSum(items, 0, 500), tree.aggregate());
+		int lo = int(rng() % 500);
+		ASSERT_EQ(bruteSum(items, lo, lo + 50), tree.aggregate(lo, lo + 50));
+	}
+	EXPECT_TRUE(verifyAVL(tree, items.size()));
+	tree.refresh(tree.end());
+	EXPECT_TRUE(verifyAVL(tree, items.size()));
+}
+
+TEST(Aggregate, SplitJoinAndBulkBuilds)
+{
+	std::vector<std::pair<int, int> > sorted;
+	std::map<int, int> items;
+	for(int i = 0; i < 1000; ++i)
+	{
+		sorted.push_back(std::make_pair(i, i % 7));
+		items[i] = i % 7;
+	}
+	ListTree tree;
+	tree.assign_sorted(sorted.begin(), sorted.end());
+	ASSERT_TRUE(verifyAVL(tree, 1000));
+	EXPECT_EQ(bruteList(items, 0, 1000), tree.aggregate());
+
+	ListTree upper;
+	tree.split(400, upper);
+	EXPECT_TRUE(verifyAVL(tree, 400));
+	EXPECT_TRUE(verifyAVL(upper, 600));
+	EXPECT_EQ(bruteList(items, 0, 400), tree.aggregate());
+	EXPECT_EQ(bruteList(items, 400, 1000), upper.aggregate());
+
+	tree.join(upper);
+	EXPECT_TRUE(verifyAVL(tree, 1000));
+	EXPECT_EQ(bruteList(items, 0, 1000), tree.aggregate());
+	EXPECT_EQ(bruteList(items, 123, 877), tree.aggregate(123, 877));
+
+	tree.rebalance();
+	EXPECT_TRUE(verifyAVL(tree, 1000));
+	EXPECT_EQ(bruteList(items, 0, 1000), tree.aggregate());
+}
@@ -0,0 +1,135 @@
+#include "check_trees.h"
+
+#include <list>
+
+typedef std::vector<std::pair<int, int> > Pairs;
+
+// Counts the live values, to check that a rejected range leaves nothing.
+struct Tracked
+{
+	static int live;
+
+	Tracked(int v) : value(v) { ++live; }
+	Tracked(const Tracked& other) : value(other.value) { ++live; }
+	~Tracked() { --live; }
+	Tracked& operator=(const Tracked& other)
+	{
+		value = other.value;
+		return *this;
+	}
+
+	int value;
+};
+
+int Tracked::live = 0;
+
+static Pairs sortedPairs(int n)
+{
+	Pairs sorted;
+	for(int i = 0; i < n; ++i)
+	{
+		sorted.push_back(std::make_pair(i * 3, i));
+	}
+	return sorted;
+}
+
+TEST(AssignSorted, BuildsBalancedTreesOfEverySize)
+{
+	for(int n = 0; n <= 300; n += (n < 40 ? 1 : 29))
+	{
+		Pairs sorted = sortedPairs(n);
+		std::map<int, int> items(sorted.begin(), sorted.end());
+
+		AVLTree<int, int, OrderStatistics> avl;
+		avl.insert(std::make_pair(-7, 0));
+		avl.assign_sorted(sorted.begin(), sorted.end());
+		ASSERT_TRUE(verifyAVL(avl, items.size())) << n << " items";
+		EXPECT_TRUE(sameItems(avl, items));
+
+		RedBlackTree<int, int> rb;
+		rb.assign_sorted(sorted.begin(), sorted.end());
+		ASSERT_TRUE(verifyRB(rb, items.size())) << n << " items";
+		EXPECT_TRUE(sameItems(rb, items));
+
+		BinarySearchTree<int, int> plain;
+		plain.assign_sorted(sorted.begin(), sorted.end());
+		testing::AssertionResult links = testing::AssertionSuccess();
+		EXPECT_EQ(n, (checkLinks<int, int>(plain.root_, static_cast<Node<int, int>*>(nullptr), nullptr, nullptr, links)))
+			<< links.message();
+		EXPECT_TRUE(plain.isBalanced());
+		EXPECT_TRUE(sameItems(plain, items));
+
+		//the built trees take further changes like any other
+		avl.insert(std::make_pair(1, 1));
+		avl.remove(0);
+		items[1] = 1;
+		items.erase(0);
+		EXPECT_TRUE(verifyAVL(avl, items.size()));
+		EXPECT_TRUE(sameItems(avl, items));
+		if(n > 0)
+		{
+			AVLTree<int, int, OrderStatistics>::iterator last = avl.insert(avl.end(), std::make_pair(n * 3, -1));
+			EXPECT_TRUE(last == avl.select(avl.size() - 1));
+		}
+	}
+}
+
+TEST(AssignSorted, RepeatedKeysKeepTheLastValue)
+{
+	Pairs sorted;
+	std::map<int, int> items;
+	for(int i = 0; i < 100; ++i)
+	{
+		sorted.push_back(std::make_pair(i / 3, i));
+		items[i / 3] = i;
+	}
+	AVLTree<int, int, OrderStatistics> tree;
+	tree.assign_sorted(sorted.begin(), sorted.end());
+	EXPECT_TRUE(verifyAVL(tree, items.size()));
+	EXPECT_TRUE(sameItems(tree, items));
+
+	//single pass input works too
+	std::list<std::pair<int, int> > once(sorted.begin(), sorted.end());
+	RedBlackTree<int, int> rb;
+	rb.assign_sorted(once.begin(), once.end());
+	EXPECT_TRUE(verifyRB(rb, items.size()));
+	EXPECT_TRUE(sameItems(rb, items));
+}
+
+TEST(AssignSorted, UnsortedInputThrowsAndLeavesTheTreeEmpty)
+{
+	typedef std::vector<std::pair<int, Tracked> > TrackedPairs;
+	{
+		TrackedPairs unsorted;
+		for(int i = 0; i < 50; ++i)
+		{
+			unsorted.push_back(std::make_pair(i == 30 ? 5 : i, Tracked(i)));
+		}
+		int inInput = Tracked::live;
+
+		AVLTree<int, Tracked> tree;
+		tree.insert(std::make_pair(100, Tracked(100)));
+		EXPECT_THROW(tree.assign_sorted(unsorted.begin(), unsorted.end()), std::invalid_argument);
+		EXPECT_TRUE(tree.empty());
+		EXPECT_EQ(inInput, Tracked::live);
+		EXPECT_TRUE(verifyAVL(tree, 0));
+
+		RedBlackTree<int, Tracked> rb;
+		EXPECT_THROW(rb.assign_sorted(unsorted.begin(), unsorted.end()), std::invalid_argument);
+		EXPECT_TRUE(rb.empty());
+		EXPECT_EQ(inInput, Tracked::live);
+
+		//still usable afterwards
+		tree.assign_sorted(unsorted.begin(), unsorted.begin() + 30);
+		EXPECT_TRUE(verifyAVL(tree, 30));
+		EXPECT_EQ(29, tree.find(29)->second.value);
+	}
+	EXPECT_EQ(0, Tracked::live);
+
+	Pairs descending;
+	descending.push_back(std::make_pair(2, 0));
+	descending.push_back(std::make_pair(1, 0));
+	BinarySearchTree<int, int> plain;
+	EXPECT_THROW(plain.assign_sorted(descending.begin(), descending.end()), std::invalid_argument);
+	EXPECT_TRUE(plain.empty());
+}
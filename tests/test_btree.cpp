@@ -0,0 +1,156 @@
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <set>
+#include <string>
+
+#include "check_trees.h"
+#include <btree.h>
+
+// Inserts, overwrites, removes and looks up keys drawn from picks (plus
+// random ones), comparing the BTree with std::map after every phase.
+template<typename Key>
+static void checkAgainstMap(const std::vector<Key>& picks, unsigned seed)
+{
+	BTree<Key, int> tree;
+	std::map<Key, int> expected;
+	std::mt19937_64 rng(seed);
+	auto randomKey = [&]() {
+		return rng() % 4 == 0 ? picks[rng() % picks.size()] : static_cast<Key>(rng());
+	};
+	std::vector<Key> used;
+	for(int i = 0; i < 20000; ++i)
+	{
+		Key key = randomKey();
+		tree.insert(std::make_pair(key, i));
+		expected[key] = i;
+		used.push_back(key);
+	}
+	ASSERT_TRUE(sameItems(tree, expected));
+	ASSERT_EQ(expected.size(), tree.size());
+
+	for(int i = 0; i < 15000; ++i)
+	{
+		Key key = rng() % 2 ? used[rng() % used.size()] : randomKey();
+		tree.remove(key);
+		expected.erase(key);
+	}
+	ASSERT_TRUE(sameItems(tree, expected));
+	ASSERT_EQ(expected.size(), tree.size());
+
+	for(std::size_t i = 0; i < picks.size(); ++i)
+	{
+		typename BTree<Key, int>::iterator it = tree.find(picks[i]);
+		ASSERT_EQ(expected.count(picks[i]) > 0, it != tree.end()) << "key " << picks[i];
+		if(it != tree.end())
+		{
+			EXPECT_EQ(picks[i], it->first);
+			EXPECT_EQ(expected[picks[i]], it->second);
+		}
+	}
+	for(int i = 0; i < 20000; ++i)
+	{
+		Key key = randomKey();
+		ASSERT_EQ(expected.count(key) > 0, tree.find(key) != tree.end()) << "key " << key;
+	}
+}
+
+// Only the edge keys, so they end up next to the filler slots of the
+// same leaf and the sign flip decides the order.
+template<typename Key>
+static void checkEdgesOnly(const std::vector<Key>& picks)
+{
+	BTree<Key, int> tree;
+	std::map<Key, int> expected;
+	for(std::size_t i = 0; i < picks.size(); ++i)
+	{
+		tree.insert(std::make_pair(picks[i], int(i)));
+		expected[picks[i]] = int(i);
+		ASSERT_TRUE(sameItems(tree, expected));
+		for(std::size_t j = 0; j < picks.size(); ++j)
+		{
+			ASSERT_EQ(expected.count(picks[j]) > 0, tree.find(picks[j]) != tree.end()) << "key " << picks[j];
+		}
+	}
+	for(std::size_t i = 0; i < picks.size(); i += 2)
+	{
+		tree.remove(picks[i]);
+		expected.erase(picks[i]);
+	}
+	ASSERT_TRUE(sameItems(tree, expected));
+	for(std::size_t j = 0; j < picks.size(); ++j)
+	{
+		ASSERT_EQ(expected.count(picks[j]) > 0, tree.find(picks[j]) != tree.end()) << "key " << picks[j];
+	}
+}
+
+TEST(BTree, SignedInt32)
+{
+	std::vector<int32_t> picks = {std::numeric_limits<int32_t>::min(), std::numeric_limits<int32_t>::min() + 1,
+		-1, 0, 1, std::numeric_limits<int32_t>::max() - 1, std::numeric_limits<int32_t>::max()};
+	checkEdgesOnly(picks);
+	checkAgainstMap(picks, 1);
+}
+
+TEST(BTree, UnsignedInt32)
+{
+	std::vector<uint32_t> picks = {0u, 1u, 0x7fffffffu, 0x80000000u, 0x80000001u,
+		std::numeric_limits<uint32_t>::max() - 1, std::numeric_limits<uint32_t>::max()};
+	checkEdgesOnly(picks);
+	checkAgainstMap(picks, 2);
+}
+
+TEST(BTree, SignedInt64)
+{
+	std::vector<int64_t> picks = {std::numeric_limits<int64_t>::min(), std::numeric_limits<int64_t>::min() + 1,
+		-int64_t(std::numeric_limits<uint32_t>::max()), -1, 0, 1, int64_t(std::numeric_limits<uint32_t>::max()),
+		int64_t(std::numeric_limits<uint32_t>::max()) + 1, std::numeric_limits<int64_t>::max() - 1,
+		std::numeric_limits<int64_t>::max()};
+	checkEdgesOnly(picks);
+	checkAgainstMap(picks, 3);
+}
+
+TEST(BTree, UnsignedInt64)
+{
+	std::vector<uint64_t> picks = {0u, 1u, std::numeric_limits<uint32_t>::max(),
+		uint64_t(std::numeric_limits<uint32_t>::max()) + 1, 0x7fffffffffffffffull, 0x8000000000000000ull,
+		0x8000000000000001ull, std::numeric_limits<uint64_t>::max() - 1, std::numeric_limits<uint64_t>::max()};
+	checkEdgesOnly(picks);
+	checkAgainstMap(picks, 4);
+}
+
+TEST(BTree, MaxKeyAsOnlyKey)
+{
+	BTree<int64_t, int> tree;
+	tree.insert(std::make_pair(std::numeric_limits<int64_t>::max(), 7));
+	ASSERT_NE(tree.end(), tree.find(std::numeric_limits<int64_t>::max()));
+	EXPECT_EQ(7, tree[std::numeric_limits<int64_t>::max()]);
+	EXPECT_EQ(tree.end(), tree.find(0));
+	tree.remove(std::numeric_limits<int64_t>::max());
+	EXPECT_TRUE(tree.empty());
+}
+
+TEST(BTree, StringKeys)
+{
+	BTree<std::string, int> tree;
+	std::map<std::string, int> expected;
+	std::mt19937 rng(5);
+	for(int i = 0; i < 5000; ++i)
+	{
+		std::string key = std::to_string(rng() % 3000);
+		if(rng() % 3 == 0)
+		{
+			tree.remove(key);
+			expected.erase(key);
+		}
+		else
+		{
+			tree.insert(std::make_pair(key, i));
+			expected[key] = i;
+		}
+	}
+	EXPECT_TRUE(sameItems(tree, expected));
+	EXPECT_EQ(expected.size(), tree.size());
+	const BTree<std::string, int>& constTree = tree;
+	EXPECT_THROW(constTree["missing"], std::out_of_range);
+}
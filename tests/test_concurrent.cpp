@@ -0,0 +1,138 @@
+#include "check_trees.h"
+
+#include <atomic>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <concurrentavl.h>
+
+static const int THREADS = 4;
+static const int KEYS_PER_THREAD = 20000;
+
+// Thread t owns the keys congruent to t, so every return value it gets
+// is predictable however the threads interleave.
+static void ownKeys(ConcurrentAVLTree<int, int>& tree, int t, std::atomic<int>& failures)
+{
+	std::vector<int> keys;
+	for(int i = 0; i < KEYS_PER_THREAD; ++i)
+	{
+		keys.push_back(i * THREADS + t);
+	}
+	std::shuffle(keys.begin(), keys.end(), std::mt19937(t));
+
+	for(std::size_t i = 0; i < keys.size(); ++i)
+	{
+		if(!tree.insert(std::make_pair(keys[i], keys[i])))
+		{
+			++failures;
+		}
+	}
+	for(std::size_t i = 0; i < keys.size(); ++i)
+	{
+		//a second insert only replaces the value
+		if(tree.insert(std::make_pair(keys[i], -keys[i])))
+		{
+			++failures;
+		}
+	}
+	for(std::size_t i = 0; i < keys.size(); ++i)
+	{
+		int value = 0;
+		if(!tree.find(keys[i], value) || value != -keys[i])
+		{
+			++failures;
+		}
+	}
+	//remove the odd multiples, twice
+	for(std::size_t i = 0; i < keys.size(); ++i)
+	{
+		if(keys[i] / THREADS % 2 == 1 && !tree.remove(keys[i]))
+		{
+			++failures;
+		}
+	}
+	for(std::size_t i = 0; i < keys.size(); ++i)
+	{
+		if(keys[i] / THREADS % 2 == 1 && tree.remove(keys[i]))
+		{
+			++failures;
+		}
+	}
+	for(std::size_t i = 0; i < keys.size(); ++i)
+	{
+		if(tree.contains(keys[i]) != (keys[i] / THREADS % 2 == 0))
+		{
+			++failures;
+		}
+	}
+}
+
+TEST(ConcurrentAVL, OwnedKeysStress)
+{
+	ConcurrentAVLTree<int, int> tree;
+	std::atomic<int> failures(0);
+	std::vector<std::thread> threads;
+	for(int t = 0; t < THREADS; ++t)
+	{
+		threads.push_back(std::thread(ownKeys, std::ref(tree), t, std::ref(failures)));
+	}
+	for(int t = 0; t < THREADS; ++t)
+	{
+		threads[t].join();
+	}
+
+	EXPECT_EQ(0, failures.load());
+	EXPECT_EQ(std::size_t(THREADS * KEYS_PER_THREAD / 2), tree.size());
+	for(int key = 0; key < THREADS * KEYS_PER_THREAD; ++key)
+	{
+		int value = 0;
+		bool kept = key / THREADS % 2 == 0;
+		ASSERT_EQ(kept, tree.find(key, value)) << key;
+		if(kept)
+		{
+			EXPECT_EQ(-key, value);
+		}
+	}
+}
+
+TEST(ConcurrentAVL, ContendedKeysKeepCount)
+{
+	// All threads fight over a few keys; the successful inserts minus the
+	// successful removes must still add up to the final size.
+	const int RANGE = 64;
+	ConcurrentAVLTree<int, int> tree;
+	std::atomic<long> net(0);
+	std::vector<std::thread> threads;
+	for(int t = 0; t < THREADS; ++t)
+	{
+		threads.push_back(std::thread([&tree, &net, t]()
+		{
+			std::mt19937 rng(100 + t);
+			for(int i = 0; i < 50000; ++i)
+			{
+				int key = int(rng() % RANGE);
+				if(rng() % 2 == 0)
+				{
+					net += tree.insert(std::make_pair(key, t)) ? 1 : 0;
+				}
+				else
+				{
+					net -= tree.remove(key) ? 1 : 0;
+				}
+			}
+		}));
+	}
+	for(int t = 0; t < THREADS; ++t)
+	{
+		threads[t].join();
+	}
+
+	long present = 0;
+	for(int key = 0; key < RANGE; ++key)
+	{
+		present += tree.contains(key) ? 1 : 0;
+	}
+	EXPECT_EQ(net.load(), present);
+	EXPECT_EQ(std::size_t(present), tree.size());
+}
@@ -0,0 +1,160 @@
+#include "check_trees.h"
+
+#include <random>
+
+typedef AVLTree<int, int> AVLInts;
+typedef RedBlackTree<int, int> RBInts;
+
+static testing::AssertionResult verifyTree(AVLInts& tree, std::size_t size)
+{
+	return verifyAVL(tree, size);
+}
+
+static testing::AssertionResult verifyTree(RBInts& tree, std::size_t size)
+{
+	return verifyRB(tree, size);
+}
+
+// Mixes cursor lookups, inserts and removes with plain removes of the
+// items around the cursor, keys mostly close to the previous one.
+template<typename Tree>
+void walkWithCursor(unsigned seed)
+{
+	std::mt19937 rng(seed);
+	Tree tree;
+	std::map<int, int> items;
+	for(int i = 0; i < 2000; i += 2)
+	{
+		tree.insert(std::make_pair(i, i));
+		items[i] = i;
+	}
+	typename Tree::cursor finger(tree);
+	EXPECT_TRUE(finger.position() == tree.end());
+	int key = 1000;
+	for(int step = 0; step < 20000; ++step)
+	{
+		key = std::max(-10, std::min(2010, key + int(rng() % 21) - 10));
+		switch(rng() % 5)
+		{
+		case 0:
+		{
+			typename Tree::iterator it = finger.find(key);
+			std::map<int, int>::iterator want = items.find(key);
+			ASSERT_EQ(want != items.end(), it != tree.end()) << key;
+			if(want != items.end())
+			{
+				EXPECT_EQ(want->second, it->second);
+				EXPECT_TRUE(finger.position() == it);
+			}
+			break;
+		}
+		case 1:
+		{
+			typename Tree::iterator it = finger.lower_bound(key);
+			std::map<int, int>::iterator want = items.lower_bound(key);
+			ASSERT_EQ(want != items.end(), it != tree.end()) << key;
+			if(want != items.end())
+			{
+				EXPECT_EQ(want->first, it->first);
+				EXPECT_TRUE(finger.position() == it);
+			}
+			break;
+		}
+		case 2:
+			finger.insert(std::make_pair(key, step));
+			items[key] = step;
+			ASSERT_EQ(key, finger.position()->first);
+			EXPECT_EQ(step, finger.position()->second);
+			break;
+		case 3:
+		{
+			finger.remove(key);
+			items.erase(key);
+			if(items.empty())
+			{
+				finger.reset();
+			}
+			break;
+		}
+		default:
+		{
+			//take out the neighbours of the cursor's item behind its back
+			typename Tree::iterator here = finger.position();
+			if(here == tree.end())
+			{
+				break;
+			}
+			std::map<int, int>::iterator at = items.find(here->first);
+			ASSERT_TRUE(at != items.end());
+			int neighbour = at->first;
+			if(at != items.begin())
+			{
+				--at;
+				neighbour = at->first;
+				++at;
+			}
+			else if(++at != items.end())
+			{
+				neighbour = at->first;
+			}
+			if(neighbour != here->first)
+			{
+				tree.remove(neighbour);
+				items.erase(neighbour);
+			}
+			EXPECT_TRUE(finger.position() == here);
+			break;
+		}
+		}
+		if(step % 1000 == 0)
+		{
+			ASSERT_TRUE(verifyTree(tree, items.size())) << "step " << step;
+			ASSERT_TRUE(sameItems(tree, items)) << "step " << step;
+		}
+	}
+	EXPECT_TRUE(verifyTree(tree, items.size()));
+	EXPECT_TRUE(sameItems(tree, items));
+}
+
+TEST(Cursor, AVLTreeAgainstMap)
+{
+	walkWithCursor<AVLInts>(18);
+}
+
+TEST(Cursor, RedBlackTreeAgainstMap)
+{
+	walkWithCursor<RBInts>(81);
+}
+
+TEST(Cursor, RemoveMovesToTheNextItem)
+{
+	AVLInts tree;
+	for(int i = 0; i < 100; ++i)
+	{
+		tree.insert(std::make_pair(i, i));
+	}
+	AVLInts::cursor finger(tree);
+	finger.find(40);
+	finger.remove(40);
+	EXPECT_EQ(41, finger.position()->first);
+
+	//the last item steps back instead
+	finger.remove(99);
+	EXPECT_EQ(98, finger.position()->first);
+
+	//a removed neighbour of the cursor's item does not disturb it
+	tree.remove(97);
+	EXPECT_EQ(98, finger.position()->first);
+	EXPECT_TRUE(finger.find(97) == tree.end());
+	EXPECT_EQ(98, finger.lower_bound(97)->first);
+	finger.insert(std::make_pair(97, -97));
+	EXPECT_EQ(-97, tree[97]);
+
+	//a missing key leaves the cursor at the next larger item
+	finger.remove(50);
+	EXPECT_TRUE(finger.find(50) == tree.end());
+	EXPECT_EQ(51, finger.position()->first);
+	EXPECT_TRUE(finger.lower_bound(1000) == tree.end());
+	EXPECT_EQ(51, finger.position()->first);
+	EXPECT_TRUE(verifyAVL(tree, 97));
+}
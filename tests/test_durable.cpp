@@ -0,0 +1,188 @@
+#include "check_trees.h"
+
+#include <csignal>
+#include <random>
+#include <string>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <durableavl.h>
+
+typedef DurableAVLTree<int, long> Store;
+
+// Lets a test swap the log's file descriptor for a broken one.
+class FaultyStore : public Store
+{
+public:
+	explicit FaultyStore(const std::string& path) : Store(path) {}
+
+	void replaceLog(int fd)
+	{
+		ASSERT_EQ(fd_, ::dup2(fd, fd_));
+	}
+};
+
+static std::string storePath(const char* name)
+{
+	std::string path = testing::TempDir() + "tree-tests-" + name;
+	::unlink((path + ".log").c_str());
+	::unlink((path + ".ckpt").c_str());
+	return path;
+}
+
+static off_t fileSize(const std::string& path)
+{
+	struct stat info;
+	return ::stat(path.c_str(), &info) == 0 ? info.st_size : -1;
+}
+
+static std::map<int, long> contents(const Store& store)
+{
+	std::map<int, long> items;
+	store.forEach([&](int key, long value)
+	{
+		items[key] = value;
+	});
+	return items;
+}
+
+TEST(DurableAVL, RecoversCheckpointAndLog)
+{
+	std::string path = storePath("recover");
+	std::map<int, long> items;
+	std::mt19937 rng(9);
+	DurabilityOptions options;
+	options.syncEvery = 7;
+	options.bufferBytes = 256;
+	for(int round = 0; round < 4; ++round)
+	{
+		Store store(path, options);
+		ASSERT_EQ(items, contents(store)) << "round " << round;
+		for(int i = 0; i < 2000; ++i)
+		{
+			int key = int(rng() % 500);
+			if(rng() % 3 != 0)
+			{
+				long value = long(rng());
+				store.insert(std::make_pair(key, value));
+				items[key] = value;
+			}
+			else
+			{
+				EXPECT_EQ(items.erase(key) > 0, store.remove(key));
+			}
+		}
+		if(round % 2 == 1)
+		{
+			store.checkpoint();
+		}
+	}
+	Store store(path, options);
+	EXPECT_EQ(items, contents(store));
+}
+
+TEST(DurableAVL, CutsOffATornRecord)
+{
+	std::string path = storePath("torn");
+	{
+		Store store(path);
+		for(int i = 0; i < 100; ++i)
+		{
+			store.insert(std::make_pair(i, long(i)));
+		}
+	}
+	ASSERT_EQ(0, ::truncate((path + ".log").c_str(), fileSize(path + ".log") - 3));
+	{
+		Store store(path);
+		EXPECT_EQ(99u, contents(store).size());
+		EXPECT_FALSE(store.contains(99));
+		store.insert(std::make_pair(500, 5L));
+	}
+	Store store(path);
+	EXPECT_EQ(100u, contents(store).size());
+	EXPECT_TRUE(store.contains(500));
+}
+
+TEST(DurableAVL, FailedWriteIsCutOffAndRetried)
+{
+	// A file size limit makes the batch write stop partway through a
+	// record. The torn bytes must go, or recovery would stop at them and
+	// lose every record written after.
+	std::string path = storePath("limit");
+	DurabilityOptions options;
+	options.syncEvery = 0;
+	options.bufferBytes = 1 << 20;
+	{
+		Store store(path, options);
+		for(int i = 0; i < 100; ++i)
+		{
+			store.insert(std::make_pair(i, long(i)));
+		}
+		store.sync();
+		off_t good = fileSize(path + ".log");
+		for(int i = 100; i < 200; ++i)
+		{
+			store.insert(std::make_pair(i, long(i)));
+		}
+
+		struct rlimit saved;
+		ASSERT_EQ(0, ::getrlimit(RLIMIT_FSIZE, &saved));
+		void (*handler)(int) = std::signal(SIGXFSZ, SIG_IGN);
+		struct rlimit limit = saved;
+		limit.rlim_cur = good + 500;
+		ASSERT_EQ(0, ::setrlimit(RLIMIT_FSIZE, &limit));
+		EXPECT_THROW(store.sync(), std::system_error);
+		::setrlimit(RLIMIT_FSIZE, &saved);
+		std::signal(SIGXFSZ, handler);
+		EXPECT_EQ(good, fileSize(path + ".log"));
+
+		//the batch was kept, so it goes out with the next commit
+		store.sync();
+		for(int i = 200; i < 210; ++i)
+		{
+			store.insert(std::make_pair(i, long(i)));
+		}
+	}
+	Store store(path, options);
+	std::map<int, long> items = contents(store);
+	EXPECT_EQ(210u, items.size());
+	for(int i = 0; i < 210; ++i)
+	{
+		EXPECT_EQ(long(i), items[i]);
+	}
+}
+
+TEST(DurableAVL, UnwritableLogFailsTheTree)
+{
+	std::string path = storePath("readonly");
+	{
+		FaultyStore store(path);
+		for(int i = 0; i < 50; ++i)
+		{
+			store.insert(std::make_pair(i, long(i)));
+		}
+		int readOnly = ::open((path + ".log").c_str(), O_RDONLY);
+		ASSERT_LE(0, readOnly);
+		store.replaceLog(readOnly);
+		::close(readOnly);
+
+		//the log cannot be written or truncated back, so the tree gives up
+		EXPECT_THROW(store.insert(std::make_pair(50, 50L)), std::system_error);
+		EXPECT_THROW(store.insert(std::make_pair(51, 51L)), std::system_error);
+		EXPECT_THROW(store.remove(0), std::system_error);
+		EXPECT_THROW(store.sync(), std::system_error);
+		EXPECT_THROW(store.checkpoint(), std::system_error);
+
+		//reads still see memory, where only the first failed insert landed
+		EXPECT_TRUE(store.contains(0));
+		EXPECT_TRUE(store.contains(50));
+		EXPECT_FALSE(store.contains(51));
+	}
+	Store store(path);
+	std::map<int, long> items = contents(store);
+	EXPECT_EQ(50u, items.size());
+	EXPECT_FALSE(store.contains(50));
+	EXPECT_TRUE(store.contains(49));
+}
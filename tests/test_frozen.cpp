@@ -0,0 +1,134 @@
+#include "check_trees.h"
+
+#include <random>
+#include <string>
+
+typedef FrozenTree<int, std::string> Snapshot;
+
+// Counts the live copies and throws from the copy constructor once the
+// budget runs out, to check that a failed freeze() cleans up.
+struct Counted
+{
+	static int live;
+	static int copiesLeft;
+
+	explicit Counted(int v) : value(v) { ++live; }
+	Counted(const Counted& other) : value(other.value)
+	{
+		if(copiesLeft-- == 0)
+		{
+			throw std::runtime_error("copy");
+		}
+		++live;
+	}
+	~Counted() { --live; }
+
+	int value;
+};
+
+int Counted::live = 0;
+int Counted::copiesLeft = -1;
+
+TEST(FrozenTree, MatchesTheTreeAtEverySize)
+{
+	std::mt19937 rng(10);
+	for(int n = 0; n <= 200; n += (n < 40 ? 1 : 23))
+	{
+		AVLTree<int, std::string> tree;
+		std::map<int, std::string> items;
+		for(int i = 0; i < n; ++i)
+		{
+			int key = int(rng() % 1000);
+			tree.insert(std::make_pair(key, std::to_string(i)));
+			items[key] = std::to_string(i);
+		}
+		Snapshot frozen = tree.freeze();
+		ASSERT_EQ(items.size(), frozen.size()) << n << " items";
+		EXPECT_EQ(items.empty(), frozen.empty());
+		EXPECT_TRUE(sameItems(frozen, items)) << n << " items";
+		EXPECT_EQ(0u, reinterpret_cast<std::uintptr_t>(frozen.items_) % Eytzinger::CACHE_LINE);
+		for(int key = -1; key <= 1000; ++key)
+		{
+			Snapshot::iterator it = frozen.find(key);
+			std::map<int, std::string>::iterator want = items.find(key);
+			ASSERT_EQ(want != items.end(), it != frozen.end()) << key;
+			if(want != items.end())
+			{
+				EXPECT_EQ(want->second, it->second);
+				EXPECT_EQ(want->second, frozen[key]);
+			}
+			else
+			{
+				EXPECT_THROW(frozen[key], std::out_of_range);
+			}
+		}
+	}
+}
+
+TEST(FrozenTree, SnapshotOutlivesChangesAndMoves)
+{
+	AVLTree<int, std::string> tree;
+	std::map<int, std::string> items;
+	for(int i = 0; i < 100; ++i)
+	{
+		tree.insert(std::make_pair(i, std::string(i, 'x')));
+		items[i] = std::string(i, 'x');
+	}
+	Snapshot frozen = tree.freeze();
+	for(int i = 0; i < 100; i += 2)
+	{
+		tree.remove(i);
+	}
+	tree.insert(std::make_pair(500, std::string("new")));
+	tree.clear();
+	EXPECT_TRUE(sameItems(frozen, items));
+
+	Snapshot moved(std::move(frozen));
+	EXPECT_EQ(0u, frozen.size());
+	EXPECT_TRUE(frozen.begin() == frozen.end());
+	EXPECT_TRUE(frozen.find(5) == frozen.end());
+	EXPECT_TRUE(sameItems(moved, items));
+	frozen = std::move(moved);
+	EXPECT_TRUE(sameItems(frozen, items));
+	EXPECT_EQ(std::string(42, 'x'), frozen[42]);
+}
+
+TEST(FrozenTree, KeepsTheTreeOrder)
+{
+	typedef AVLTree<int, int, NoAugment, std::greater<int> > Descending;
+	Descending tree;
+	for(int i = 0; i < 301; ++i)
+	{
+		tree.insert(std::make_pair(i * 3 % 301, i));
+	}
+	FrozenTree<int, int, std::greater<int> > frozen = tree.freeze();
+	int expect = 300;
+	for(FrozenTree<int, int, std::greater<int> >::iterator it = frozen.begin(); it != frozen.end(); ++it, --expect)
+	{
+		ASSERT_EQ(expect, it->first);
+		EXPECT_EQ(tree[expect], it->second);
+	}
+	EXPECT_EQ(-1, expect);
+	EXPECT_EQ(tree[17], frozen.find(17)->second);
+}
+
+TEST(FrozenTree, FailedCopyDestroysWhatWasBuilt)
+{
+	{
+		AVLTree<int, Counted> tree;
+		for(int i = 0; i < 50; ++i)
+		{
+			tree.insert(std::make_pair(i, Counted(i)));
+		}
+		int inTree = Counted::live;
+		Counted::copiesLeft = 30;
+		EXPECT_THROW(tree.freeze(), std::runtime_error);
+		Counted::copiesLeft = -1;
+		EXPECT_EQ(inTree, Counted::live);
+
+		FrozenTree<int, Counted> frozen = tree.freeze();
+		EXPECT_EQ(2 * inTree, Counted::live);
+		EXPECT_EQ(7, frozen[7].value);
+	}
+	EXPECT_EQ(0, Counted::live);
+}
@@ -0,0 +1,156 @@
+#include "check_trees.h"
+
+#include <random>
+
+typedef AVLTree<int, int, OrderStatistics> SizedTree;
+
+// The cached rightmost node may be unknown (NULL) but never wrong.
+template<typename Tree>
+testing::AssertionResult rightmostCached(Tree& tree)
+{
+	Node<int, int>* last = tree.root_;
+	while(last != nullptr && last->getRight() != nullptr)
+	{
+		last = last->getRight();
+	}
+	if(tree.rightmost_ != nullptr && tree.rightmost_ != last)
+	{
+		return testing::AssertionFailure() << "Cached rightmost is " << tree.rightmost_->getKey()
+			<< " but the largest key is " << (last ? last->getKey() : -1);
+	}
+	return testing::AssertionSuccess();
+}
+
+TEST(HintInsert, CorrectHints)
+{
+	SizedTree tree;
+	std::map<int, int> items;
+	//ascending keys at end()
+	for(int i = 0; i < 1000; i += 4)
+	{
+		SizedTree::iterator it = tree.insert(tree.end(), std::make_pair(i, i));
+		items[i] = i;
+		ASSERT_EQ(i, it->first);
+	}
+	//right after the previous insert
+	SizedTree::iterator prev = tree.find(0);
+	for(int i = 1; i < 1000; i += 4)
+	{
+		prev = tree.insert(prev, std::make_pair(i, i));
+		items[i] = i;
+		ASSERT_EQ(i, prev->first);
+		++prev;
+	}
+	//right before the hint, like std::map
+	for(int i = 3; i < 1000; i += 4)
+	{
+		SizedTree::iterator next = tree.find(i + 1);
+		SizedTree::iterator it = tree.insert(next, std::make_pair(i, i));
+		items[i] = i;
+		ASSERT_EQ(i, it->first);
+	}
+	EXPECT_TRUE(verifyAVL(tree, items.size()));
+	EXPECT_TRUE(sameItems(tree, items));
+	EXPECT_TRUE(rightmostCached(tree));
+}
+
+TEST(HintInsert, WrongAndEndHints)
+{
+	std::mt19937 rng(19);
+	SizedTree tree;
+	std::map<int, int> items;
+	for(int i = 0; i < 3000; ++i)
+	{
+		int key = int(rng() % 5000);
+		SizedTree::iterator hint = tree.end();
+		if(!items.empty() && i % 3 != 0)
+		{
+			hint = tree.select(rng() % tree.size());
+		}
+		SizedTree::iterator it = tree.insert(hint, std::make_pair(key, i));
+		items[key] = i;
+		ASSERT_EQ(key, it->first);
+		ASSERT_EQ(i, it->second);
+	}
+	EXPECT_TRUE(verifyAVL(tree, items.size()));
+	EXPECT_TRUE(sameItems(tree, items));
+	EXPECT_TRUE(rightmostCached(tree));
+
+	//end() with a key below the largest one
+	SizedTree::iterator it = tree.insert(tree.end(), std::make_pair(-1, 7));
+	items[-1] = 7;
+	EXPECT_EQ(-1, it->first);
+	EXPECT_TRUE(tree.begin() == it);
+	EXPECT_TRUE(sameItems(tree, items));
+}
+
+TEST(HintInsert, ExistingKeyIsOverwritten)
+{
+	BinarySearchTree<int, int> tree;
+	for(int i = 0; i < 10; ++i)
+	{
+		tree.insert(std::make_pair(i, i));
+	}
+	BinarySearchTree<int, int>::iterator five = tree.find(5);
+	//as the hint itself, next to it, far from it and at end()
+	EXPECT_TRUE(tree.insert(five, std::make_pair(5, 50)) == five);
+	EXPECT_TRUE(tree.insert(tree.find(6), std::make_pair(5, 51)) == five);
+	EXPECT_TRUE(tree.insert(tree.begin(), std::make_pair(5, 52)) == five);
+	EXPECT_TRUE(tree.insert(tree.end(), std::make_pair(5, 53)) == five);
+	EXPECT_TRUE(tree.insert(tree.end(), std::make_pair(9, 90)) == tree.find(9));
+	EXPECT_EQ(53, tree[5]);
+	EXPECT_EQ(90, tree[9]);
+	int count = 0;
+	for(BinarySearchTree<int, int>::iterator it = tree.begin(); it != tree.end(); ++it)
+	{
+		++count;
+	}
+	EXPECT_EQ(10, count);
+}
+
+TEST(HintInsert, RightmostAfterRemoveClearAndSplit)
+{
+	SizedTree tree;
+	std::map<int, int> items;
+	for(int i = 0; i < 500; ++i)
+	{
+		tree.insert(tree.end(), std::make_pair(i, i));
+		items[i] = i;
+	}
+	//removing the largest keys moves the cache back
+	for(int i = 499; i > 450; i -= 2)
+	{
+		tree.remove(i);
+		items.erase(i);
+		ASSERT_TRUE(rightmostCached(tree)) << "removed " << i;
+		tree.insert(tree.end(), std::make_pair(i + 1000, i));
+		items[i + 1000] = i;
+		ASSERT_TRUE(rightmostCached(tree));
+		tree.remove(i + 1000);
+		items.erase(i + 1000);
+	}
+	EXPECT_TRUE(sameItems(tree, items));
+
+	SizedTree upper;
+	tree.split(300, upper);
+	EXPECT_TRUE(rightmostCached(tree));
+	EXPECT_TRUE(rightmostCached(upper));
+	tree.insert(tree.end(), std::make_pair(300, -1));
+	upper.insert(upper.end(), std::make_pair(2000, -2));
+	upper.insert(upper.end(), std::make_pair(301, -3));
+	EXPECT_TRUE(rightmostCached(tree));
+	EXPECT_TRUE(rightmostCached(upper));
+	EXPECT_EQ(300, tree.select(tree.size() - 1)->first);
+	EXPECT_EQ(2000, upper.select(upper.size() - 1)->first);
+	EXPECT_TRUE(verifyAVL(tree, 301));
+
+	upper.clear();
+	EXPECT_TRUE(rightmostCached(upper));
+	SizedTree::iterator it = upper.insert(upper.end(), std::make_pair(5, 5));
+	EXPECT_TRUE(it == upper.begin());
+	upper.insert(upper.end(), std::make_pair(3, 3));
+	upper.insert(upper.end(), std::make_pair(8, 8));
+	EXPECT_TRUE(rightmostCached(upper));
+	EXPECT_TRUE(verifyAVL(upper, 3));
+	EXPECT_EQ(8, upper.select(2)->first);
+}
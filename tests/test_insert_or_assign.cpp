@@ -0,0 +1,101 @@
+#include "check_trees.h"
+
+#include <random>
+
+typedef AVLTree<int, std::string, OrderStatistics> Names;
+typedef std::pair<Names::iterator, bool> Result;
+
+TEST(InsertOrAssign, MixAgainstMap)
+{
+	std::mt19937 rng(2);
+	Names tree;
+	RedBlackTree<int, std::string> rb;
+	std::map<int, std::string> items;
+	for(int i = 0; i < 10000; ++i)
+	{
+		int key = int(rng() % 1500);
+		std::string value = std::to_string(i);
+		bool fresh = items.count(key) == 0;
+		switch(rng() % 3)
+		{
+		case 0:
+		{
+			Result result = tree.insert_or_assign(key, value);
+			rb.insert_or_assign(key, value);
+			items[key] = value;
+			EXPECT_EQ(fresh, result.second);
+			EXPECT_EQ(key, result.first->first);
+			EXPECT_EQ(value, result.first->second);
+			break;
+		}
+		case 1:
+		{
+			Result result = tree.try_emplace(key, value);
+			rb.try_emplace(key, value);
+			items.insert(std::make_pair(key, value));
+			EXPECT_EQ(fresh, result.second);
+			EXPECT_EQ(items[key], result.first->second);
+			break;
+		}
+		default:
+			tree[key] += "+";
+			rb[key] += "+";
+			items[key] += "+";
+		}
+		if(i % 1000 == 0)
+		{
+			ASSERT_TRUE(verifyAVL(tree, items.size())) << "step " << i;
+			ASSERT_TRUE(verifyRB(rb, items.size())) << "step " << i;
+		}
+	}
+	EXPECT_TRUE(sameItems(tree, items));
+	EXPECT_TRUE(sameItems(rb, items));
+}
+
+TEST(InsertOrAssign, ExistingKeysLeaveArgumentsAlone)
+{
+	AVLTree<std::string, std::string> tree;
+	std::string key = "key";
+	std::string value = "first";
+	EXPECT_TRUE(tree.try_emplace(std::move(key), std::move(value)).second);
+	EXPECT_TRUE(tree.find("key") != tree.end());
+
+	//nothing is moved out of the arguments when the key is there
+	key = "key";
+	value = "second";
+	EXPECT_FALSE(tree.try_emplace(std::move(key), std::move(value)).second);
+	EXPECT_EQ(std::string("key"), key);
+	EXPECT_EQ(std::string("second"), value);
+	EXPECT_EQ(std::string("first"), tree["key"]);
+
+	//insert_or_assign overwrites, and an rvalue key is kept in that case
+	bool added = tree.insert_or_assign(std::move(key), std::move(value)).second;
+	EXPECT_FALSE(added);
+	EXPECT_EQ(std::string("key"), key);
+	EXPECT_EQ(std::string("second"), tree["key"]);
+
+	//try_emplace builds the value from several arguments
+	EXPECT_TRUE(tree.try_emplace("stars", 3u, '*').second);
+	EXPECT_EQ(std::string("***"), tree["stars"]);
+}
+
+TEST(InsertOrAssign, SubscriptInsertsDefaults)
+{
+	AVLTree<int, int, OrderStatistics> tree;
+	for(int i = 0; i < 100; ++i)
+	{
+		tree[i % 10] += i;
+	}
+	EXPECT_EQ(10u, tree.size());
+	EXPECT_EQ(0 + 10 + 20 + 30 + 40 + 50 + 60 + 70 + 80 + 90, tree[0]);
+	EXPECT_TRUE(verifyAVL(tree, 10));
+
+	int key = 42;
+	tree[std::move(key)] = 1;
+	EXPECT_EQ(11u, tree.size());
+
+	const AVLTree<int, int, OrderStatistics>& view = tree;
+	EXPECT_EQ(1, view[42]);
+	EXPECT_THROW(view[43], std::out_of_range);
+	EXPECT_EQ(11u, tree.size());
+}
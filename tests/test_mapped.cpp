@@ -0,0 +1,156 @@
+#include "check_trees.h"
+
+#include <csignal>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <string>
+#include <sys/resource.h>
+
+#include <mapped.h>
+
+typedef MappedTree<int, long> Image;
+
+struct Record
+{
+	double x;
+	char tag[5];
+};
+
+static std::string imagePath(const char* name)
+{
+	return testing::TempDir() + "tree-tests-" + name + ".img";
+}
+
+TEST(MappedTree, SaveAndOpenRoundTrip)
+{
+	std::string path = imagePath("roundtrip");
+	std::mt19937 rng(5);
+	const int sizes[] = { 0, 1, 2, 3, 7, 8, 100, 1000, 4097 };
+	for(std::size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s)
+	{
+		AVLTree<int, long> tree;
+		std::map<int, long> items;
+		for(int i = 0; i < sizes[s]; ++i)
+		{
+			int key = int(rng() % 100000);
+			tree.insert(std::make_pair(key, long(i)));
+			items[key] = i;
+		}
+		Image::save(path, tree);
+		Image image = Image::open(path);
+		EXPECT_EQ(items.size(), image.size());
+		EXPECT_EQ(items.empty(), image.empty());
+		EXPECT_TRUE(sameItems(image, items));
+		for(int q = 0; q < 2000; ++q)
+		{
+			int key = int(rng() % 100000);
+			Image::iterator it = image.find(key);
+			ASSERT_EQ(items.count(key) > 0, it != image.end()) << key;
+			if(it != image.end())
+			{
+				EXPECT_EQ(items[key], image[key]);
+			}
+		}
+
+		Image moved(std::move(image));
+		EXPECT_EQ(items.size(), moved.size());
+		EXPECT_EQ(0u, image.size());
+		image = std::move(moved);
+		EXPECT_TRUE(sameItems(image, items));
+	}
+	EXPECT_THROW(Image::open(path)[-1], std::out_of_range);
+	std::remove(path.c_str());
+}
+
+TEST(MappedTree, StructValuesAndCustomOrder)
+{
+	std::string path = imagePath("struct");
+	AVLTree<long, Record> records;
+	Record a = { 1.5, "abcd" };
+	Record b = { 2.5, "xy" };
+	records.insert(std::make_pair(5L, a));
+	records.insert(std::make_pair(2L, b));
+	MappedTree<long, Record>::save(path, records);
+	MappedTree<long, Record> image = MappedTree<long, Record>::open(path);
+	EXPECT_EQ(1.5, image[5].x);
+	EXPECT_EQ(std::string("xy"), image[2].tag);
+	//the layout check rejects an image of another type
+	EXPECT_THROW(Image::open(path), std::runtime_error);
+
+	AVLTree<int, int, NoAugment, std::greater<int> > descending;
+	for(int i = 0; i < 50; ++i)
+	{
+		descending.insert(std::make_pair(i, i));
+	}
+	MappedTree<int, int, std::greater<int> >::save(path, descending);
+	MappedTree<int, int, std::greater<int> > reversed = MappedTree<int, int, std::greater<int> >::open(path);
+	int expect = 49;
+	for(MappedTree<int, int, std::greater<int> >::iterator it = reversed.begin(); it != reversed.end(); ++it, --expect)
+	{
+		EXPECT_EQ(expect, it->first);
+	}
+	EXPECT_EQ(-1, expect);
+	EXPECT_EQ(17, reversed.find(17)->second);
+	std::remove(path.c_str());
+}
+
+TEST(MappedTree, RejectsBadImages)
+{
+	std::string path = imagePath("bad");
+	EXPECT_THROW(Image::open(path + ".missing"), std::runtime_error);
+
+	{
+		std::ofstream out(path.c_str());
+		out << "hello world, this is not an image at all, padding padding padding padding";
+	}
+	EXPECT_THROW(Image::open(path), std::runtime_error);
+
+	AVLTree<int, long> tree;
+	for(int i = 0; i < 100; ++i)
+	{
+		tree.insert(std::make_pair(i, long(i)));
+	}
+	Image::save(path, tree);
+	//cut the file short of its last item
+	ASSERT_EQ(0, ::truncate(path.c_str(), 64 + 100 * sizeof(Image::value_type)));
+	EXPECT_THROW(Image::open(path), std::runtime_error);
+
+	//a count so large that count + 1 wraps around to 0
+	Image::save(path, tree);
+	{
+		std::fstream file(path.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+		uint64_t count = ~uint64_t(0);
+		file.seekp(40);
+		file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+	}
+	EXPECT_THROW(Image::open(path), std::runtime_error);
+
+	EXPECT_THROW(Image::save("/nonexistent/dir/x", tree), std::runtime_error);
+	std::remove(path.c_str());
+}
+
+TEST(MappedTree, SaveThrowsWhenTheFileCannotGrow)
+{
+	// A file size limit stands in for a full disk: the blocks cannot be
+	// allocated, so save must throw rather than fault while writing.
+	std::string path = imagePath("limit");
+	AVLTree<int, long> tree;
+	for(int i = 0; i < 10000; ++i)
+	{
+		tree.insert(std::make_pair(i, long(i)));
+	}
+	struct rlimit saved;
+	ASSERT_EQ(0, ::getrlimit(RLIMIT_FSIZE, &saved));
+	void (*handler)(int) = std::signal(SIGXFSZ, SIG_IGN);
+	struct rlimit limit = saved;
+	limit.rlim_cur = 4096;
+	ASSERT_EQ(0, ::setrlimit(RLIMIT_FSIZE, &limit));
+	EXPECT_THROW(Image::save(path, tree), std::runtime_error);
+	::setrlimit(RLIMIT_FSIZE, &saved);
+	std::signal(SIGXFSZ, handler);
+
+	//the failed save left nothing behind
+	EXPECT_THROW(Image::open(path), std::runtime_error);
+	EXPECT_THROW(Image::open(path + ".tmp"), std::runtime_error);
+}
@@ -0,0 +1,117 @@
+#include "check_trees.h"
+
+#include <random>
+#include <tuple>
+
+// Move-only and not default constructible; counts the live objects so
+// the tests notice values that are leaked or destroyed twice.
+struct Handle
+{
+	static int live;
+
+	explicit Handle(int v) : value(new int(v)) { ++live; }
+	Handle(Handle&& other) : value(std::move(other.value)) { ++live; }
+	Handle& operator=(Handle&& other)
+	{
+		value = std::move(other.value);
+		return *this;
+	}
+	~Handle() { --live; }
+
+	std::unique_ptr<int> value;
+};
+
+int Handle::live = 0;
+
+template<typename Tree>
+void emplaceMoveOnly(Tree& tree)
+{
+	std::mt19937 rng(3);
+	std::map<int, int> items;
+	for(int i = 0; i < 3000; ++i)
+	{
+		int key = int(rng() % 500);
+		switch(rng() % 4)
+		{
+		case 0:
+		{
+			//an existing key keeps its value, the new one is dropped
+			std::pair<typename Tree::iterator, bool> result = tree.emplace(key, Handle(i));
+			EXPECT_EQ(items.count(key) == 0, result.second);
+			items.insert(std::make_pair(key, i));
+			EXPECT_EQ(items[key], *result.first->second.value);
+			break;
+		}
+		case 1:
+			tree.insert(std::make_pair(key, Handle(i)));
+			items[key] = i;
+			break;
+		case 2:
+			tree.insert_or_assign(key, Handle(i));
+			items[key] = i;
+			break;
+		default:
+			tree.remove(key);
+			items.erase(key);
+		}
+		ASSERT_EQ(int(items.size()), Handle::live) << "step " << i;
+	}
+	std::map<int, int>::iterator want = items.begin();
+	for(typename Tree::iterator it = tree.begin(); it != tree.end(); ++it, ++want)
+	{
+		ASSERT_TRUE(want != items.end());
+		EXPECT_EQ(want->first, it->first);
+		EXPECT_EQ(want->second, *it->second.value);
+	}
+	EXPECT_TRUE(want == items.end());
+	tree.clear();
+	EXPECT_EQ(0, Handle::live);
+}
+
+TEST(MoveOnly, EmplaceIntoEveryTree)
+{
+	{
+		BinarySearchTree<int, Handle> plain;
+		emplaceMoveOnly(plain);
+	}
+	{
+		AVLTree<int, Handle, OrderStatistics> avl;
+		emplaceMoveOnly(avl);
+		avl.emplace(std::piecewise_construct, std::forward_as_tuple(1), std::forward_as_tuple(10));
+		EXPECT_TRUE(verifyAVL(avl, 1));
+	}
+	{
+		RedBlackTree<int, Handle> rb;
+		emplaceMoveOnly(rb);
+		rb.try_emplace(2, 20);
+		EXPECT_TRUE(verifyRB(rb, 1));
+	}
+	EXPECT_EQ(0, Handle::live);
+}
+
+TEST(MoveOnly, UniquePtrValues)
+{
+	AVLTree<std::string, std::unique_ptr<int> > tree;
+	tree.emplace("one", std::unique_ptr<int>(new int(1)));
+	tree.insert(std::make_pair(std::string("two"), std::unique_ptr<int>(new int(2))));
+	EXPECT_TRUE(tree.try_emplace("three", new int(3)).second);
+	EXPECT_FALSE(tree.try_emplace("three", nullptr).second);
+	tree["four"].reset(new int(4));
+	std::unique_ptr<int> five(new int(5));
+	tree.insert_or_assign("five", std::move(five));
+	EXPECT_TRUE(five == nullptr);
+
+	EXPECT_EQ(1, *tree["one"]);
+	EXPECT_EQ(2, *tree["two"]);
+	EXPECT_EQ(3, *tree["three"]);
+	EXPECT_EQ(4, *tree["four"]);
+	EXPECT_EQ(5, *tree["five"]);
+	tree.remove("two");
+	EXPECT_TRUE(tree.find("two") == tree.end());
+	EXPECT_TRUE(verifyAVL(tree, 4));
+
+	//keys are moved in too
+	std::string key(100, 'k');
+	tree.emplace(std::move(key), std::unique_ptr<int>(new int(6)));
+	EXPECT_EQ(6, *tree[std::string(100, 'k')]);
+}
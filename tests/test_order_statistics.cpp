@@ -0,0 +1,113 @@
+#include "check_trees.h"
+
+#include <random>
+
+typedef AVLTree<int, int, OrderStatistics> SizedTree;
+
+// Compares size, select, rank and count_range with the brute-force
+// answers from a sorted copy of the keys.
+static testing::AssertionResult sameStatistics(const SizedTree& tree, const std::map<int, int>& items, std::mt19937& rng)
+{
+	std::vector<int> keys;
+	for(std::map<int, int>::const_iterator it = items.begin(); it != items.end(); ++it)
+	{
+		keys.push_back(it->first);
+	}
+	if(tree.size() != keys.size())
+	{
+		return testing::AssertionFailure() << "size() is " << tree.size() << ", expected " << keys.size();
+	}
+	for(std::size_t k = 0; k < keys.size(); ++k)
+	{
+		SizedTree::iterator it = tree.select(k);
+		if(it == tree.end() || it->first != keys[k])
+		{
+			return testing::AssertionFailure() << "select(" << k << ") is wrong";
+		}
+	}
+	if(!(tree.select(keys.size()) == tree.end()))
+	{
+		return testing::AssertionFailure() << "select(size()) is not end()";
+	}
+	for(int q = 0; q < 200; ++q)
+	{
+		int key = int(rng() % 2200) - 100;
+		std::size_t below = std::lower_bound(keys.begin(), keys.end(), key) - keys.begin();
+		if(tree.rank(key) != below)
+		{
+			return testing::AssertionFailure() << "rank(" << key << ") is " << tree.rank(key) << ", expected " << below;
+		}
+		int hi = key + int(rng() % 400) - 100;
+		std::size_t inside = 0;
+		for(std::size_t i = 0; i < keys.size(); ++i)
+		{
+			inside += key <= keys[i] && keys[i] < hi ? 1 : 0;
+		}
+		if(tree.count_range(key, hi) != inside)
+		{
+			return testing::AssertionFailure() << "count_range(" << key << ", " << hi << ") is "
+				<< tree.count_range(key, hi) << ", expected " << inside;
+		}
+	}
+	return testing::AssertionSuccess();
+}
+
+TEST(OrderStatistics, AgainstSortedKeys)
+{
+	std::mt19937 rng(6);
+	SizedTree tree;
+	std::map<int, int> items;
+	EXPECT_TRUE(sameStatistics(tree, items, rng));
+	for(int round = 0; round < 20; ++round)
+	{
+		for(int i = 0; i < 200; ++i)
+		{
+			int key = int(rng() % 2000);
+			if(rng() % 3 != 0)
+			{
+				tree.insert(std::make_pair(key, i));
+				items[key] = i;
+			}
+			else
+			{
+				tree.remove(key);
+				items.erase(key);
+			}
+		}
+		ASSERT_TRUE(verifyAVL(tree, items.size())) << "round " << round;
+		ASSERT_TRUE(sameStatistics(tree, items, rng)) << "round " << round;
+	}
+}
+
+TEST(OrderStatistics, BulkBuildsAndRemovalsDownToEmpty)
+{
+	std::mt19937 rng(60);
+	std::vector<std::pair<int, int> > sorted;
+	std::map<int, int> items;
+	for(int i = 0; i < 1000; ++i)
+	{
+		sorted.push_back(std::make_pair(i * 2, i));
+		items[i * 2] = i;
+	}
+	SizedTree tree;
+	tree.assign_sorted(sorted.begin(), sorted.end());
+	ASSERT_TRUE(verifyAVL(tree, items.size()));
+	EXPECT_TRUE(sameStatistics(tree, items, rng));
+
+	//remove through the middle so two-child removals swap nodes around
+	while(!items.empty())
+	{
+		std::map<int, int>::iterator middle = items.begin();
+		std::advance(middle, items.size() / 2);
+		tree.remove(middle->first);
+		items.erase(middle);
+		if(items.size() % 50 == 0)
+		{
+			ASSERT_TRUE(verifyAVL(tree, items.size()));
+			ASSERT_TRUE(sameStatistics(tree, items, rng));
+		}
+	}
+	EXPECT_EQ(0u, tree.size());
+	EXPECT_TRUE(tree.select(0) == tree.end());
+	EXPECT_EQ(0u, tree.count_range(-5, 5));
+}
@@ -0,0 +1,170 @@
+#include "check_trees.h"
+
+#include <atomic>
+#include <functional>
+#include <stdexcept>
+#include <string>
+
+#include <parallel_bst.h>
+
+static long addLongs(long a, long b)
+{
+	return a + b;
+}
+
+TEST(ParallelScan, ForEachVisitsEveryItemOnce)
+{
+	for(std::size_t workers = 0; workers <= 8; workers = workers * 2 + 1)
+	{
+		ThreadPool pool(workers);
+		AVLTree<int, int> tree;
+		for(int i = 0; i < 100000; ++i)
+		{
+			tree.insert(std::make_pair(i * 7 % 100003, i));
+		}
+		std::atomic<long> sum(0);
+		std::atomic<long> count(0);
+		parallel_for_each(tree, [&](std::pair<const int, int>& item)
+		{
+			sum += item.first;
+			++count;
+			item.second += 1;
+		}, pool);
+
+		long expectSum = 0;
+		long expectCount = 0;
+		long values = 0;
+		for(AVLTree<int, int>::iterator it = tree.begin(); it != tree.end(); ++it)
+		{
+			expectSum += it->first;
+			++expectCount;
+			values += it->second;
+		}
+		EXPECT_EQ(expectSum, sum.load()) << workers << " workers";
+		EXPECT_EQ(expectCount, count.load()) << workers << " workers";
+		EXPECT_EQ(values, parallel_reduce(tree, 0L, [](const std::pair<const int, int>& item)
+		{
+			return long(item.second);
+		}, addLongs, pool));
+	}
+}
+
+TEST(ParallelScan, ReduceKeepsKeyOrder)
+{
+	ThreadPool pool(3);
+	AVLTree<int, char> tree;
+	for(int i = 0; i < 3000; ++i)
+	{
+		tree.insert(std::make_pair(i * 37 % 3001, char('a' + i % 26)));
+	}
+	std::string sequential;
+	for(AVLTree<int, char>::iterator it = tree.begin(); it != tree.end(); ++it)
+	{
+		sequential += it->second;
+	}
+	std::string parallel = parallel_reduce(tree, std::string(), [](const std::pair<const int, char>& item)
+	{
+		return std::string(1, item.second);
+	}, [](const std::string& a, const std::string& b)
+	{
+		return a + b;
+	}, pool);
+	EXPECT_EQ(sequential, parallel);
+}
+
+TEST(ParallelScan, UnbalancedAndEmptyTrees)
+{
+	ThreadPool pool(3);
+	BinarySearchTree<int, int> chain;
+	for(int i = 0; i < 20000; ++i)
+	{
+		chain.insert(std::make_pair(i, 1));
+	}
+	EXPECT_EQ(20000L, parallel_reduce(chain, 0L, [](const std::pair<const int, int>& item)
+	{
+		return long(item.second);
+	}, addLongs, pool));
+
+	BinarySearchTree<int, int> empty;
+	EXPECT_EQ(5L, parallel_reduce(empty, 5L, [](const std::pair<const int, int>&)
+	{
+		return 1L;
+	}, addLongs, pool));
+}
+
+TEST(ParallelScan, ExceptionsReachTheCaller)
+{
+	ThreadPool pool(3);
+	AVLTree<int, int> tree;
+	for(int i = 0; i < 1000; ++i)
+	{
+		tree.insert(std::make_pair(i, i));
+	}
+	EXPECT_THROW(parallel_for_each(tree, [](std::pair<const int, int>& item)
+	{
+		if(item.first == 500)
+		{
+			throw std::runtime_error("stop");
+		}
+	}, pool), std::runtime_error);
+
+	std::atomic<int> count(0);
+	parallel_for_each(tree, [&](std::pair<const int, int>&)
+	{
+		++count;
+	});
+	EXPECT_EQ(1000, count.load());
+}
+
+TEST(ParallelScan, ThrowsFromDeepForksOnOneWorker)
+{
+	// Many subtrees below the fork depth throw, so invoke() unwinds while
+	// its forked half is still queued on the throwing worker's own deque.
+	ThreadPool pool(1);
+	AVLTree<int, int> tree;
+	for(int i = 0; i < 100000; ++i)
+	{
+		tree.insert(std::make_pair(i, i));
+	}
+	for(int round = 0; round < 5; ++round)
+	{
+		EXPECT_THROW(parallel_for_each(tree, [](std::pair<const int, int>& item)
+		{
+			if(item.first % 1000 == 999)
+			{
+				throw std::runtime_error("deep");
+			}
+		}, pool), std::runtime_error);
+		EXPECT_THROW(parallel_reduce(tree, 0L, [](const std::pair<const int, int>& item) -> long
+		{
+			if(item.first % 1000 == 999)
+			{
+				throw std::runtime_error("deep");
+			}
+			return 1;
+		}, addLongs, pool), std::runtime_error);
+	}
+
+	//the pool is still usable afterwards
+	EXPECT_EQ(100000L, parallel_reduce(tree, 0L, [](const std::pair<const int, int>&)
+	{
+		return 1L;
+	}, addLongs, pool));
+}
+
+TEST(ParallelScan, NestedInvokesUnwindOnOneWorker)
+{
+	ThreadPool pool(1);
+	std::atomic<int> ran(0);
+	std::function<void(int)> fork = [&](int depth)
+	{
+		++ran;
+		if(depth == 0)
+		{
+			throw std::runtime_error("leaf");
+		}
+		pool.invoke([&]() { fork(depth - 1); }, [&]() { fork(depth - 1); });
+	};
+	EXPECT_THROW(pool.invoke([&]() { fork(10); }, [&]() { fork(10); }), std::runtime_error);
+	EXPECT_LT(0, ran.load());
+}
@@ -0,0 +1,129 @@
+#include "check_trees.h"
+
+#include <atomic>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <persistentavl.h>
+
+typedef PersistentAVLTree<int, int> Tree;
+typedef PersistentAVLSnapshot<int, int> Snapshot;
+
+TEST(PersistentAVL, SnapshotsOutliveLaterUpdates)
+{
+	Tree tree;
+	std::map<int, int> items;
+	std::vector<Snapshot> snapshots;
+	std::vector<std::map<int, int> > expected;
+	std::mt19937 rng(12);
+	for(int step = 0; step < 3000; ++step)
+	{
+		int key = int(rng() % 500);
+		if(rng() % 3 == 0)
+		{
+			tree.remove(key);
+			items.erase(key);
+		}
+		else
+		{
+			tree.insert(std::make_pair(key, step));
+			items[key] = step;
+		}
+		if(step % 100 == 0)
+		{
+			snapshots.push_back(tree.snapshot());
+			expected.push_back(items);
+		}
+	}
+	EXPECT_TRUE(sameItems(tree, items));
+	EXPECT_EQ(items.size(), tree.size());
+
+	for(std::size_t i = 0; i < snapshots.size(); ++i)
+	{
+		EXPECT_TRUE(sameItems(snapshots[i], expected[i])) << "snapshot " << i;
+		EXPECT_EQ(expected[i].size(), snapshots[i].size());
+		for(std::map<int, int>::const_iterator it = expected[i].begin(); it != expected[i].end(); ++it)
+		{
+			EXPECT_EQ(it->second, snapshots[i][it->first]);
+		}
+	}
+}
+
+TEST(PersistentAVL, SnapshotOutlivesClearAndTree)
+{
+	Snapshot snapshot;
+	std::map<int, int> items;
+	{
+		Tree tree;
+		for(int i = 0; i < 200; ++i)
+		{
+			tree.insert(std::make_pair(i, -i));
+			items[i] = -i;
+		}
+		snapshot = tree.snapshot();
+		tree.clear();
+		EXPECT_TRUE(tree.empty());
+		EXPECT_EQ(0u, tree.size());
+	}
+	EXPECT_TRUE(sameItems(snapshot, items));
+	EXPECT_TRUE(snapshot.find(200) == snapshot.end());
+	EXPECT_THROW(snapshot[200], std::out_of_range);
+}
+
+TEST(PersistentAVL, ReadersIterateWhileWriterPublishes)
+{
+	// The writer keeps every version a prefix 0..n-1 of the keys, each
+	// holding its own key as the value, so a reader can check a whole
+	// snapshot against its size alone.
+	const int WRITES = 20000;
+	Tree tree;
+	std::atomic<bool> done(false);
+	std::atomic<int> failures(0);
+	std::atomic<long> checked(0);
+
+	std::vector<std::thread> readers;
+	for(int r = 0; r < 3; ++r)
+	{
+		readers.push_back(std::thread([&]()
+		{
+			while(!done.load())
+			{
+				Snapshot snapshot = tree.snapshot();
+				int expect = 0;
+				for(Snapshot::iterator it = snapshot.begin(); it != snapshot.end(); ++it, ++expect)
+				{
+					if(it->first != expect || it->second != expect)
+					{
+						++failures;
+					}
+				}
+				if(std::size_t(expect) != snapshot.size())
+				{
+					++failures;
+				}
+				++checked;
+			}
+		}));
+	}
+
+	for(int i = 0; i < WRITES; ++i)
+	{
+		tree.insert(std::make_pair(i, i));
+		if(i % 4 == 3)
+		{
+			//shrink back by one now and then so removals are published too
+			tree.remove(i);
+			tree.insert(std::make_pair(i, i));
+		}
+	}
+	done = true;
+	for(std::size_t r = 0; r < readers.size(); ++r)
+	{
+		readers[r].join();
+	}
+
+	EXPECT_EQ(0, failures.load());
+	EXPECT_LT(0, checked.load());
+	EXPECT_EQ(std::size_t(WRITES), tree.size());
+}
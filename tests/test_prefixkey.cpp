@@ -0,0 +1,133 @@
+#include "check_trees.h"
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <prefixkey.h>
+
+typedef AVLTree<PrefixedString, int, NoAugment, PrefixLess> PrefixTree;
+
+// Short strings, embedded and trailing '\0's, bytes >= 0x80 and strings
+// that tie on the first 8 bytes.
+static std::vector<std::string> awkwardKeys()
+{
+	std::vector<std::string> keys;
+	keys.push_back("");
+	keys.push_back(std::string(1, '\0'));
+	keys.push_back(std::string(2, '\0'));
+	keys.push_back(std::string(9, '\0'));
+	keys.push_back("a");
+	keys.push_back(std::string("a\0", 2));
+	keys.push_back(std::string("a\0b", 3));
+	keys.push_back("ab");
+	keys.push_back("abcdefg");
+	keys.push_back(std::string("abcdefg\0", 8));
+	keys.push_back("abcdefgh");
+	keys.push_back(std::string("abcdefgh\0", 9));
+	keys.push_back("abcdefghi");
+	keys.push_back("abcdefgi");
+	keys.push_back("\x7f");
+	keys.push_back("\x80");
+	keys.push_back("\xff");
+	keys.push_back("\xff\xff\xff\xff\xff\xff\xff\xff");
+	keys.push_back("\xff\xff\xff\xff\xff\xff\xff\xff\x01");
+	keys.push_back("z\x80y");
+	keys.push_back("z\x7fy");
+	return keys;
+}
+
+TEST(PrefixedString, OrdersLikeStdString)
+{
+	std::vector<std::string> keys = awkwardKeys();
+	for(std::size_t i = 0; i < keys.size(); ++i)
+	{
+		for(std::size_t j = 0; j < keys.size(); ++j)
+		{
+			PrefixedString a(keys[i]);
+			PrefixedString b(keys[j]);
+			EXPECT_EQ(keys[i] < keys[j], a < b) << i << " " << j;
+			EXPECT_EQ(keys[i] == keys[j], a == b) << i << " " << j;
+			EXPECT_EQ(keys[i] <= keys[j], a <= b) << i << " " << j;
+			EXPECT_EQ(keys[i] < keys[j], PrefixLess()(a, keys[j])) << i << " " << j;
+			EXPECT_EQ(keys[i] < keys[j], PrefixLess()(keys[i], b)) << i << " " << j;
+		}
+	}
+}
+
+TEST(PrefixedString, ShortStringsArePaddedWithZeros)
+{
+	EXPECT_EQ(0u, PrefixedString("").prefix());
+	EXPECT_EQ(uint64_t(0x6162000000000000ull), PrefixedString("ab").prefix());
+	EXPECT_EQ(uint64_t(0x8000000000000000ull), PrefixedString("\x80").prefix());
+	//a trailing '\0' does not change the prefix, but the keys still differ
+	PrefixedString a("a");
+	PrefixedString b(std::string("a\0", 2));
+	EXPECT_EQ(a.prefix(), b.prefix());
+	EXPECT_TRUE(a < b);
+	EXPECT_FALSE(a == b);
+	EXPECT_EQ(2u, b.size());
+}
+
+TEST(PrefixedString, CharPointerOverloadsStopAtTheFirstZero)
+{
+	PrefixedString key("abc");
+	PrefixLess less;
+	EXPECT_FALSE(less(key, "abc"));
+	EXPECT_FALSE(less("abc", key));
+	EXPECT_TRUE(less(key, "abd"));
+	EXPECT_TRUE(less("ab", key));
+	EXPECT_TRUE(less(key, "\x80"));
+	EXPECT_FALSE(less("\x80", key));
+	//a const char* ends at its first '\0'
+	PrefixedString embedded(std::string("abc\0d", 5));
+	EXPECT_TRUE(less("abc", embedded));
+	EXPECT_FALSE(less(embedded, "abc"));
+}
+
+TEST(PrefixedString, TreeLookupsWithEveryKeyType)
+{
+	std::vector<std::string> keys = awkwardKeys();
+	std::mt19937 rng(5);
+	std::shuffle(keys.begin(), keys.end(), rng);
+
+	PrefixTree tree;
+	std::map<std::string, int> expected;
+	for(std::size_t i = 0; i < keys.size(); ++i)
+	{
+		tree.insert(std::make_pair(PrefixedString(keys[i]), int(i)));
+		expected[keys[i]] = int(i);
+	}
+
+	std::map<std::string, int>::const_iterator want = expected.begin();
+	for(PrefixTree::iterator it = tree.begin(); it != tree.end(); ++it, ++want)
+	{
+		ASSERT_TRUE(want != expected.end());
+		EXPECT_EQ(want->first, it->first.str());
+		EXPECT_EQ(want->second, it->second);
+	}
+	EXPECT_TRUE(want == expected.end());
+
+	for(std::size_t i = 0; i < keys.size(); ++i)
+	{
+		PrefixTree::iterator byString = tree.find(keys[i]);
+		ASSERT_TRUE(byString != tree.end()) << i;
+		EXPECT_EQ(keys[i], byString->first.str());
+		EXPECT_TRUE(tree.find(PrefixedString(keys[i])) == byString);
+		if(keys[i].find('\0') == std::string::npos)
+		{
+			EXPECT_TRUE(tree.find(keys[i].c_str()) == byString) << i;
+		}
+	}
+	EXPECT_TRUE(tree.find(std::string("abcdefgh\0\0", 10)) == tree.end());
+	EXPECT_TRUE(tree.find("abcdefgj") == tree.end());
+	EXPECT_TRUE(tree.find("\xfe") == tree.end());
+
+	tree.remove(std::string("a\0b", 3));
+	tree.remove("\x80");
+	EXPECT_TRUE(tree.find(std::string("a\0b", 3)) == tree.end());
+	EXPECT_TRUE(tree.find("\x80") == tree.end());
+	EXPECT_TRUE(tree.find("a") != tree.end());
+	EXPECT_TRUE(tree.find("\xff") != tree.end());
+}
@@ -0,0 +1,134 @@
+#include "check_trees.h"
+
+#include <random>
+
+typedef RedBlackTree<int, int> RBTree;
+
+TEST(RedBlackTree, InsertAndRemoveKeepTheColors)
+{
+	std::mt19937 rng(21);
+	RBTree tree;
+	std::map<int, int> items;
+	for(int i = 0; i < 4000; ++i)
+	{
+		int key = int(rng() % 1000);
+		if(rng() % 3 != 0)
+		{
+			tree.insert(std::make_pair(key, i));
+			items[key] = i;
+		}
+		else
+		{
+			tree.remove(key);
+			items.erase(key);
+		}
+		if(i % 97 == 0)
+		{
+			ASSERT_TRUE(verifyRB(tree, items.size())) << "step " << i;
+		}
+	}
+	EXPECT_TRUE(verifyRB(tree, items.size()));
+	EXPECT_TRUE(sameItems(tree, items));
+
+	//remove everything, checking after each one
+	while(!items.empty())
+	{
+		int key = items.begin()->first;
+		if(items.size() % 2 == 0)
+		{
+			key = items.rbegin()->first;
+		}
+		tree.remove(key);
+		items.erase(key);
+		ASSERT_TRUE(verifyRB(tree, items.size())) << "removed " << key;
+	}
+	EXPECT_TRUE(tree.empty());
+}
+
+TEST(RedBlackTree, SortedInsertsStayShallow)
+{
+	RBTree tree;
+	std::map<int, int> items;
+	for(int i = 0; i < 10000; ++i)
+	{
+		tree.insert(std::make_pair(i, -i));
+		items[i] = -i;
+	}
+	EXPECT_TRUE(verifyRB(tree, items.size()));
+	EXPECT_TRUE(sameItems(tree, items));
+	for(int i = 0; i < 10000; i += 3)
+	{
+		tree.remove(i);
+		items.erase(i);
+	}
+	EXPECT_TRUE(verifyRB(tree, items.size()));
+	EXPECT_TRUE(sameItems(tree, items));
+	EXPECT_EQ(-4, tree[4]);
+	EXPECT_TRUE(tree.find(3) == tree.end());
+}
+
+TEST(RedBlackTree, AssignSortedColorsEverySize)
+{
+	for(int n = 0; n <= 130; ++n)
+	{
+		std::vector<std::pair<int, int> > sorted;
+		std::map<int, int> items;
+		for(int i = 0; i < n; ++i)
+		{
+			sorted.push_back(std::make_pair(i * 2, i));
+			items[i * 2] = i;
+		}
+		RBTree tree;
+		tree.insert(std::make_pair(-5, 0));
+		tree.assign_sorted(sorted.begin(), sorted.end());
+		ASSERT_TRUE(verifyRB(tree, items.size())) << n << " items";
+		EXPECT_TRUE(sameItems(tree, items)) << n << " items";
+
+		//the built tree keeps working as a red-black tree
+		for(int i = 0; i < n; i += 2)
+		{
+			tree.remove(i * 2);
+			items.erase(i * 2);
+			tree.insert(std::make_pair(i * 2 + 1, i));
+			items[i * 2 + 1] = i;
+		}
+		ASSERT_TRUE(verifyRB(tree, items.size())) << n << " items";
+		EXPECT_TRUE(sameItems(tree, items)) << n << " items";
+	}
+}
+
+TEST(RedBlackTree, RebalanceColorsEverySize)
+{
+	std::mt19937 rng(4);
+	for(int n = 0; n <= 130; ++n)
+	{
+		RBTree tree;
+		std::map<int, int> items;
+		for(int i = 0; i < n; ++i)
+		{
+			int key = int(rng() % 1000);
+			tree.insert(std::make_pair(key, i));
+			items[key] = i;
+		}
+		tree.rebalance();
+		ASSERT_TRUE(verifyRB(tree, items.size())) << n << " items";
+		EXPECT_TRUE(sameItems(tree, items)) << n << " items";
+
+		for(int i = 0; i < 50; ++i)
+		{
+			int key = int(rng() % 1000);
+			if(i % 2 == 0)
+			{
+				tree.insert(std::make_pair(key, i));
+				items[key] = i;
+			}
+			else
+			{
+				tree.remove(key);
+				items.erase(key);
+			}
+		}
+		ASSERT_TRUE(verifyRB(tree, items.size())) << n << " items";
+		EXPECT_TRUE(sameItems(tree, items)) << n << " items";
+	}
+}
@@ -0,0 +1,142 @@
+#include "check_trees.h"
+
+#include <random>
+
+struct KeySum
+{
+	typedef long value_type;
+	static long identity() { return 0; }
+	static long lift(const int& key, const int&) { return key; }
+	static long combine(long a, long b) { return a + b; }
+};
+
+typedef AVLTree<int, int, Aggregate<KeySum> > SumTree;
+
+// Checks the cached rightmost node (if one is cached) and that appending
+// through insert(end(), ...) still lands after the largest key.
+template<typename Tree>
+testing::AssertionResult rightmostWorks(Tree& tree, int next)
+{
+	Node<int, int>* last = tree.root_;
+	while(last != nullptr && last->getRight() != nullptr)
+	{
+		last = last->getRight();
+	}
+	if(tree.rightmost_ != nullptr && tree.rightmost_ != last)
+	{
+		return testing::AssertionFailure() << "Cached rightmost is " << tree.rightmost_->getKey();
+	}
+	typename Tree::iterator it = tree.insert(tree.end(), std::make_pair(next, next));
+	if(it == tree.end() || it->first != next)
+	{
+		return testing::AssertionFailure() << "insert(end(), " << next << ") did not return the item";
+	}
+	typename Tree::iterator after = it;
+	if(!(++after == tree.end()))
+	{
+		return testing::AssertionFailure() << next << " is not the last item";
+	}
+	return testing::AssertionSuccess();
+}
+
+TEST(Rebalance, DegenerateBinarySearchTree)
+{
+	for(int n = 0; n <= 300; n += (n < 20 ? 1 : 37))
+	{
+		BinarySearchTree<int, int> tree;
+		std::map<int, int> items;
+		std::vector<BinarySearchTree<int, int>::iterator> kept;
+		for(int i = 0; i < n; ++i)
+		{
+			kept.push_back(tree.insert(tree.end(), std::make_pair(i, i * 2)));
+			items[i] = i * 2;
+		}
+		tree.rebalance();
+
+		testing::AssertionResult links = testing::AssertionSuccess();
+		ASSERT_EQ(n, (checkLinks<int, int>(tree.root_, static_cast<Node<int, int>*>(nullptr), nullptr, nullptr, links)))
+			<< links.message();
+		EXPECT_TRUE(tree.isBalanced()) << n << " items";
+		EXPECT_TRUE(sameItems(tree, items));
+
+		//the nodes stayed put, so old iterators still walk in order
+		for(int i = 0; i < n; ++i)
+		{
+			BinarySearchTree<int, int>::iterator it = kept[i];
+			EXPECT_EQ(i, it->first);
+			++it;
+			EXPECT_TRUE(i + 1 < n ? it->first == i + 1 : it == tree.end());
+		}
+		EXPECT_TRUE(rightmostWorks(tree, n));
+	}
+}
+
+TEST(Rebalance, AVLKeepsBalancesAndAggregates)
+{
+	std::mt19937 rng(23);
+	for(int n = 0; n <= 300; n += (n < 20 ? 1 : 37))
+	{
+		SumTree tree;
+		std::map<int, int> items;
+		for(int i = 0; i < n; ++i)
+		{
+			int key = int(rng() % 1000);
+			tree.insert(std::make_pair(key, i));
+			items[key] = i;
+		}
+		tree.rebalance();
+		ASSERT_TRUE(verifyAVL(tree, items.size())) << n << " items";
+		EXPECT_TRUE(sameItems(tree, items));
+		EXPECT_EQ(items.size(), tree.size());
+
+		std::size_t index = 0;
+		long total = 0;
+		for(std::map<int, int>::iterator it = items.begin(); it != items.end(); ++it, ++index)
+		{
+			EXPECT_EQ(it->first, tree.select(index)->first);
+			EXPECT_EQ(index, tree.rank(it->first));
+			total += it->first;
+		}
+		EXPECT_EQ(total, tree.aggregate());
+		for(int q = 0; q < 20; ++q)
+		{
+			int lo = int(rng() % 1000);
+			int hi = lo + int(rng() % 300);
+			long sum = 0;
+			for(std::map<int, int>::iterator it = items.lower_bound(lo); it != items.lower_bound(hi); ++it)
+			{
+				sum += it->first;
+			}
+			EXPECT_EQ(sum, tree.aggregate(lo, hi)) << "[" << lo << ", " << hi << ")";
+		}
+
+		//and it stays a working AVL tree
+		tree.remove(items.empty() ? 0 : items.begin()->first);
+		items.erase(items.empty() ? 0 : items.begin()->first);
+		tree.insert(std::make_pair(500, -1));
+		items[500] = -1;
+		EXPECT_TRUE(verifyAVL(tree, items.size()));
+		EXPECT_TRUE(rightmostWorks(tree, 1000));
+	}
+}
+
+TEST(Rebalance, RedBlackColors)
+{
+	for(int n = 0; n <= 300; n += (n < 20 ? 1 : 37))
+	{
+		RedBlackTree<int, int> tree;
+		std::map<int, int> items;
+		for(int i = 0; i < n; ++i)
+		{
+			tree.insert(std::make_pair(i, i));
+			items[i] = i;
+		}
+		tree.rebalance();
+		ASSERT_TRUE(verifyRB(tree, items.size())) << n << " items";
+		EXPECT_TRUE(tree.isBalanced());
+		EXPECT_TRUE(sameItems(tree, items));
+		EXPECT_TRUE(rightmostWorks(tree, n));
+		items[n] = n;
+		EXPECT_TRUE(verifyRB(tree, items.size()));
+	}
+}
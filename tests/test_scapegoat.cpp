@@ -0,0 +1,126 @@
+#include "check_trees.h"
+
+#include <cmath>
+#include <random>
+#include <stdexcept>
+
+#include <scapegoat.h>
+
+typedef ScapegoatTree<int, int> Tree;
+
+// Levels a lookup can visit: 1 for a single node.
+template<typename Key, typename Value>
+static int deepest(Node<Key, Value>* node)
+{
+	if(node == nullptr)
+	{
+		return 0;
+	}
+	return 1 + std::max(deepest(node->getLeft()), deepest(node->getRight()));
+}
+
+static testing::AssertionResult withinDepthBound(Tree& tree)
+{
+	std::size_t n = std::max<std::size_t>(tree.size(), 1);
+	int depth = deepest(tree.root_);
+	double bound = std::log(double(n)) / std::log(1 / tree.alpha()) + 1;
+	if(depth > bound + 1e-9)
+	{
+		return testing::AssertionFailure() << "depth " << depth << " over " << bound << " with " << n << " items";
+	}
+	return testing::AssertionSuccess();
+}
+
+TEST(Scapegoat, SortedInsertsStayShallow)
+{
+	const double alphas[] = { 0.55, 2.0 / 3, 0.8, 0.95 };
+	for(std::size_t a = 0; a < sizeof(alphas) / sizeof(alphas[0]); ++a)
+	{
+		Tree ascending(alphas[a]);
+		Tree descending(alphas[a]);
+		for(int i = 0; i < 20000; ++i)
+		{
+			ascending.insert(std::make_pair(i, i));
+			descending.insert(std::make_pair(-i, i));
+			if(i % 97 == 0)
+			{
+				ASSERT_TRUE(withinDepthBound(ascending)) << "alpha " << alphas[a];
+				ASSERT_TRUE(withinDepthBound(descending)) << "alpha " << alphas[a];
+			}
+		}
+		EXPECT_EQ(20000u, ascending.size());
+		EXPECT_EQ(20000u, descending.size());
+		EXPECT_TRUE(withinDepthBound(ascending));
+		EXPECT_TRUE(withinDepthBound(descending));
+	}
+}
+
+TEST(Scapegoat, InterleavedRemovesKeepSizeAndBound)
+{
+	Tree tree;
+	std::map<int, int> items;
+	std::mt19937 rng(22);
+	for(int step = 0; step < 40000; ++step)
+	{
+		//sorted runs of inserts, with random removes mixed in
+		if(rng() % 3 == 0 && !items.empty())
+		{
+			int key = int(rng() % (step + 1));
+			tree.remove(key);
+			items.erase(key);
+		}
+		else
+		{
+			tree.insert(std::make_pair(step, step));
+			items[step] = step;
+		}
+		ASSERT_EQ(items.size(), tree.size()) << "step " << step;
+		if(step % 101 == 0)
+		{
+			ASSERT_TRUE(withinDepthBound(tree)) << "step " << step;
+		}
+	}
+	EXPECT_TRUE(sameItems(tree, items));
+
+	//remove down to nothing; the full rebuilds along the way keep the bound
+	for(std::map<int, int>::const_iterator it = items.begin(); it != items.end(); ++it)
+	{
+		tree.remove(it->first);
+		if(it->first % 53 == 0)
+		{
+			ASSERT_TRUE(withinDepthBound(tree));
+		}
+	}
+	EXPECT_EQ(0u, tree.size());
+	EXPECT_TRUE(tree.empty());
+}
+
+TEST(Scapegoat, SizeStartsOverAfterClear)
+{
+	Tree tree;
+	for(int i = 0; i < 100; ++i)
+	{
+		tree.insert(std::make_pair(i, i));
+	}
+	tree.clear();
+	EXPECT_EQ(0u, tree.size());
+	for(int i = 0; i < 10; ++i)
+	{
+		tree.insert(std::make_pair(i, i));
+	}
+	EXPECT_EQ(10u, tree.size());
+	EXPECT_TRUE(withinDepthBound(tree));
+}
+
+TEST(Scapegoat, RejectsAlphaOutOfRange)
+{
+	EXPECT_THROW(Tree(0.5), std::invalid_argument);
+	EXPECT_THROW(Tree(1.0), std::invalid_argument);
+	EXPECT_THROW(Tree(0.2), std::invalid_argument);
+	EXPECT_THROW(Tree(1.5), std::invalid_argument);
+	EXPECT_THROW(Tree(-0.7), std::invalid_argument);
+	EXPECT_THROW(Tree(std::nan("")), std::invalid_argument);
+	EXPECT_NO_THROW(Tree(0.51));
+	EXPECT_NO_THROW(Tree(0.99));
+	EXPECT_DOUBLE_EQ(0.75, Tree(0.75).alpha());
+}
@@ -0,0 +1,126 @@
+#include "check_trees.h"
+
+#include <random>
+#include <set>
+
+typedef AVLTree<int, int, OrderStatistics> SizedTree;
+
+// Large enough that the top levels of the recursion (height >=
+// PARALLEL_MIN_HEIGHT) are forked onto the thread pool.
+static const int BIG = 60000;
+
+static std::set<int> randomKeys(std::mt19937& rng, int count, int range)
+{
+	std::set<int> keys;
+	while(keys.size() < std::size_t(count))
+	{
+		keys.insert(int(rng() % range));
+	}
+	return keys;
+}
+
+static void load(SizedTree& tree, const std::set<int>& keys, int tag)
+{
+	for(std::set<int>::const_iterator it = keys.begin(); it != keys.end(); ++it)
+	{
+		tree.insert(std::make_pair(*it, tag));
+	}
+}
+
+enum Operation { UNION, INTERSECTION, DIFFERENCE };
+
+// Runs op on trees holding a and b (this tree's values are tagged 1,
+// other's 2) and checks the result against std::set.
+static void checkOperation(Operation op, const std::set<int>& a, const std::set<int>& b, ThreadPool& threads)
+{
+	SizedTree left;
+	SizedTree right;
+	load(left, a, 1);
+	load(right, b, 2);
+	std::map<int, int> expected;
+	for(std::set<int>::const_iterator it = a.begin(); it != a.end(); ++it)
+	{
+		bool inB = b.count(*it) > 0;
+		if(op == UNION || (op == INTERSECTION && inB) || (op == DIFFERENCE && !inB))
+		{
+			expected[*it] = 1;
+		}
+	}
+	if(op == UNION)
+	{
+		for(std::set<int>::const_iterator it = b.begin(); it != b.end(); ++it)
+		{
+			expected.insert(std::make_pair(*it, 2));
+		}
+	}
+
+	if(op == UNION)
+	{
+		left.set_union(right, threads);
+	}
+	else if(op == INTERSECTION)
+	{
+		left.set_intersection(right, threads);
+	}
+	else
+	{
+		left.set_difference(right, threads);
+	}
+	ASSERT_TRUE(verifyAVL(left, expected.size()));
+	EXPECT_EQ(expected.size(), left.size());
+	EXPECT_TRUE(sameItems(left, expected));
+	EXPECT_TRUE(right.empty());
+	EXPECT_EQ(0u, right.size());
+	EXPECT_TRUE(verifyAVL(right, 0));
+}
+
+static void checkAll(const std::set<int>& a, const std::set<int>& b, ThreadPool& threads)
+{
+	checkOperation(UNION, a, b, threads);
+	checkOperation(INTERSECTION, a, b, threads);
+	checkOperation(DIFFERENCE, a, b, threads);
+}
+
+TEST(AVLSetOperations, LargeOverlappingTrees)
+{
+	ThreadPool threads(4);
+	std::mt19937 rng(11);
+	std::set<int> a = randomKeys(rng, BIG, BIG * 2);
+	std::set<int> b = randomKeys(rng, BIG, BIG * 2);
+	checkAll(a, b, threads);
+}
+
+TEST(AVLSetOperations, LargeAndSmall)
+{
+	ThreadPool threads(4);
+	std::mt19937 rng(12);
+	std::set<int> big = randomKeys(rng, BIG, BIG * 4);
+	std::set<int> small = randomKeys(rng, 500, BIG * 4);
+	checkAll(big, small, threads);
+	checkAll(small, big, threads);
+}
+
+TEST(AVLSetOperations, DisjointAndIdentical)
+{
+	ThreadPool threads(4);
+	std::set<int> evens;
+	std::set<int> odds;
+	for(int i = 0; i < BIG; ++i)
+	{
+		(i % 2 == 0 ? evens : odds).insert(i);
+	}
+	checkAll(evens, odds, threads);
+	checkAll(evens, evens, threads);
+	checkAll(evens, std::set<int>(), threads);
+	checkAll(std::set<int>(), odds, threads);
+}
+
+TEST(AVLSetOperations, SharedPoolAndSingleThread)
+{
+	ThreadPool one(1);
+	std::mt19937 rng(13);
+	std::set<int> a = randomKeys(rng, 3000, 10000);
+	std::set<int> b = randomKeys(rng, 3000, 10000);
+	checkAll(a, b, one);
+	checkAll(a, b, ThreadPool::shared());
+}
@@ -0,0 +1,181 @@
+#include "check_trees.h"
+
+#include <random>
+
+#include <shardedmap.h>
+
+typedef ShardedAVLMap<int, long> Sharded;
+
+static std::map<int, long> contents(const Sharded& map)
+{
+	std::map<int, long> items;
+	map.forEach([&](const std::pair<const int, long>& item)
+	{
+		items.insert(item);
+	});
+	return items;
+}
+
+// forEach must hand out the keys in increasing order.
+static testing::AssertionResult visitsInOrder(const Sharded& map)
+{
+	bool first = true;
+	int last = 0;
+	testing::AssertionResult result = testing::AssertionSuccess();
+	map.forEach([&](const std::pair<const int, long>& item)
+	{
+		if(!first && !(last < item.first) && result)
+		{
+			result = testing::AssertionFailure() << item.first << " came after " << last;
+		}
+		first = false;
+		last = item.first;
+	});
+	return result;
+}
+
+TEST(ShardedAVLMap, SingleOperationsAgainstMap)
+{
+	std::mt19937 rng(14);
+	const std::size_t shardCounts[] = { 1, 3, 16 };
+	for(std::size_t s = 0; s < 3; ++s)
+	{
+		Sharded map(shardCounts[s]);
+		std::map<int, long> items;
+		EXPECT_EQ(shardCounts[s], map.shardCount());
+		EXPECT_TRUE(map.empty());
+		for(int i = 0; i < 5000; ++i)
+		{
+			int key = int(rng() % 2000) - 1000;
+			long value = long(rng());
+			switch(rng() % 3)
+			{
+			case 0:
+				EXPECT_EQ(items.count(key) == 0, map.insert(std::make_pair(key, value)));
+				items[key] = value;
+				break;
+			case 1:
+				EXPECT_EQ(items.erase(key) > 0, map.remove(key));
+				break;
+			default:
+			{
+				long found = 0;
+				EXPECT_EQ(items.count(key) > 0, map.find(key, found));
+				EXPECT_EQ(items.count(key) > 0, map.contains(key));
+				if(items.count(key) > 0)
+				{
+					EXPECT_EQ(items[key], found);
+				}
+			}
+			}
+		}
+		EXPECT_EQ(items.size(), map.size());
+		EXPECT_TRUE(visitsInOrder(map));
+		EXPECT_EQ(items, contents(map));
+		map.clear();
+		EXPECT_TRUE(map.empty());
+		EXPECT_TRUE(contents(map).empty());
+	}
+	EXPECT_THROW(Sharded(0), std::invalid_argument);
+}
+
+TEST(ShardedAVLMap, BatchedOperationsAgainstMap)
+{
+	std::mt19937 rng(41);
+	Sharded map(7);
+	std::map<int, long> items;
+	for(int round = 0; round < 50; ++round)
+	{
+		std::vector<std::pair<const int, long> > batch;
+		std::size_t added = 0;
+		for(int i = 0; i < 200; ++i)
+		{
+			//repeats within a batch keep the last value, like single inserts
+			int key = int(rng() % 3000);
+			batch.push_back(std::make_pair(key, long(i + round * 1000)));
+			if(items.count(key) == 0)
+			{
+				++added;
+			}
+			items[key] = i + round * 1000;
+		}
+		EXPECT_EQ(added, map.insert(batch.begin(), batch.end()));
+
+		std::vector<int> keys;
+		for(int i = 0; i < 100; ++i)
+		{
+			keys.push_back(int(rng() % 3000));
+		}
+		std::map<int, long> seen;
+		std::size_t present = 0;
+		for(std::size_t i = 0; i < keys.size(); ++i)
+		{
+			present += items.count(keys[i]);
+		}
+		EXPECT_EQ(present, map.find(keys.begin(), keys.end(), [&](const std::pair<const int, long>& item)
+		{
+			seen[item.first] = item.second;
+		}));
+		for(std::map<int, long>::iterator it = seen.begin(); it != seen.end(); ++it)
+		{
+			EXPECT_EQ(items[it->first], it->second);
+		}
+
+		std::vector<int> gone(keys.begin(), keys.begin() + 50);
+		std::sort(gone.begin(), gone.end());
+		gone.erase(std::unique(gone.begin(), gone.end()), gone.end());
+		std::size_t removed = 0;
+		for(std::size_t i = 0; i < gone.size(); ++i)
+		{
+			removed += items.erase(gone[i]);
+		}
+		EXPECT_EQ(removed, map.remove(gone.begin(), gone.end()));
+		ASSERT_EQ(items.size(), map.size()) << "round " << round;
+	}
+	EXPECT_TRUE(visitsInOrder(map));
+	EXPECT_EQ(items, contents(map));
+}
+
+TEST(ShardedAVLMap, ForEachWhileWritersRun)
+{
+	Sharded map(8);
+	std::atomic<bool> done(false);
+	std::vector<std::thread> writers;
+	for(int t = 0; t < 3; ++t)
+	{
+		writers.push_back(std::thread([&map, t]()
+		{
+			std::mt19937 rng(t);
+			for(int round = 0; round < 100; ++round)
+			{
+				std::vector<std::pair<const int, long> > batch;
+				for(int i = 0; i < 50; ++i)
+				{
+					batch.push_back(std::make_pair(t * 10000 + int(rng() % 1000), long(round)));
+				}
+				map.insert(batch.begin(), batch.end());
+				std::vector<int> keys;
+				for(int i = 0; i < 20; ++i)
+				{
+					keys.push_back(t * 10000 + int(rng() % 1000));
+				}
+				map.remove(keys.begin(), keys.end());
+			}
+		}));
+	}
+	std::thread reader([&]()
+	{
+		while(!done.load())
+		{
+			EXPECT_TRUE(visitsInOrder(map));
+		}
+	});
+	for(std::size_t t = 0; t < writers.size(); ++t)
+	{
+		writers[t].join();
+	}
+	done.store(true);
+	reader.join();
+	EXPECT_TRUE(visitsInOrder(map));
+	EXPECT_EQ(map.size(), contents(map).size());
+}
@@ -0,0 +1,137 @@
+#include "check_trees.h"
+
+#include <random>
+
+#include <splay.h>
+
+typedef SplayTree<int, int> Splay;
+
+static testing::AssertionResult verifySplay(Splay& tree, std::size_t size)
+{
+	testing::AssertionResult result = testing::AssertionSuccess();
+	int count = checkLinks<int, int>(tree.root_, static_cast<Node<int, int>*>(nullptr), nullptr, nullptr, result);
+	if(count < 0)
+	{
+		return result;
+	}
+	if(std::size_t(count) != size)
+	{
+		return testing::AssertionFailure() << "Tree has " << count << " nodes, expected " << size;
+	}
+	return testing::AssertionSuccess();
+}
+
+TEST(SplayTree, RandomOperationsAgainstMap)
+{
+	std::mt19937 rng(20);
+	Splay tree;
+	std::map<int, int> items;
+	for(int i = 0; i < 20000; ++i)
+	{
+		int key = int(rng() % 2000);
+		switch(rng() % 4)
+		{
+		case 0:
+		case 1:
+			tree.insert(std::make_pair(key, i));
+			items[key] = i;
+			ASSERT_EQ(key, tree.root_->getKey());
+			break;
+		case 2:
+			tree.remove(key);
+			items.erase(key);
+			break;
+		default:
+		{
+			Splay::iterator it = tree.find(key);
+			ASSERT_EQ(items.count(key) > 0, it != tree.end()) << key;
+			if(it != tree.end())
+			{
+				EXPECT_EQ(items[key], it->second);
+				EXPECT_EQ(key, tree.root_->getKey());
+			}
+		}
+		}
+		if(i % 500 == 0)
+		{
+			ASSERT_TRUE(verifySplay(tree, items.size())) << "step " << i;
+		}
+	}
+	EXPECT_TRUE(verifySplay(tree, items.size()));
+	EXPECT_TRUE(sameItems(tree, items));
+}
+
+TEST(SplayTree, MissesSplayTheLastNodeOnThePath)
+{
+	Splay tree;
+	for(int i = 0; i < 100; i += 2)
+	{
+		tree.insert(std::make_pair(i, i));
+	}
+	EXPECT_TRUE(tree.find(51) == tree.end());
+	int root = tree.root_->getKey();
+	EXPECT_TRUE(root == 50 || root == 52) << root;
+	EXPECT_TRUE(tree.find(1000) == tree.end());
+	EXPECT_EQ(98, tree.root_->getKey());
+	EXPECT_TRUE(tree.find(-1) == tree.end());
+	EXPECT_EQ(0, tree.root_->getKey());
+	EXPECT_TRUE(verifySplay(tree, 50));
+}
+
+TEST(SplayTree, ConstLookupsKeepTheShape)
+{
+	Splay tree;
+	for(int i = 0; i < 100; ++i)
+	{
+		tree.insert(std::make_pair(i, i));
+	}
+	const Splay& view = tree;
+	Node<int, int>* root = tree.root_;
+	EXPECT_EQ(10, view.find(10)->second);
+	EXPECT_EQ(20, view.lower_bound(20)->first);
+	EXPECT_EQ(30, view[30]);
+	EXPECT_EQ(root, tree.root_);
+
+	//operator[] on an existing key only looks it up, overwrites splay
+	tree[40] = -40;
+	EXPECT_EQ(root, tree.root_);
+	EXPECT_EQ(-40, view[40]);
+	tree.insert(std::make_pair(50, -50));
+	EXPECT_EQ(50, tree.root_->getKey());
+	tree.insert_or_assign(60, -60);
+	EXPECT_EQ(60, tree.root_->getKey());
+	EXPECT_TRUE(verifySplay(tree, 100));
+}
+
+TEST(SplayTree, IteratorsAndEndHintsSurviveSplays)
+{
+	Splay tree;
+	std::map<int, int> items;
+	std::vector<Splay::iterator> kept;
+	for(int i = 0; i < 500; ++i)
+	{
+		kept.push_back(tree.insert(tree.end(), std::make_pair(i, i)));
+		items[i] = i;
+	}
+	std::mt19937 rng(2);
+	for(int i = 0; i < 2000; ++i)
+	{
+		tree.find(int(rng() % 500));
+	}
+	for(int i = 0; i < 500; ++i)
+	{
+		EXPECT_EQ(i, kept[i]->first);
+	}
+	//the largest key moves around but appending at end() still works
+	Splay::iterator last = tree.insert(tree.end(), std::make_pair(500, 500));
+	items[500] = 500;
+	EXPECT_TRUE(++last == tree.end());
+	tree.remove(500);
+	tree.remove(499);
+	items.erase(500);
+	items.erase(499);
+	tree.insert(tree.end(), std::make_pair(1000, 1));
+	items[1000] = 1;
+	EXPECT_TRUE(verifySplay(tree, items.size()));
+	EXPECT_TRUE(sameItems(tree, items));
+}
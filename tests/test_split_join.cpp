@@ -0,0 +1,223 @@
+#include "check_trees.h"
+
+#include <random>
+#include <set>
+
+typedef AVLTree<int, int, OrderStatistics> SizedTree;
+
+static std::map<int, int> fill(SizedTree& tree, int count, unsigned seed)
+{
+	std::mt19937 rng(seed);
+	std::map<int, int> items;
+	while(items.size() < std::size_t(count))
+	{
+		int key = int(rng() % (count * 4));
+		tree.insert(std::make_pair(key, key * 3));
+		items[key] = key * 3;
+	}
+	return items;
+}
+
+TEST(AVLSplit, EveryCutPoint)
+{
+	for(int cut = -1; cut <= 201; cut += 7)
+	{
+		SizedTree left;
+		std::map<int, int> items = fill(left, 50, 1);
+		SizedTree right;
+		right.insert(std::make_pair(1000, 1));
+		left.split(cut, right);
+
+		std::map<int, int> below(items.begin(), items.lower_bound(cut));
+		std::map<int, int> above(items.lower_bound(cut), items.end());
+		EXPECT_TRUE(verifyAVL(left, below.size()));
+		EXPECT_TRUE(verifyAVL(right, above.size()));
+		EXPECT_EQ(below.size(), left.size());
+		EXPECT_EQ(above.size(), right.size());
+		EXPECT_TRUE(sameItems(left, below));
+		EXPECT_TRUE(sameItems(right, above));
+	}
+}
+
+TEST(AVLJoin, AppendAndPivot)
+{
+	SizedTree left;
+	SizedTree right;
+	std::map<int, int> items;
+	for(int i = 0; i < 300; ++i)
+	{
+		left.insert(std::make_pair(i, i));
+		items[i] = i;
+	}
+	for(int i = 1000; i < 1040; ++i)
+	{
+		right.insert(std::make_pair(i, i));
+		items[i] = i;
+	}
+	left.join(right);
+	EXPECT_TRUE(verifyAVL(left, items.size()));
+	EXPECT_TRUE(verifyAVL(right, 0));
+	EXPECT_EQ(items.size(), left.size());
+	EXPECT_TRUE(sameItems(left, items));
+
+	SizedTree upper;
+	for(int i = 2000; i < 2700; ++i)
+	{
+		upper.insert(std::make_pair(i, i));
+		items[i] = i;
+	}
+	SizedTree joined;
+	joined.join(left, std::make_pair(1500, 1500), upper);
+	items[1500] = 1500;
+	EXPECT_TRUE(verifyAVL(joined, items.size()));
+	EXPECT_TRUE(left.empty());
+	EXPECT_TRUE(upper.empty());
+	EXPECT_EQ(items.size(), joined.size());
+	EXPECT_TRUE(sameItems(joined, items));
+}
+
+TEST(AVLJoin, RejectsOverlap)
+{
+	SizedTree left;
+	SizedTree right;
+	left.insert(std::make_pair(5, 5));
+	right.insert(std::make_pair(5, 5));
+	EXPECT_THROW(left.join(right), std::invalid_argument);
+	EXPECT_THROW(left.split(3, left), std::invalid_argument);
+}
+
+TEST(AVLSplit, RoundTrips)
+{
+	SizedTree tree;
+	std::map<int, int> items = fill(tree, 2000, 2);
+	std::mt19937 rng(3);
+	for(int round = 0; round < 200; ++round)
+	{
+		int cut = int(rng() % 8000);
+		SizedTree upper;
+		tree.split(cut, upper);
+		ASSERT_TRUE(verifyAVL(tree, tree.size()));
+		ASSERT_TRUE(verifyAVL(upper, upper.size()));
+		tree.join(upper);
+		ASSERT_TRUE(verifyAVL(tree, items.size()));
+	}
+	EXPECT_TRUE(sameItems(tree, items));
+}
+
+// The halves of a split share a node pool but must behave like
+// independent trees, including when two threads modify them.
+TEST(AVLSplit, HalvesWrittenFromTwoThreads)
+{
+	SizedTree lower;
+	for(int i = 0; i < 100000; ++i)
+	{
+		lower.insert(std::make_pair(i, i));
+	}
+	SizedTree upper;
+	lower.split(50000, upper);
+
+	auto churn = [](SizedTree* tree, int base) {
+		for(int round = 0; round < 3; ++round)
+		{
+			for(int i = 0; i < 50000; i += 2)
+			{
+				tree->remove(base + i);
+			}
+			for(int i = 0; i < 50000; i += 2)
+			{
+				tree->insert(std::make_pair(base + i, -i));
+			}
+		}
+	};
+	std::thread first(churn, &lower, 0);
+	std::thread second(churn, &upper, 50000);
+	first.join();
+	second.join();
+
+	EXPECT_TRUE(verifyAVL(lower, 50000));
+	EXPECT_TRUE(verifyAVL(upper, 50000));
+	EXPECT_EQ(50000u, lower.size());
+	EXPECT_EQ(50000u, upper.size());
+}
+
+// Splits and joins on one tree merge its pool with others while a
+// sibling tree on the same pool keeps allocating from another thread.
+TEST(AVLJoin, WhileASiblingInserts)
+{
+	SizedTree lower;
+	for(int i = 0; i < 20000; ++i)
+	{
+		lower.insert(std::make_pair(i, i));
+	}
+	SizedTree upper;
+	lower.split(10000, upper);
+
+	std::thread sibling([&upper]() {
+		for(int round = 0; round < 20; ++round)
+		{
+			for(int i = 10000; i < 20000; i += 2)
+			{
+				upper.remove(i);
+			}
+			for(int i = 10000; i < 20000; i += 2)
+			{
+				upper.insert(std::make_pair(i, -i));
+			}
+		}
+	});
+	for(int round = 0; round < 2000; ++round)
+	{
+		SizedTree tail;
+		for(int i = 0; i < 10; ++i)
+		{
+			tail.insert(std::make_pair(50000 + i, i));
+		}
+		//moves lower's nodes out of the pool upper is using, and back
+		SizedTree whole;
+		whole.join(lower, std::make_pair(40000, 0), tail);
+		SizedTree rest;
+		whole.split(40000, rest);
+		lower.join(whole);
+	}
+	sibling.join();
+
+	std::map<int, int> expect;
+	for(int i = 0; i < 10000; ++i)
+	{
+		expect[i] = i;
+	}
+	EXPECT_TRUE(verifyAVL(lower, 10000));
+	EXPECT_TRUE(sameItems(lower, expect));
+	EXPECT_TRUE(verifyAVL(upper, 10000));
+	EXPECT_EQ(-10000, upper.find(10000)->second);
+}
+
+// A tree that no longer holds nodes from a split or join must not keep
+// the shared pool (and so the other tree's memory) alive.
+TEST(AVLSplit, EmptiedTreesLetGoOfThePool)
+{
+	SizedTree lower;
+	for(int i = 0; i < 1000; ++i)
+	{
+		lower.insert(std::make_pair(i, i));
+	}
+	SizedTree upper;
+	lower.split(500, upper);
+	EXPECT_EQ(&lower.pool(), &upper.pool());
+
+	upper.clear();
+	EXPECT_NE(&lower.pool(), &upper.pool());
+	EXPECT_EQ(1, lower.pool_.use_count());
+
+	SizedTree more;
+	for(int i = 2000; i < 2100; ++i)
+	{
+		more.insert(std::make_pair(i, i));
+	}
+	lower.join(more);
+	EXPECT_NE(&lower.pool(), &more.pool());
+	EXPECT_EQ(1, more.pool_.use_count());
+	more.insert(std::make_pair(1, 1));
+	EXPECT_TRUE(verifyAVL(more, 1));
+	EXPECT_TRUE(verifyAVL(lower, 600));
+}
@@ -0,0 +1,131 @@
+#include "check_trees.h"
+
+#include <random>
+
+// A key that counts how often one is made, so the tests can tell that a
+// lookup by id did not build a temporary Account.
+struct Account
+{
+	static int made;
+
+	Account(int i, const std::string& n) : id(i), name(n) { ++made; }
+	Account(const Account& other) : id(other.id), name(other.name) { ++made; }
+	Account(Account&& other) : id(other.id), name(std::move(other.name)) { ++made; }
+
+	bool operator==(const Account& other) const { return id == other.id; }
+
+	int id;
+	std::string name;
+};
+
+int Account::made = 0;
+
+std::ostream& operator<<(std::ostream& out, const Account& account)
+{
+	return out << account.id;
+}
+
+struct ById
+{
+	typedef void is_transparent;
+
+	bool operator()(const Account& a, const Account& b) const { return a.id < b.id; }
+	bool operator()(const Account& a, int b) const { return a.id < b; }
+	bool operator()(int a, const Account& b) const { return a < b.id; }
+};
+
+// The checkers compare keys with operator<, which Account lacks.
+bool operator<(const Account& a, const Account& b)
+{
+	return a.id < b.id;
+}
+
+template<typename Tree>
+void lookUpById(Tree& tree)
+{
+	std::map<int, int> items;
+	for(int i = 0; i < 1000; i += 3)
+	{
+		tree.insert(std::make_pair(Account(i, "n" + std::to_string(i)), i * 2));
+		items[i] = i * 2;
+	}
+	int made = Account::made;
+	for(int key = -2; key < 1002; ++key)
+	{
+		typename Tree::iterator it = tree.find(key);
+		ASSERT_EQ(items.count(key) > 0, it != tree.end()) << key;
+		if(it != tree.end())
+		{
+			EXPECT_EQ(key, it->first.id);
+			EXPECT_EQ(items[key], it->second);
+		}
+		typename Tree::iterator lower = tree.lower_bound(key);
+		std::map<int, int>::iterator want = items.lower_bound(key);
+		ASSERT_EQ(want != items.end(), lower != tree.end()) << key;
+		if(want != items.end())
+		{
+			EXPECT_EQ(want->first, lower->first.id);
+		}
+	}
+	for(int key = 0; key < 1000; key += 2)
+	{
+		tree.remove(key);
+		items.erase(key);
+	}
+	EXPECT_EQ(made, Account::made);
+
+	std::size_t count = 0;
+	std::map<int, int>::iterator want = items.begin();
+	for(typename Tree::iterator it = tree.begin(); it != tree.end(); ++it, ++want, ++count)
+	{
+		ASSERT_TRUE(want != items.end());
+		EXPECT_EQ(want->first, it->first.id);
+	}
+	EXPECT_EQ(items.size(), count);
+}
+
+TEST(TransparentCompare, PlainTree)
+{
+	BinarySearchTree<Account, int, ById> tree;
+	lookUpById(tree);
+}
+
+TEST(TransparentCompare, AVLTree)
+{
+	AVLTree<Account, int, OrderStatistics, ById> tree;
+	lookUpById(tree);
+	EXPECT_TRUE(verifyAVL(tree, tree.size()));
+	EXPECT_EQ(tree.size(), tree.count_range(Account(-1, ""), Account(1000, "")));
+}
+
+TEST(TransparentCompare, RedBlackTree)
+{
+	RedBlackTree<Account, int, ById> tree;
+	lookUpById(tree);
+	std::size_t count = 0;
+	for(RedBlackTree<Account, int, ById>::iterator it = tree.begin(); it != tree.end(); ++it)
+	{
+		++count;
+	}
+	EXPECT_TRUE(verifyRB(tree, count));
+}
+
+TEST(TransparentCompare, KeyLookupsStillWork)
+{
+	AVLTree<Account, int, NoAugment, ById> tree;
+	tree.insert(std::make_pair(Account(5, "five"), 5));
+	tree.insert(std::make_pair(Account(7, "seven"), 7));
+	EXPECT_EQ(std::string("five"), tree.find(Account(5, ""))->first.name);
+	EXPECT_EQ(7, tree.lower_bound(Account(6, ""))->first.id);
+	tree.remove(Account(5, ""));
+	EXPECT_TRUE(tree.find(5) == tree.end());
+	EXPECT_TRUE(verifyAVL(tree, 1));
+
+	//a plain std::less tree still converts the argument to Key
+	AVLTree<std::string, int> words;
+	words.insert(std::make_pair(std::string("apple"), 1));
+	words.insert(std::make_pair(std::string("pear"), 2));
+	EXPECT_EQ(2, words.find("pear")->second);
+	words.remove("apple");
+	EXPECT_TRUE(words.find("apple") == words.end());
+}
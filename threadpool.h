@@ -0,0 +1,283 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <cstddef>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <functional>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <atomic>
+
+/**
+* A fixed set of worker threads for fork-join style divide and conquer,
+* as used by the AVLTree set operations. invoke(a, b) runs a on the pool
+* and b on the calling thread, then waits for a. While it waits, the
+* caller runs other queued tasks itself, so nested invoke() calls from
+* inside tasks cannot deadlock even when every worker is busy.
+*
+* Each worker has its own task deque. Tasks submitted from a worker go
+* onto its deque and are taken back newest first, so a fork-join tree
+* runs depth first on one thread. Idle workers steal the oldest task
+* from another deque (the biggest piece of work left there); tasks from
+* outside the pool go through a shared queue.
+*
+* A pool with no workers runs everything on the calling thread.
+* shared() returns a process-wide pool with one worker per core.
+*/
+class ThreadPool
+{
+public:
+    explicit ThreadPool(std::size_t threads = std::thread::hardware_concurrency());
+    ~ThreadPool();
+
+    std::size_t size() const;
+
+    template<typename Fn>
+    std::future<void> submit(Fn fn);
+    template<typename Fn1, typename Fn2>
+    void invoke(Fn1&& first, Fn2&& second);
+
+    static ThreadPool& shared();
+
+private:
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    struct TaskQueue
+    {
+        std::mutex mutex;
+        std::deque<std::function<void()> > tasks;
+    };
+
+    static const std::size_t NOT_A_WORKER = static_cast<std::size_t>(-1);
+
+    std::size_t workerIndex() const;
+    bool takeTask(std::size_t self, std::function<void()>& task);
+    bool runPending();
+    void helpUntilReady(const std::future<void>& pending);
+    void workerLoop(std::size_t index);
+
+    std::vector<std::thread> workers_;
+    std::vector<std::unique_ptr<TaskQueue> > queues_;   // one per worker
+    TaskQueue injected_;                                // from other threads
+    std::atomic<long> queued_;
+    std::mutex mutex_;
+    std::condition_variable ready_;
+    bool stopping_;
+};
+
+/*
+  -----------------------------------------------
+  Begin implementations for the ThreadPool class.
+  -----------------------------------------------
+*/
+
+/**
+* Starts the given number of worker threads.
+*/
+inline ThreadPool::ThreadPool(std::size_t threads) :
+    queued_(0),
+    stopping_(false)
+{
+    for(std::size_t i = 0; i < threads; ++i) {
+        queues_.push_back(std::unique_ptr<TaskQueue>(new TaskQueue()));
+    }
+    for(std::size_t i = 0; i < threads; ++i) {
+        workers_.push_back(std::thread(&ThreadPool::workerLoop, this, i));
+    }
+}
+
+/**
+* Lets the workers finish the queued tasks, then joins them.
+*/
+inline ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    ready_.notify_all();
+    for(std::size_t i = 0; i < workers_.size(); ++i) {
+        workers_[i].join();
+    }
+}
+
+/**
+* A getter for the number of worker threads.
+*/
+inline std::size_t ThreadPool::size() const
+{
+    return workers_.size();
+}
+
+/**
+* Queues fn to run on a worker: on the calling worker's own deque, or on
+* the shared queue when called from outside the pool. Exceptions thrown
+* by fn come out of the returned future.
+*/
+template<typename Fn>
+std::future<void> ThreadPool::submit(Fn fn)
+{
+    std::shared_ptr<std::packaged_task<void()> > task =
+        std::make_shared<std::packaged_task<void()> >(std::move(fn));
+    std::future<void> result = task->get_future();
+    std::size_t self = workerIndex();
+    TaskQueue& queue = self == NOT_A_WORKER ? injected_ : *queues_[self];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back([task]() { (*task)(); });
+    }
+    {
+        //under mutex_ so a worker about to sleep cannot miss it
+        std::lock_guard<std::mutex> lock(mutex_);
+        queued_.fetch_add(1);
+    }
+    ready_.notify_one();
+    return result;
+}
+
+/**
+* Runs first and second in parallel and returns once both are done. If
+* either throws, the exception is rethrown here (after both finished).
+*/
+template<typename Fn1, typename Fn2>
+void ThreadPool::invoke(Fn1&& first, Fn2&& second)
+{
+    if(workers_.empty()) {
+        first();
+        second();
+        return;
+    }
+    std::future<void> pending = submit([&first]() { first(); });
+    try {
+        second();
+    } catch(...) {
+        //first may still be queued on this thread's own deque
+        helpUntilReady(pending);
+        throw;
+    }
+    helpUntilReady(pending);
+    pending.get();
+}
+
+/**
+* The process-wide pool, started on first use.
+*/
+inline ThreadPool& ThreadPool::shared()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+/**
+* The index of the calling thread among this pool's workers, or
+* NOT_A_WORKER.
+*/
+inline std::size_t ThreadPool::workerIndex() const
+{
+    for(std::size_t i = 0; i < workers_.size(); ++i) {
+        if(workers_[i].get_id() == std::this_thread::get_id()) {
+            return i;
+        }
+    }
+    return NOT_A_WORKER;
+}
+
+/**
+* Takes a task for the given worker (or NOT_A_WORKER): the newest one on
+* its own deque, else the oldest shared one, else the oldest one of
+* another worker.
+*/
+inline bool ThreadPool::takeTask(std::size_t self, std::function<void()>& task)
+{
+    std::size_t count = queues_.size();
+    for(std::size_t step = 0; step <= count + 1; ++step) {
+        TaskQueue* queue;
+        bool newest = false;
+        if(step == 0) {
+            if(self == NOT_A_WORKER) {
+                continue;
+            }
+            queue = queues_[self].get();
+            newest = true;
+        } else if(step == 1) {
+            queue = &injected_;
+        } else {
+            std::size_t victim = (self == NOT_A_WORKER ? 0 : self + 1) + step - 2;
+            queue = queues_[victim % count].get();
+        }
+        std::lock_guard<std::mutex> lock(queue->mutex);
+        if(queue->tasks.empty()) {
+            continue;
+        }
+        if(newest) {
+            task = std::move(queue->tasks.back());
+            queue->tasks.pop_back();
+        } else {
+            task = std::move(queue->tasks.front());
+            queue->tasks.pop_front();
+        }
+        queued_.fetch_sub(1);
+        return true;
+    }
+    return false;
+}
+
+/**
+* Runs one queued task on the calling thread. Returns false if there
+* was nothing to run.
+*/
+inline bool ThreadPool::runPending()
+{
+    std::function<void()> task;
+    if(!takeTask(workerIndex(), task)) {
+        return false;
+    }
+    task();
+    return true;
+}
+
+/**
+* Waits for pending, running queued tasks meanwhile. The task behind
+* pending may still sit on the caller's own deque, and if every other
+* thread is blocked as well nobody else would ever run it. Once nothing
+* is queued, pending is running on some other thread and blocking is
+* safe.
+*/
+inline void ThreadPool::helpUntilReady(const std::future<void>& pending)
+{
+    while(pending.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        if(!runPending()) {
+            pending.wait();
+        }
+    }
+}
+
+inline void ThreadPool::workerLoop(std::size_t index)
+{
+    for(;;) {
+        std::function<void()> task;
+        if(takeTask(index, task)) {
+            task();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(mutex_);
+        ready_.wait(lock, [this]() { return stopping_ || queued_.load() > 0; });
+        if(stopping_ && queued_.load() <= 0) {
+            return;
+        }
+    }
+}
+
+/*
+  ---------------------------------------------
+  End implementations for the ThreadPool class.
+  ---------------------------------------------
+*/
+
+#endif